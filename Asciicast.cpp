@@ -0,0 +1,144 @@
+// Copyright (C)
+
+#include "./Asciicast.h"
+#include "./SocketTerminalManager.h"
+#include "./TetrisGame.h"
+#include "./VersusView.h"
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+// Buffered bytes that are written in one piece
+static constexpr size_t flushThreshold = 1 << 20;
+
+// Append the string to the buffer as the contents of a JSON string.
+static void appendJson(std::string *buffer, const std::string &data) {
+  static const char *hex = "0123456789abcdef";
+  for (char c : data) {
+    unsigned char byte = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      buffer->push_back('\\');
+      buffer->push_back(c);
+    } else if (byte < 0x20 || byte == 0x7F) {
+      buffer->append("\\u00");
+      buffer->push_back(hex[byte >> 4]);
+      buffer->push_back(hex[byte & 15]);
+    } else {
+      buffer->push_back(c);
+    }
+  }
+}
+
+// ____________________________________________________________________________
+AsciicastWriter::AsciicastWriter(const std::string &path, int width,
+                                 int height, Format format,
+                                 const std::string &title)
+    : format_(format) {
+  file_ = fopen(path.c_str(), "wb");
+  if (file_ == nullptr) {
+    throw std::runtime_error("Could not create recording " + path);
+  }
+  buffer_.reserve(flushThreshold + (1 << 16));
+  if (format_ == Format::Asciicast) {
+    buffer_ += "{\"version\": 2, \"width\": " + std::to_string(width) +
+               ", \"height\": " + std::to_string(height);
+    if (!title.empty()) {
+      buffer_ += ", \"title\": \"";
+      appendJson(&buffer_, title);
+      buffer_ += "\"";
+    }
+    buffer_ += "}\n";
+  }
+}
+
+// ____________________________________________________________________________
+AsciicastWriter::~AsciicastWriter() {
+  if (file_ != nullptr) {
+    flush();
+    fclose(file_);
+  }
+}
+
+// ____________________________________________________________________________
+void AsciicastWriter::output(double seconds, const std::string &data) {
+  if (format_ == Format::Ansi) {
+    buffer_ += data;
+  } else {
+    char time[32];
+    snprintf(time, sizeof(time), "[%.6f, \"o\", \"", seconds);
+    buffer_ += time;
+    appendJson(&buffer_, data);
+    buffer_ += "\"]\n";
+  }
+  if (buffer_.size() >= flushThreshold) {
+    flush();
+  }
+}
+
+// ____________________________________________________________________________
+void AsciicastWriter::flush() {
+  if (!buffer_.empty()) {
+    failed_ |= fwrite(buffer_.data(), 1, buffer_.size(), file_) !=
+               buffer_.size();
+    written_ += buffer_.size();
+    buffer_.clear();
+  }
+}
+
+// ____________________________________________________________________________
+void AsciicastWriter::close() {
+  flush();
+  failed_ |= fclose(file_) != 0;
+  file_ = nullptr;
+  if (failed_) {
+    throw std::runtime_error("Could not write the recording");
+  }
+}
+
+// ____________________________________________________________________________
+AsciicastStats exportReplay(ReplayReader &reader, const std::string &path,
+                            AsciicastWriter::Format format,
+                            const std::string &title) {
+  auto start = std::chrono::steady_clock::now();
+  SocketTerminalManager tm(TetrisGame::colors(), VersusView::layoutRows,
+                           VersusView::boardPixels + 1);
+  AsciicastWriter writer(path, 2 * tm.numCols(), tm.numRows(), format,
+                         title);
+  AsciicastStats stats;
+  VersusView view(&tm, {title});
+  std::string data;
+  auto record = [&](uint64_t frame) {
+    tm.takeOutput(&data);
+    if (!data.empty()) {
+      writer.output(std::chrono::duration<double>(frame *
+                                                  TetrisGame::frameDuration)
+                        .count(),
+                    data);
+      stats.outputs++;
+      data.clear();
+    }
+  };
+  view.drawLayout();
+  record(0);
+  TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+  game.onReplayEvent([&](uint64_t frame) {
+    view.drawFrame(0, game.broadcastFrame());
+    record(frame);
+  });
+  stats.result = game.replay(reader);
+  if (game.gameOver()) {
+    view.drawMessage(0, "Game over");
+  }
+  // Leave the terminal below the board with the default colors and the
+  // cursor on.
+  tm.takeOutput(&data);
+  data += "\x1b[0m\x1b[" + std::to_string(tm.numRows() + 1) +
+          ";1H\x1b[?25h";
+  record(stats.result.frames);
+  writer.close();
+  stats.bytes = writer.bytes();
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  return stats;
+}
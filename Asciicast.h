@@ -0,0 +1,64 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Replay.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Writes terminal output to a recording that plays back in a terminal:
+// asciicast v2 (asciinema), a JSON header line and then one line
+// [time, "o", data] per output, or the raw ANSI stream that `cat` shows at
+// once. Outputs collect in a large buffer that is written in one piece.
+class AsciicastWriter {
+public:
+  enum class Format { Asciicast, Ansi };
+
+  // A recording of a terminal with the size in characters. Throws if the
+  // file cannot be created.
+  AsciicastWriter(const std::string &path, int width, int height,
+                  Format format = Format::Asciicast,
+                  const std::string &title = "");
+  // Closes the file, without throwing.
+  ~AsciicastWriter();
+
+  AsciicastWriter(const AsciicastWriter &) = delete;
+  AsciicastWriter &operator=(const AsciicastWriter &) = delete;
+
+  // Record output at the time in seconds since the start.
+  void output(double seconds, const std::string &data);
+
+  // Write what is buffered and close the file. Throws if writing failed.
+  void close();
+
+  // Bytes written to the file so far, and the buffered ones
+  uint64_t bytes() const { return written_ + buffer_.size(); }
+
+private:
+  void flush();
+
+  FILE *file_;
+  Format format_;
+  std::string buffer_;
+  uint64_t written_{0};
+  bool failed_{false};
+};
+
+struct AsciicastStats {
+  // What the game of the replay came to
+  ReplayResult result;
+  // Outputs and bytes of the recording
+  uint64_t outputs{0};
+  uint64_t bytes{0};
+  double seconds{0};
+};
+
+// Render a replay into a recording as fast as it can be simulated. After
+// every event of the replay the cells that changed are drawn like in versus
+// mode (VersusView) on a SocketTerminalManager, and its escape sequences
+// become one output at the time of the frame on the virtual clock of the
+// game, 60 frames per second of play.
+AsciicastStats exportReplay(ReplayReader &reader, const std::string &path,
+                            AsciicastWriter::Format format,
+                            const std::string &title);
@@ -0,0 +1,140 @@
+// Copyright (C)
+
+#include "./Asciicast.h"
+#include "./MappedFile.h"
+#include "./TetrisGame.h"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <memory>
+#include <ncurses.h> // For keycodes
+#include <string>
+#include <unistd.h>
+
+namespace {
+// Plays frames with scripted inputs like the game loop would.
+class ScriptedGame : public TetrisGame {
+public:
+  using TetrisGame::TetrisGame;
+  using TetrisGame::stepFrame;
+
+  void start(uint64_t seed) {
+    seedRandom(seed);
+    initGame();
+  }
+  ReplayResult result(uint64_t frames) const {
+    return ReplayResult{frames, score_, lines_, level_};
+  }
+};
+} // namespace
+
+// Record a game of pseudo random inputs to the path.
+static void recordGame(const std::string &path, uint64_t frames) {
+  const uint64_t seed = 42;
+  ScriptedGame game(std::make_unique<HeadlessTerminalManager>());
+  game.start(seed);
+  const int keys[] = {KEY_LEFT, KEY_RIGHT, KEY_DOWN, 97, 100};
+  ReplayWriter writer(path, ReplayHeader{seed, 0, 97, 100});
+  srand(seed);
+  uint64_t frame = 0;
+  for (; frame < frames && !game.gameOver(); ++frame) {
+    UserInput ui;
+    ui.keycode_ = -1;
+    bool gravity = frame % 30 == 0;
+    if (gravity) {
+      writer.gravity(frame);
+    } else if (frame % 4 == 0) {
+      ui.keycode_ = keys[rand() % 5];
+      writer.input(frame, ui.keycode_);
+    }
+    game.stepFrame(ui, gravity);
+  }
+  writer.finish(game.result(frame));
+}
+
+// The whole file as a string
+static std::string readAll(const std::string &path) {
+  MappedFile file(path);
+  return std::string(reinterpret_cast<const char *>(file.data()),
+                     file.size());
+}
+
+TEST(Asciicast, writer) {
+  std::string path = "AsciicastTest." + std::to_string(getpid()) + ".cast";
+  {
+    AsciicastWriter writer(path, 28, 22, AsciicastWriter::Format::Asciicast,
+                           "a \"game\"");
+    writer.output(0, "\x1b[1;1Hhi");
+    writer.output(1.5, "\\\n");
+    writer.close();
+    ASSERT_EQ(writer.bytes(), readAll(path).size());
+  }
+  ASSERT_EQ(readAll(path),
+            "{\"version\": 2, \"width\": 28, \"height\": 22, "
+            "\"title\": \"a \\\"game\\\"\"}\n"
+            "[0.000000, \"o\", \"\\u001b[1;1Hhi\"]\n"
+            "[1.500000, \"o\", \"\\\\\\u000a\"]\n");
+  std::remove(path.c_str());
+  ASSERT_THROW(AsciicastWriter("/nonexistent/x.cast", 1, 1),
+               std::runtime_error);
+}
+
+TEST(Asciicast, exportReplay) {
+  // Export the same replay in both formats. The raw stream has to be the
+  // outputs of the recording one after the other, at times that only go
+  // forward.
+  std::string base = "AsciicastTest." + std::to_string(getpid());
+  std::string replayPath = base + ".replay";
+  recordGame(replayPath, 6000);
+  MappedFile replay(replayPath);
+  std::remove(replayPath.c_str());
+
+  ReplayReader castReader(replay.data(), replay.size());
+  AsciicastStats cast = exportReplay(castReader, base + ".cast",
+                                     AsciicastWriter::Format::Asciicast, "t");
+  ReplayReader ansiReader(replay.data(), replay.size());
+  AsciicastStats ansi = exportReplay(ansiReader, base + ".ansi",
+                                     AsciicastWriter::Format::Ansi, "t");
+  std::string castText = readAll(base + ".cast");
+  std::string ansiText = readAll(base + ".ansi");
+  std::remove((base + ".cast").c_str());
+  std::remove((base + ".ansi").c_str());
+
+  ASSERT_EQ(cast.result.frames, castReader.result().frames);
+  ASSERT_EQ(cast.result.score, castReader.result().score);
+  ASSERT_EQ(cast.outputs, ansi.outputs);
+  ASSERT_GT(cast.outputs, 100u);
+  ASSERT_EQ(cast.bytes, castText.size());
+  ASSERT_EQ(ansi.bytes, ansiText.size());
+  ASSERT_EQ(castText.compare(0, 15, "{\"version\": 2, "), 0);
+
+  // Unescape the data of every output line and check the times.
+  std::string data;
+  double last = -1;
+  size_t lines = 0;
+  size_t pos = castText.find('\n') + 1;
+  while (pos < castText.size()) {
+    size_t end = castText.find('\n', pos);
+    ASSERT_NE(end, std::string::npos);
+    double time = std::stod(castText.substr(pos + 1));
+    ASSERT_GE(time, last);
+    last = time;
+    size_t i = castText.find(", \"o\", \"", pos) + 8;
+    for (; i < end - 2; ++i) {
+      if (castText[i] != '\\') {
+        data += castText[i];
+      } else if (castText[++i] == 'u') {
+        data += static_cast<char>(std::stoi(castText.substr(i + 1, 4),
+                                            nullptr, 16));
+        i += 4;
+      } else {
+        data += castText[i];
+      }
+    }
+    lines++;
+    pos = end + 1;
+  }
+  ASSERT_EQ(lines, cast.outputs);
+  ASSERT_EQ(data, ansiText);
+  ASSERT_NEAR(last, cast.result.frames / 60.0, 1e-3);
+  ASSERT_NE(ansiText.find("\x1b[?25h"), std::string::npos);
+}
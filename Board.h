@@ -0,0 +1,173 @@
+// Copyright (C)
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// The smallest unsigned integer with a bit for every cell of a row.
+template <int width>
+using RowMask = std::conditional_t<
+    width <= 16, uint16_t, std::conditional_t<width <= 32, uint32_t, uint64_t>>;
+
+// The board of a game with the dimensions fixed at compile time, so every
+// size gets its own fully specialized code.
+// Settled blocks are kept as one bit mask per row, which makes collisions and
+// full rows a few bit operations. Next to it a color plane holds what is drawn,
+// including the falling Tetromino, which is not settled and does not collide.
+// Highest row is 0.
+template <int W, int H> class Board {
+  static_assert(W >= 1 && W <= 64, "Boards are 1 to 64 cells wide");
+  static_assert(H >= 1, "Boards need at least one row");
+
+public:
+  using Mask = RowMask<W>;
+  static constexpr int width = W;
+  static constexpr int height = H;
+  static constexpr Mask fullRow =
+      W == 8 * sizeof(Mask) ? static_cast<Mask>(~Mask{0})
+                            : static_cast<Mask>((Mask{1} << (W % 64)) - 1);
+
+  Board() { clear(); }
+
+  // Empty the whole board
+  void clear() {
+    for (int i = 0; i < top + H; ++i) {
+      rows_[i] = 0;
+    }
+    for (int i = top + H; i < top + H + floor; ++i) {
+      rows_[i] = fullRow;
+    }
+    memset(colors_, 0, sizeof(colors_));
+  }
+
+  // Empty one row
+  void clearRow(int y) {
+    rows_[y + top] = 0;
+    memset(colors_[y], 0, W);
+  }
+
+  // Is there a settled block in the cell? Never for cells off the board,
+  // unlike blocked().
+  bool settled(int x, int y) const {
+    unsigned column = x;
+    unsigned shift = column % (8 * sizeof(Mask));
+    return (column < W) & (static_cast<unsigned>(y) < H) &
+           ((rows_[y + top] >> shift) & 1);
+  }
+
+  // Color that is drawn in the cell, 0 if it is empty
+  int color(int x, int y) const { return colors_[y][x]; }
+
+  // Colors of all cells of a row
+  const uint8_t *colors(int y) const { return colors_[y]; }
+
+  // Settled blocks of a row, bit x is column x
+  Mask row(int y) const { return rows_[y + top]; }
+
+  // Check if the row is full
+  bool isFull(int y) const { return rows_[y + top] == fullRow; }
+
+  // Put a settled block into the cell
+  void settle(int x, int y, int color) {
+    rows_[y + top] |= Mask{1} << x;
+    colors_[y][x] = color;
+  }
+
+  // Draw a falling block into the cell. It does not collide.
+  void paint(int x, int y, int color) { colors_[y][x] = color; }
+
+  // Empty the cell
+  void erase(int x, int y) {
+    rows_[y + top] &= ~(Mask{1} << x);
+    colors_[y][x] = 0;
+  }
+
+  // Would a block in the cell collide? Cells left or right of the board, on
+  // the floor or on a settled block do, cells a few rows above the board do
+  // not. No branches: the rows above and below the board are kept as
+  // sentinels, so only the walls need a comparison.
+  bool blocked(int x, int y) const {
+    unsigned column = x;
+    unsigned shift = column % (8 * sizeof(Mask));
+    return (column >= W) | ((rows_[y + top] >> shift) & 1);
+  }
+
+  // Would any of the points (x, y) collide when moved by (dx, dy)?
+  template <class Points>
+  bool collides(const Points &points, int dx = 0, int dy = 0) const {
+    bool collision = false;
+    for (const auto &point : points) {
+      collision |= blocked(point.first + dx, point.second + dy);
+    }
+    return collision;
+  }
+
+  // Remove all full rows and let the rows above fall down. Every row is moved
+  // at most once, however many rows are cleared.
+  // Returns the number of cleared rows.
+  int clearFullLines() {
+    int to = H - 1;
+    for (int from = H - 1; from >= 0; --from) {
+      if (rows_[from + top] == fullRow) {
+        continue;
+      }
+      if (to != from) {
+        rows_[to + top] = rows_[from + top];
+        memcpy(colors_[to], colors_[from], W);
+      }
+      to--;
+    }
+    for (int y = to; y >= 0; --y) {
+      clearRow(y);
+    }
+    return to + 1;
+  }
+
+  // Push everything up by `lines` rows and fill the bottom rows with settled
+  // blocks of the color, except for the hole column. Moves all rows with two
+  // memmoves, whatever the number of lines.
+  // Returns true if settled blocks were pushed off the top.
+  bool insertGarbage(int lines, int hole, int color) {
+    lines = lines < H ? lines : H;
+    if (lines <= 0) {
+      return false;
+    }
+    Mask lost = 0;
+    for (int y = 0; y < lines; ++y) {
+      lost |= rows_[y + top];
+    }
+    memmove(&rows_[top], &rows_[top + lines], (H - lines) * sizeof(Mask));
+    memmove(colors_[0], colors_[lines], (H - lines) * W);
+    Mask garbage = fullRow & ~(Mask{1} << (hole % W));
+    for (int y = H - lines; y < H; ++y) {
+      rows_[y + top] = garbage;
+      memset(colors_[y], color, W);
+      colors_[y][hole % W] = 0;
+    }
+    return lost != 0;
+  }
+
+  bool operator==(const Board &other) const {
+    return memcmp(rows_, other.rows_, sizeof(rows_)) == 0 &&
+           memcmp(colors_, other.colors_, sizeof(colors_)) == 0;
+  }
+  bool operator!=(const Board &other) const { return !(*this == other); }
+
+private:
+  // Empty rows above and full rows below the board, enough for every point of
+  // a Tetromino that is checked next to the board.
+  static constexpr int top = 4;
+  static constexpr int floor = 4;
+
+  Mask rows_[top + H + floor];
+  uint8_t colors_[H][W];
+};
+
+// The standard board of the game
+using StandardBoard = Board<10, 20>;
+// Narrow board, e.g. for training bots
+using TrainingBoard = Board<4, 20>;
+// Standard width with a buffer zone above the visible 20 rows
+using TallBoard = Board<10, 40>;
@@ -0,0 +1,207 @@
+// Copyright (C)
+
+#include "./Board.h"
+#include "./SparseBoard.h"
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <utility>
+#include <vector>
+
+static_assert(std::is_same_v<StandardBoard::Mask, uint16_t>);
+static_assert(std::is_same_v<Board<32, 20>::Mask, uint32_t>);
+static_assert(std::is_same_v<Board<64, 20>::Mask, uint64_t>);
+static_assert(StandardBoard::fullRow == 0x3FF);
+static_assert(Board<64, 20>::fullRow == ~uint64_t{0});
+
+// Settle random colors into every cell of a row.
+template <class B> void setRowRandom(B *board, int y) {
+  for (int x = 0; x < B::width; ++x) {
+    board->settle(x, y, 3 + rand() % 7);
+  }
+}
+
+TEST(Board, clear) {
+  StandardBoard board;
+  for (int i = 0; i < 20; ++i) {
+    setRowRandom(&board, i);
+  }
+  board.clearRow(5);
+  for (int j = 0; j < 10; ++j) {
+    ASSERT_FALSE(board.settled(j, 5));
+    ASSERT_EQ(board.color(j, 5), 0);
+    ASSERT_TRUE(board.settled(j, 6));
+  }
+  board.clear();
+  ASSERT_TRUE(board == StandardBoard{});
+}
+
+TEST(Board, isFull) {
+  StandardBoard board;
+  for (int i = 0; i < 20; ++i) {
+    setRowRandom(&board, i);
+  }
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(board.isFull(i));
+  }
+  board.erase(3, 7);
+  ASSERT_FALSE(board.isFull(7));
+  // A falling block does not fill a row.
+  board.paint(3, 7, 4);
+  ASSERT_FALSE(board.isFull(7));
+}
+
+TEST(Board, clearFullLines) {
+  StandardBoard board;
+  for (int i = 0; i < 20; ++i) {
+    setRowRandom(&board, i);
+  }
+  // Every third row gets a hole and stays.
+  for (int i = 0; i < 20; i += 3) {
+    board.erase(i % 10, i);
+  }
+  StandardBoard before = board;
+  ASSERT_EQ(board.clearFullLines(), 13);
+  // The 7 rows with holes fell to the bottom in their order, the rows above
+  // them are empty.
+  for (int k = 0; k < 7; ++k) {
+    for (int j = 0; j < 10; ++j) {
+      ASSERT_EQ(board.color(j, 13 + k), before.color(j, 3 * k));
+      ASSERT_EQ(board.settled(j, 13 + k), before.settled(j, 3 * k));
+    }
+  }
+  for (int i = 0; i < 13; ++i) {
+    ASSERT_EQ(board.row(i), 0);
+    for (int j = 0; j < 10; ++j) {
+      ASSERT_EQ(board.color(j, i), 0);
+    }
+  }
+  ASSERT_EQ(board.clearFullLines(), 0);
+}
+
+TEST(Board, blocked) {
+  StandardBoard board;
+  board.settle(4, 10, 3);
+  ASSERT_TRUE(board.blocked(4, 10));
+  ASSERT_FALSE(board.blocked(5, 10));
+  // Walls and floor
+  ASSERT_TRUE(board.blocked(-1, 10));
+  ASSERT_TRUE(board.blocked(10, 10));
+  ASSERT_TRUE(board.blocked(4, 20));
+  // Above the board is free.
+  ASSERT_FALSE(board.blocked(4, -2));
+  std::vector<std::pair<int, int>> points = {{3, 9}, {4, 9}, {5, 9}};
+  ASSERT_TRUE(board.collides(points, 0, 1));
+  ASSERT_FALSE(board.collides(points));
+  ASSERT_TRUE(board.collides(points, 5, 0));
+  ASSERT_FALSE(board.collides(points, 4, 0));
+}
+
+TEST(Board, insertGarbage) {
+  StandardBoard board;
+  board.settle(2, 19, 4);
+  board.settle(2, 18, 5);
+  ASSERT_FALSE(board.insertGarbage(2, 7, 2));
+  // The blocks moved up with their colors.
+  ASSERT_TRUE(board.settled(2, 17));
+  ASSERT_EQ(board.color(2, 16), 5);
+  for (int y : {18, 19}) {
+    ASSERT_EQ(board.row(y), 0x3FF & ~(1 << 7));
+    ASSERT_EQ(board.color(0, y), 2);
+    ASSERT_EQ(board.color(7, y), 0);
+  }
+  ASSERT_FALSE(board.blocked(7, 19));
+  // Filling the hole clears both garbage lines at once.
+  board.settle(7, 18, 3);
+  board.settle(7, 19, 3);
+  ASSERT_EQ(board.clearFullLines(), 2);
+  ASSERT_EQ(board.color(2, 18), 5);
+  // Blocks pushed off the top end the game.
+  board.settle(0, 1, 3);
+  ASSERT_FALSE(board.insertGarbage(1, 0, 2));
+  ASSERT_TRUE(board.settled(0, 0));
+  ASSERT_TRUE(board.insertGarbage(1, 0, 2));
+  ASSERT_FALSE(board.insertGarbage(0, 0, 2));
+}
+
+TEST(Board, variants) {
+  // Narrow board: a single Tetromino row fills a line.
+  Board<4, 6> narrow;
+  for (int x = 0; x < 4; ++x) {
+    narrow.settle(x, 5, 5);
+  }
+  narrow.settle(1, 4, 6);
+  ASSERT_TRUE(narrow.isFull(5));
+  ASSERT_TRUE(narrow.blocked(4, 0));
+  ASSERT_EQ(narrow.clearFullLines(), 1);
+  ASSERT_EQ(narrow.row(5), 0b10);
+  ASSERT_EQ(narrow.color(1, 5), 6);
+
+  // The widest board uses every bit of its mask.
+  Board<64, 40> wide;
+  setRowRandom(&wide, 39);
+  setRowRandom(&wide, 38);
+  wide.erase(63, 38);
+  ASSERT_TRUE(wide.isFull(39));
+  ASSERT_FALSE(wide.isFull(38));
+  ASSERT_TRUE(wide.blocked(64, 20));
+  ASSERT_TRUE(wide.blocked(-1, 20));
+  ASSERT_FALSE(wide.blocked(63, 20));
+  ASSERT_TRUE(wide.blocked(62, 38));
+  ASSERT_FALSE(wide.blocked(63, 38));
+  ASSERT_EQ(wide.clearFullLines(), 1);
+  ASSERT_EQ(wide.row(39), ~uint64_t{0} >> 1);
+}
+
+TEST(SparseBoard, sameAsBoard) {
+  // Random settles, falling blocks, erases and line clears give the same
+  // cells on a sparse and a dense board.
+  srand(42);
+  SparseBoard<10> sparse(200);
+  Board<10, 200> dense;
+  for (int i = 0; i < 20'000; ++i) {
+    int x = rand() % 10;
+    int y = 150 + rand() % 50;
+    switch (rand() % 4) {
+    case 0:
+    case 1:
+      sparse.settle(x, y, 3 + x % 7);
+      dense.settle(x, y, 3 + x % 7);
+      break;
+    case 2:
+      sparse.erase(x, y);
+      dense.erase(x, y);
+      break;
+    case 3:
+      ASSERT_EQ(sparse.clearFullLines(), dense.clearFullLines());
+    }
+  }
+  for (int y = -2; y < 202; ++y) {
+    for (int x = -1; x < 11; ++x) {
+      ASSERT_EQ(sparse.blocked(x, y), dense.blocked(x, y)) << x << " " << y;
+      if (y >= 0 && y < 200 && x >= 0 && x < 10) {
+        ASSERT_EQ(sparse.settled(x, y), dense.settled(x, y));
+        ASSERT_EQ(sparse.color(x, y), dense.color(x, y));
+      }
+    }
+  }
+}
+
+TEST(SparseBoard, storesOnlyOccupiedRows) {
+  SparseBoard<10> board(10'000);
+  ASSERT_EQ(board.highestRow(), 10'000);
+  for (int x = 0; x < 10; ++x) {
+    board.settle(x, 9'999, 3);
+  }
+  board.settle(4, 9'998, 5);
+  board.paint(4, 20, 6);
+  ASSERT_EQ(board.numRows(), 3u);
+  ASSERT_EQ(board.highestRow(), 20);
+  // Erasing the falling block removes its row again.
+  board.erase(4, 20);
+  ASSERT_EQ(board.numRows(), 2u);
+  ASSERT_EQ(board.clearFullLines(), 1);
+  ASSERT_EQ(board.numRows(), 1u);
+  ASSERT_EQ(board.color(4, 9'999), 5);
+  ASSERT_TRUE(board.blocked(4, 10'000));
+  ASSERT_FALSE(board.blocked(4, 0));
+}
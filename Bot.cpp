@@ -0,0 +1,150 @@
+// Copyright (C)
+
+#include "./Bot.h"
+#include <climits>
+#include <cstdlib>
+#include <limits>
+#include <ncurses.h> // For keycodes
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+// Keys of the game for rotating, TetrisGame's default for D
+static constexpr int keyRotate = 100;
+
+// Keys pressed for a Tetromino before the bot gives up steering and drops
+// it, e.g. when a rotation is blocked.
+static constexpr int maxKeys = 24;
+
+// ____________________________________________________________________________
+BotConfig BotConfig::parse(const std::string &spec) {
+  BotConfig config;
+  size_t colon = spec.find(':');
+  config.name = spec.substr(0, colon);
+  if (config.name.empty()) {
+    throw std::invalid_argument("Bot without a name: " + spec);
+  }
+  if (colon == std::string::npos) {
+    return config;
+  }
+  std::istringstream weights(spec.substr(colon + 1));
+  double *fields[] = {&config.lines, &config.holes, &config.height,
+                      &config.bumpiness};
+  char comma;
+  for (double *field : fields) {
+    if (!(weights >> *field) || (field != fields[3] && !(weights >> comma))) {
+      throw std::invalid_argument("Invalid weights of bot: " + spec);
+    }
+  }
+  if (weights >> comma && !(weights >> config.framesPerKey)) {
+    throw std::invalid_argument("Invalid keys of bot: " + spec);
+  }
+  if (config.framesPerKey < 1) {
+    throw std::invalid_argument("A bot needs at least one frame per key");
+  }
+  return config;
+}
+
+// ____________________________________________________________________________
+Bot::Bot(const BotConfig &config)
+    : config_(config), scratch_(std::make_unique<TetrisGame>(
+                           std::make_unique<HeadlessTerminalManager>())) {}
+
+// ____________________________________________________________________________
+int Bot::nextKey(const TetrisGame &game) {
+  if (game.pieces() != plannedPiece_) {
+    plan(game.snapshot());
+    plannedPiece_ = game.pieces();
+    keys_ = 0;
+  }
+  if (++frames_ < config_.framesPerKey) {
+    return -1;
+  }
+  frames_ = 0;
+  GameState state = game.snapshot();
+  keys_++;
+  if (keys_ > maxKeys) {
+    return KEY_DOWN;
+  }
+  bool isI = state.current == static_cast<int>(TetrominoForm::I);
+  if (isI ? state.iIsUp != iIsUp_ : state.rotation != rotation_) {
+    return keyRotate;
+  }
+  if (state.positionX != positionX_) {
+    return state.positionX < positionX_ ? KEY_RIGHT : KEY_LEFT;
+  }
+  return KEY_DOWN;
+}
+
+// ____________________________________________________________________________
+void Bot::plan(GameState state) {
+  // No gravity while trying a placement, so every key does what it should.
+  state.gravityFrames = INT8_MIN;
+  UserInput uI;
+  double best = -std::numeric_limits<double>::infinity();
+  std::set<std::tuple<int, int, int>> tried;
+  for (int rotations = 0; rotations < 4; ++rotations) {
+    for (int shift = -StandardBoard::width / 2;
+         shift <= StandardBoard::width / 2; ++shift) {
+      scratch_->restore(state);
+      uI.keycode_ = keyRotate;
+      for (int i = 0; i < rotations; ++i) {
+        scratch_->simulateFrame(uI);
+      }
+      uI.keycode_ = shift < 0 ? KEY_LEFT : KEY_RIGHT;
+      for (int i = 0; i < std::abs(shift); ++i) {
+        scratch_->simulateFrame(uI);
+      }
+      GameState target = scratch_->snapshot();
+      if (!tried.emplace(target.rotation, target.iIsUp, target.positionX)
+               .second) {
+        continue;
+      }
+      uint64_t piece = scratch_->pieces();
+      uI.keycode_ = KEY_DOWN;
+      for (int i = 0; i <= StandardBoard::height && !scratch_->gameOver() &&
+                      scratch_->pieces() == piece;
+           ++i) {
+        scratch_->simulateFrame(uI);
+      }
+      GameState settled = scratch_->snapshot();
+      double value = scratch_->gameOver()
+                         ? -std::numeric_limits<double>::max()
+                         : evaluate(settled, settled.lines - state.lines);
+      if (value > best) {
+        best = value;
+        rotation_ = target.rotation;
+        iIsUp_ = target.iIsUp;
+        positionX_ = target.positionX;
+      }
+    }
+  }
+}
+
+// ____________________________________________________________________________
+double Bot::evaluate(const GameState &state, int cleared) const {
+  int heights[StandardBoard::width];
+  int holes = 0;
+  for (int x = 0; x < StandardBoard::width; ++x) {
+    heights[x] = 0;
+    for (int y = 0; y < StandardBoard::height; ++y) {
+      bool settled = (state.rows[y] >> (3 * x)) & 7;
+      if (settled && heights[x] == 0) {
+        heights[x] = StandardBoard::height - y;
+      } else if (!settled && heights[x] > 0) {
+        holes++;
+      }
+    }
+  }
+  int height = 0;
+  int bumpiness = 0;
+  for (int x = 0; x < StandardBoard::width; ++x) {
+    height += heights[x];
+    if (x > 0) {
+      bumpiness += std::abs(heights[x] - heights[x - 1]);
+    }
+  }
+  return config_.lines * cleared + config_.holes * holes +
+         config_.height * height + config_.bumpiness * bumpiness;
+}
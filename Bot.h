@@ -0,0 +1,61 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./GameState.h"
+#include "./TetrisGame.h"
+#include <memory>
+#include <string>
+
+// How a Bot plays: the weights of its evaluation of a placement and how fast
+// it presses keys.
+struct BotConfig {
+  std::string name;
+  // Weights of the lines a placement clears, of the holes under blocks, of
+  // the sum of the column heights and of the height differences of
+  // neighbouring columns
+  double lines{3.0};
+  double holes{-8.0};
+  double height{-0.5};
+  double bumpiness{-2.0};
+  // Frames between two keys, 1 presses a key every frame
+  int framesPerKey{1};
+
+  // From "name" (default weights) or
+  // "name:lines,holes,height,bumpiness[,framesPerKey]".
+  static BotConfig parse(const std::string &spec);
+};
+
+// Plays a game with keys like a player. When a Tetromino spawns, it tries all
+// rotations and columns on a fork of the game, evaluates where the Tetromino
+// settles, and then steers it there. Everything runs on the simulation of
+// the game, so bots play by the same rules as humans.
+class Bot {
+public:
+  explicit Bot(const BotConfig &config);
+
+  // The key to press in the current frame of the game, -1 for none.
+  int nextKey(const TetrisGame &game);
+
+  // Evaluation of the settled blocks of a state and the lines that were
+  // cleared to get there. Higher is better.
+  double evaluate(const GameState &state, int cleared) const;
+
+  const BotConfig &config() const { return config_; }
+
+private:
+  // Choose the target of the current Tetromino of the state.
+  void plan(GameState state);
+
+  BotConfig config_;
+  // The fork of the game to try placements on
+  std::unique_ptr<TetrisGame> scratch_;
+  // The Tetromino the target is for
+  uint64_t plannedPiece_{~uint64_t{0}};
+  int8_t rotation_{0};
+  int8_t iIsUp_{0};
+  int8_t positionX_{0};
+  // Keys pressed for the current Tetromino and frames since the last one
+  int keys_{0};
+  int frames_{0};
+};
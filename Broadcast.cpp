@@ -0,0 +1,281 @@
+// Copyright (C)
+
+#include "./Broadcast.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Every record starts with this, followed by all cells for a keyframe or by
+// (index, color) pairs of the changed cells for a delta.
+struct RecordHeader {
+  uint32_t size;
+  uint32_t type;
+  uint64_t frame;
+  int32_t score;
+  int32_t lines;
+  int32_t level;
+  int32_t high;
+  int32_t next;
+};
+
+// The header of a record that was copied out of the ring
+static RecordHeader headerOf(const std::vector<uint8_t> &record) {
+  RecordHeader header;
+  memcpy(&header, record.data(), sizeof(header));
+  return header;
+}
+
+enum RecordType : uint32_t { Keyframe = 1, Delta = 2 };
+
+static constexpr size_t numCells =
+    StandardBoard::width * StandardBoard::height;
+static_assert(numCells <= 256, "Cell indices of deltas are one byte");
+static constexpr size_t maxRecordSize = sizeof(RecordHeader) + 2 * numCells;
+static constexpr size_t minCapacity = 64 * 1024;
+static_assert(minCapacity >
+                  2 * BroadcastPublisher::keyframeInterval * maxRecordSize,
+              "The ring must hold a keyframe and all deltas after it");
+
+// The ring starts in its own cache line after the header.
+static constexpr size_t ringOffset = 64;
+static_assert(sizeof(BroadcastHeader) <= ringOffset);
+
+static constexpr char magic[4] = {'T', 'B', 'C', '1'};
+static constexpr uint32_t version = 1;
+
+// ____________________________________________________________________________
+BroadcastPublisher::BroadcastPublisher(const std::string &name,
+                                       size_t capacity)
+    : name_(name), capacity_(capacity), mappedSize_(ringOffset + capacity) {
+  if (capacity < minCapacity) {
+    throw std::runtime_error("Broadcast ring is too small: " +
+                             std::to_string(capacity));
+  }
+  // Spectators of an old broadcast keep their mapping of it.
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Could not create broadcast " + name);
+  }
+  if (ftruncate(fd, mappedSize_) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Could not resize broadcast " + name);
+  }
+  void *memory =
+      mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Could not map broadcast " + name);
+  }
+  header_ = new (memory) BroadcastHeader{};
+  header_->version = version;
+  header_->capacity = capacity;
+  header_->writePos.store(0);
+  header_->keyframePos.store(BroadcastHeader::noKeyframe);
+  memcpy(header_->magic, magic, sizeof(magic));
+  ring_ = static_cast<uint8_t *>(memory) + ringOffset;
+  record_.reserve(maxRecordSize);
+}
+
+// ____________________________________________________________________________
+BroadcastPublisher::~BroadcastPublisher() {
+  munmap(header_, mappedSize_);
+  shm_unlink(name_.c_str());
+}
+
+// ____________________________________________________________________________
+void BroadcastPublisher::publish(const BroadcastFrame &frame) {
+  bool keyframe = sinceKeyframe_ >= keyframeInterval;
+  record_.resize(sizeof(RecordHeader));
+  const uint8_t *cells = &frame.cells[0][0];
+  if (keyframe) {
+    record_.insert(record_.end(), cells, cells + numCells);
+  } else {
+    const uint8_t *lastCells = &last_.cells[0][0];
+    for (size_t i = 0; i < numCells; ++i) {
+      if (cells[i] != lastCells[i]) {
+        record_.push_back(i);
+        record_.push_back(cells[i]);
+      }
+    }
+    if (record_.size() == sizeof(RecordHeader) && frame.score == last_.score &&
+        frame.lines == last_.lines && frame.level == last_.level &&
+        frame.high == last_.high && frame.next == last_.next) {
+      return;
+    }
+  }
+  RecordHeader header{static_cast<uint32_t>(record_.size()),
+                      keyframe ? Keyframe : Delta,
+                      frame.frame,
+                      frame.score,
+                      frame.lines,
+                      frame.level,
+                      frame.high,
+                      frame.next};
+  memcpy(record_.data(), &header, sizeof(header));
+  append();
+  if (keyframe) {
+    header_->keyframePos.store(header_->writePos.load() - record_.size(),
+                               std::memory_order_release);
+    sinceKeyframe_ = 0;
+  }
+  sinceKeyframe_++;
+  last_ = frame;
+}
+
+// ____________________________________________________________________________
+void BroadcastPublisher::append() {
+  uint64_t pos = header_->writePos.load(std::memory_order_relaxed);
+  // Spectators that see any of the following bytes also see the position of
+  // the last record, so they know when they were overwritten (a seqlock).
+  std::atomic_thread_fence(std::memory_order_release);
+  size_t offset = pos % capacity_;
+  size_t first = std::min(record_.size(), capacity_ - offset);
+  memcpy(ring_ + offset, record_.data(), first);
+  memcpy(ring_, record_.data() + first, record_.size() - first);
+  header_->writePos.store(pos + record_.size(), std::memory_order_release);
+}
+
+// ____________________________________________________________________________
+uint64_t BroadcastPublisher::bytesPublished() const {
+  return header_->writePos.load(std::memory_order_relaxed);
+}
+
+// ____________________________________________________________________________
+BroadcastSubscriber::BroadcastSubscriber(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::runtime_error("No broadcast " + name);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= ringOffset) {
+    close(fd);
+    throw std::runtime_error("Not a broadcast: " + name);
+  }
+  mappedSize_ = st.st_size;
+  void *memory = mmap(nullptr, mappedSize_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("Could not map broadcast " + name);
+  }
+  header_ = static_cast<const BroadcastHeader *>(memory);
+  ring_ = static_cast<const uint8_t *>(memory) + ringOffset;
+  capacity_ = header_->capacity;
+  if (memcmp(header_->magic, magic, sizeof(magic)) != 0 ||
+      header_->version != version || ringOffset + capacity_ != mappedSize_) {
+    munmap(memory, mappedSize_);
+    throw std::runtime_error("Not a broadcast: " + name);
+  }
+  record_.resize(maxRecordSize);
+}
+
+// ____________________________________________________________________________
+BroadcastSubscriber::~BroadcastSubscriber() {
+  munmap(const_cast<BroadcastHeader *>(header_), mappedSize_);
+}
+
+// ____________________________________________________________________________
+bool BroadcastSubscriber::update(BroadcastFrame *frame) {
+  bool changed{false};
+  if (!synced_) {
+    if (!resync(frame)) {
+      return false;
+    }
+    changed = true;
+  }
+  // Only what was published until now, so a fast publisher cannot keep the
+  // spectator here forever.
+  uint64_t end = header_->writePos.load(std::memory_order_acquire);
+  while (pos_ < end) {
+    if (!readRecord(pos_)) {
+      // The publisher lapped the spectator.
+      if (!resync(frame)) {
+        return changed;
+      }
+      changed = true;
+      continue;
+    }
+    apply(frame);
+    pos_ += headerOf(record_).size;
+    changed = true;
+  }
+  return changed;
+}
+
+// ____________________________________________________________________________
+bool BroadcastSubscriber::readRecord(uint64_t pos) {
+  auto copy = [this](uint64_t from, uint8_t *to, size_t size) {
+    size_t offset = from % capacity_;
+    size_t first = std::min(size, capacity_ - offset);
+    memcpy(to, ring_ + offset, first);
+    memcpy(to + first, ring_, size - first);
+  };
+  // The record is intact if the publisher did not write to its bytes yet,
+  // also not to the record it may be writing right now.
+  auto intact = [this, pos]() {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t end = header_->writePos.load(std::memory_order_relaxed);
+    return end + maxRecordSize <= pos + capacity_;
+  };
+  copy(pos, record_.data(), sizeof(RecordHeader));
+  uint32_t size = headerOf(record_).size;
+  if (size < sizeof(RecordHeader) || size > maxRecordSize) {
+    if (intact()) {
+      throw std::runtime_error("Corrupt broadcast record");
+    }
+    return false;
+  }
+  copy(pos + sizeof(RecordHeader), record_.data() + sizeof(RecordHeader),
+       size - sizeof(RecordHeader));
+  return intact();
+}
+
+// ____________________________________________________________________________
+void BroadcastSubscriber::apply(BroadcastFrame *frame) const {
+  RecordHeader header = headerOf(record_);
+  frame->frame = header.frame;
+  frame->score = header.score;
+  frame->lines = header.lines;
+  frame->level = header.level;
+  frame->high = header.high;
+  frame->next = header.next;
+  const uint8_t *payload = record_.data() + sizeof(header);
+  size_t payloadSize = header.size - sizeof(header);
+  uint8_t *cells = &frame->cells[0][0];
+  if (header.type == Keyframe) {
+    memcpy(cells, payload, std::min(payloadSize, numCells));
+    return;
+  }
+  for (size_t i = 0; i + 1 < payloadSize; i += 2) {
+    if (payload[i] < numCells) {
+      cells[payload[i]] = payload[i + 1];
+    }
+  }
+}
+
+// ____________________________________________________________________________
+bool BroadcastSubscriber::resync(BroadcastFrame *frame) {
+  // The keyframe can be overwritten while it is read if the spectator is
+  // very slow, then the next one is tried.
+  for (int attempt = 0; attempt < 3; ++attempt) {
+    uint64_t pos = header_->keyframePos.load(std::memory_order_acquire);
+    if (pos == BroadcastHeader::noKeyframe) {
+      return false;
+    }
+    if (readRecord(pos) && headerOf(record_).type == Keyframe) {
+      apply(frame);
+      pos_ = pos + headerOf(record_).size;
+      synced_ = true;
+      resyncs_++;
+      return true;
+    }
+  }
+  synced_ = false;
+  return false;
+}
@@ -0,0 +1,133 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Board.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Live broadcast of a game to any number of spectators through a ring buffer
+// in POSIX shared memory. The game publishes the changed cells of every frame
+// and regularly a keyframe with all cells. Spectators map the ring read-only
+// and read at their own pace, so publishing costs the same for any number of
+// spectators. Spectators that attach mid-game or fall behind by more than
+// the ring holds start again from the latest keyframe.
+
+// What spectators see of a game: the colors of the play screen, the scores
+// and the upcoming Tetromino
+struct BroadcastFrame {
+  uint64_t frame{0};
+  int32_t score{0};
+  int32_t lines{0};
+  int32_t level{0};
+  int32_t high{0};
+  int32_t next{0};
+  uint8_t cells[StandardBoard::height][StandardBoard::width]{};
+
+  bool operator==(const BroadcastFrame &other) const {
+    return frame == other.frame && score == other.score &&
+           lines == other.lines && level == other.level &&
+           high == other.high && next == other.next &&
+           memcmp(cells, other.cells, sizeof(cells)) == 0;
+  }
+  bool operator!=(const BroadcastFrame &other) const {
+    return !(*this == other);
+  }
+};
+
+// Start of the shared memory
+struct BroadcastHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t capacity;
+  // Bytes ever written to the ring. Records up to here are complete.
+  std::atomic<uint64_t> writePos;
+  // Position of the latest keyframe, noKeyframe before the first one
+  std::atomic<uint64_t> keyframePos;
+
+  static constexpr uint64_t noKeyframe = ~uint64_t{0};
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The broadcast needs lock-free atomics in shared memory");
+
+class BroadcastPublisher {
+public:
+  // Create the shared memory with the name (e.g. "/tetris") and a ring of
+  // the capacity in bytes, at least 64 KiB. A broadcast with the same name is
+  // replaced, the shared memory is removed again on destruction.
+  explicit BroadcastPublisher(const std::string &name,
+                              size_t capacity = 1 << 20);
+  ~BroadcastPublisher();
+
+  BroadcastPublisher(const BroadcastPublisher &) = delete;
+  BroadcastPublisher &operator=(const BroadcastPublisher &) = delete;
+
+  // Publish the changes since the last frame, or a keyframe. Frames without
+  // changes are not published.
+  void publish(const BroadcastFrame &frame);
+
+  // Published frames between two keyframes. The ring always holds the
+  // latest keyframe and everything after it.
+  static constexpr uint64_t keyframeInterval = 60;
+
+  // Bytes written so far
+  uint64_t bytesPublished() const;
+
+private:
+  // Write the record at the end of the ring, then make it visible.
+  void append();
+
+  std::string name_;
+  size_t capacity_;
+  size_t mappedSize_;
+  BroadcastHeader *header_;
+  uint8_t *ring_;
+
+  BroadcastFrame last_;
+  uint64_t sinceKeyframe_{keyframeInterval};
+  // Reused for every record
+  std::vector<uint8_t> record_;
+};
+
+class BroadcastSubscriber {
+public:
+  // Attach to the broadcast with the name. Throws if there is none.
+  explicit BroadcastSubscriber(const std::string &name);
+  ~BroadcastSubscriber();
+
+  BroadcastSubscriber(const BroadcastSubscriber &) = delete;
+  BroadcastSubscriber &operator=(const BroadcastSubscriber &) = delete;
+
+  // Apply everything that was published since the last call to the frame.
+  // Returns true if it changed. The first call syncs from the latest
+  // keyframe and returns false if none was published yet.
+  bool update(BroadcastFrame *frame);
+
+  // How often the spectator had to start again from a keyframe
+  uint64_t resyncs() const { return resyncs_; }
+
+private:
+  // Copy the record at the position and check that the publisher did not
+  // overwrite it meanwhile. False if it did.
+  bool readRecord(uint64_t pos);
+
+  // Apply the record that was read to the frame.
+  void apply(BroadcastFrame *frame) const;
+
+  // Start again from the latest keyframe. False if there is none (yet).
+  bool resync(BroadcastFrame *frame);
+
+  size_t capacity_;
+  size_t mappedSize_;
+  const BroadcastHeader *header_;
+  const uint8_t *ring_;
+
+  uint64_t pos_{0};
+  bool synced_{false};
+  uint64_t resyncs_{0};
+  std::vector<uint8_t> record_;
+};
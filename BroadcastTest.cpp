@@ -0,0 +1,123 @@
+// Copyright (C)
+
+#include "./Broadcast.h"
+#include "./TetrisGame.h"
+#include <gtest/gtest.h>
+#include <ncurses.h> // For keycodes
+#include <unistd.h>
+
+// A shared memory name of its own for every test process
+static std::string testName() {
+  return "/tetris-broadcast-test-" + std::to_string(getpid());
+}
+
+// Change a few cells and the score like a frame of a game would.
+static void nextFrame(BroadcastFrame *frame) {
+  frame->frame++;
+  int cell = frame->frame * 7 % 200;
+  frame->cells[cell / 10][cell % 10] = frame->frame % 7 + 3;
+  frame->cells[19 - cell / 10][cell % 10] = 0;
+  if (frame->frame % 10 == 0) {
+    frame->score += 40;
+  }
+}
+
+TEST(Broadcast, deltas) {
+  BroadcastPublisher publisher(testName());
+  BroadcastSubscriber subscriber(testName());
+  BroadcastFrame seen;
+  // Nothing to sync from yet.
+  ASSERT_FALSE(subscriber.update(&seen));
+  BroadcastFrame frame;
+  frame.cells[19][4] = 5;
+  frame.next = 2;
+  publisher.publish(frame);
+  ASSERT_TRUE(subscriber.update(&seen));
+  ASSERT_EQ(seen, frame);
+  ASSERT_FALSE(subscriber.update(&seen));
+  // Only the two changed cells are published after the keyframe: a small
+  // header and two (index, color) pairs.
+  uint64_t bytes = publisher.bytesPublished();
+  frame.frame = 1;
+  frame.cells[19][4] = 0;
+  frame.cells[18][4] = 5;
+  publisher.publish(frame);
+  ASSERT_LT(publisher.bytesPublished() - bytes, 50u);
+  ASSERT_TRUE(subscriber.update(&seen));
+  ASSERT_EQ(seen, frame);
+  // Frames without changes are not published at all.
+  frame.frame = 2;
+  bytes = publisher.bytesPublished();
+  publisher.publish(frame);
+  ASSERT_EQ(publisher.bytesPublished(), bytes);
+  ASSERT_FALSE(subscriber.update(&seen));
+  ASSERT_EQ(subscriber.resyncs(), 1u);
+}
+
+TEST(Broadcast, attachMidGame) {
+  BroadcastPublisher publisher(testName());
+  BroadcastSubscriber early(testName());
+  BroadcastFrame frame;
+  BroadcastFrame seenEarly;
+  for (int i = 0; i < 1000; ++i) {
+    nextFrame(&frame);
+    publisher.publish(frame);
+    ASSERT_TRUE(early.update(&seenEarly));
+    ASSERT_EQ(seenEarly, frame);
+    if (i % 97 == 0) {
+      // Syncs from the latest keyframe and the deltas after it.
+      BroadcastSubscriber late(testName());
+      BroadcastFrame seenLate;
+      ASSERT_TRUE(late.update(&seenLate));
+      ASSERT_EQ(seenLate, frame);
+    }
+  }
+  ASSERT_EQ(early.resyncs(), 1u);
+}
+
+TEST(Broadcast, lapped) {
+  BroadcastPublisher publisher(testName(), 64 * 1024);
+  BroadcastSubscriber subscriber(testName());
+  BroadcastFrame frame;
+  BroadcastFrame seen;
+  nextFrame(&frame);
+  publisher.publish(frame);
+  ASSERT_TRUE(subscriber.update(&seen));
+  // Much more than the ring holds.
+  while (publisher.bytesPublished() < 200 * 1024) {
+    nextFrame(&frame);
+    publisher.publish(frame);
+  }
+  ASSERT_TRUE(subscriber.update(&seen));
+  ASSERT_EQ(seen, frame);
+  ASSERT_EQ(subscriber.resyncs(), 2u);
+  ASSERT_THROW(BroadcastPublisher(testName(), 1024), std::runtime_error);
+  ASSERT_THROW(BroadcastSubscriber("/tetris-no-broadcast"), std::runtime_error);
+}
+
+TEST(Broadcast, game) {
+  TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+  auto clock = std::make_unique<VirtualClock>();
+  VirtualClock *time = clock.get();
+  game.setClock(std::move(clock));
+  game.setSeed(5);
+  game.broadcastTo(testName());
+  BroadcastSubscriber subscriber(testName());
+  game.newGame();
+  BroadcastFrame seen;
+  const int keys[] = {KEY_LEFT, KEY_RIGHT, KEY_DOWN, 97, 100};
+  UserInput uI;
+  for (int i = 0; i < 3000 && !game.gameOver(); ++i) {
+    uI.keycode_ = i % 5 == 0 ? keys[i / 5 % 5] : -1;
+    game.tick(uI);
+    time->advance(TetrisGame::frameDuration);
+    // The spectator only looks every few frames.
+    if (i % 3 == 0) {
+      subscriber.update(&seen);
+      BroadcastFrame frame = game.broadcastFrame();
+      // Frames without changes are not published.
+      seen.frame = frame.frame;
+      ASSERT_EQ(seen, frame) << i;
+    }
+  }
+}
@@ -0,0 +1,50 @@
+// Copyright (C)
+
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+// Declaration and Implementation of the clocks of the game
+
+// A clock the game reads the time from and sleeps with. Virtual so that tests
+// can use a VirtualClock that does not really wait.
+class Clock {
+public:
+  using time_point = std::chrono::steady_clock::time_point;
+  using duration = std::chrono::steady_clock::duration;
+
+  virtual ~Clock() {}
+
+  // The current time.
+  virtual time_point now() = 0;
+
+  // Wait for the given duration.
+  virtual void sleepFor(duration duration) = 0;
+};
+
+// The monotonic clock of the system. Used for real games.
+class RealClock : public Clock {
+public:
+  time_point now() override { return std::chrono::steady_clock::now(); }
+
+  void sleepFor(duration duration) override {
+    std::this_thread::sleep_for(duration);
+  }
+};
+
+// A clock that only moves when it is told to. Sleeping returns immediately
+// and advances the time by exactly the slept duration, so timing dependent
+// code can be tested without waiting and without any jitter.
+class VirtualClock : public Clock {
+public:
+  time_point now() override { return now_; }
+
+  void sleepFor(duration duration) override { now_ += duration; }
+
+  // Let time pass without sleeping.
+  void advance(duration duration) { now_ += duration; }
+
+private:
+  time_point now_{};
+};
@@ -0,0 +1,9 @@
+// Copyright (C)
+
+#include "./GameState.h"
+#include <cstring>
+
+// ____________________________________________________________________________
+bool GameState::operator==(const GameState &other) const {
+  return memcmp(this, &other, sizeof(GameState)) == 0;
+}
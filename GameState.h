@@ -0,0 +1,74 @@
+// Copyright (C)
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// A snapshot of everything that decides how a game goes on: the settled
+// blocks, both Tetrominos, the values and the state of the random number
+// generator. It is a small POD, so forking a game for undo or search is a
+// plain copy, and it can be written to files as raw bytes (replay keyframes).
+struct GameState {
+  uint64_t rngState{0};
+  // 3 bits per settled cell (0 is empty, otherwise the color - 2). The
+  // falling Tetromino is not part of the rows, it follows from the fields
+  // below. The settled cells of rows in garbageRows are garbage.
+  uint32_t rows[20]{};
+  int32_t score{0};
+  int32_t lines{0};
+  int32_t level{0};
+  int8_t current{0};
+  int8_t next{0};
+  int8_t rotation{0};
+  int8_t positionX{0};
+  int8_t positionY{0};
+  int8_t iIsUp{0};
+  // Frames since the last gravity tick of simulateFrame()
+  int8_t gravityFrames{0};
+  // The game is over
+  int8_t gameOver{0};
+  // Bit y is set if row y is a garbage row of versus mode. Garbage has no
+  // color of its own in the 3 bits of a cell, but the rows can not mix: the
+  // only free cell of a garbage row is its hole, and filling it clears the
+  // row.
+  uint32_t garbageRows{0};
+
+  bool operator==(const GameState &other) const;
+};
+static_assert(sizeof(GameState) == 112,
+              "GameState is copied and written raw and must not have padding");
+
+// A ring buffer of the last `capacity` game states. Pushing to a full ring
+// overwrites the oldest state.
+template <size_t capacity> class GameStateRing {
+public:
+  void push(const GameState &state) {
+    states_[head_] = state;
+    head_ = (head_ + 1) % capacity;
+    if (size_ < capacity) {
+      size_++;
+    }
+  }
+
+  // Remove the newest state.
+  void pop() {
+    head_ = (head_ + capacity - 1) % capacity;
+    size_--;
+  }
+
+  // The newest state.
+  const GameState &top() const {
+    return states_[(head_ + capacity - 1) % capacity];
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  void clear() { size_ = 0; }
+
+private:
+  std::array<GameState, capacity> states_;
+  size_t head_{0};
+  size_t size_{0};
+};
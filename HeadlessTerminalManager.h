@@ -0,0 +1,42 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./VirtualTerminalManager.h"
+
+// A terminal manager that draws nothing and never has input. Used to simulate
+// games as fast as possible, e.g. when re-simulating replays.
+class HeadlessTerminalManager : public VirtualTerminalManager {
+public:
+  // Initialize with the given logical dimensions.
+  HeadlessTerminalManager(int numRows = 100, int numCols = 100)
+      : numRows_(numRows), numCols_(numCols) {}
+
+  // Drawing does nothing.
+  void drawPixel(int, int, int) override {}
+  void drawString(int, int, int, const char *) override {}
+  void drawScore(int, int, int, int) override {}
+
+  // Return the logical dimensions of the screen.
+  int numRows() const override { return numRows_; }
+  int numCols() const override { return numCols_; }
+
+  // Does nothing.
+  void flipDelay(bool) override {}
+
+  // There is never a key pressed.
+  UserInput getUserInput() override {
+    UserInput userInput;
+    userInput.keycode_ = -1;
+    return userInput;
+  }
+
+  // Nothing is ever drawn.
+  bool isCellPixel(int, int) const override { return false; }
+  bool isCellString(int, int, const char *) const override { return false; }
+
+private:
+  // The logical dimensions of the screen.
+  int numRows_;
+  int numCols_;
+};
@@ -0,0 +1,64 @@
+// Copyright (C)
+
+#include "./Histogram.h"
+#include <cmath>
+
+// ____________________________________________________________________________
+void Histogram::record(uint64_t value) {
+  counts_[bucketIndex(value)]++;
+  count_++;
+  if (value < min_) {
+    min_ = value;
+  }
+  if (value > max_) {
+    max_ = value;
+  }
+}
+
+// ____________________________________________________________________________
+void Histogram::clear() {
+  counts_.fill(0);
+  count_ = 0;
+  min_ = UINT64_MAX;
+  max_ = 0;
+}
+
+// ____________________________________________________________________________
+uint64_t Histogram::percentile(double percent) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  uint64_t target = std::ceil(percent / 100.0 * count_);
+  if (target == 0) {
+    target = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < numBuckets; ++i) {
+    seen += counts_[i];
+    if (seen >= target) {
+      return bucketEnd(i) < max_ ? bucketEnd(i) : max_;
+    }
+  }
+  return max_;
+}
+
+// ____________________________________________________________________________
+int Histogram::bucketIndex(uint64_t value) {
+  if (value < subBuckets) {
+    return value;
+  }
+  int exponent = 63 - __builtin_clzll(value);
+  int sub = (value >> (exponent - subBucketBits)) & (subBuckets - 1);
+  return (exponent - subBucketBits + 1) * subBuckets + sub;
+}
+
+// ____________________________________________________________________________
+uint64_t Histogram::bucketEnd(int index) {
+  if (index < subBuckets) {
+    return index;
+  }
+  int exponent = index / subBuckets + subBucketBits - 1;
+  uint64_t sub = index % subBuckets;
+  int shift = exponent - subBucketBits;
+  return ((subBuckets + sub) << shift) + ((uint64_t{1} << shift) - 1);
+}
@@ -0,0 +1,42 @@
+// Copyright (C)
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// A histogram with logarithmic buckets in the style of HdrHistogram. Values
+// below 16 are counted exactly, above that every power of two is split into
+// 16 buckets, so percentiles have a relative error below 1/16. The memory is
+// fixed, no matter how many values are recorded.
+class Histogram {
+public:
+  // Count a value (e.g. a duration in microseconds).
+  void record(uint64_t value);
+
+  // Forget all values.
+  void clear();
+
+  // Number of recorded values, smallest and largest recorded value.
+  uint64_t count() const { return count_; }
+  uint64_t min() const { return count_ == 0 ? 0 : min_; }
+  uint64_t max() const { return max_; }
+
+  // The value below which the given percentage (0 to 100) of the recorded
+  // values fall, rounded up to the end of its bucket.
+  uint64_t percentile(double percent) const;
+
+private:
+  static constexpr int subBucketBits = 4;
+  static constexpr int subBuckets = 1 << subBucketBits;
+  static constexpr int numBuckets = (64 - subBucketBits + 1) * subBuckets;
+
+  // The bucket of a value and the largest value in a bucket.
+  static int bucketIndex(uint64_t value);
+  static uint64_t bucketEnd(int index);
+
+  std::array<uint64_t, numBuckets> counts_{};
+  uint64_t count_{0};
+  uint64_t min_{UINT64_MAX};
+  uint64_t max_{0};
+};
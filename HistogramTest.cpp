@@ -0,0 +1,52 @@
+// Copyright (C)
+
+#include "./Histogram.h"
+#include <gtest/gtest.h>
+
+TEST(Histogram, empty) {
+  Histogram histogram;
+  ASSERT_EQ(histogram.count(), 0u);
+  ASSERT_EQ(histogram.min(), 0u);
+  ASSERT_EQ(histogram.max(), 0u);
+  ASSERT_EQ(histogram.percentile(50), 0u);
+}
+
+TEST(Histogram, smallValuesAreExact) {
+  Histogram histogram;
+  for (uint64_t i = 1; i <= 10; ++i) {
+    histogram.record(i);
+  }
+  ASSERT_EQ(histogram.count(), 10u);
+  ASSERT_EQ(histogram.min(), 1u);
+  ASSERT_EQ(histogram.max(), 10u);
+  ASSERT_EQ(histogram.percentile(50), 5u);
+  ASSERT_EQ(histogram.percentile(90), 9u);
+  ASSERT_EQ(histogram.percentile(100), 10u);
+}
+
+TEST(Histogram, percentiles) {
+  // 1 to 100000 microseconds, every value once.
+  Histogram histogram;
+  for (uint64_t i = 1; i <= 100'000; ++i) {
+    histogram.record(i);
+  }
+  // The relative error is below 1/16.
+  auto isClose = [](uint64_t value, uint64_t expected) {
+    return value >= expected && value <= expected + expected / 16;
+  };
+  ASSERT_TRUE(isClose(histogram.percentile(50), 50'000));
+  ASSERT_TRUE(isClose(histogram.percentile(99), 99'000));
+  ASSERT_EQ(histogram.percentile(100), 100'000u);
+  ASSERT_EQ(histogram.max(), 100'000u);
+}
+
+TEST(Histogram, largeValuesAndClear) {
+  Histogram histogram;
+  histogram.record(UINT64_MAX);
+  histogram.record(0);
+  ASSERT_EQ(histogram.percentile(50), 0u);
+  ASSERT_EQ(histogram.percentile(100), UINT64_MAX);
+  histogram.clear();
+  ASSERT_EQ(histogram.count(), 0u);
+  ASSERT_EQ(histogram.max(), 0u);
+}
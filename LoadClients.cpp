@@ -0,0 +1,107 @@
+// Copyright (C)
+
+#include "./LoadClients.h"
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// What the clients press: space, the arrow keys left, right and down, A and D
+static const char *const keys[] = {" ", "\x1b[D", "\x1b[C", "\x1b[B", "a", "d"};
+
+// ____________________________________________________________________________
+LoadClients::LoadClients(const std::string &path, int numClients,
+                         uint64_t seed)
+    : rngState_(seed | 1) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  for (int i = 0; i < numClients; ++i) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address),
+                          sizeof(address)) < 0) {
+      throw std::runtime_error("Could not connect to " + path + ": " +
+                               strerror(errno));
+    }
+    // Start a game right away.
+    send(fd, " ", 1, MSG_NOSIGNAL);
+    fds_.push_back(fd);
+    bytes_.push_back(0);
+  }
+}
+
+// ____________________________________________________________________________
+LoadClients::~LoadClients() {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+// ____________________________________________________________________________
+void LoadClients::run(std::chrono::milliseconds duration,
+                      std::chrono::milliseconds keyInterval) {
+  auto now = std::chrono::steady_clock::now();
+  auto end = now + duration;
+  auto nextKeys = now;
+  std::vector<pollfd> polls(fds_.size());
+  while ((now = std::chrono::steady_clock::now()) < end) {
+    if (now >= nextKeys) {
+      for (int fd : fds_) {
+        if (fd < 0) {
+          continue;
+        }
+        rngState_ ^= rngState_ << 13;
+        rngState_ ^= rngState_ >> 7;
+        rngState_ ^= rngState_ << 17;
+        const char *key = keys[rngState_ % 6];
+        send(fd, key, strlen(key), MSG_NOSIGNAL | MSG_DONTWAIT);
+      }
+      nextKeys += keyInterval;
+    }
+    for (size_t i = 0; i < fds_.size(); ++i) {
+      polls[i].fd = fds_[i];
+      polls[i].events = POLLIN;
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::min(nextKeys, end) - now);
+    int n = poll(polls.data(), polls.size(), std::max<int>(wait.count(), 0));
+    for (size_t i = 0; n > 0 && i < polls.size(); ++i) {
+      if (polls[i].revents != 0) {
+        readClient(i);
+      }
+    }
+  }
+}
+
+// ____________________________________________________________________________
+size_t LoadClients::numConnected() const {
+  size_t connected = 0;
+  for (int fd : fds_) {
+    connected += fd >= 0;
+  }
+  return connected;
+}
+
+// ____________________________________________________________________________
+void LoadClients::readClient(int client) {
+  char buffer[1 << 16];
+  while (true) {
+    ssize_t n = recv(fds_[client], buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (n > 0) {
+      bytes_[client] += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else {
+      close(fds_[client]);
+      fds_[client] = -1;
+      return;
+    }
+  }
+}
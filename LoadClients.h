@@ -0,0 +1,38 @@
+// Copyright (C)
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Local stand-ins for the terminal clients of a TetrisServer, to test and
+// load it: they connect, start games by pressing space and keep pressing
+// random keys, and read everything the server sends.
+class LoadClients {
+public:
+  // Connect the clients to the server socket at the path.
+  LoadClients(const std::string &path, int numClients, uint64_t seed = 1);
+  ~LoadClients();
+
+  // Press a random key on every client every keyInterval for the duration.
+  void run(std::chrono::milliseconds duration,
+           std::chrono::milliseconds keyInterval =
+               std::chrono::milliseconds(100));
+
+  // Number of clients the server did not disconnect
+  size_t numConnected() const;
+
+  // Bytes a client received
+  uint64_t bytesReceived(int client) const { return bytes_[client]; }
+
+private:
+  // Read everything that is available, close the client on disconnect.
+  void readClient(int client);
+
+  // -1 for disconnected clients
+  std::vector<int> fds_;
+  std::vector<uint64_t> bytes_;
+  uint64_t rngState_;
+};
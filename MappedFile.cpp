@@ -0,0 +1,47 @@
+// Copyright (C)
+
+#include "./MappedFile.h"
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ____________________________________________________________________________
+MappedFile::MappedFile(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Could not stat " + path);
+  }
+  size_ = st.st_size;
+  // mmap does not accept empty files, an empty file simply has no data.
+  if (size_ > 0) {
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Could not map " + path);
+    }
+    data_ = static_cast<const uint8_t *>(data);
+  }
+  // The mapping stays valid after closing the descriptor.
+  close(fd);
+}
+
+// ____________________________________________________________________________
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+}
+
+// ____________________________________________________________________________
+void MappedFile::adviseSequential() const {
+  if (data_ != nullptr) {
+    madvise(const_cast<uint8_t *>(data_), size_, MADV_SEQUENTIAL);
+  }
+}
@@ -0,0 +1,33 @@
+// Copyright (C)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A read-only memory mapped file. Pages are only read from disk when they are
+// touched, so looking at a small part of a large file is cheap.
+class MappedFile {
+public:
+  // Map the whole file. Throws if it cannot be opened or mapped.
+  explicit MappedFile(const std::string &path);
+
+  // Unmaps the file.
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Tell the kernel that the file will be read from front to back, so it
+  // reads ahead aggressively.
+  void adviseSequential() const;
+
+  // Getters for the mapped bytes.
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  const uint8_t *data_{nullptr};
+  size_t size_{0};
+};
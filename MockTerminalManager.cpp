@@ -6,6 +6,8 @@
 // ____________________________________________________________________________
 MockTerminalManager::MockTerminalManager(int numRows, int numCols)
     : numRows_(numRows), numCols_(numCols) {
+  // No key is pressed until setUserInput is called.
+  userInput_.keycode_ = -1;
   for (int i = 0; i < numRows_; ++i) {
     for (int j = 0; j < numCols_; ++j) {
       screen_[std::make_pair(i, j)] = std::make_pair(0, 0);
@@ -0,0 +1,74 @@
+// Copyright (C)
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A bounded lock-free queue for many producer threads and one consumer
+// thread. Every slot has a sequence number that says whose turn it is, so
+// producers only compete for the tail with one compare-and-swap and the
+// consumer never has to. Nothing is allocated after construction.
+template <class T, size_t Capacity> class MpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "The capacity must be a power of two");
+
+public:
+  MpscQueue() {
+    for (size_t i = 0; i < Capacity; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  // Append a value, from any thread. Returns false if the queue is full.
+  bool push(const T &value) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot &slot = slots_[pos % Capacity];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          slot.value = value;
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        // The consumer did not take the value of the last round yet.
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Take the oldest value, only from the consumer thread. Returns false if
+  // the queue is empty.
+  bool pop(T *value) {
+    Slot &slot = slots_[head_ % Capacity];
+    if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+      return false;
+    }
+    *value = slot.value;
+    slot.sequence.store(head_ + Capacity, std::memory_order_release);
+    head_++;
+    return true;
+  }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  // Producers and the consumer each on their own cache line
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) size_t head_{0};
+  alignas(64) Slot slots_[Capacity];
+};
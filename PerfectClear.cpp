@@ -0,0 +1,334 @@
+// Copyright (C)
+
+#include "./PerfectClear.h"
+#include "./TetrisGame.h"
+#include "./WorkStealingPool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+// The search packs the bottom rows of the board into 64 bits: bit 10 * y + x
+// is column x of row y, counted from the bottom.
+static constexpr int width = StandardBoard::width;
+static constexpr int height = StandardBoard::height;
+static constexpr int maxLines = 6;
+static_assert(width * maxLines <= 60, "Boards and depths share a hash key");
+static constexpr uint64_t rowMask = (uint64_t{1} << width) - 1;
+
+// Cells of the lowest `lines` rows
+static uint64_t rowsMask(int lines) {
+  return (uint64_t{1} << (width * lines)) - 1;
+}
+
+// A rotation of a Tetromino, packed like the board with its lowest row at
+// the bottom and its leftmost column at the left
+struct Orientation {
+  uint64_t mask;
+  int width;
+  int height;
+  int rotation;
+  // Where the position of the Tetromino is relative to its mask
+  int offsetX;
+  int offsetY;
+};
+
+// The distinct rotations of every form
+static const std::vector<Orientation> &orientationsOf(TetrominoForm form) {
+  static const auto table = []() {
+    std::vector<std::vector<Orientation>> table(7);
+    for (int f = 0; f < 7; ++f) {
+      TetrominoForm form = static_cast<TetrominoForm>(f);
+      Tetromino tetromino{form};
+      int numRotations = form == TetrominoForm::O   ? 1
+                         : form == TetrominoForm::I ? 2
+                                                    : 4;
+      for (int rotation = 0; rotation < numRotations; ++rotation) {
+        std::vector<std::pair<int, int>> points =
+            tetromino.getRotatedForm(rotation);
+        int minX = 4, maxX = -4, minY = 4, maxY = -4;
+        for (const auto &point : points) {
+          minX = std::min(minX, point.first);
+          maxX = std::max(maxX, point.first);
+          minY = std::min(minY, point.second);
+          maxY = std::max(maxY, point.second);
+        }
+        Orientation orientation{0, maxX - minX + 1, maxY - minY + 1,
+                                rotation, -minX, maxY};
+        for (const auto &point : points) {
+          orientation.mask |= uint64_t{1}
+                              << ((maxY - point.second) * width +
+                                  point.first - minX);
+        }
+        bool seen = false;
+        for (const Orientation &other : table[f]) {
+          seen |= other.mask == orientation.mask;
+        }
+        if (!seen) {
+          table[f].push_back(orientation);
+        }
+      }
+    }
+    return table;
+  }();
+  return table.at(static_cast<int>(form));
+}
+
+// Can the empty cells of the lowest `lines` rows still be filled with
+// Tetrominos? Cells that may ever touch belong to the same region: cells
+// next to each other in a row, and all empty cells of a column, because the
+// blocks between them may be cleared. Every region needs a multiple of 4
+// cells.
+static bool regionsFillable(uint64_t board, int lines) {
+  uint64_t empty = ~board & rowsMask(lines);
+  uint64_t columnMask = 0;
+  for (int y = 0; y < lines; ++y) {
+    columnMask |= uint64_t{1} << (width * y);
+  }
+  // Empty cells with an empty right neighbour in the same row
+  uint64_t notLast = 0;
+  for (int y = 0; y < lines; ++y) {
+    notLast |= (rowMask >> 1) << (width * y);
+  }
+  uint64_t touching = empty & (empty >> 1) & notLast;
+  int region = 0;
+  for (int x = 0; x < width; ++x) {
+    region += __builtin_popcountll(empty & (columnMask << x));
+    if (x == width - 1 || (touching & (columnMask << x)) == 0) {
+      if (region % 4 != 0) {
+        return false;
+      }
+      region = 0;
+    }
+  }
+  return true;
+}
+
+// A set of 64 bit keys for all threads, open addressing without locks. When
+// it is too full, keys are not remembered and boards are searched again.
+class VisitedSet {
+public:
+  explicit VisitedSet(size_t capacity)
+      : slots_(new std::atomic<uint64_t>[capacity]), mask_(capacity - 1) {
+    if (capacity == 0 || (capacity & mask_) != 0) {
+      throw std::invalid_argument("The capacity must be a power of 2");
+    }
+    clear();
+  }
+
+  void clear() {
+    for (size_t i = 0; i <= mask_; ++i) {
+      slots_[i].store(empty, std::memory_order_relaxed);
+    }
+  }
+
+  // Add the key. False if it was there already.
+  bool insert(uint64_t key) {
+    size_t index = (key * 0x9E3779B97F4A7C15ULL) >> 20 & mask_;
+    for (int probe = 0; probe < maxProbes; ++probe) {
+      std::atomic<uint64_t> &slot = slots_[(index + probe) & mask_];
+      uint64_t seen = slot.load(std::memory_order_relaxed);
+      if (seen == empty &&
+          slot.compare_exchange_strong(seen, key, std::memory_order_relaxed)) {
+        return true;
+      }
+      if (seen == key) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  // No board with all cells and depth 15, because full rows are cleared
+  static constexpr uint64_t empty = ~uint64_t{0};
+  static constexpr int maxProbes = 32;
+
+  std::unique_ptr<std::atomic<uint64_t>[]> slots_;
+  size_t mask_;
+};
+
+namespace {
+// Everything the tasks of one search share
+struct Search {
+  const std::vector<TetrominoForm> *pieces;
+  // Pieces the perfect clear needs
+  int depth;
+  std::chrono::steady_clock::time_point deadline;
+  VisitedSet *visited;
+  WorkStealingPool *pool;
+  // Subtrees up to this depth are tasks of their own
+  int splitDepth;
+  std::atomic<bool> stop{false};
+  std::atomic<bool> timedOut{false};
+  std::mutex mutex;
+  std::vector<Placement> solution;
+  // Per worker, on its own cache line
+  struct alignas(64) Counters {
+    uint64_t nodes{0};
+    uint64_t pruned{0};
+  };
+  std::vector<Counters> counters;
+
+  // Search all placements of the Tetromino at `depth` on the board with
+  // `lines` rows left to clear. `path` holds the placements so far.
+  void expand(int worker, uint64_t board, int lines, int at,
+              std::vector<Placement> &path);
+};
+} // namespace
+
+// ____________________________________________________________________________
+void Search::expand(int worker, uint64_t board, int lines, int at,
+                    std::vector<Placement> &path) {
+  if (stop.load(std::memory_order_relaxed) || at == depth) {
+    return;
+  }
+  Counters &own = counters[worker];
+  if (++own.nodes % 1024 == 0 && std::chrono::steady_clock::now() > deadline) {
+    timedOut = true;
+    stop = true;
+    return;
+  }
+  TetrominoForm form = (*pieces)[at];
+  for (const Orientation &orientation : orientationsOf(form)) {
+    for (int x = 0; x + orientation.width <= width; ++x) {
+      // Dropped from above the stack, it must not stick out of the rows of
+      // the perfect clear.
+      int y = lines;
+      while (y > 0 &&
+             (orientation.mask << (width * (y - 1) + x) & board) == 0) {
+        y--;
+      }
+      if (y + orientation.height > lines) {
+        continue;
+      }
+      uint64_t next = board | orientation.mask << (width * y + x);
+      int left = lines;
+      for (int row = y + orientation.height - 1; row >= y; --row) {
+        if ((next >> (width * row) & rowMask) == rowMask) {
+          uint64_t below = rowsMask(row);
+          next = (next & below) | (next >> width & ~below);
+          left--;
+        }
+      }
+      path.push_back({form, orientation.rotation, x + orientation.offsetX,
+                      height - 1 - y - orientation.offsetY});
+      if (next == 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stop.exchange(true)) {
+          solution = path;
+        }
+        return;
+      }
+      if (!regionsFillable(next, left) ||
+          !visited->insert(next | uint64_t(at + 1) << 60)) {
+        own.pruned++;
+        path.pop_back();
+        continue;
+      }
+      if (at < splitDepth) {
+        pool->submit([this, next, left, at, path](int worker) mutable {
+          expand(worker, next, left, at + 1, path);
+        });
+      } else {
+        expand(worker, next, left, at + 1, path);
+      }
+      path.pop_back();
+    }
+  }
+}
+
+// ____________________________________________________________________________
+PerfectClear::PerfectClear(const uint16_t (&rows)[20],
+                           std::vector<TetrominoForm> pieces)
+    : pieces_(std::move(pieces)) {
+  std::copy(rows, rows + height, rows_);
+  for (TetrominoForm form : pieces_) {
+    if (static_cast<unsigned>(form) >= 7) {
+      throw std::invalid_argument("Perfect clears need real Tetrominos");
+    }
+  }
+}
+
+// ____________________________________________________________________________
+PerfectClear::PerfectClear(const GameState &state, size_t numPieces)
+    : pieces_(TetrisGame::upcomingTetrominos(state, numPieces)) {
+  for (int y = 0; y < height; ++y) {
+    rows_[y] = 0;
+    for (int x = 0; x < width; ++x) {
+      if ((state.rows[y] >> (3 * x) & 7) != 0) {
+        rows_[y] |= 1 << x;
+      }
+    }
+  }
+}
+
+// ____________________________________________________________________________
+PerfectClear::Result PerfectClear::solve(const Options &options) const {
+  if (options.maxLines < 1 || options.maxLines > maxLines) {
+    throw std::invalid_argument("Perfect clears have 1 to 6 lines");
+  }
+  auto start = std::chrono::steady_clock::now();
+  Result result;
+  // The board in the lowest rows. Blocks above them rule out a perfect clear
+  // within maxLines.
+  uint64_t board = 0;
+  int stack = 0;
+  int cells = 0;
+  for (int y = 0; y < height; ++y) {
+    int fromBottom = height - 1 - y;
+    if (rows_[y] == 0) {
+      continue;
+    }
+    if (fromBottom >= options.maxLines) {
+      return result;
+    }
+    board |= uint64_t{rows_[y]} << (width * fromBottom);
+    stack = std::max(stack, fromBottom + 1);
+    cells += __builtin_popcount(rows_[y]);
+  }
+  WorkStealingPool pool(options.threads);
+  VisitedSet visited(options.visitedCapacity);
+  result.threads = pool.numThreads();
+  // Try the lowest perfect clears first. The cells decide how many pieces
+  // each one needs.
+  for (int lines = std::max(stack, 1);
+       lines <= options.maxLines && !result.found && !result.timedOut;
+       ++lines) {
+    int missing = width * lines - cells;
+    if (missing % 4 != 0 || missing / 4 > static_cast<int>(pieces_.size()) ||
+        !regionsFillable(board, lines)) {
+      continue;
+    }
+    visited.clear();
+    Search search;
+    search.pieces = &pieces_;
+    search.depth = missing / 4;
+    search.deadline = start + options.deadline;
+    search.visited = &visited;
+    search.pool = &pool;
+    search.splitDepth = 2;
+    search.counters.resize(pool.numThreads());
+    pool.submit([&search, board, lines](int worker) {
+      std::vector<Placement> path;
+      search.expand(worker, board, lines, 0, path);
+    });
+    pool.wait();
+    for (const Search::Counters &counters : search.counters) {
+      result.nodes += counters.nodes;
+      result.pruned += counters.pruned;
+    }
+    result.timedOut = search.timedOut;
+    if (!search.solution.empty()) {
+      result.found = true;
+      result.placements = search.solution;
+      result.lines = lines;
+    }
+  }
+  result.steals = pool.steals();
+  result.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return result;
+}
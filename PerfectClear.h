@@ -0,0 +1,71 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./GameState.h"
+#include "./Tetromino.h"
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Where a Tetromino settles, in the coordinates of TetrisGame: the rotation
+// like in a TrainingRecord (for I 0 is upright and 1 flat) and the position
+// of the Tetromino on the board.
+struct Placement {
+  TetrominoForm form;
+  int rotation;
+  int positionX;
+  int positionY;
+};
+
+// Finds placements for a known sequence of Tetrominos that clear every block
+// off the board: a perfect clear. The Tetrominos are placed in their order,
+// each rotated and moved above the stack and dropped straight down, the way
+// the bots steer them, and the clear has to happen within a few rows.
+// The search is a depth first search over the placements. It skips boards
+// that were seen before at the same depth (a hash set shared by all threads)
+// and boards with an empty region that pieces cannot fill, because its size
+// is not a multiple of 4. Subtrees near the root are tasks on a
+// WorkStealingPool, so idle threads take over work of busy ones. The search
+// stops at the first perfect clear or at the deadline.
+class PerfectClear {
+public:
+  struct Options {
+    // Zero means one per core
+    int threads{0};
+    std::chrono::milliseconds deadline{1000};
+    // Rows of the perfect clear, at most 6
+    int maxLines{6};
+    // Boards the hash set remembers, a power of 2
+    size_t visitedCapacity{1 << 20};
+  };
+
+  struct Result {
+    bool found{false};
+    // The placements of the first Tetrominos of the sequence
+    std::vector<Placement> placements;
+    // Lines the perfect clear clears
+    int lines{0};
+    bool timedOut{false};
+    // Boards searched and boards skipped by the hash set or the regions
+    uint64_t nodes{0};
+    uint64_t pruned{0};
+    double seconds{0};
+    int threads{0};
+    uint64_t steals{0};
+  };
+
+  // The settled blocks of rows[y] (bit x is column x, row 0 is the top, like
+  // Board::row) and the Tetrominos to place, in their order.
+  PerfectClear(const uint16_t (&rows)[20], std::vector<TetrominoForm> pieces);
+
+  // The settled blocks of a snapshot and its next `numPieces` Tetrominos,
+  // see TetrisGame::upcomingTetrominos.
+  PerfectClear(const GameState &state, size_t numPieces);
+
+  Result solve(const Options &options) const;
+
+private:
+  uint16_t rows_[20];
+  std::vector<TetrominoForm> pieces_;
+};
@@ -0,0 +1,136 @@
+// Copyright (C)
+
+#include "./PerfectClear.h"
+#include "./TetrisGame.h"
+#include <climits>
+#include <gtest/gtest.h>
+#include <ncurses.h> // For keycodes
+
+// Steer the Tetrominos of the game to the placements with keys, like the bots
+// do, without gravity. False if one does not settle where it should.
+static bool play(TetrisGame *game, const std::vector<Placement> &placements) {
+  UserInput uI;
+  for (const Placement &placement : placements) {
+    GameState state = game->snapshot();
+    if (state.current != static_cast<int>(placement.form)) {
+      return false;
+    }
+    state.gravityFrames = INT8_MIN;
+    game->restore(state);
+    bool isI = placement.form == TetrominoForm::I;
+    for (int i = 0; i < 4; ++i) {
+      state = game->snapshot();
+      if (isI ? state.iIsUp == !placement.rotation
+              : state.rotation == placement.rotation) {
+        break;
+      }
+      uI.keycode_ = 'd';
+      game->simulateFrame(uI);
+    }
+    while (game->snapshot().positionX != placement.positionX) {
+      uI.keycode_ = game->snapshot().positionX < placement.positionX
+                        ? KEY_RIGHT
+                        : KEY_LEFT;
+      game->simulateFrame(uI);
+    }
+    uint64_t piece = game->pieces();
+    int positionY = -1;
+    uI.keycode_ = KEY_DOWN;
+    while (game->pieces() == piece && !game->gameOver()) {
+      positionY = game->snapshot().positionY;
+      game->simulateFrame(uI);
+    }
+    if (positionY != placement.positionY) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A headless game with the seed
+static std::unique_ptr<TetrisGame> startGame(uint64_t seed) {
+  auto game =
+      std::make_unique<TetrisGame>(std::make_unique<HeadlessTerminalManager>());
+  game->setSeed(seed);
+  game->newGame();
+  return game;
+}
+
+TEST(PerfectClear, upcomingTetrominos) {
+  auto game = startGame(3);
+  std::vector<TetrominoForm> forms =
+      TetrisGame::upcomingTetrominos(game->snapshot(), 20);
+  ASSERT_EQ(forms.size(), 20u);
+  UserInput uI;
+  uI.keycode_ = KEY_DOWN;
+  for (TetrominoForm form : forms) {
+    ASSERT_EQ(game->snapshot().current, static_cast<int>(form));
+    for (uint64_t piece = game->pieces(); game->pieces() == piece;) {
+      game->simulateFrame(uI);
+    }
+  }
+}
+
+TEST(PerfectClear, fromGame) {
+  PerfectClear::Options options;
+  options.maxLines = 4;
+  int found = 0;
+  // Without hold and with straight drops only some sequences have one.
+  for (uint64_t seed : {4, 5, 7}) {
+    auto game = startGame(seed);
+    PerfectClear::Result single =
+        PerfectClear(game->snapshot(), 10).solve({1, options.deadline, 4});
+    options.threads = 2;
+    PerfectClear::Result result =
+        PerfectClear(game->snapshot(), 10).solve(options);
+    ASSERT_EQ(result.found, single.found) << seed;
+    ASSERT_FALSE(result.timedOut);
+    ASSERT_EQ(result.threads, 2);
+    ASSERT_GT(result.nodes, 0u);
+    if (!result.found) {
+      continue;
+    }
+    found++;
+    ASSERT_EQ(result.lines, 4);
+    ASSERT_EQ(result.placements.size(), 10u);
+    ASSERT_TRUE(play(game.get(), result.placements)) << seed;
+    GameState state = game->snapshot();
+    for (uint32_t row : state.rows) {
+      ASSERT_EQ(row, 0u);
+    }
+    ASSERT_EQ(state.lines, 4);
+  }
+  ASSERT_GT(found, 0);
+}
+
+TEST(PerfectClear, pruning) {
+  // Two rows with room for two flat Is on the left
+  uint16_t rows[20]{};
+  rows[18] = rows[19] = 0x3F0;
+  PerfectClear::Options options;
+  PerfectClear::Result result =
+      PerfectClear(rows, {TetrominoForm::I, TetrominoForm::I}).solve(options);
+  ASSERT_TRUE(result.found);
+  ASSERT_EQ(result.lines, 2);
+  ASSERT_EQ(result.placements[0].rotation, 1);
+  ASSERT_EQ(result.placements[0].positionY, 19);
+  // A well of 3 cells in column 0 can never be filled.
+  rows[17] = 0x3FE;
+  rows[18] = rows[19] = 0x3FE;
+  result = PerfectClear(rows, {TetrominoForm::I, TetrominoForm::O,
+                               TetrominoForm::T, TetrominoForm::L})
+               .solve(options);
+  ASSERT_FALSE(result.found);
+  ASSERT_FALSE(result.timedOut);
+  // S and Z always leave a hole that cannot be reached.
+  std::vector<TetrominoForm> pieces;
+  for (int i = 0; i < 15; ++i) {
+    pieces.push_back(i % 2 == 0 ? TetrominoForm::S : TetrominoForm::Z);
+  }
+  uint16_t empty[20]{};
+  options.deadline = std::chrono::milliseconds(200);
+  result = PerfectClear(empty, pieces).solve(options);
+  ASSERT_FALSE(result.found);
+  ASSERT_GT(result.pruned, 0u);
+  ASSERT_THROW(PerfectClear(empty, {TetrominoForm::N}), std::invalid_argument);
+}
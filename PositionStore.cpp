@@ -0,0 +1,310 @@
+// Copyright (C)
+
+#include "./PositionStore.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+static constexpr char magic[4] = {'T', 'P', 'O', 'S'};
+static constexpr uint32_t version = 1;
+// Slots a position may be in, after the one of its hash
+static constexpr size_t window = 16;
+static constexpr uint64_t emptyTag = 0;
+static constexpr uint64_t busyTag = 1;
+static constexpr uint64_t maxVisits = 0xFFFFFFFF;
+// Visits of a thread per tick of the clock
+static constexpr uint32_t visitsPerTick = 256;
+
+// Start of a snapshot, followed by `capacity` records
+struct PositionSnapshotHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t capacity;
+  uint64_t size;
+};
+
+// A position of a snapshot, 0 visits for an empty record
+struct PositionRecord {
+  uint64_t words[4];
+  uint32_t visits;
+  uint32_t lastVisit;
+};
+
+// ____________________________________________________________________________
+static uint64_t hashOf(const uint64_t (&words)[4]) {
+  uint64_t hash = 0;
+  for (uint64_t word : words) {
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+// The tag of a hash, never one of the reserved ones
+static uint64_t tagOf(uint64_t hash) {
+  uint64_t tag = hash >> 32;
+  return tag <= busyTag ? tag + 2 : tag;
+}
+
+// ____________________________________________________________________________
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+// ____________________________________________________________________________
+PositionKey PositionKey::of(const uint16_t (&rows)[20],
+                            TetrominoForm current) {
+  PositionKey key{};
+  for (int y = 0; y < 20; ++y) {
+    key.words[y / 6] |= uint64_t{rows[y] & 0x3FFu} << (10 * (y % 6));
+  }
+  key.words[3] |= uint64_t(static_cast<int>(current)) << 60;
+  return key;
+}
+
+// ____________________________________________________________________________
+PositionKey PositionKey::of(const GameState &state) {
+  uint16_t rows[20];
+  for (int y = 0; y < 20; ++y) {
+    rows[y] = 0;
+    for (int x = 0; x < 10; ++x) {
+      if ((state.rows[y] >> (3 * x) & 7) != 0) {
+        rows[y] |= 1 << x;
+      }
+    }
+  }
+  return of(rows, static_cast<TetrominoForm>(state.current));
+}
+
+// ____________________________________________________________________________
+bool PositionKey::operator==(const PositionKey &other) const {
+  return memcmp(words, other.words, sizeof(words)) == 0;
+}
+
+// ____________________________________________________________________________
+PositionStore::PositionStore(size_t memoryLimit) {
+  size_t capacity = 1;
+  while (capacity * 2 * sizeof(Slot) <= memoryLimit) {
+    capacity *= 2;
+  }
+  if (capacity * sizeof(Slot) > memoryLimit || capacity < window) {
+    throw std::invalid_argument("The memory limit is too small");
+  }
+  slots_.reset(new Slot[capacity]);
+  mask_ = capacity - 1;
+  for (size_t i = 0; i < capacity; ++i) {
+    slots_[i].meta.store(emptyTag, std::memory_order_relaxed);
+    slots_[i].lastVisit.store(0, std::memory_order_relaxed);
+  }
+}
+
+// ____________________________________________________________________________
+uint32_t PositionStore::visit(const PositionKey &key) {
+  thread_local uint32_t ownVisits = 0;
+  if (++ownVisits % visitsPerTick == 0) {
+    clock_.fetch_add(1, std::memory_order_relaxed);
+  }
+  uint32_t now = clock_.load(std::memory_order_relaxed);
+  uint64_t hash = hashOf(key.words);
+  uint32_t visits;
+  do {
+    visits = tryVisit(key, hash, now);
+  } while (visits == 0);
+  return visits;
+}
+
+// ____________________________________________________________________________
+bool PositionStore::claim(Slot *slot, uint64_t seen, const PositionKey &key,
+                          uint64_t tag, uint32_t now) {
+  if (!slot->meta.compare_exchange_strong(seen, busyTag << 32,
+                                          std::memory_order_acquire)) {
+    return false;
+  }
+  for (int i = 0; i < 4; ++i) {
+    slot->words[i].store(key.words[i], std::memory_order_relaxed);
+  }
+  slot->lastVisit.store(now, std::memory_order_relaxed);
+  slot->meta.store(tag << 32 | 1, std::memory_order_release);
+  return true;
+}
+
+// ____________________________________________________________________________
+uint32_t PositionStore::tryVisit(const PositionKey &key, uint64_t hash,
+                                 uint32_t now) {
+  uint64_t tag = tagOf(hash);
+  Slot *oldest = nullptr;
+  uint64_t oldestMeta = 0;
+  uint32_t oldestAge = 0;
+  for (size_t probe = 0; probe < window; ++probe) {
+    Slot &slot = slots_[(hash + probe) & mask_];
+    uint64_t meta = slot.meta.load(std::memory_order_acquire);
+    if (meta >> 32 == emptyTag) {
+      if (claim(&slot, meta, key, tag, now)) {
+        return 1;
+      }
+      meta = slot.meta.load(std::memory_order_acquire);
+    }
+    while (meta >> 32 == busyTag) {
+      cpuRelax();
+      meta = slot.meta.load(std::memory_order_acquire);
+    }
+    if (meta >> 32 == tag) {
+      bool equal = true;
+      for (int i = 0; i < 4; ++i) {
+        equal &=
+            slot.words[i].load(std::memory_order_relaxed) == key.words[i];
+      }
+      // Counting only succeeds if the slot did not change meanwhile, e.g.
+      // was evicted for another position.
+      while (equal && (meta & maxVisits) < maxVisits) {
+        if (slot.meta.compare_exchange_weak(meta, meta + 1,
+                                            std::memory_order_relaxed)) {
+          slot.lastVisit.store(now, std::memory_order_relaxed);
+          return (meta & maxVisits) + 1;
+        }
+        if (meta >> 32 != tag) {
+          return 0;
+        }
+      }
+      if (equal) {
+        return maxVisits;
+      }
+      // The key may have been torn by a new one.
+      if (slot.meta.load(std::memory_order_acquire) != meta) {
+        return 0;
+      }
+    }
+    // The clock is coarse, of positions visited in the same tick the one
+    // with the fewest visits goes.
+    uint32_t age = now - slot.lastVisit.load(std::memory_order_relaxed);
+    if (oldest == nullptr || age > oldestAge ||
+        (age == oldestAge && (meta & maxVisits) < (oldestMeta & maxVisits))) {
+      oldest = &slot;
+      oldestMeta = meta;
+      oldestAge = age;
+    }
+  }
+  if (!claim(oldest, oldestMeta, key, tag, now)) {
+    return 0;
+  }
+  evictions_.fetch_add(1, std::memory_order_relaxed);
+  return 1;
+}
+
+// ____________________________________________________________________________
+uint32_t PositionStore::visits(const PositionKey &key) const {
+  uint64_t hash = hashOf(key.words);
+  uint64_t tag = tagOf(hash);
+  for (size_t probe = 0; probe < window; ++probe) {
+    const Slot &slot = slots_[(hash + probe) & mask_];
+    uint64_t meta = slot.meta.load(std::memory_order_acquire);
+    if (meta >> 32 != tag) {
+      continue;
+    }
+    bool equal = true;
+    for (int i = 0; i < 4; ++i) {
+      equal &= slot.words[i].load(std::memory_order_relaxed) == key.words[i];
+    }
+    if (equal) {
+      return meta & maxVisits;
+    }
+  }
+  return 0;
+}
+
+// ____________________________________________________________________________
+size_t PositionStore::size() const {
+  size_t size = 0;
+  for (size_t i = 0; i <= mask_; ++i) {
+    size += slots_[i].meta.load(std::memory_order_relaxed) >> 32 > busyTag;
+  }
+  return size;
+}
+
+// ____________________________________________________________________________
+void PositionStore::save(const std::string &path) const {
+  std::vector<PositionRecord> positions;
+  for (size_t i = 0; i <= mask_; ++i) {
+    const Slot &slot = slots_[i];
+    uint64_t meta = slot.meta.load(std::memory_order_acquire);
+    if (meta >> 32 <= busyTag) {
+      continue;
+    }
+    PositionRecord record;
+    for (int w = 0; w < 4; ++w) {
+      record.words[w] = slot.words[w].load(std::memory_order_relaxed);
+    }
+    record.visits = meta & maxVisits;
+    record.lastVisit = slot.lastVisit.load(std::memory_order_relaxed);
+    // Skip a key that was replaced while it was copied.
+    if (slot.meta.load(std::memory_order_acquire) >> 32 == meta >> 32) {
+      positions.push_back(record);
+    }
+  }
+  // At most half full, so lookups in the file find a key or an empty record
+  // soon.
+  size_t capacity = 1;
+  while (capacity < 2 * positions.size()) {
+    capacity *= 2;
+  }
+  std::vector<PositionRecord> records(capacity, PositionRecord{});
+  for (const PositionRecord &record : positions) {
+    size_t index = hashOf(record.words);
+    while (records[index & (capacity - 1)].visits != 0) {
+      index++;
+    }
+    records[index & (capacity - 1)] = record;
+  }
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("Could not write positions " + path);
+  }
+  PositionSnapshotHeader header{};
+  memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.capacity = capacity;
+  header.size = positions.size();
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(records.data(), sizeof(PositionRecord), capacity, file) ==
+                capacity;
+  ok &= fclose(file) == 0;
+  if (!ok) {
+    throw std::runtime_error("Could not write positions " + path);
+  }
+}
+
+// ____________________________________________________________________________
+PositionSnapshot::PositionSnapshot(const std::string &path) : file_(path) {
+  header_ = reinterpret_cast<const PositionSnapshotHeader *>(file_.data());
+  if (file_.size() < sizeof(PositionSnapshotHeader) ||
+      memcmp(header_->magic, magic, sizeof(magic)) != 0 ||
+      header_->version != version || header_->capacity == 0 ||
+      (header_->capacity & (header_->capacity - 1)) != 0 ||
+      file_.size() < sizeof(PositionSnapshotHeader) +
+                         header_->capacity * sizeof(PositionRecord)) {
+    throw std::runtime_error("Not a position snapshot: " + path);
+  }
+  records_ = reinterpret_cast<const PositionRecord *>(
+      file_.data() + sizeof(PositionSnapshotHeader));
+}
+
+// ____________________________________________________________________________
+uint32_t PositionSnapshot::visits(const PositionKey &key) const {
+  uint64_t mask = header_->capacity - 1;
+  for (uint64_t index = hashOf(key.words);; ++index) {
+    const PositionRecord &record = records_[index & mask];
+    if (record.visits == 0) {
+      return 0;
+    }
+    if (memcmp(record.words, key.words, sizeof(key.words)) == 0) {
+      return record.visits;
+    }
+  }
+}
+
+// ____________________________________________________________________________
+size_t PositionSnapshot::size() const { return header_->size; }
@@ -0,0 +1,107 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./GameState.h"
+#include "./MappedFile.h"
+#include "./Tetromino.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// A position for a bot: the settled blocks and the Tetromino to place. Row y
+// of the board (0 is the top) is bits 10 * (y % 6) to 10 * (y % 6) + 9 of
+// word y / 6, bit x for column x. The form is in the top bits of the last
+// word.
+struct PositionKey {
+  uint64_t words[4];
+
+  // From bit masks of the rows like Board::row
+  static PositionKey of(const uint16_t (&rows)[20], TetrominoForm current);
+  // The settled blocks and the current Tetromino of a snapshot
+  static PositionKey of(const GameState &state);
+
+  bool operator==(const PositionKey &other) const;
+};
+
+// Counts how often positions were visited, for corpora of bot games where the
+// same positions come up again and again. An open addressing hash table in a
+// fixed amount of memory that any number of threads visit without locks: an
+// empty slot is claimed with a compare-and-swap, its key written and then
+// published with its tag, and the visits of a position are counted in the
+// same atomic word as its tag. A visit only waits for another one that is
+// writing a key into the same slot. A position is looked for in a window of
+// slots after its hash, and when the window is full the position that was
+// visited least recently (on a coarse clock) is evicted for it.
+class PositionStore {
+public:
+  // Bytes of a slot
+  static constexpr size_t bytesPerEntry = 48;
+
+  // Use at most `memoryLimit` bytes, the largest power of 2 of slots that
+  // fits. Throws if that is less than a window.
+  explicit PositionStore(size_t memoryLimit);
+
+  // Count a visit of the position. Returns its visits, 1 if it is new.
+  uint32_t visit(const PositionKey &key);
+
+  // Visits of the position, 0 if it was never visited or was evicted
+  uint32_t visits(const PositionKey &key) const;
+
+  // Positions in the store. Counts all slots.
+  size_t size() const;
+  size_t capacity() const { return mask_ + 1; }
+  // Positions that had to leave for new ones
+  uint64_t evictions() const { return evictions_.load(); }
+
+  // Write the positions and their visits to a file that PositionSnapshot
+  // maps. Visits while saving may be missing from it.
+  void save(const std::string &path) const;
+
+private:
+  struct Slot {
+    // Tag in the upper 32 bits (0 for an empty slot, 1 while a key is
+    // written), visits in the lower ones
+    std::atomic<uint64_t> meta;
+    // Clock at the last visit
+    std::atomic<uint32_t> lastVisit;
+    std::atomic<uint64_t> words[4];
+  };
+  static_assert(sizeof(Slot) == bytesPerEntry, "Slots are packed");
+
+  // Look for the key in its window and count the visit, or put it into an
+  // empty slot or over the least recently visited one. Returns 0 if another
+  // thread got in the way.
+  uint32_t tryVisit(const PositionKey &key, uint64_t hash, uint32_t now);
+
+  // Take the slot if its meta is still `seen`, write the key and publish it
+  // with one visit.
+  static bool claim(Slot *slot, uint64_t seen, const PositionKey &key,
+                    uint64_t tag, uint32_t now);
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  // Advanced every few visits of a thread
+  std::atomic<uint32_t> clock_{0};
+  std::atomic<uint64_t> evictions_{0};
+};
+
+// A file written by PositionStore::save, mapped into memory. It is a hash
+// table itself, so lookups only touch the pages they need.
+class PositionSnapshot {
+public:
+  // Throws if the file is not a snapshot.
+  explicit PositionSnapshot(const std::string &path);
+
+  // Visits of the position when it was saved, 0 if it is not in it
+  uint32_t visits(const PositionKey &key) const;
+
+  size_t size() const;
+
+private:
+  MappedFile file_;
+  const struct PositionSnapshotHeader *header_;
+  const struct PositionRecord *records_;
+};
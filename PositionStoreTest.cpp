@@ -0,0 +1,117 @@
+// Copyright (C)
+
+#include "./PositionStore.h"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// A different position for every i
+static PositionKey keyOf(uint32_t i) {
+  uint16_t rows[20]{};
+  for (int y = 0; y < 4; ++y) {
+    rows[19 - y] = i >> (10 * y) & 0x3FF;
+  }
+  return PositionKey::of(rows, static_cast<TetrominoForm>(i % 7));
+}
+
+// ____________________________________________________________________________
+TEST(PositionStoreTest, keys) {
+  GameState state;
+  state.rows[19] = 07 | 02 << 27;
+  state.rows[0] = 01;
+  state.current = static_cast<int>(TetrominoForm::T);
+  uint16_t rows[20]{};
+  rows[19] = 1 | 1 << 9;
+  rows[0] = 1;
+  ASSERT_EQ(PositionKey::of(rows, TetrominoForm::T), PositionKey::of(state));
+  ASSERT_FALSE(PositionKey::of(rows, TetrominoForm::I) ==
+               PositionKey::of(state));
+  rows[0] = 0;
+  ASSERT_FALSE(PositionKey::of(rows, TetrominoForm::T) ==
+               PositionKey::of(state));
+}
+
+// ____________________________________________________________________________
+TEST(PositionStoreTest, visits) {
+  PositionStore store(1 << 20);
+  // 2^20 bytes hold 21845 slots
+  ASSERT_EQ(16384u, store.capacity());
+  ASSERT_EQ(0u, store.visits(keyOf(1)));
+  ASSERT_EQ(1u, store.visit(keyOf(1)));
+  ASSERT_EQ(2u, store.visit(keyOf(1)));
+  ASSERT_EQ(1u, store.visit(keyOf(2)));
+  ASSERT_EQ(2u, store.visits(keyOf(1)));
+  ASSERT_EQ(1u, store.visits(keyOf(2)));
+  ASSERT_EQ(2u, store.size());
+  ASSERT_EQ(0u, store.evictions());
+}
+
+// ____________________________________________________________________________
+TEST(PositionStoreTest, threads) {
+  PositionStore store(1 << 20);
+  constexpr uint32_t numKeys = 2000;
+  constexpr int numThreads = 4;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&store, t]() {
+      for (uint32_t i = 0; i < numKeys; ++i) {
+        store.visit(keyOf((i * 7 + t * 131) % numKeys));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(numKeys, store.size());
+  for (uint32_t i = 0; i < numKeys; ++i) {
+    ASSERT_EQ(uint32_t{numThreads}, store.visits(keyOf(i))) << i;
+  }
+}
+
+// ____________________________________________________________________________
+TEST(PositionStoreTest, eviction) {
+  // 16 slots, a single window
+  PositionStore store(16 * PositionStore::bytesPerEntry);
+  ASSERT_EQ(16u, store.capacity());
+  ASSERT_THROW(PositionStore(8 * PositionStore::bytesPerEntry),
+               std::invalid_argument);
+  // A frequent position stays while many others come and go.
+  for (uint32_t i = 1; i <= 10000; ++i) {
+    store.visit(keyOf(0));
+    store.visit(keyOf(i));
+  }
+  ASSERT_EQ(10000u, store.visits(keyOf(0)));
+  ASSERT_EQ(16u, store.size());
+  ASSERT_EQ(10000u - 15, store.evictions());
+  ASSERT_EQ(1u, store.visits(keyOf(10000)));
+}
+
+// ____________________________________________________________________________
+TEST(PositionStoreTest, snapshot) {
+  std::string path =
+      "/tmp/PositionStoreTest." + std::to_string(getpid()) + ".positions";
+  PositionStore store(1 << 16);
+  for (uint32_t i = 0; i < 300; ++i) {
+    for (uint32_t j = 0; j <= i % 5; ++j) {
+      store.visit(keyOf(i));
+    }
+  }
+  store.save(path);
+  {
+    PositionSnapshot snapshot(path);
+    ASSERT_EQ(store.size(), snapshot.size());
+    for (uint32_t i = 0; i < 300; ++i) {
+      ASSERT_EQ(store.visits(keyOf(i)), snapshot.visits(keyOf(i))) << i;
+    }
+    ASSERT_EQ(0u, snapshot.visits(keyOf(300)));
+  }
+  PositionStore empty(1 << 16);
+  empty.save(path);
+  ASSERT_EQ(0u, PositionSnapshot(path).visits(keyOf(1)));
+  remove(path.c_str());
+  ASSERT_THROW(PositionSnapshot("/tmp/TetrisNoSuchPositions"),
+               std::runtime_error);
+}
@@ -0,0 +1,298 @@
+// Copyright (C)
+
+#include "./Puzzle.h"
+#include "./WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+static constexpr int width = 10;
+static constexpr int height = 20;
+static constexpr uint16_t fullRow = (1 << width) - 1;
+static constexpr char magic[4] = {'T', 'P', 'Z', 'L'};
+static constexpr uint32_t version = 1;
+// Candidates per task of the generator
+static constexpr uint64_t batchSize = 16;
+
+// Start of a puzzle file, followed by the puzzles
+struct PuzzleFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t count;
+};
+
+namespace {
+// A rotation of a Tetromino, row by row from its top, bit x for column x
+struct Orientation {
+  uint16_t rows[4];
+  int width;
+  int height;
+};
+} // namespace
+
+// The distinct rotations of every form
+static const std::vector<Orientation> &orientationsOf(int form) {
+  static const auto table = []() {
+    std::vector<std::vector<Orientation>> table(7);
+    for (int f = 0; f < 7; ++f) {
+      Tetromino tetromino{static_cast<TetrominoForm>(f)};
+      for (int rotation = 0; rotation < 4; ++rotation) {
+        std::vector<std::pair<int, int>> points =
+            tetromino.getRotatedForm(rotation);
+        int minX = 4, maxX = -4, minY = 4, maxY = -4;
+        for (const auto &point : points) {
+          minX = std::min(minX, point.first);
+          maxX = std::max(maxX, point.first);
+          minY = std::min(minY, point.second);
+          maxY = std::max(maxY, point.second);
+        }
+        Orientation orientation{{0, 0, 0, 0}, maxX - minX + 1,
+                                maxY - minY + 1};
+        for (const auto &point : points) {
+          orientation.rows[point.second - minY] |= 1 << (point.first - minX);
+        }
+        bool seen = false;
+        for (const Orientation &other : table[f]) {
+          seen |= memcmp(other.rows, orientation.rows,
+                         sizeof(orientation.rows)) == 0;
+        }
+        if (!seen) {
+          table[f].push_back(orientation);
+        }
+      }
+    }
+    return table;
+  }();
+  return table[form];
+}
+
+// Does the orientation fit with its top row in row y?
+static bool fits(const uint16_t (&rows)[20], const Orientation &orientation,
+                 int x, int y) {
+  if (y + orientation.height > height) {
+    return false;
+  }
+  for (int r = 0; r < orientation.height; ++r) {
+    if ((orientation.rows[r] << x & rows[y + r]) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Place the Tetromino at `at` of the puzzle in every way and count the
+// solutions up to the limit.
+static void search(const Puzzle &puzzle, const uint16_t (&rows)[20],
+                   int cleared, int at, int limit,
+                   PuzzleSolutions *solutions) {
+  if (at == puzzle.numPieces) {
+    return;
+  }
+  for (const Orientation &orientation : orientationsOf(puzzle.pieces[at])) {
+    for (int x = 0; x + orientation.width <= width; ++x) {
+      if (!fits(rows, orientation, x, 0)) {
+        continue;
+      }
+      int y = 0;
+      while (fits(rows, orientation, x, y + 1)) {
+        y++;
+      }
+      uint16_t next[20];
+      int lines = 0;
+      // Settle and shift the rows above full ones down
+      for (int row = height - 1, to = height - 1; row >= 0; --row) {
+        uint16_t blocks = rows[row];
+        if (row >= y && row < y + orientation.height) {
+          blocks |= orientation.rows[row - y] << x;
+        }
+        if (blocks == fullRow) {
+          lines++;
+        } else {
+          next[to--] = blocks;
+        }
+        if (row == 0) {
+          for (; to >= 0; --to) {
+            next[to] = 0;
+          }
+        }
+      }
+      if (cleared + lines >= puzzle.lines) {
+        if (solutions->count++ == 0) {
+          solutions->pieces = at + 1;
+        }
+      } else {
+        search(puzzle, next, cleared + lines, at + 1, limit, solutions);
+      }
+      if (solutions->count >= limit) {
+        return;
+      }
+    }
+  }
+}
+
+// ____________________________________________________________________________
+PuzzleSolutions solvePuzzle(const Puzzle &puzzle, int limit) {
+  if (puzzle.numPieces > maxPuzzlePieces) {
+    throw std::invalid_argument("Too many Tetrominos for a puzzle");
+  }
+  for (int i = 0; i < puzzle.numPieces; ++i) {
+    if (puzzle.pieces[i] >= 7) {
+      throw std::invalid_argument("Puzzles need real Tetrominos");
+    }
+  }
+  PuzzleSolutions solutions;
+  if (puzzle.lines == 0) {
+    solutions.count = 1;
+    return solutions;
+  }
+  search(puzzle, puzzle.rows, 0, 0, limit, &solutions);
+  return solutions;
+}
+
+// ____________________________________________________________________________
+void writePuzzles(const std::string &path,
+                  const std::vector<Puzzle> &puzzles) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("Could not write puzzles " + path);
+  }
+  PuzzleFileHeader header{};
+  memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.count = puzzles.size();
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(puzzles.data(), sizeof(Puzzle), puzzles.size(), file) ==
+                puzzles.size();
+  ok &= fclose(file) == 0;
+  if (!ok) {
+    throw std::runtime_error("Could not write puzzles " + path);
+  }
+}
+
+// ____________________________________________________________________________
+std::vector<Puzzle> readPuzzles(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    throw std::runtime_error("Could not read puzzles " + path);
+  }
+  PuzzleFileHeader header;
+  std::vector<Puzzle> puzzles;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+            header.version == version && header.count < (1 << 24);
+  if (ok) {
+    puzzles.resize(header.count);
+    ok = fread(puzzles.data(), sizeof(Puzzle), puzzles.size(), file) ==
+         puzzles.size();
+  }
+  fclose(file);
+  for (const Puzzle &puzzle : puzzles) {
+    ok &= puzzle.numPieces <= maxPuzzlePieces;
+    for (int i = 0; i < puzzle.numPieces; ++i) {
+      ok &= puzzle.pieces[i] < 7;
+    }
+  }
+  if (!ok) {
+    throw std::runtime_error("Not a puzzle file: " + path);
+  }
+  return puzzles;
+}
+
+// ____________________________________________________________________________
+PuzzleGenerator::PuzzleGenerator(const Options &options) : options_(options) {
+  if (options.pieces < 1 || options.pieces > maxPuzzlePieces) {
+    throw std::invalid_argument("Puzzles have 1 to 8 Tetrominos");
+  }
+  if (options.lines < 1 || options.maxRows < 2 ||
+      options.maxRows > height - 4) {
+    throw std::invalid_argument("Puzzles need lines and 2 to 16 rows");
+  }
+}
+
+// ____________________________________________________________________________
+Puzzle PuzzleGenerator::candidate(uint64_t index) const {
+  // splitmix64 of the seed and the index
+  uint64_t state = options_.seed * 0x9E3779B97F4A7C15ULL + index;
+  auto random = [&state]() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  };
+  Puzzle puzzle;
+  puzzle.numPieces = options_.pieces;
+  puzzle.lines = options_.lines;
+  for (int i = 0; i < puzzle.numPieces; ++i) {
+    puzzle.pieces[i] = random() % 7;
+  }
+  // Rows from the bottom, each with one to three holes, fewer blocks higher
+  // up
+  int rows = 2 + random() % (options_.maxRows - 1);
+  for (int i = 0; i < rows; ++i) {
+    uint16_t blocks = fullRow;
+    int holes = 1 + random() % 3 + i / 2;
+    for (int h = 0; h < holes; ++h) {
+      blocks &= ~(1 << (random() % width));
+    }
+    puzzle.rows[height - 1 - i] = blocks;
+  }
+  return puzzle;
+}
+
+// ____________________________________________________________________________
+std::vector<Puzzle> PuzzleGenerator::generate(size_t count) {
+  auto start = std::chrono::steady_clock::now();
+  stats_ = Stats{};
+  WorkStealingPool pool(options_.threads);
+  std::mutex mutex;
+  std::vector<std::pair<uint64_t, Puzzle>> accepted;
+  uint64_t next = 0;
+  // Enough batches to keep every thread busy between two looks at the count
+  uint64_t batchesPerRound = 4 * pool.numThreads();
+  while (accepted.size() < count) {
+    for (uint64_t b = 0; b < batchesPerRound; ++b, next += batchSize) {
+      pool.submit([&, first = next](int) {
+        Stats own;
+        std::vector<std::pair<uint64_t, Puzzle>> found;
+        for (uint64_t i = first; i < first + batchSize; ++i) {
+          Puzzle puzzle = candidate(i);
+          PuzzleSolutions solutions = solvePuzzle(puzzle, 2);
+          own.candidates++;
+          if (solutions.count == 0) {
+            own.unsolvable++;
+          } else if (solutions.count > 1 ||
+                     solutions.pieces < puzzle.numPieces) {
+            own.ambiguous++;
+          } else {
+            found.emplace_back(i, puzzle);
+          }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        stats_.candidates += own.candidates;
+        stats_.unsolvable += own.unsolvable;
+        stats_.ambiguous += own.ambiguous;
+        accepted.insert(accepted.end(), found.begin(), found.end());
+      });
+    }
+    pool.wait();
+    if (options_.progress != nullptr) {
+      fprintf(options_.progress, "%zu of %zu puzzles from %lu candidates\n",
+              std::min(accepted.size(), count), count, stats_.candidates);
+    }
+  }
+  std::sort(accepted.begin(), accepted.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+  accepted.resize(count);
+  std::vector<Puzzle> puzzles;
+  for (const auto &entry : accepted) {
+    puzzles.push_back(entry.second);
+  }
+  stats_.accepted = puzzles.size();
+  stats_.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return puzzles;
+}
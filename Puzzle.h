@@ -0,0 +1,84 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Tetromino.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static constexpr int maxPuzzlePieces = 8;
+
+// A puzzle: settled blocks, the Tetrominos to place in their order and the
+// lines they have to clear. A plain struct, written to files as raw bytes.
+struct Puzzle {
+  // Bit x is column x, row 0 is the top, like Board::row
+  uint16_t rows[20]{};
+  // TetrominoForms, the first numPieces of them count
+  uint8_t pieces[maxPuzzlePieces]{};
+  uint8_t numPieces{0};
+  uint8_t lines{0};
+  uint8_t unused[6]{};
+};
+static_assert(sizeof(Puzzle) == 56,
+              "Puzzles are written raw and must not have padding");
+
+// The ways to solve a puzzle with Tetrominos that are rotated and moved above
+// the stack and dropped straight down, like the bots steer them. A solution
+// ends with the Tetromino that clears the last line of the goal.
+struct PuzzleSolutions {
+  // Solutions found, at most the limit
+  int count{0};
+  // Tetrominos the first solution places
+  int pieces{0};
+};
+PuzzleSolutions solvePuzzle(const Puzzle &puzzle, int limit);
+
+// Write puzzles to a file and read them back. Both throw if that fails.
+void writePuzzles(const std::string &path, const std::vector<Puzzle> &puzzles);
+std::vector<Puzzle> readPuzzles(const std::string &path);
+
+// Generates puzzles with exactly one solution that needs all Tetrominos.
+// Candidates are a few rows of random blocks with holes and random
+// Tetrominos, and every one is checked by solving it exhaustively. Batches of
+// candidates are tasks on a WorkStealingPool. Candidate i only depends on the
+// seed and i, and the accepted ones are returned in the order of their index,
+// so the result does not depend on the threads.
+class PuzzleGenerator {
+public:
+  struct Options {
+    // Zero means one per core
+    int threads{0};
+    int pieces{3};
+    int lines{2};
+    // Rows of blocks of the candidates, at least 2
+    int maxRows{4};
+    uint64_t seed{1};
+    // Where progress lines go, nullptr for none
+    FILE *progress{nullptr};
+  };
+
+  struct Stats {
+    uint64_t candidates{0};
+    uint64_t unsolvable{0};
+    // More than one solution, or one with fewer Tetrominos
+    uint64_t ambiguous{0};
+    uint64_t accepted{0};
+    double seconds{0};
+  };
+
+  explicit PuzzleGenerator(const Options &options);
+
+  // The first `count` puzzles that pass.
+  std::vector<Puzzle> generate(size_t count);
+
+  // The candidate with the index.
+  Puzzle candidate(uint64_t index) const;
+
+  Stats stats() const { return stats_; }
+
+private:
+  Options options_;
+  Stats stats_;
+};
@@ -0,0 +1,120 @@
+// Copyright (C)
+
+#include "./Puzzle.h"
+#include "./TetrisGame.h"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <ncurses.h> // For keycodes
+#include <string>
+#include <unistd.h>
+
+// The bottom row full but for the right column, and the Tetrominos
+static Puzzle wellPuzzle(std::vector<TetrominoForm> pieces, int lines) {
+  Puzzle puzzle;
+  puzzle.rows[19] = 0x1FF;
+  for (TetrominoForm form : pieces) {
+    puzzle.pieces[puzzle.numPieces++] = static_cast<uint8_t>(form);
+  }
+  puzzle.lines = lines;
+  return puzzle;
+}
+
+// ____________________________________________________________________________
+TEST(PuzzleTest, solve) {
+  // Only an upright I in the right column clears the row.
+  PuzzleSolutions solutions =
+      solvePuzzle(wellPuzzle({TetrominoForm::I}, 1), 2);
+  ASSERT_EQ(1, solutions.count);
+  ASSERT_EQ(1, solutions.pieces);
+  // An O cannot, it is two wide.
+  ASSERT_EQ(0, solvePuzzle(wellPuzzle({TetrominoForm::O}, 1), 2).count);
+  // The I can come first or second, and the O goes anywhere before it.
+  solutions = solvePuzzle(wellPuzzle({TetrominoForm::O, TetrominoForm::I}, 1),
+                          100);
+  ASSERT_GT(solutions.count, 2);
+  ASSERT_EQ(2, solutions.pieces);
+  ASSERT_EQ(2, solvePuzzle(wellPuzzle({TetrominoForm::O, TetrominoForm::I}, 1),
+                           2)
+                   .count);
+  // Two lines need more blocks than an I brings.
+  ASSERT_EQ(0, solvePuzzle(wellPuzzle({TetrominoForm::I}, 2), 2).count);
+}
+
+// ____________________________________________________________________________
+TEST(PuzzleTest, generate) {
+  PuzzleGenerator::Options options;
+  options.pieces = 2;
+  options.lines = 1;
+  options.threads = 1;
+  PuzzleGenerator single(options);
+  std::vector<Puzzle> puzzles = single.generate(20);
+  ASSERT_EQ(20u, puzzles.size());
+  PuzzleGenerator::Stats stats = single.stats();
+  ASSERT_EQ(20u, stats.accepted);
+  ASSERT_LE(stats.unsolvable + stats.ambiguous + stats.accepted,
+            stats.candidates);
+  for (const Puzzle &puzzle : puzzles) {
+    PuzzleSolutions solutions = solvePuzzle(puzzle, 2);
+    ASSERT_EQ(1, solutions.count);
+    ASSERT_EQ(2, solutions.pieces);
+  }
+  // The same puzzles on more threads
+  options.threads = 3;
+  PuzzleGenerator parallel(options);
+  std::vector<Puzzle> again = parallel.generate(20);
+  ASSERT_EQ(0, memcmp(puzzles.data(), again.data(),
+                      puzzles.size() * sizeof(Puzzle)));
+
+  std::string path = "/tmp/PuzzleTest." + std::to_string(getpid());
+  writePuzzles(path, puzzles);
+  std::vector<Puzzle> read = readPuzzles(path);
+  ASSERT_EQ(puzzles.size(), read.size());
+  ASSERT_EQ(0, memcmp(puzzles.data(), read.data(),
+                      puzzles.size() * sizeof(Puzzle)));
+  remove(path.c_str());
+  ASSERT_THROW(readPuzzles("/tmp/TetrisNoSuchPuzzles"), std::runtime_error);
+}
+
+// ____________________________________________________________________________
+TEST(PuzzleTest, play) {
+  TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+  Puzzle second = wellPuzzle({TetrominoForm::T}, 1);
+  second.rows[19] = 0x3F8;
+  game.setPuzzles({wellPuzzle({TetrominoForm::I}, 1), second});
+  UserInput uI;
+
+  // Dropped where it spawns, the I does not clear the row.
+  game.newGame();
+  GameState state = game.snapshot();
+  ASSERT_EQ(static_cast<int>(TetrominoForm::I), state.current);
+  ASSERT_EQ(static_cast<int>(TetrominoForm::N), state.next);
+  ASSERT_NE(0u, state.rows[19]);
+  uI.keycode_ = KEY_DOWN;
+  while (!game.gameOver()) {
+    game.simulateFrame(uI);
+  }
+  ASSERT_EQ(0, game.snapshot().lines);
+
+  // Again, in the right column
+  game.resetGame();
+  game.newGame();
+  ASSERT_EQ(static_cast<int>(TetrominoForm::I), game.snapshot().current);
+  uI.keycode_ = KEY_RIGHT;
+  for (int i = 0; i < 10; ++i) {
+    game.simulateFrame(uI);
+  }
+  uI.keycode_ = KEY_DOWN;
+  while (!game.gameOver()) {
+    game.simulateFrame(uI);
+  }
+  ASSERT_EQ(1, game.snapshot().lines);
+
+  // Solved, so the next game is the second puzzle.
+  game.resetGame();
+  game.newGame();
+  state = game.snapshot();
+  ASSERT_EQ(static_cast<int>(TetrominoForm::T), state.current);
+  ASSERT_EQ(0u, state.rows[18]);
+  ASSERT_NE(0u, state.rows[19] & 7u << 9);
+  ASSERT_EQ(0u, state.rows[19] & 07u);
+}
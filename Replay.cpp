@@ -0,0 +1,231 @@
+// Copyright (C)
+
+#include "./Replay.h"
+#include <cstring>
+#include <stdexcept>
+
+static constexpr char replayMagic[4] = {'T', 'R', 'P', 'L'};
+static constexpr char indexMagic[4] = {'T', 'R', 'P', 'X'};
+static constexpr uint8_t replayVersion = 2;
+static constexpr size_t flushThreshold = 1 << 16;
+// Number of entries, offset of the index, magic
+static constexpr size_t footerSize = 2 * sizeof(uint64_t) + 4;
+
+// ____________________________________________________________________________
+void putVarint(std::vector<uint8_t> *buffer, uint64_t value) {
+  while (value >= 0x80) {
+    buffer->push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  buffer->push_back(static_cast<uint8_t>(value));
+}
+
+// ____________________________________________________________________________
+uint64_t getVarint(const uint8_t *data, size_t size, size_t *pos) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*pos >= size) {
+      throw std::runtime_error("Replay is truncated");
+    }
+    uint8_t byte = data[(*pos)++];
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Replay contains an invalid varint");
+}
+
+// ____________________________________________________________________________
+ReplayWriter::ReplayWriter(const std::string &path,
+                           const ReplayHeader &header) {
+  file_ = fopen(path.c_str(), "wb");
+  if (file_ == nullptr) {
+    throw std::runtime_error("Could not open replay file " + path);
+  }
+  buffer_.reserve(flushThreshold + 64);
+  buffer_.insert(buffer_.end(), replayMagic, replayMagic + 4);
+  buffer_.push_back(replayVersion);
+  putVarint(&buffer_, header.seed);
+  putVarint(&buffer_, header.level);
+  putVarint(&buffer_, header.keycodeA);
+  putVarint(&buffer_, header.keycodeD);
+}
+
+// ____________________________________________________________________________
+ReplayWriter::~ReplayWriter() {
+  flush();
+  fclose(file_);
+}
+
+// ____________________________________________________________________________
+void ReplayWriter::gravity(uint64_t frame) { event(frame, REPLAY_GRAVITY); }
+
+// ____________________________________________________________________________
+void ReplayWriter::input(uint64_t frame, int keycode) {
+  event(frame, REPLAY_INPUT + keycode);
+}
+
+// ____________________________________________________________________________
+void ReplayWriter::keyframe(uint64_t frame, const GameState &keyframe) {
+  event(frame, REPLAY_KEYFRAME);
+  index_.push_back(ReplayIndexEntry{frame, written_ + buffer_.size()});
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&keyframe);
+  buffer_.insert(buffer_.end(), bytes, bytes + sizeof(GameState));
+}
+
+// ____________________________________________________________________________
+void ReplayWriter::finish(const ReplayResult &result) {
+  event(result.frames, REPLAY_END);
+  putVarint(&buffer_, result.score);
+  putVarint(&buffer_, result.lines);
+  putVarint(&buffer_, result.level);
+  uint64_t footer[2] = {index_.size(), written_ + buffer_.size()};
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(index_.data());
+  buffer_.insert(buffer_.end(), bytes,
+                 bytes + index_.size() * sizeof(ReplayIndexEntry));
+  bytes = reinterpret_cast<const uint8_t *>(footer);
+  buffer_.insert(buffer_.end(), bytes, bytes + sizeof(footer));
+  buffer_.insert(buffer_.end(), indexMagic, indexMagic + 4);
+  flush();
+  fflush(file_);
+}
+
+// ____________________________________________________________________________
+void ReplayWriter::event(uint64_t frame, uint32_t code) {
+  putVarint(&buffer_, frame - lastFrame_);
+  putVarint(&buffer_, code);
+  lastFrame_ = frame;
+  if (buffer_.size() >= flushThreshold) {
+    flush();
+  }
+}
+
+// ____________________________________________________________________________
+void ReplayWriter::flush() {
+  if (!buffer_.empty()) {
+    fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    written_ += buffer_.size();
+    buffer_.clear();
+  }
+}
+
+// ____________________________________________________________________________
+ReplayReader::ReplayReader(const uint8_t *data, size_t size)
+    : data_(data), size_(size) {
+  if (size_ < 5 || memcmp(data_, replayMagic, 4) != 0) {
+    throw std::runtime_error("Not a replay file");
+  }
+  if (data_[4] != replayVersion) {
+    throw std::runtime_error("Unsupported replay version");
+  }
+  pos_ = 5;
+  header_.seed = getVarint(data_, size_, &pos_);
+  header_.level = getVarint(data_, size_, &pos_);
+  header_.keycodeA = getVarint(data_, size_, &pos_);
+  header_.keycodeD = getVarint(data_, size_, &pos_);
+  firstEvent_ = pos_;
+  if (size_ >= pos_ + footerSize &&
+      memcmp(data_ + size_ - 4, indexMagic, 4) == 0) {
+    uint64_t footer[2];
+    memcpy(footer, data_ + size_ - footerSize, sizeof(footer));
+    // Subtractions only, a crafted footer must not overflow the check.
+    uint64_t indexEnd = size_ - footerSize;
+    if (footer[1] > indexEnd ||
+        footer[0] > (indexEnd - footer[1]) / sizeof(ReplayIndexEntry) ||
+        footer[0] * sizeof(ReplayIndexEntry) != indexEnd - footer[1]) {
+      throw std::runtime_error("Replay has a corrupt keyframe index");
+    }
+    numKeyframes_ = footer[0];
+    index_ = data_ + footer[1];
+  }
+}
+
+// ____________________________________________________________________________
+bool ReplayReader::next(uint64_t *frame, uint32_t *code) {
+  uint64_t delta = getVarint(data_, size_, &pos_);
+  if (delta > 0) {
+    eventInFrame_ = false;
+  }
+  frame_ += delta;
+  *frame = frame_;
+  *code = getVarint(data_, size_, &pos_);
+  if (*code == REPLAY_KEYFRAME) {
+    if (pos_ + sizeof(GameState) > size_) {
+      throw std::runtime_error("Replay is truncated");
+    }
+    pos_ += sizeof(GameState);
+    return next(frame, code);
+  }
+  if (*code == REPLAY_END) {
+    result_.frames = frame_;
+    result_.score = getVarint(data_, size_, &pos_);
+    result_.lines = getVarint(data_, size_, &pos_);
+    result_.level = getVarint(data_, size_, &pos_);
+    return false;
+  }
+  // A frame has a gravity tick or an input, more would be free moves.
+  if (eventInFrame_) {
+    throw std::runtime_error("Replay has two events in frame " +
+                             std::to_string(frame_));
+  }
+  eventInFrame_ = true;
+  return true;
+}
+
+// ____________________________________________________________________________
+bool ReplayReader::peek(uint64_t *frame, uint32_t *code) {
+  size_t pos = pos_;
+  uint64_t lastFrame = frame_;
+  bool eventInFrame = eventInFrame_;
+  bool ret = next(frame, code);
+  pos_ = pos;
+  frame_ = lastFrame;
+  eventInFrame_ = eventInFrame;
+  return ret;
+}
+
+// ____________________________________________________________________________
+void ReplayReader::rewind() {
+  pos_ = firstEvent_;
+  frame_ = 0;
+  eventInFrame_ = false;
+}
+
+// ____________________________________________________________________________
+bool ReplayReader::seekKeyframe(uint64_t frame, GameState *keyframe,
+                                uint64_t *keyframeFrame) {
+  // Binary search for the first keyframe after the frame.
+  size_t low = 0;
+  size_t high = numKeyframes_;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    if (indexEntry(mid).frame <= frame) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low == 0) {
+    rewind();
+    return false;
+  }
+  ReplayIndexEntry entry = indexEntry(low - 1);
+  if (size_ < sizeof(GameState) || entry.offset > size_ - sizeof(GameState)) {
+    throw std::runtime_error("Replay has a corrupt keyframe index");
+  }
+  memcpy(keyframe, data_ + entry.offset, sizeof(GameState));
+  *keyframeFrame = entry.frame;
+  pos_ = entry.offset + sizeof(GameState);
+  frame_ = entry.frame;
+  eventInFrame_ = false;
+  return true;
+}
+
+// ____________________________________________________________________________
+ReplayIndexEntry ReplayReader::indexEntry(size_t i) const {
+  // The index is not necessarily aligned in the file.
+  ReplayIndexEntry entry;
+  memcpy(&entry, index_ + i * sizeof(ReplayIndexEntry), sizeof(entry));
+  return entry;
+}
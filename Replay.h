@@ -0,0 +1,150 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./GameState.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Declaration of the replay log
+
+// A replay is a compact binary log of one game. Layout:
+//   "TRPL" magic, one version byte,
+//   header varints: seed, level, keycode A, keycode D,
+//   events: varint frame delta (frames since the previous event) followed by
+//           a varint event code. A REPLAY_KEYFRAME event is followed by a
+//           raw GameState, the full game state at the start of its frame,
+//   end: frame delta and REPLAY_END, then varints of the claimed final score,
+//        lines and level,
+//   index: one raw ReplayIndexEntry per keyframe, then the uint64 number of
+//          entries, the uint64 offset of the index and "TRPX".
+// Frames in which neither gravity nor an input happened are not recorded,
+// they do not change the game.
+// The index has a fixed width and sits at the end of the file, so a reader
+// on a memory mapped file finds the nearest keyframe with a binary search
+// without decoding anything before it.
+
+// Event codes. Every code >= REPLAY_INPUT is an input with keycode
+// code - REPLAY_INPUT.
+enum ReplayEvent : uint32_t {
+  REPLAY_END = 0,
+  REPLAY_GRAVITY = 1,
+  REPLAY_KEYFRAME = 2,
+  REPLAY_INPUT = 3
+};
+
+// Everything needed to start a game exactly like the recorded one.
+struct ReplayHeader {
+  uint64_t seed{0};
+  int level{0};
+  int keycodeA{97};
+  int keycodeD{100};
+};
+
+// The values a replay claims at its end.
+struct ReplayResult {
+  uint64_t frames{0};
+  int score{0};
+  int lines{0};
+  int level{0};
+};
+
+// Entry of the keyframe index: the frame of a keyframe and the file offset
+// of its GameState.
+struct ReplayIndexEntry {
+  uint64_t frame;
+  uint64_t offset;
+};
+
+// Append a varint (7 bits per byte, lowest group first) to the buffer.
+void putVarint(std::vector<uint8_t> *buffer, uint64_t value);
+
+// Decode a varint at *pos and advance *pos. Throws at the end of the data.
+uint64_t getVarint(const uint8_t *data, size_t size, size_t *pos);
+
+// Writes a replay. Events are collected in memory and only written to the
+// file in large blocks, so recording does not cost a syscall per frame.
+class ReplayWriter {
+public:
+  // Create the file and write the header.
+  ReplayWriter(const std::string &path, const ReplayHeader &header);
+
+  // Flushes and closes the file. A replay that was not finished stays
+  // without an end marker and is rejected by the reader.
+  ~ReplayWriter();
+
+  ReplayWriter(const ReplayWriter &) = delete;
+  ReplayWriter &operator=(const ReplayWriter &) = delete;
+
+  // Record a gravity tick in the given frame.
+  void gravity(uint64_t frame);
+
+  // Record an input in the given frame.
+  void input(uint64_t frame, int keycode);
+
+  // Record the game state at the start of the given frame and add it to the
+  // index.
+  void keyframe(uint64_t frame, const GameState &keyframe);
+
+  // Write the end marker, the claimed result and the index, then flush.
+  void finish(const ReplayResult &result);
+
+private:
+  void event(uint64_t frame, uint32_t code);
+  void flush();
+
+  FILE *file_;
+  std::vector<uint8_t> buffer_;
+  // Bytes already written to the file
+  uint64_t written_{0};
+  uint64_t lastFrame_{0};
+  std::vector<ReplayIndexEntry> index_;
+};
+
+// Decodes a replay from memory, usually a MappedFile. Does not copy or own
+// the data.
+class ReplayReader {
+public:
+  // Checks the magic and reads the header and the keyframe index.
+  ReplayReader(const uint8_t *data, size_t size);
+
+  const ReplayHeader &header() const { return header_; }
+
+  // Decode the next event. Keyframes are skipped. Returns false when the end
+  // marker is reached, result() is valid afterwards. Throws if a frame has
+  // more than one event.
+  bool next(uint64_t *frame, uint32_t *code);
+
+  // Like next(), but does not advance.
+  bool peek(uint64_t *frame, uint32_t *code);
+
+  const ReplayResult &result() const { return result_; }
+
+  // Go back to the first event.
+  void rewind();
+
+  // Number of keyframes in the index.
+  size_t numKeyframes() const { return numKeyframes_; }
+
+  // Find the last keyframe at or before the given frame and continue
+  // decoding right after it. Returns false (and rewinds) if there is none.
+  bool seekKeyframe(uint64_t frame, GameState *keyframe,
+                    uint64_t *keyframeFrame);
+
+private:
+  ReplayIndexEntry indexEntry(size_t i) const;
+
+  const uint8_t *data_;
+  size_t size_;
+  size_t pos_{0};
+  size_t firstEvent_{0};
+  uint64_t frame_{0};
+  // A gravity tick or an input was decoded in frame_ already
+  bool eventInFrame_{false};
+  ReplayHeader header_;
+  ReplayResult result_;
+  const uint8_t *index_{nullptr};
+  size_t numKeyframes_{0};
+};
@@ -0,0 +1,205 @@
+// Copyright (C)
+
+#include "./Rollback.h"
+#include "./Versus.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+
+// ____________________________________________________________________________
+RollbackSession::RollbackSession(uint64_t seed, int local, int maxPrediction)
+    : local_(local), maxPrediction_(maxPrediction) {
+  if (local < 0 || local > 1 || maxPrediction < 1 ||
+      maxPrediction >= inputHistory / 2) {
+    throw std::invalid_argument("Invalid rollback session");
+  }
+  for (int i = 0; i < 2; ++i) {
+    boards_[i] = std::make_unique<TetrisGame>(
+        std::make_unique<HeadlessTerminalManager>());
+    boards_[i]->setSeed(seed + i);
+    boards_[i]->onSettle([this, i](int cleared) { settled(i, cleared); });
+    boards_[i]->newGame();
+  }
+}
+
+// ____________________________________________________________________________
+bool RollbackSession::advanceFrame(int keycode) {
+  if (frame_ >= remoteConfirmed_ + maxPrediction_) {
+    stats_.stalls++;
+    return false;
+  }
+  synchronize();
+  localInputs_[frame_ % inputHistory] = keycode;
+  states_[frame_ % inputHistory] = save();
+  simulate(frame_);
+  frame_++;
+  return true;
+}
+
+// ____________________________________________________________________________
+void RollbackSession::addRemoteInput(int keycode) {
+  uint64_t frame = remoteConfirmed_++;
+  remoteInputs_[frame % inputHistory] = keycode;
+  // The frame was simulated with "no key" already.
+  if (frame < frame_ && keycode != -1) {
+    rollbackFrame_ = std::min(rollbackFrame_, frame);
+  }
+}
+
+// ____________________________________________________________________________
+void RollbackSession::synchronize() {
+  if (rollbackFrame_ >= frame_) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  load(states_[rollbackFrame_ % inputHistory]);
+  for (uint64_t frame = rollbackFrame_; frame < frame_; ++frame) {
+    states_[frame % inputHistory] = save();
+    simulate(frame);
+  }
+  stats_.rollbacks++;
+  stats_.resimulatedFrames += frame_ - rollbackFrame_;
+  stats_.maxRollbackFrames =
+      std::max(stats_.maxRollbackFrames, frame_ - rollbackFrame_);
+  stats_.maxRollbackMicros = std::max(
+      stats_.maxRollbackMicros,
+      std::chrono::duration<double, std::micro>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+  rollbackFrame_ = ~uint64_t{0};
+}
+
+// ____________________________________________________________________________
+int RollbackSession::localInput(uint64_t frame) const {
+  return localInputs_[frame % inputHistory];
+}
+
+// ____________________________________________________________________________
+uint64_t RollbackSession::checksum() const {
+  // FNV-1a
+  FrameState state = save();
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&state);
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < sizeof(state); ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+// ____________________________________________________________________________
+RollbackSession::FrameState RollbackSession::save() const {
+  FrameState state;
+  for (int i = 0; i < 2; ++i) {
+    state.boards[i] = boards_[i]->snapshot();
+    state.pendingGarbage[i] = pendingGarbage_[i];
+    state.garbageHole[i] = garbageHole_[i];
+  }
+  return state;
+}
+
+// ____________________________________________________________________________
+void RollbackSession::load(const FrameState &state) {
+  for (int i = 0; i < 2; ++i) {
+    boards_[i]->restore(state.boards[i]);
+    pendingGarbage_[i] = state.pendingGarbage[i];
+    garbageHole_[i] = state.garbageHole[i];
+  }
+}
+
+// ____________________________________________________________________________
+void RollbackSession::simulate(uint64_t frame) {
+  simulating_ = frame;
+  for (int i = 0; i < 2; ++i) {
+    if (boards_[i]->gameOver()) {
+      continue;
+    }
+    UserInput uI;
+    uI.keycode_ = -1;
+    if (i == local_) {
+      uI.keycode_ = localInputs_[frame % inputHistory];
+    } else if (frame < remoteConfirmed_) {
+      uI.keycode_ = remoteInputs_[frame % inputHistory];
+    }
+    boards_[i]->simulateFrame(uI);
+  }
+}
+
+// ____________________________________________________________________________
+void RollbackSession::settled(int index, int cleared) {
+  int lines = Versus::garbageFor(cleared);
+  if (lines > 0) {
+    // The hole only depends on the frame, so both peers agree on it.
+    pendingGarbage_[1 - index] += lines;
+    garbageHole_[1 - index] =
+        (simulating_ * 7 + index * 3) % StandardBoard::width;
+  }
+  if (pendingGarbage_[index] > 0) {
+    boards_[index]->addGarbage(pendingGarbage_[index], garbageHole_[index]);
+    pendingGarbage_[index] = 0;
+  }
+}
+
+// ____________________________________________________________________________
+RollbackPeer::RollbackPeer(int fd, RollbackSession *session,
+                           std::chrono::milliseconds delay,
+                           std::chrono::milliseconds jitter, uint64_t seed)
+    : fd_(fd), session_(session), delay_(delay), jitter_(jitter),
+      random_(seed) {}
+
+// ____________________________________________________________________________
+void RollbackPeer::poll(Clock::time_point now) {
+  constexpr size_t headerSize = offsetof(Message, inputs);
+  Message message;
+  ssize_t n;
+  while ((n = recv(fd_, &message, sizeof(message), MSG_DONTWAIT)) >=
+         static_cast<ssize_t>(headerSize)) {
+    messagesReceived_++;
+    acked_ = std::max(acked_, message.ack);
+    uint32_t numInputs = std::min<uint64_t>(
+        message.numInputs, (n - headerSize) / sizeof(int16_t));
+    for (uint32_t i = 0; i < numInputs; ++i) {
+      // Inputs that are known already or would leave a gap are skipped.
+      if (message.firstFrame + i == session_->remoteConfirmed()) {
+        session_->addRemoteInput(message.inputs[i]);
+      }
+    }
+  }
+
+  uint64_t frame = session_->frame();
+  uint64_t ack = session_->remoteConfirmed();
+  if (frame != sentFrame_ || ack != sentAck_) {
+    Message &out = outgoing_.emplace_back().second;
+    out.firstFrame = std::min(acked_, frame);
+    out.numInputs = std::min<uint64_t>(frame - out.firstFrame,
+                                       maxInputsPerMessage);
+    out.ack = ack;
+    for (uint32_t i = 0; i < out.numInputs; ++i) {
+      out.inputs[i] = session_->localInput(out.firstFrame + i);
+    }
+    auto latency = delay_;
+    if (jitter_.count() > 0) {
+      latency += std::chrono::milliseconds(
+          static_cast<int>(random_() % (2 * jitter_.count() + 1)) -
+          jitter_.count());
+    }
+    outgoing_.back().first = now + latency;
+    sentFrame_ = frame;
+    sentAck_ = ack;
+  }
+
+  // With jitter, messages can overtake each other like on a network.
+  for (auto it = outgoing_.begin(); it != outgoing_.end();) {
+    if (it->first > now) {
+      ++it;
+      continue;
+    }
+    const Message &out = it->second;
+    if (send(fd_, &out, headerSize + out.numInputs * sizeof(int16_t),
+             MSG_DONTWAIT | MSG_NOSIGNAL) > 0) {
+      messagesSent_++;
+    }
+    it = outgoing_.erase(it);
+  }
+}
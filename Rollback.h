@@ -0,0 +1,156 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Clock.h"
+#include "./GameState.h"
+#include "./TetrisGame.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+
+// Rollback netcode for a versus game of two peers, like GGPO: every peer
+// simulates both boards. Local inputs are used at once, remote inputs that
+// did not arrive yet are predicted as "no key" (keys are presses, repeating
+// the last one like for held buttons would mostly be wrong). When a remote
+// input turns out to differ from its prediction, the boards are restored to
+// the snapshot of that frame and the frames since are simulated again with
+// the real input, so nobody has to wait for the network as long as the
+// prediction window suffices.
+// Garbage between the boards is part of the simulated state.
+class RollbackSession {
+public:
+  // Both peers use the same seed. `local` is the board of this peer, 0 or 1.
+  // At most `maxPrediction` frames are simulated ahead of the last confirmed
+  // remote input.
+  RollbackSession(uint64_t seed, int local, int maxPrediction = 8);
+
+  // Simulate the next frame with the keycode of the local player (-1 for
+  // none). Re-simulates first if a prediction was wrong. Returns false
+  // without simulating if the remote player is too far behind.
+  bool advanceFrame(int keycode);
+
+  // Confirm the remote input of the next frame that has none yet.
+  void addRemoteInput(int keycode);
+
+  // Re-simulate now if a prediction was wrong, without advancing.
+  void synchronize();
+
+  // Frame that is simulated next
+  uint64_t frame() const { return frame_; }
+
+  // Frames with confirmed remote inputs, all frames before this one
+  uint64_t remoteConfirmed() const { return remoteConfirmed_; }
+
+  // The local input of a frame that was simulated in the last
+  // inputHistory frames, e.g. to send it again.
+  int localInput(uint64_t frame) const;
+
+  // The boards as simulated so far
+  const TetrisGame &board(int index) const { return *boards_[index]; }
+
+  // Hash of the state of both boards at the start of frame(). Equal on both
+  // peers once all inputs before it are confirmed.
+  uint64_t checksum() const;
+
+  // Inputs and snapshots of this many frames are kept.
+  static constexpr int inputHistory = 128;
+
+  struct Stats {
+    uint64_t rollbacks;
+    uint64_t resimulatedFrames;
+    uint64_t maxRollbackFrames;
+    // Frames not simulated because the remote player was too far behind
+    uint64_t stalls;
+    // Longest time a rollback took
+    double maxRollbackMicros;
+  };
+  Stats stats() const { return stats_; }
+
+private:
+  // Everything that is restored on a rollback
+  struct FrameState {
+    GameState boards[2];
+    // Garbage for a board that it takes when its next Tetromino settles
+    int32_t pendingGarbage[2];
+    int32_t garbageHole[2];
+  };
+
+  FrameState save() const;
+  void load(const FrameState &state);
+
+  // Simulate a frame of both boards with the known or predicted inputs.
+  void simulate(uint64_t frame);
+
+  // A board settled a Tetromino in the frame that is simulated: send
+  // garbage to the other board and take the pending garbage.
+  void settled(int index, int cleared);
+
+  int local_;
+  int maxPrediction_;
+  std::unique_ptr<TetrisGame> boards_[2];
+  int32_t pendingGarbage_[2]{};
+  int32_t garbageHole_[2]{};
+  // Frame that is simulated right now
+  uint64_t simulating_{0};
+
+  uint64_t frame_{0};
+  uint64_t remoteConfirmed_{0};
+  // First frame whose prediction was wrong, or none
+  uint64_t rollbackFrame_{~uint64_t{0}};
+  std::array<int16_t, inputHistory> localInputs_{};
+  std::array<int16_t, inputHistory> remoteInputs_{};
+  // Snapshots at the start of the frames
+  std::array<FrameState, inputHistory> states_{};
+  Stats stats_{};
+};
+
+// Exchanges the inputs of a RollbackSession with the other peer over a
+// datagram socket. Every message repeats all local inputs the other peer did
+// not acknowledge yet, so lost or reordered messages do no harm. For tests,
+// messages can be held back by a delay with random jitter, like on a network.
+class RollbackPeer {
+public:
+  RollbackPeer(int fd, RollbackSession *session,
+               std::chrono::milliseconds delay = std::chrono::milliseconds(0),
+               std::chrono::milliseconds jitter = std::chrono::milliseconds(0),
+               uint64_t seed = 1);
+
+  // Read all messages that arrived, send the unacknowledged local inputs and
+  // whatever is due of the messages that were held back.
+  void poll(Clock::time_point now);
+
+  // Messages sent and received
+  uint64_t messagesSent() const { return messagesSent_; }
+  uint64_t messagesReceived() const { return messagesReceived_; }
+
+  static constexpr int maxInputsPerMessage = 64;
+
+private:
+  struct Message {
+    // First frame of the inputs
+    uint64_t firstFrame;
+    // Remote frames the sender has inputs for
+    uint64_t ack;
+    uint32_t numInputs;
+    int16_t inputs[maxInputsPerMessage];
+  };
+
+  int fd_;
+  RollbackSession *session_;
+  std::chrono::milliseconds delay_;
+  std::chrono::milliseconds jitter_;
+  std::minstd_rand random_;
+  // Local frames the other peer has inputs for
+  uint64_t acked_{0};
+  // Last frame and ack that were sent, nothing new means nothing to send
+  uint64_t sentFrame_{~uint64_t{0}};
+  uint64_t sentAck_{~uint64_t{0}};
+  // Held back messages with the time they are due
+  std::deque<std::pair<Clock::time_point, Message>> outgoing_;
+  uint64_t messagesSent_{0};
+  uint64_t messagesReceived_{0};
+};
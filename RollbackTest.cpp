@@ -0,0 +1,183 @@
+// Copyright (C)
+
+#include "./Bot.h"
+#include "./Rollback.h"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <ncurses.h> // For keycodes
+#include <random>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Random keys of a player, a key every few frames.
+static std::vector<int> randomInputs(int numFrames, unsigned seed) {
+  const int keys[] = {KEY_LEFT, KEY_RIGHT, KEY_DOWN, KEY_DOWN, 97, 100};
+  std::minstd_rand random(seed);
+  std::vector<int> inputs(numFrames, -1);
+  for (int &input : inputs) {
+    if (random() % 4 == 0) {
+      input = keys[random() % 6];
+    }
+  }
+  return inputs;
+}
+
+TEST(Rollback, sameAsWithoutLatency) {
+  const int numFrames = 3000;
+  std::vector<int> local = randomInputs(numFrames, 1);
+  std::vector<int> remote = randomInputs(numFrames, 2);
+  // Knows every remote input in time, never predicts.
+  RollbackSession reference(7, 0);
+  std::vector<uint64_t> checksums;
+  for (int frame = 0; frame < numFrames; ++frame) {
+    checksums.push_back(reference.checksum());
+    reference.addRemoteInput(remote[frame]);
+    ASSERT_TRUE(reference.advanceFrame(local[frame]));
+  }
+  checksums.push_back(reference.checksum());
+  ASSERT_EQ(reference.stats().rollbacks, 0u);
+  // The first board should have an effect on the game at all.
+  ASSERT_GT(reference.board(0).broadcastFrame().score +
+                reference.board(1).broadcastFrame().score,
+            0);
+
+  // Remote inputs arrive 6 frames late.
+  RollbackSession session(7, 0);
+  const int latency = 6;
+  for (int frame = 0; frame < numFrames; ++frame) {
+    if (frame >= latency) {
+      session.addRemoteInput(remote[frame - latency]);
+    }
+    ASSERT_TRUE(session.advanceFrame(local[frame]));
+  }
+  for (int frame = numFrames - latency; frame < numFrames; ++frame) {
+    session.addRemoteInput(remote[frame]);
+  }
+  session.synchronize();
+  ASSERT_EQ(session.checksum(), checksums.back());
+  RollbackSession::Stats stats = session.stats();
+  ASSERT_GT(stats.rollbacks, 100u);
+  ASSERT_LE(stats.maxRollbackFrames, static_cast<uint64_t>(latency));
+
+  // Too far ahead of the remote player, the session waits for it.
+  RollbackSession stalled(7, 1, 4);
+  for (int frame = 0; frame < 4; ++frame) {
+    ASSERT_TRUE(stalled.advanceFrame(-1));
+  }
+  ASSERT_FALSE(stalled.advanceFrame(-1));
+  stalled.addRemoteInput(KEY_LEFT);
+  ASSERT_TRUE(stalled.advanceFrame(-1));
+  ASSERT_EQ(stalled.stats().stalls, 1u);
+}
+
+TEST(Rollback, acrossGarbage) {
+  // Bots clear enough lines to send garbage. Rollbacks that go back before
+  // garbage arrived have to restore the boards with their holes.
+  const int numFrames = 6000;
+  Bot bots[] = {Bot(BotConfig{}), Bot(BotConfig{})};
+  RollbackSession reference(3, 0);
+  std::vector<int> inputs[2];
+  int garbageFrames = 0;
+  for (int frame = 0; frame < numFrames; ++frame) {
+    for (int i = 0; i < 2; ++i) {
+      inputs[i].push_back(bots[i].nextKey(reference.board(i)));
+      garbageFrames += reference.board(i).snapshot().garbageRows != 0;
+    }
+    reference.addRemoteInput(inputs[1].back());
+    ASSERT_TRUE(reference.advanceFrame(inputs[0].back()));
+  }
+  ASSERT_GT(garbageFrames, 0);
+
+  RollbackSession session(3, 0);
+  const int latency = 6;
+  for (int frame = 0; frame < numFrames; ++frame) {
+    if (frame >= latency) {
+      session.addRemoteInput(inputs[1][frame - latency]);
+    }
+    ASSERT_TRUE(session.advanceFrame(inputs[0][frame]));
+  }
+  for (int frame = numFrames - latency; frame < numFrames; ++frame) {
+    session.addRemoteInput(inputs[1][frame]);
+  }
+  session.synchronize();
+  ASSERT_EQ(session.checksum(), reference.checksum());
+  for (int i = 0; i < 2; ++i) {
+    BroadcastFrame drawn = session.board(i).broadcastFrame();
+    BroadcastFrame expected = reference.board(i).broadcastFrame();
+    ASSERT_EQ(memcmp(drawn.cells, expected.cells, sizeof(drawn.cells)), 0);
+  }
+  ASSERT_GT(session.stats().rollbacks, 1000u);
+}
+
+// Play the frames with random keys at real speed while exchanging inputs
+// over the socket, then wait for all remote inputs. Returns the checksum of
+// the state after the frames.
+static uint64_t playPeer(int fd, int player, int numFrames,
+                         RollbackSession::Stats *stats) {
+  RollbackSession session(11, player);
+  RollbackPeer peer(fd, &session, std::chrono::milliseconds(40),
+                    std::chrono::milliseconds(15), player + 1);
+  std::vector<int> inputs = randomInputs(numFrames, 10 + player);
+  auto deadline = std::chrono::steady_clock::now();
+  auto giveUp = deadline + std::chrono::seconds(20);
+  while (session.remoteConfirmed() < static_cast<uint64_t>(numFrames) &&
+         deadline < giveUp) {
+    peer.poll(std::chrono::steady_clock::now());
+    if (session.frame() < static_cast<uint64_t>(numFrames)) {
+      session.advanceFrame(inputs[session.frame()]);
+    }
+    deadline += TetrisGame::frameDuration;
+    std::this_thread::sleep_until(deadline);
+  }
+  // Let the last messages of the other peer go out.
+  for (int i = 0; i < 10; ++i) {
+    peer.poll(std::chrono::steady_clock::now());
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  session.synchronize();
+  *stats = session.stats();
+  return session.frame() == static_cast<uint64_t>(numFrames)
+             ? session.checksum()
+             : 0;
+}
+
+TEST(Rollback, twoProcesses) {
+  const int numFrames = 180;
+  int fds[2];
+  int results[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+  ASSERT_EQ(pipe(results), 0);
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    close(fds[0]);
+    RollbackSession::Stats stats;
+    uint64_t checksum = playPeer(fds[1], 1, numFrames, &stats);
+    if (write(results[1], &checksum, sizeof(checksum)) != sizeof(checksum)) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  RollbackSession::Stats stats;
+  uint64_t checksum = playPeer(fds[0], 0, numFrames, &stats);
+  uint64_t childChecksum{0};
+  ASSERT_EQ(read(results[0], &childChecksum, sizeof(childChecksum)),
+            static_cast<ssize_t>(sizeof(childChecksum)));
+  int status;
+  waitpid(child, &status, 0);
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+  ASSERT_NE(checksum, 0u);
+  ASSERT_EQ(checksum, childChecksum);
+  // 40 ms of latency is two to three frames.
+  ASSERT_GT(stats.rollbacks, 0u);
+  ASSERT_GE(stats.maxRollbackFrames, 2u);
+  // Even with sanitizers a rollback takes much less than a frame.
+  ASSERT_LT(stats.maxRollbackMicros, 8000);
+  close(fds[0]);
+  close(results[0]);
+  close(results[1]);
+}
@@ -0,0 +1,247 @@
+// Copyright (C)
+
+#include "./SharedEnv.h"
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+
+static constexpr char magic[4] = {'T', 'E', 'N', 'V'};
+static constexpr uint32_t version = 1;
+static constexpr size_t numCells = TETRIS_ROWS * TETRIS_COLS;
+
+// Point the slots at the columns after the header at `base` and return the
+// size of the whole region. With a null base only the size is computed.
+static size_t layout(uint8_t *base, uint32_t numEnvs, SharedEnvSlots *slots) {
+  size_t offset = sizeof(SharedEnvHeader);
+  auto column = [&](auto **pointer, size_t width) {
+    offset = (offset + 63) / 64 * 64;
+    using Pointer = std::remove_pointer_t<decltype(pointer)>;
+    *pointer =
+        base == nullptr ? nullptr : reinterpret_cast<Pointer>(base + offset);
+    offset += width * numEnvs;
+  };
+  column(&slots->actions, sizeof(int32_t));
+  column(&slots->seeds, sizeof(uint64_t));
+  column(&slots->rewards, sizeof(int32_t));
+  column(&slots->gameOver, sizeof(uint8_t));
+  column(&slots->score, sizeof(int32_t));
+  column(&slots->lines, sizeof(int32_t));
+  column(&slots->level, sizeof(int32_t));
+  column(&slots->current, sizeof(int32_t));
+  column(&slots->next, sizeof(int32_t));
+  column(&slots->frame, sizeof(uint64_t));
+  column(&slots->cells, numCells);
+  return offset;
+}
+
+// The spins for sharedEnvAutoSpins
+static int spinsFor(int spins) {
+  if (spins != sharedEnvAutoSpins) {
+    return spins;
+  }
+  return std::thread::hardware_concurrency() > 1 ? 200 : 0;
+}
+
+// Sleep until the word is no longer `value`, at most 100 ms.
+static void futexWait(std::atomic<uint32_t> *word, uint32_t value) {
+  timespec timeout{0, 100'000'000};
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, value,
+          &timeout, nullptr, 0);
+}
+
+// ____________________________________________________________________________
+static void futexWake(std::atomic<uint32_t> *word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+}
+
+// Wait until the doorbell is no longer `value`: spin first, then sleep.
+// Returns false if the server closed first.
+static bool waitForDoorbell(std::atomic<uint32_t> &doorbell, uint32_t value,
+                            std::atomic<uint32_t> &sleeps,
+                            const std::atomic<uint32_t> &closed, int spins,
+                            uint64_t *numSleeps) {
+  for (int i = 0; i < spins; ++i) {
+    if (doorbell.load(std::memory_order_acquire) != value) {
+      return true;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+  (*numSleeps)++;
+  // Announce the sleep before the last look, the ringing side stores the
+  // doorbell before it looks at this, so one of both sees the other.
+  sleeps.store(1);
+  while (doorbell.load() == value && closed.load() == 0) {
+    futexWait(&doorbell, value);
+  }
+  sleeps.store(0, std::memory_order_relaxed);
+  return doorbell.load(std::memory_order_acquire) != value;
+}
+
+// Set the doorbell and wake the other side only if it sleeps.
+static void ringDoorbell(std::atomic<uint32_t> &doorbell, uint32_t value,
+                         const std::atomic<uint32_t> &sleeps) {
+  doorbell.store(value);
+  if (sleeps.load() != 0) {
+    futexWake(&doorbell);
+  }
+}
+
+// ____________________________________________________________________________
+SharedEnvServer::SharedEnvServer(const std::string &name, uint32_t numEnvs,
+                                 int spins)
+    : name_(name), spins_(spinsFor(spins)),
+      mappedSize_(layout(nullptr, numEnvs, &slots_)) {
+  if (numEnvs == 0) {
+    throw std::invalid_argument("The server needs at least one environment");
+  }
+  // A client of an old server keeps its mapping of it.
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    throw std::runtime_error("Could not create environments " + name);
+  }
+  if (ftruncate(fd, mappedSize_) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Could not resize environments " + name);
+  }
+  void *memory =
+      mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Could not map environments " + name);
+  }
+  header_ = new (memory) SharedEnvHeader{};
+  layout(static_cast<uint8_t *>(memory), numEnvs, &slots_);
+  envs_.reserve(numEnvs);
+  for (uint32_t i = 0; i < numEnvs; ++i) {
+    envs_.emplace_back(tetris_create());
+    if (!envs_.back()) {
+      munmap(header_, mappedSize_);
+      shm_unlink(name.c_str());
+      throw std::runtime_error(tetris_last_error());
+    }
+    tetris_reset(envs_[i].get(), i);
+    slots_.seeds[i] = i;
+    observe(i);
+  }
+  header_->version = version;
+  header_->numEnvs = numEnvs;
+  // Clients check the magic last.
+  memcpy(header_->magic, magic, sizeof(magic));
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+// ____________________________________________________________________________
+SharedEnvServer::~SharedEnvServer() {
+  stop();
+  munmap(header_, mappedSize_);
+  shm_unlink(name_.c_str());
+}
+
+// ____________________________________________________________________________
+void SharedEnvServer::run() {
+  // A request may already wait from before run().
+  uint32_t handled = header_->response.load(std::memory_order_relaxed);
+  while (waitForDoorbell(header_->request, handled, header_->serverSleeps,
+                         header_->closed, spins_, &stats_.sleeps)) {
+    handled = header_->request.load(std::memory_order_acquire);
+    stepAll();
+    ringDoorbell(header_->response, handled, header_->clientSleeps);
+  }
+}
+
+// ____________________________________________________________________________
+void SharedEnvServer::stop() {
+  header_->closed.store(1);
+  futexWake(&header_->request);
+  futexWake(&header_->response);
+}
+
+// ____________________________________________________________________________
+void SharedEnvServer::stepAll() {
+  for (uint32_t i = 0; i < envs_.size(); ++i) {
+    int32_t action = slots_.actions[i];
+    if (action == SharedEnvSlots::resetAction) {
+      tetris_reset(envs_[i].get(), slots_.seeds[i]);
+      slots_.rewards[i] = 0;
+    } else {
+      slots_.rewards[i] = tetris_step(envs_[i].get(), action);
+    }
+    observe(i);
+  }
+  stats_.batches++;
+  stats_.steps += envs_.size();
+}
+
+// ____________________________________________________________________________
+void SharedEnvServer::observe(uint32_t i) {
+  const TetrisObservation *observation = tetris_observation(envs_[i].get());
+  slots_.gameOver[i] = observation->gameOver;
+  slots_.score[i] = observation->score;
+  slots_.lines[i] = observation->lines;
+  slots_.level[i] = observation->level;
+  slots_.current[i] = observation->current;
+  slots_.next[i] = observation->next;
+  slots_.frame[i] = observation->frame;
+  memcpy(slots_.cells + i * numCells, observation->cells, numCells);
+}
+
+// ____________________________________________________________________________
+SharedEnvClient::SharedEnvClient(const std::string &name, int spins)
+    : spins_(spinsFor(spins)) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    throw std::runtime_error("No environment server " + name);
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 ||
+      static_cast<size_t>(status.st_size) < sizeof(SharedEnvHeader)) {
+    close(fd);
+    throw std::runtime_error("Not an environment server: " + name);
+  }
+  mappedSize_ = status.st_size;
+  void *memory =
+      mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("Could not map environments " + name);
+  }
+  header_ = static_cast<SharedEnvHeader *>(memory);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (memcmp(header_->magic, magic, sizeof(magic)) != 0 ||
+      header_->version != version ||
+      layout(nullptr, header_->numEnvs, &slots_) > mappedSize_) {
+    munmap(memory, mappedSize_);
+    throw std::runtime_error("Not an environment server: " + name);
+  }
+  layout(static_cast<uint8_t *>(memory), header_->numEnvs, &slots_);
+  sequence_ = header_->request.load();
+}
+
+// ____________________________________________________________________________
+SharedEnvClient::~SharedEnvClient() { munmap(header_, mappedSize_); }
+
+// ____________________________________________________________________________
+void SharedEnvClient::step() {
+  uint32_t previous = sequence_++;
+  ringDoorbell(header_->request, sequence_, header_->serverSleeps);
+  // Wait for this batch. A response can only follow our request.
+  if (!waitForDoorbell(header_->response, previous, header_->clientSleeps,
+                       header_->closed, spins_, &sleeps_)) {
+    throw std::runtime_error("The environment server is gone");
+  }
+}
@@ -0,0 +1,143 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./TetrisApi.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Game environments for trainers in other processes, served through POSIX
+// shared memory instead of a socket. The region holds one slot per
+// environment in structure-of-arrays layout: the client writes the actions of
+// all environments, rings the doorbell, and the server steps every
+// environment and writes rewards and observations column by column. A
+// doorbell is a sequence number in a cache line of its own. The waiting side
+// spins on it for a while and only then sleeps on it as a futex, and the
+// ringing side only wakes it if it sleeps, so while both sides keep up a
+// round trip for the whole batch needs no system call. One client at a time.
+
+// Start of the shared memory, followed by the columns
+struct SharedEnvHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t numEnvs;
+  // Set when the server goes away
+  std::atomic<uint32_t> closed;
+  // Batches requested by the client, and whether the server sleeps on it
+  alignas(64) std::atomic<uint32_t> request;
+  std::atomic<uint32_t> serverSleeps;
+  // Batches finished by the server, and whether the client sleeps on it
+  alignas(64) std::atomic<uint32_t> response;
+  std::atomic<uint32_t> clientSleeps;
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "Doorbells are futex words in shared memory");
+
+// The columns in the shared memory, numEnvs values each and every one
+// starting in its own cache line. The client writes actions and seeds, the
+// server everything else.
+struct SharedEnvSlots {
+  // A TetrisAction, or resetAction to start a new game with the seed
+  int32_t *actions;
+  uint64_t *seeds;
+  // Points of the last step and the observations after it, like
+  // TetrisObservation
+  int32_t *rewards;
+  uint8_t *gameOver;
+  int32_t *score;
+  int32_t *lines;
+  int32_t *level;
+  int32_t *current;
+  int32_t *next;
+  uint64_t *frame;
+  // TETRIS_ROWS * TETRIS_COLS colors per environment
+  uint8_t *cells;
+
+  static constexpr int32_t resetAction = -1;
+};
+
+// Spins before sleeping on a doorbell: a few microseconds, or none on a
+// single core where the other side cannot run meanwhile
+static constexpr int sharedEnvAutoSpins = -1;
+
+class SharedEnvServer {
+public:
+  // Create the shared memory with the name (e.g. "/tetris-envs") and the
+  // environments, game i starts with seed i. A region with the same name is
+  // replaced, the shared memory is removed again on destruction.
+  SharedEnvServer(const std::string &name, uint32_t numEnvs,
+                  int spins = sharedEnvAutoSpins);
+  ~SharedEnvServer();
+
+  SharedEnvServer(const SharedEnvServer &) = delete;
+  SharedEnvServer &operator=(const SharedEnvServer &) = delete;
+
+  // Step the batches the client requests until stop().
+  void run();
+
+  // Let run() return and tell the client. Safe in a signal handler.
+  void stop();
+
+  struct Stats {
+    uint64_t batches{0};
+    uint64_t steps{0};
+    // How often the server went to sleep on the doorbell
+    uint64_t sleeps{0};
+  };
+  // Once run() returned
+  Stats stats() const { return stats_; }
+
+private:
+  // Step (or reset) all environments and write their observations.
+  void stepAll();
+  void observe(uint32_t i);
+
+  struct EnvDeleter {
+    void operator()(TetrisEnv *env) const { tetris_destroy(env); }
+  };
+
+  std::string name_;
+  int spins_;
+  size_t mappedSize_;
+  SharedEnvHeader *header_;
+  SharedEnvSlots slots_;
+  std::vector<std::unique_ptr<TetrisEnv, EnvDeleter>> envs_;
+  Stats stats_;
+};
+
+class SharedEnvClient {
+public:
+  // Attach to the server with the name. Throws if there is none.
+  explicit SharedEnvClient(const std::string &name,
+                           int spins = sharedEnvAutoSpins);
+  ~SharedEnvClient();
+
+  SharedEnvClient(const SharedEnvClient &) = delete;
+  SharedEnvClient &operator=(const SharedEnvClient &) = delete;
+
+  uint32_t numEnvs() const { return header_->numEnvs; }
+
+  // Write the actions (and seeds) here before step(), read the results
+  // after it.
+  const SharedEnvSlots &slots() const { return slots_; }
+
+  // Step all environments with their actions and wait for the results.
+  // Throws if the server is gone.
+  void step();
+
+  // How often the client went to sleep waiting for the server
+  uint64_t sleeps() const { return sleeps_; }
+
+private:
+  int spins_;
+  size_t mappedSize_;
+  SharedEnvHeader *header_;
+  SharedEnvSlots slots_;
+  uint32_t sequence_;
+  uint64_t sleeps_{0};
+};
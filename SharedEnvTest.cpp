@@ -0,0 +1,72 @@
+// Copyright (C)
+
+#include "./SharedEnv.h"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+// A shared memory name of its own for every test process
+static std::string testName() {
+  return "/tetris-envs-test-" + std::to_string(getpid());
+}
+
+TEST(SharedEnv, stepsLikeTheCApi) {
+  SharedEnvServer server(testName(), 8);
+  std::thread thread([&server]() { server.run(); });
+  SharedEnvClient client(testName());
+  ASSERT_EQ(client.numEnvs(), 8u);
+  const SharedEnvSlots &slots = client.slots();
+  // Game i started with seed i, like this one.
+  TetrisEnv *env = tetris_create();
+  tetris_reset(env, 3);
+  const TetrisObservation *observation = tetris_observation(env);
+  ASSERT_EQ(slots.frame[3], 0u);
+  ASSERT_EQ(slots.next[3], observation->next);
+  for (int step = 0; step < 300; ++step) {
+    for (uint32_t i = 0; i < 8; ++i) {
+      slots.actions[i] = (step + i) % TETRIS_NUM_ACTIONS;
+    }
+    int32_t before = slots.score[5];
+    client.step();
+    ASSERT_EQ(slots.rewards[5], slots.score[5] - before);
+    ASSERT_EQ(slots.rewards[3], tetris_step(env, slots.actions[3]));
+    ASSERT_EQ(slots.frame[3], observation->frame);
+    ASSERT_EQ(slots.gameOver[3], observation->gameOver);
+    ASSERT_EQ(memcmp(slots.cells + 3 * TETRIS_ROWS * TETRIS_COLS,
+                     observation->cells, TETRIS_ROWS * TETRIS_COLS),
+              0)
+        << step;
+  }
+  // Reset one game with a seed of its own.
+  slots.actions[0] = SharedEnvSlots::resetAction;
+  slots.seeds[0] = 3;
+  client.step();
+  ASSERT_EQ(slots.frame[0], 0u);
+  ASSERT_EQ(slots.score[0], 0);
+  ASSERT_EQ(slots.frame[1], 301u);
+  tetris_destroy(env);
+  server.stop();
+  thread.join();
+  ASSERT_THROW(client.step(), std::runtime_error);
+  SharedEnvServer::Stats stats = server.stats();
+  ASSERT_EQ(stats.batches, 301u);
+  ASSERT_EQ(stats.steps, 301u * 8);
+}
+
+TEST(SharedEnv, sleepsWithoutSpinning) {
+  ASSERT_THROW(SharedEnvClient client(testName()), std::runtime_error);
+  SharedEnvServer server(testName(), 1, 0);
+  std::thread thread([&server]() { server.run(); });
+  SharedEnvClient client(testName(), 0);
+  for (int step = 0; step < 100; ++step) {
+    client.slots().actions[0] = TETRIS_NONE;
+    client.step();
+  }
+  server.stop();
+  thread.join();
+  ASSERT_EQ(client.slots().frame[0], 100u);
+  ASSERT_EQ(client.sleeps(), 100u);
+  ASSERT_GT(server.stats().sleeps, 0u);
+}
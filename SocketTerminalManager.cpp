@@ -0,0 +1,158 @@
+// Copyright (C)
+
+#include "./SocketTerminalManager.h"
+#include <cerrno>
+#include <ncurses.h> // For keycodes
+#include <stdexcept>
+#include <sys/socket.h>
+
+// Escape sequence for a 24 bit color, for the foreground or the background
+static std::string ansiColor(const Color &color, bool foreground) {
+  return (foreground ? "\x1b[38;2;" : "\x1b[48;2;") +
+         std::to_string(static_cast<int>(255 * color.red())) + ";" +
+         std::to_string(static_cast<int>(255 * color.green())) + ";" +
+         std::to_string(static_cast<int>(255 * color.blue())) + "m";
+}
+
+// ____________________________________________________________________________
+SocketTerminalManager::SocketTerminalManager(
+    const std::vector<std::pair<Color, Color>> &colors, int numRows,
+    int numCols) {
+  numRows_ = numRows;
+  numCols_ = numCols;
+  for (const auto &[fgColor, bgColor] : colors) {
+    // Pixels are drawn reversed, like in the TerminalManager.
+    pixelStyles_.push_back(ansiColor(fgColor, false));
+    textStyles_.push_back(ansiColor(fgColor, true) + ansiColor(bgColor, false));
+  }
+  // Clear the screen and hide the cursor.
+  output_ = "\x1b[2J\x1b[?25l";
+}
+
+// ____________________________________________________________________________
+void SocketTerminalManager::moveTo(int row, int col, const std::string &style) {
+  // Positions of escape sequences start at 1.
+  output_ += "\x1b[" + std::to_string(row + 1) + ";" +
+             std::to_string(col + 1) + "H";
+  if (currentStyle_ != &style) {
+    output_ += style;
+    currentStyle_ = &style;
+  }
+}
+
+// ____________________________________________________________________________
+void SocketTerminalManager::drawPixel(int row, int col, int color) {
+  if (color < 0 || color >= static_cast<int>(pixelStyles_.size())) {
+    throw std::runtime_error("Invalid color given to drawPixel");
+  }
+  moveTo(row, 2 * col, pixelStyles_[color]);
+  output_ += "  ";
+}
+
+// ____________________________________________________________________________
+void SocketTerminalManager::drawString(int row, int col, int color,
+                                       const char *str) {
+  if (color < 0 || color >= static_cast<int>(textStyles_.size())) {
+    throw std::runtime_error("Invalid color given to drawString");
+  }
+  moveTo(row, 2 * col, textStyles_[color]);
+  output_ += str;
+}
+
+// ____________________________________________________________________________
+void SocketTerminalManager::drawScore(int row, int col, int color,
+                                      int score) {
+  if (color < 0 || color >= static_cast<int>(textStyles_.size())) {
+    throw std::runtime_error("Invalid color given to drawScore");
+  }
+  moveTo(row, col, textStyles_[color]);
+  output_ += std::to_string(score);
+}
+
+// ____________________________________________________________________________
+UserInput SocketTerminalManager::getUserInput() {
+  UserInput userInput;
+  userInput.keycode_ = -1;
+  if (keys_.empty() && escape_.size() == 1 && ++escapeWait_ >= escapeReads) {
+    // Nothing followed the ESC in time, it was pressed alone.
+    pushKey(27);
+    escape_.clear();
+  }
+  if (!keys_.empty()) {
+    userInput.keycode_ = keys_.front();
+    keys_.pop_front();
+  }
+  return userInput;
+}
+
+// ____________________________________________________________________________
+void SocketTerminalManager::pushKey(int keycode) {
+  if (keys_.size() < maxPendingKeys) {
+    keys_.push_back(keycode);
+  }
+}
+
+// ____________________________________________________________________________
+void SocketTerminalManager::receive(const char *data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    char c = data[i];
+    if (escape_.empty()) {
+      if (c == 27) {
+        escape_ += c;
+        escapeWait_ = 0;
+      } else {
+        pushKey(static_cast<unsigned char>(c));
+      }
+    } else if (escape_.size() == 1) {
+      if (c == '[') {
+        escape_ += c;
+      } else {
+        // A single ESC, the byte is a key of its own.
+        pushKey(27);
+        escape_.clear();
+        i--;
+      }
+    } else {
+      // The arrow keys are ESC [ A to ESC [ D, everything else is ignored.
+      const int arrows[] = {KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT};
+      if (c >= 'A' && c <= 'D') {
+        pushKey(arrows[c - 'A']);
+      }
+      escape_.clear();
+    }
+  }
+}
+
+// ____________________________________________________________________________
+bool SocketTerminalManager::flush(int fd) {
+  while (sent_ < output_.size()) {
+    ssize_t n = send(fd, output_.data() + sent_, output_.size() - sent_,
+                     MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return false;
+      }
+      // Drop what was sent, so the buffer does not grow while the client is
+      // slow.
+      if (sent_ >= 1 << 16) {
+        output_.erase(0, sent_);
+        sent_ = 0;
+      }
+      return true;
+    }
+    sent_ += n;
+  }
+  output_.clear();
+  sent_ = 0;
+  return true;
+}
+
+// ____________________________________________________________________________
+void SocketTerminalManager::takeOutput(std::string *into) {
+  into->append(output_, sent_, std::string::npos);
+  output_.clear();
+  sent_ = 0;
+}
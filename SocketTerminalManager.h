@@ -0,0 +1,91 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./TerminalManager.h"
+#include "./VirtualTerminalManager.h"
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A terminal manager for a client on a socket, e.g. a session of the
+// TetrisServer. Drawing appends ANSI escape sequences to an output buffer
+// that the owner sends whenever the socket is writable, and the bytes the
+// client sends are turned into keycodes like ncurses does. Nothing blocks.
+class SocketTerminalManager : public VirtualTerminalManager {
+public:
+  // Terminal of the given logical dimensions (one pixel is two characters
+  // wide) with the colors of the game.
+  SocketTerminalManager(const std::vector<std::pair<Color, Color>> &colors,
+                        int numRows = 32, int numCols = 40);
+
+  // Append the escape sequences for drawing to the output.
+  void drawPixel(int row, int col, int color) override;
+  void drawString(int row, int col, int color, const char *str) override;
+  void drawScore(int row, int col, int color, int score) override;
+
+  // Return the logical dimensions of the screen.
+  int numRows() const override { return numRows_; }
+  int numCols() const override { return numCols_; }
+
+  // Does nothing, input never blocks.
+  void flipDelay(bool) override {}
+
+  // The next key the client sent, keycode -1 if there is none. The server
+  // reads one key per frame.
+  UserInput getUserInput() override;
+
+  // Nothing is remembered for testing.
+  bool isCellPixel(int, int) const override { return false; }
+  bool isCellString(int, int, const char *) const override { return false; }
+
+  // Parse bytes received from the client into keys. Keys beyond
+  // maxPendingKeys are dropped, so a client that sends faster than it is
+  // read does not grow the queue.
+  void receive(const char *data, size_t size);
+
+  // Keys that are kept until they are read, a few frames' worth
+  static constexpr size_t maxPendingKeys = 8;
+
+  // An ESC that nothing follows is only pressed alone after this many reads
+  // of the input, an arrow key may continue in a later read.
+  static constexpr int escapeReads = 6;
+
+  // Number of keys that were received but not read yet
+  size_t numPendingKeys() const { return keys_.size(); }
+
+  // Send as much of the output as the socket takes without blocking.
+  // Returns false if the connection is broken.
+  bool flush(int fd);
+
+  // Bytes of output that were not sent yet
+  size_t pendingBytes() const { return output_.size() - sent_; }
+
+  // Append the output that was not sent yet to the string instead of sending
+  // it, e.g. to record it.
+  void takeOutput(std::string *into);
+
+private:
+  // Move the cursor to the character and switch to the style.
+  void moveTo(int row, int col, const std::string &style);
+
+  // Queue the key unless the queue is full.
+  void pushKey(int keycode);
+
+  // Escape sequences that switch to the colors of pixels and of text
+  std::vector<std::string> pixelStyles_;
+  std::vector<std::string> textStyles_;
+  // The style that is switched to at the end of the output
+  const std::string *currentStyle_{nullptr};
+
+  std::string output_;
+  size_t sent_{0};
+
+  std::deque<int> keys_;
+  // Bytes of an escape sequence that is not complete yet
+  std::string escape_;
+  // Reads of the input since a lone ESC arrived
+  int escapeWait_{0};
+};
@@ -0,0 +1,162 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Board.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// A board for stress tests with thousands of rows. It has the same interface
+// as Board, but only keeps the rows that have something in them, sorted by
+// their height above the floor. Memory and line clears cost as much as the
+// occupied rows, however tall the board is. Looking up a row is a binary
+// search over the occupied rows.
+// Highest row is 0.
+template <int W> class SparseBoard {
+public:
+  using Mask = RowMask<W>;
+  static constexpr int width = W;
+  static constexpr Mask fullRow = Board<W, 1>::fullRow;
+
+  explicit SparseBoard(int height) : height_(height) {}
+
+  // Number of rows of the board
+  int height() const { return height_; }
+
+  // Number of rows that are actually stored
+  size_t numRows() const { return rows_.size(); }
+
+  // Highest row with anything in it, height() if the board is empty
+  int highestRow() const {
+    return rows_.empty() ? height_ : height_ - 1 - rows_.back().height;
+  }
+
+  // Empty the whole board
+  void clear() { rows_.clear(); }
+
+  // Is there a settled block in the cell? Never for cells off the board.
+  bool settled(int x, int y) const {
+    const Row *row = find(y);
+    return row != nullptr && static_cast<unsigned>(x) < W &&
+           ((row->mask >> x) & 1);
+  }
+
+  // Color that is drawn in the cell, 0 if it is empty
+  int color(int x, int y) const {
+    const Row *row = find(y);
+    return row != nullptr ? row->colors[x] : 0;
+  }
+
+  // Colors of all cells of a row, found with one lookup
+  const uint8_t *colors(int y) const {
+    const Row *row = find(y);
+    return row != nullptr ? row->colors : emptyColors_;
+  }
+
+  // Settled blocks of a row, bit x is column x
+  Mask row(int y) const {
+    const Row *row = find(y);
+    return row != nullptr ? row->mask : 0;
+  }
+
+  // Check if the row is full
+  bool isFull(int y) const { return row(y) == fullRow; }
+
+  // Put a settled block into the cell
+  void settle(int x, int y, int color) {
+    Row &row = insert(y);
+    row.mask |= Mask{1} << x;
+    row.colors[x] = color;
+  }
+
+  // Draw a falling block into the cell. It does not collide.
+  void paint(int x, int y, int color) { insert(y).colors[x] = color; }
+
+  // Empty the cell. A row that becomes empty is not stored anymore.
+  void erase(int x, int y) {
+    Row *row = find(y);
+    if (row == nullptr) {
+      return;
+    }
+    row->mask &= ~(Mask{1} << x);
+    row->colors[x] = 0;
+    if (row->mask == 0 && memcmp(row->colors, emptyColors_, W) == 0) {
+      rows_.erase(rows_.begin() + (row - rows_.data()));
+    }
+  }
+
+  // Would a block in the cell collide? Like Board::blocked().
+  bool blocked(int x, int y) const {
+    return static_cast<unsigned>(x) >= W || y >= height_ || settled(x, y);
+  }
+
+  // Would any of the points (x, y) collide when moved by (dx, dy)?
+  template <class Points>
+  bool collides(const Points &points, int dx = 0, int dy = 0) const {
+    bool collision = false;
+    for (const auto &point : points) {
+      collision |= blocked(point.first + dx, point.second + dy);
+    }
+    return collision;
+  }
+
+  // Remove all full rows and let the rows above fall down. Only the stored
+  // rows are visited.
+  // Returns the number of cleared rows.
+  int clearFullLines() {
+    int cleared = 0;
+    size_t to = 0;
+    for (size_t from = 0; from < rows_.size(); ++from) {
+      if (rows_[from].mask == fullRow) {
+        cleared++;
+        continue;
+      }
+      rows_[from].height -= cleared;
+      rows_[to++] = rows_[from];
+    }
+    rows_.resize(to);
+    return cleared;
+  }
+
+private:
+  struct Row {
+    // Rows above the floor, 0 is the bottom row
+    int height;
+    Mask mask;
+    uint8_t colors[W];
+  };
+
+  // Position of the first stored row at or above the height
+  typename std::vector<Row>::const_iterator lowerBound(int height) const {
+    return std::lower_bound(
+        rows_.begin(), rows_.end(), height,
+        [](const Row &row, int height) { return row.height < height; });
+  }
+
+  // The stored row, nullptr if it is empty
+  const Row *find(int y) const {
+    int height = height_ - 1 - y;
+    auto it = lowerBound(height);
+    return it != rows_.end() && it->height == height ? &*it : nullptr;
+  }
+  Row *find(int y) {
+    return const_cast<Row *>(static_cast<const SparseBoard *>(this)->find(y));
+  }
+
+  // The stored row, inserted empty if it was not stored yet
+  Row &insert(int y) {
+    int height = height_ - 1 - y;
+    auto it = lowerBound(height);
+    if (it == rows_.end() || it->height != height) {
+      it = rows_.insert(it, Row{height, 0, {}});
+    }
+    return rows_[it - rows_.begin()];
+  }
+
+  static constexpr uint8_t emptyColors_[W] = {};
+
+  std::vector<Row> rows_;
+  int height_;
+};
@@ -0,0 +1,415 @@
+// Copyright (C)
+
+#include "./Tablebase.h"
+#include "./WorkStealingPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+static constexpr int width = tablebaseWidth;
+static constexpr int height = tablebaseHeight;
+static constexpr int numForms = 7;
+static constexpr uint32_t rowMask = (1u << width) - 1;
+static constexpr uint64_t numPossible = uint64_t{1} << (width * height);
+static constexpr uint64_t numWords = numPossible / 64;
+static constexpr char magic[4] = {'T', 'T', 'B', 'L'};
+static constexpr char checkpointMagic[4] = {'T', 'T', 'B', 'C'};
+static constexpr uint32_t version = 1;
+// Boards per task of a sweep
+static constexpr size_t chunkSize = 4096;
+
+// Start of a tablebase file, followed by the bitmap of the reachable boards,
+// the rank of every word of it and the values
+struct TablebaseHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t valueBits;
+  uint32_t sweeps;
+  uint64_t numBoards;
+  // A value v is stored as round(v / maxValue * (2^valueBits - 1))
+  double maxValue;
+};
+
+namespace {
+// Start of a checkpoint, followed by the values
+struct CheckpointHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t numBoards;
+  uint32_t sweeps;
+  uint32_t padding;
+};
+
+// A rotation of a Tetromino, packed like the board with its lowest row at
+// the bottom and its leftmost column at the left
+struct Orientation {
+  uint32_t mask;
+  int width;
+  int height;
+};
+} // namespace
+
+// The distinct rotations of every form
+static const std::vector<Orientation> &orientationsOf(int form) {
+  static const auto table = []() {
+    std::vector<std::vector<Orientation>> table(numForms);
+    for (int f = 0; f < numForms; ++f) {
+      Tetromino tetromino{static_cast<TetrominoForm>(f)};
+      for (int rotation = 0; rotation < 4; ++rotation) {
+        std::vector<std::pair<int, int>> points =
+            tetromino.getRotatedForm(rotation);
+        int minX = 4, maxX = -4, minY = 4, maxY = -4;
+        for (const auto &point : points) {
+          minX = std::min(minX, point.first);
+          maxX = std::max(maxX, point.first);
+          minY = std::min(minY, point.second);
+          maxY = std::max(maxY, point.second);
+        }
+        Orientation orientation{0, maxX - minX + 1, maxY - minY + 1};
+        for (const auto &point : points) {
+          orientation.mask |= 1u << ((maxY - point.second) * width +
+                                     point.first - minX);
+        }
+        bool seen = false;
+        for (const Orientation &other : table[f]) {
+          seen |= other.mask == orientation.mask;
+        }
+        if (!seen) {
+          table[f].push_back(orientation);
+        }
+      }
+    }
+    return table;
+  }();
+  return table[form];
+}
+
+// Call found(next, lines) for every board the form can settle into. A
+// Tetromino appears at the top and is dropped straight down, full rows are
+// cleared.
+template <typename Found>
+static void forEachPlacement(uint32_t board, int form, Found found) {
+  for (const Orientation &orientation : orientationsOf(form)) {
+    for (int x = 0; x + orientation.width <= width; ++x) {
+      int y = height - orientation.height;
+      if ((orientation.mask << (width * y + x) & board) != 0) {
+        continue;
+      }
+      while (y > 0 &&
+             (orientation.mask << (width * (y - 1) + x) & board) == 0) {
+        y--;
+      }
+      uint32_t next = board | orientation.mask << (width * y + x);
+      int lines = 0;
+      for (int row = y + orientation.height - 1; row >= y; --row) {
+        if ((next >> (width * row) & rowMask) == rowMask) {
+          uint32_t below = (1u << (width * row)) - 1;
+          next = (next & below) | (next >> width & ~below);
+          lines++;
+        }
+      }
+      found(next, lines);
+    }
+  }
+}
+
+// Index of a reachable board: the reachable boards before it
+static uint64_t rankOf(const uint64_t *bitmap, const uint32_t *ranks,
+                       uint32_t board) {
+  uint64_t below = (uint64_t{1} << (board % 64)) - 1;
+  return ranks[board / 64] + __builtin_popcountll(bitmap[board / 64] & below);
+}
+
+// Read the checkpoint into the values if it belongs to these boards. Returns
+// the sweeps it holds, 0 if there is none.
+static int loadCheckpoint(const std::string &path, uint64_t numBoards,
+                          std::vector<float> *values) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return 0;
+  }
+  CheckpointHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            memcmp(header.magic, checkpointMagic, 4) == 0 &&
+            header.version == version && header.numBoards == numBoards &&
+            fread(values->data(), sizeof(float), values->size(), file) ==
+                values->size();
+  fclose(file);
+  if (!ok) {
+    std::fill(values->begin(), values->end(), 0.0f);
+    return 0;
+  }
+  return header.sweeps;
+}
+
+// Write the values next to the checkpoint and move them over it, so a crash
+// leaves the last complete checkpoint.
+static void saveCheckpoint(const std::string &path, uint64_t numBoards,
+                           int sweeps, const std::vector<float> &values) {
+  std::string temporary = path + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("Could not write checkpoint " + temporary);
+  }
+  CheckpointHeader header{};
+  memcpy(header.magic, checkpointMagic, 4);
+  header.version = version;
+  header.numBoards = numBoards;
+  header.sweeps = sweeps;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(values.data(), sizeof(float), values.size(), file) ==
+                values.size();
+  ok &= fclose(file) == 0;
+  if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Could not write checkpoint " + path);
+  }
+}
+
+// ____________________________________________________________________________
+TablebaseBuilder::TablebaseBuilder(const Options &options)
+    : options_(options) {
+  if (options.valueBits < 1 || options.valueBits > 32) {
+    throw std::invalid_argument("Values have 1 to 32 bits");
+  }
+}
+
+// ____________________________________________________________________________
+void TablebaseBuilder::build(const std::string &path) {
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&start]() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+  stats_ = Stats{};
+  WorkStealingPool pool(options_.threads);
+  std::vector<std::vector<uint32_t>> found(pool.numThreads());
+
+  // Breadth first from the empty board. Whoever sets the bit of a board
+  // expands it in the next level.
+  std::unique_ptr<std::atomic<uint64_t>[]> reachable(
+      new std::atomic<uint64_t>[numWords]);
+  for (uint64_t i = 0; i < numWords; ++i) {
+    reachable[i].store(0, std::memory_order_relaxed);
+  }
+  reachable[0].store(1, std::memory_order_relaxed);
+  std::vector<uint32_t> frontier{0};
+  for (int level = 1; !frontier.empty(); ++level) {
+    for (size_t begin = 0; begin < frontier.size(); begin += chunkSize) {
+      size_t end = std::min(frontier.size(), begin + chunkSize);
+      pool.submit([&, begin, end](int worker) {
+        for (size_t i = begin; i < end; ++i) {
+          for (int form = 0; form < numForms; ++form) {
+            forEachPlacement(frontier[i], form, [&](uint32_t next, int) {
+              uint64_t bit = uint64_t{1} << (next % 64);
+              if ((reachable[next / 64].fetch_or(
+                       bit, std::memory_order_relaxed) &
+                   bit) == 0) {
+                found[worker].push_back(next);
+              }
+            });
+          }
+        }
+      });
+    }
+    pool.wait();
+    frontier.clear();
+    for (std::vector<uint32_t> &boards : found) {
+      frontier.insert(frontier.end(), boards.begin(), boards.end());
+      boards.clear();
+    }
+    if (options_.progress != nullptr && !frontier.empty()) {
+      fprintf(options_.progress, "Level %d: %zu new boards\n", level,
+              frontier.size());
+    }
+  }
+
+  std::vector<uint64_t> bitmap(numWords);
+  std::vector<uint32_t> ranks(numWords);
+  std::vector<uint32_t> boards;
+  for (uint64_t i = 0; i < numWords; ++i) {
+    bitmap[i] = reachable[i].load(std::memory_order_relaxed);
+    ranks[i] = boards.size();
+    for (uint64_t bits = bitmap[i]; bits != 0; bits &= bits - 1) {
+      boards.push_back(i * 64 + __builtin_ctzll(bits));
+    }
+  }
+  reachable.reset();
+  stats_.boards = boards.size();
+  if (options_.progress != nullptr) {
+    fprintf(options_.progress, "%zu reachable boards in %.1f s\n",
+            boards.size(), elapsed());
+  }
+
+  // The value of (board, current) is the best placement's lines plus the
+  // value of the board after it for the next form: the game draws a form
+  // and draws once more if it is the current one, so it is the current one
+  // with probability 1/49 and each other one with 8/49.
+  size_t numValues = boards.size() * numForms;
+  std::vector<float> values(numValues, 0.0f);
+  std::vector<float> updated(numValues, 0.0f);
+  if (!options_.checkpoint.empty()) {
+    stats_.resumedSweeps =
+        loadCheckpoint(options_.checkpoint, boards.size(), &values);
+    stats_.sweeps = stats_.resumedSweeps;
+    if (options_.progress != nullptr && stats_.resumedSweeps > 0) {
+      fprintf(options_.progress, "Continuing after sweep %d\n",
+              stats_.resumedSweeps);
+    }
+  }
+  struct alignas(64) Delta {
+    double value{0};
+  };
+  std::vector<Delta> deltas(pool.numThreads());
+  double lastCheckpoint = elapsed();
+  stats_.delta = HUGE_VAL;
+  while (stats_.sweeps < options_.maxSweeps &&
+         stats_.delta > options_.tolerance) {
+    for (size_t begin = 0; begin < boards.size(); begin += chunkSize) {
+      size_t end = std::min(boards.size(), begin + chunkSize);
+      pool.submit([&, begin, end](int worker) {
+        for (size_t i = begin; i < end; ++i) {
+          for (int form = 0; form < numForms; ++form) {
+            float best = 0;
+            forEachPlacement(boards[i], form, [&](uint32_t next, int lines) {
+              const float *after =
+                  &values[rankOf(bitmap.data(), ranks.data(), next) *
+                          numForms];
+              float sum = 0;
+              for (int n = 0; n < numForms; ++n) {
+                sum += after[n];
+              }
+              float value =
+                  lines + (8 * sum - 7 * after[form]) / (numForms * numForms);
+              best = std::max(best, value);
+            });
+            size_t own = i * numForms + form;
+            deltas[worker].value =
+                std::max(deltas[worker].value,
+                         double(std::abs(best - values[own])));
+            updated[own] = best;
+          }
+        }
+      });
+    }
+    pool.wait();
+    values.swap(updated);
+    stats_.sweeps++;
+    stats_.delta = 0;
+    for (Delta &delta : deltas) {
+      stats_.delta = std::max(stats_.delta, delta.value);
+      delta.value = 0;
+    }
+    if (options_.progress != nullptr) {
+      fprintf(options_.progress, "Sweep %d: largest change %.6f\n",
+              stats_.sweeps, stats_.delta);
+    }
+    if (!options_.checkpoint.empty() &&
+        elapsed() - lastCheckpoint >= options_.checkpointSeconds) {
+      saveCheckpoint(options_.checkpoint, boards.size(), stats_.sweeps,
+                     values);
+      lastCheckpoint = elapsed();
+    }
+  }
+  if (!options_.checkpoint.empty()) {
+    saveCheckpoint(options_.checkpoint, boards.size(), stats_.sweeps, values);
+  }
+
+  // Quantize and pack the values, the lowest bits first.
+  TablebaseHeader header{};
+  memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.width = width;
+  header.height = height;
+  header.valueBits = options_.valueBits;
+  header.sweeps = stats_.sweeps;
+  header.numBoards = boards.size();
+  header.maxValue = *std::max_element(values.begin(), values.end());
+  uint64_t maxCode = (uint64_t{1} << options_.valueBits) - 1;
+  double scale = header.maxValue > 0 ? maxCode / header.maxValue : 0;
+  // With 8 bytes to spare, so readers may always load 64 bits
+  std::vector<uint8_t> packed((numValues * options_.valueBits + 7) / 8 + 8);
+  for (size_t i = 0; i < numValues; ++i) {
+    uint64_t code =
+        std::min<uint64_t>(std::llround(values[i] * scale), maxCode);
+    uint64_t bit = i * options_.valueBits;
+    uint64_t word;
+    memcpy(&word, &packed[bit / 8], sizeof(word));
+    word |= code << (bit % 8);
+    memcpy(&packed[bit / 8], &word, sizeof(word));
+  }
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("Could not write tablebase " + path);
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(bitmap.data(), sizeof(uint64_t), numWords, file) ==
+                numWords &&
+            fwrite(ranks.data(), sizeof(uint32_t), numWords, file) ==
+                numWords &&
+            fwrite(packed.data(), 1, packed.size(), file) == packed.size();
+  ok &= fclose(file) == 0;
+  if (!ok) {
+    throw std::runtime_error("Could not write tablebase " + path);
+  }
+  stats_.seconds = elapsed();
+}
+
+// ____________________________________________________________________________
+Tablebase::Tablebase(const std::string &path) : file_(path) {
+  size_t offset = sizeof(TablebaseHeader);
+  header_ = reinterpret_cast<const TablebaseHeader *>(file_.data());
+  if (file_.size() < offset || memcmp(header_->magic, magic, 4) != 0 ||
+      header_->version != version || header_->width != width ||
+      header_->height != height || header_->valueBits < 1 ||
+      header_->valueBits > 32) {
+    throw std::runtime_error("Not a tablebase: " + path);
+  }
+  bitmap_ = reinterpret_cast<const uint64_t *>(file_.data() + offset);
+  offset += numWords * sizeof(uint64_t);
+  ranks_ = reinterpret_cast<const uint32_t *>(file_.data() + offset);
+  offset += numWords * sizeof(uint32_t);
+  values_ = file_.data() + offset;
+  offset += (header_->numBoards * numForms * header_->valueBits + 7) / 8 + 8;
+  if (file_.size() < offset) {
+    throw std::runtime_error("Truncated tablebase: " + path);
+  }
+}
+
+// ____________________________________________________________________________
+bool Tablebase::contains(uint32_t board) const {
+  return board < numPossible && (bitmap_[board / 64] >> (board % 64) & 1) != 0;
+}
+
+// ____________________________________________________________________________
+uint64_t Tablebase::indexOf(uint32_t board) const {
+  if (!contains(board)) {
+    throw std::invalid_argument("The board cannot be reached");
+  }
+  return rankOf(bitmap_, ranks_, board);
+}
+
+// ____________________________________________________________________________
+double Tablebase::expectedLines(uint32_t board, TetrominoForm current) const {
+  int form = static_cast<int>(current);
+  if (form < 0 || form >= numForms) {
+    throw std::invalid_argument("Not a Tetromino");
+  }
+  uint64_t bit = (indexOf(board) * numForms + form) * header_->valueBits;
+  uint64_t word;
+  memcpy(&word, values_ + bit / 8, sizeof(word));
+  uint64_t maxCode = (uint64_t{1} << header_->valueBits) - 1;
+  uint64_t code = word >> (bit % 8) & maxCode;
+  return maxCode == 0 ? 0 : code * header_->maxValue / maxCode;
+}
+
+// ____________________________________________________________________________
+uint64_t Tablebase::numBoards() const { return header_->numBoards; }
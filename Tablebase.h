@@ -0,0 +1,94 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./MappedFile.h"
+#include "./Tetromino.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// The value of perfect play on a small board: for every board that can be
+// reached from the empty one and every Tetromino to place, the expected
+// number of lines until the game is over. Tetrominos come from the same
+// generator as in the game (a form is drawn again once if it repeats), are
+// rotated with the rotations of Tetromino and dropped straight down. A game
+// is over when a Tetromino does not fit below the top.
+// Building it first enumerates the reachable boards breadth first, then
+// sweeps over all of them, improving every value from the values of its
+// successors, until no value changes by more than the tolerance. Both run
+// on a WorkStealingPool. The file maps every possible board to the index of
+// its values with a rank over a bitmap of the reachable boards, a minimal
+// perfect hash, and holds the values as quantized fixed-width bit fields.
+
+// A board has a bit per cell, bit width * y + x for column x of row y, where
+// row 0 is the bottom.
+static constexpr int tablebaseWidth = 4;
+static constexpr int tablebaseHeight = 6;
+
+class TablebaseBuilder {
+public:
+  struct Options {
+    // Zero means one per core
+    int threads{0};
+    // Sweeps are saved here, at most every checkpointSeconds, and a build
+    // continues from it if it exists. Empty for none.
+    std::string checkpoint;
+    double checkpointSeconds{10};
+    // Sweeps stop when no value changes by more than this
+    double tolerance{1e-3};
+    int maxSweeps{100000};
+    // Bits of a value in the file
+    int valueBits{16};
+    // Where progress lines go, nullptr for none
+    FILE *progress{nullptr};
+  };
+
+  struct Stats {
+    uint64_t boards{0};
+    int sweeps{0};
+    // Sweeps done before, taken from the checkpoint
+    int resumedSweeps{0};
+    // Largest change of a value in the last sweep
+    double delta{0};
+    double seconds{0};
+  };
+
+  explicit TablebaseBuilder(const Options &options);
+
+  // Compute the tablebase and write it to the path.
+  void build(const std::string &path);
+
+  Stats stats() const { return stats_; }
+
+private:
+  Options options_;
+  Stats stats_;
+};
+
+// A tablebase file, mapped into memory.
+class Tablebase {
+public:
+  // Throws if the file is not a tablebase.
+  explicit Tablebase(const std::string &path);
+
+  // Can the board be reached from the empty board?
+  bool contains(uint32_t board) const;
+
+  // Expected lines with perfect play when `current` is the Tetromino to
+  // place, up to the precision of the file. Throws for boards that cannot
+  // be reached.
+  double expectedLines(uint32_t board, TetrominoForm current) const;
+
+  uint64_t numBoards() const;
+
+private:
+  // Index of the values of a reachable board
+  uint64_t indexOf(uint32_t board) const;
+
+  MappedFile file_;
+  const struct TablebaseHeader *header_;
+  const uint64_t *bitmap_;
+  const uint32_t *ranks_;
+  const uint8_t *values_;
+};
@@ -0,0 +1,81 @@
+// Copyright (C)
+
+#include "./Tablebase.h"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+
+// A path in /tmp for a file of the test, removed again at the end of it.
+struct TemporaryPath {
+  explicit TemporaryPath(const std::string &name)
+      : path("/tmp/TablebaseTest." + std::to_string(getpid()) + "." + name) {}
+  ~TemporaryPath() {
+    remove(path.c_str());
+    remove((path + ".tmp").c_str());
+  }
+  std::string path;
+};
+
+// ____________________________________________________________________________
+TEST(TablebaseTest, firstSweep) {
+  TemporaryPath path("firstSweep");
+  TablebaseBuilder::Options options;
+  options.threads = 2;
+  options.maxSweeps = 1;
+  TablebaseBuilder builder(options);
+  builder.build(path.path);
+  TablebaseBuilder::Stats stats = builder.stats();
+  ASSERT_EQ(1, stats.sweeps);
+  ASSERT_EQ(0, stats.resumedSweeps);
+
+  Tablebase tablebase(path.path);
+  ASSERT_EQ(stats.boards, tablebase.numBoards());
+  ASSERT_TRUE(tablebase.contains(0));
+  // A flat I fills the bottom row, an O in column 0 and 1
+  ASSERT_TRUE(tablebase.contains(0x33));
+  // Full rows are cleared, floating blocks never settle.
+  ASSERT_FALSE(tablebase.contains(0xF));
+  ASSERT_FALSE(tablebase.contains(0x10));
+  ASSERT_THROW(tablebase.expectedLines(0x10, TetrominoForm::I),
+               std::invalid_argument);
+  // After one sweep a value is the lines of the best single placement.
+  ASSERT_NEAR(1.0, tablebase.expectedLines(0, TetrominoForm::I), 1e-4);
+  ASSERT_NEAR(0.0, tablebase.expectedLines(0, TetrominoForm::O), 1e-4);
+  // A second O next to the first clears both rows, a flat I only its own.
+  ASSERT_NEAR(2.0, tablebase.expectedLines(0x33, TetrominoForm::O), 1e-4);
+  ASSERT_NEAR(1.0, tablebase.expectedLines(0x33, TetrominoForm::I), 1e-4);
+}
+
+// ____________________________________________________________________________
+TEST(TablebaseTest, resume) {
+  TemporaryPath fresh("fresh"), resumed("resumed"), checkpoint("checkpoint");
+  TablebaseBuilder::Options options;
+  options.threads = 2;
+  options.maxSweeps = 3;
+  TablebaseBuilder builder(options);
+  builder.build(fresh.path);
+
+  // Interrupted after the first sweep, then continued
+  options.checkpoint = checkpoint.path;
+  options.maxSweeps = 1;
+  TablebaseBuilder first(options);
+  first.build(resumed.path);
+  options.maxSweeps = 3;
+  TablebaseBuilder second(options);
+  second.build(resumed.path);
+  ASSERT_EQ(1, second.stats().resumedSweeps);
+  ASSERT_EQ(3, second.stats().sweeps);
+
+  Tablebase expected(fresh.path);
+  Tablebase actual(resumed.path);
+  for (uint32_t board : {0x0u, 0x33u, 0x17u, 0x1111u}) {
+    ASSERT_TRUE(expected.contains(board)) << board;
+    for (int form = 0; form < 7; ++form) {
+      TetrominoForm current = static_cast<TetrominoForm>(form);
+      ASSERT_EQ(expected.expectedLines(board, current),
+                actual.expectedLines(board, current));
+    }
+  }
+  ASSERT_GT(expected.expectedLines(0, TetrominoForm::O), 0.0);
+}
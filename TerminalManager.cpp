@@ -3,9 +3,27 @@
 // Author: Hannah Bast <bast@cs.uni-freiburg.de>
 
 #include "./TerminalManager.h"
+#include "./Trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <clocale>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <langinfo.h>
 #include <ncurses.h>
+#include <poll.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 static constexpr size_t systemColors = 16;
+// How long quitting waits for a terminal that does not take the output
+static constexpr int exitDrainMs = 1000;
+// The upper half block U+2580 in UTF-8, for both characters of a pixel
+static const char *upperHalves = "\u2580\u2580";
 
 // NOTE: We need `ncurses` stuff only in the implementation of
 // `TerminalManager`, nowhere else (not even in `TerminalManager.h`, let alone
@@ -21,15 +39,31 @@ bool UserInput::isMouseclick() const { return mouseRow_ != -1; }
 
 // ____________________________________________________________________________
 TerminalManager::TerminalManager(
-    const std::vector<std::pair<Color, Color>> &colors)
-    : numColors_(colors.size()) {
-  // Initialize ncurses and some settings suitable for gaming.
-  initscr();
+    const std::vector<std::pair<Color, Color>> &colors, bool halfBlocks)
+    : numColors_(colors.size()), halfBlocks_(halfBlocks) {
+  if (halfBlocks_) {
+    // ncurses only writes multibyte characters in the locale of the user.
+    setlocale(LC_CTYPE, "");
+    if (strcmp(nl_langinfo(CODESET), "UTF-8") != 0) {
+      throw std::runtime_error{
+          "Half blocks need a UTF-8 locale, e.g. `LANG=C.UTF-8`"};
+    }
+  }
+  // Initialize ncurses and some settings suitable for gaming. ncurses gets a
+  // descriptor of its own for the terminal, so it can be switched to the
+  // memory file later.
+  hasShellModes_ = tcgetattr(STDOUT_FILENO, &shellModes_) == 0;
+  ncursesOutput_ = fdopen(dup(STDOUT_FILENO), "w");
+  if (ncursesOutput_ == nullptr ||
+      newterm(nullptr, ncursesOutput_, stdin) == nullptr) {
+    throw std::runtime_error{"Could not set up the terminal"};
+  }
   cbreak();
   noecho();
   curs_set(false);
-  nodelay(stdscr, true);
-  keypad(stdscr, true);
+  input_ = newwin(1, 1, 0, 0);
+  nodelay(input_, true);
+  keypad(input_, true);
   // Catch mouse events
   mousemask(ALL_MOUSE_EVENTS, NULL);
   mouseinterval(0);
@@ -58,49 +92,224 @@ TerminalManager::TerminalManager(
     init_pair(i + systemColors, 2 * (systemColors + i),
               2 * (systemColors + i) + 1);
   }
+  if (halfBlocks_) {
+    // A pair for every two colors of the pixels of a cell, upper one in
+    // front
+    size_t pairs = systemColors + numColors_ + numColors_ * numColors_;
+    if (static_cast<size_t>(COLOR_PAIRS) < pairs) {
+      endwin();
+      throw std::runtime_error{"Not enough color pairs for half blocks"};
+    }
+    for (int upper = 0; upper < numColors_; ++upper) {
+      for (int lower = 0; lower < numColors_; ++lower) {
+        init_pair(systemColors + numColors_ * (1 + upper) + lower,
+                  2 * (systemColors + upper), 2 * (systemColors + lower));
+      }
+    }
+  }
   // Set the logical dimensions of the screen.
-  numRows_ = LINES;
+  numRows_ = LINES * rowsPerLine();
   numCols_ = COLS / 2;
+  if (halfBlocks_) {
+    pixels_.assign(numRows_ * numCols_, 0);
+  }
+
+  // From now on ncurses writes into a memory file, which never blocks.
+  // Nothing but the output goes to that descriptor any more: the terminal
+  // modes are set, and the size of the terminal is not asked again, so
+  // ncurses does not follow resizes (neither does the layout of the game).
+  signal(SIGWINCH, SIG_DFL);
+  wnoutrefresh(input_);
+  doupdate();
+  int ncursesFd = fileno(ncursesOutput_);
+  terminalFd_ = dup(ncursesFd);
+  memoryFd_ = memfd_create("tetris-output", MFD_CLOEXEC);
+  if (terminalFd_ < 0 || memoryFd_ < 0 || dup2(memoryFd_, ncursesFd) < 0) {
+    endwin();
+    throw std::runtime_error{"Could not set up the terminal output"};
+  }
+  // A descriptor of its own can write without blocking while the one that
+  // was inherited (and is shared with the shell) stays as it is.
+  const char *name = ttyname(terminalFd_);
+  if (name != nullptr) {
+    writeFd_ = open(name, O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  }
+  if (writeFd_ < 0) {
+    // Not a terminal: write blocking, frames are still only shown when the
+    // output before them is written.
+    writeFd_ = dup(terminalFd_);
+  }
+}
+
+// ____________________________________________________________________________
+TerminalManager::~TerminalManager() {
+  // ncurses writes what restores the screen into the memory file as well, and
+  // it all gets a second to go out. A terminal that is stalled (a paused
+  // pane, a dead link) loses the rest, so quitting never hangs. ncurses
+  // restores the modes of the terminal only after waiting for it to take all
+  // output, so that is done here without waiting.
+  endwin();
+  drain(exitDrainMs);
+  if (hasShellModes_) {
+    tcsetattr(terminalFd_, TCSANOW, &shellModes_);
+  }
+  fclose(ncursesOutput_);
+  close(terminalFd_);
+  close(writeFd_);
+  close(memoryFd_);
 }
 
 // ____________________________________________________________________________
-TerminalManager::~TerminalManager() { endwin(); }
+bool TerminalManager::refresh() {
+  flush();
+  if (pendingBytes() > 0) {
+    if (drawn_) {
+      TRACE_EVENT(TRACE_DROP_FRAME,
+                  static_cast<int>(std::min<size_t>(pendingBytes(), 32767)));
+      droppedFrames_++;
+      drawn_ = false;
+    }
+    return false;
+  }
+  wnoutrefresh(stdscr);
+  doupdate();
+  drawn_ = false;
+  flush();
+  return true;
+}
+
+// ____________________________________________________________________________
+void TerminalManager::flush() {
+  struct stat written;
+  if (fstat(memoryFd_, &written) == 0 && written.st_size > 0) {
+    size_t size = written.st_size;
+    size_t old = output_.size();
+    output_.resize(old + size);
+    ssize_t n = pread(memoryFd_, &output_[old], size, 0);
+    output_.resize(old + std::max<ssize_t>(n, 0));
+    // The descriptor of ncurses shares the offset with this one.
+    if (ftruncate(memoryFd_, 0) != 0 || lseek(memoryFd_, 0, SEEK_SET) != 0) {
+      throw std::runtime_error{"Could not reset the terminal output"};
+    }
+  }
+  while (sent_ < output_.size()) {
+    ssize_t n = write(writeFd_, output_.data() + sent_, output_.size() - sent_);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return;
+      }
+      // The terminal is gone, nobody sees the output any more.
+      break;
+    }
+    sent_ += n;
+  }
+  output_.clear();
+  sent_ = 0;
+}
 
 // ____________________________________________________________________________
-void TerminalManager::refresh() { ::refresh(); }
+bool TerminalManager::drain(int timeoutMs) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  flush();
+  while (pendingBytes() > 0) {
+    int wait = -1;
+    if (timeoutMs >= 0) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0) {
+        return false;
+      }
+      wait = left.count();
+    }
+    pollfd writable{writeFd_, POLLOUT, 0};
+    poll(&writable, 1, wait);
+    flush();
+  }
+  return true;
+}
 
 // ____________________________________________________________________________
-void TerminalManager::flipDelay(bool to) { nodelay(stdscr, to); }
+void TerminalManager::flipDelay(bool to) {
+  nodelay(input_, to);
+  waitForKeys_ = !to;
+}
 
 // ____________________________________________________________________________
 void TerminalManager::drawPixel(int row, int col, int color) {
-  if (color != 0) {
-    std::string logMessage = "Drawing pixel at (" + std::to_string(row) + ", " +
-                             std::to_string(col) + ") with color " +
-                             std::to_string(color);
-  }
+  TRACE_EVENT(TRACE_DRAW_PIXEL, row, col, color);
   if (color >= numColors_) {
     throw std::runtime_error("Invalid color given to drawPixel");
   }
+  if (halfBlocks_) {
+    if (row >= 0 && row < numRows_ && col >= 0 && col < numCols_) {
+      drawn_ = true;
+      pixels_[row * numCols_ + col] = color;
+      drawHalfBlocks(row, col);
+    }
+    return;
+  }
+  drawn_ = true;
   attron(COLOR_PAIR(color + systemColors));
   attron(A_REVERSE);
   mvprintw(row, 2 * col, "  ");
   attroff(A_REVERSE);
 }
 
+// ____________________________________________________________________________
+void TerminalManager::drawHalfBlocks(int row, int col) {
+  int upper = pixels_[(row & ~1) * numCols_ + col];
+  int lower = pixels_[(row | 1) * numCols_ + col];
+  if (upper == lower) {
+    // Spaces like a full pixel are fewer bytes
+    attron(COLOR_PAIR(upper + systemColors));
+    attron(A_REVERSE);
+    mvprintw(row / 2, 2 * col, "  ");
+    attroff(A_REVERSE);
+  } else {
+    attron(COLOR_PAIR(systemColors + numColors_ * (1 + upper) + lower));
+    mvprintw(row / 2, 2 * col, "%s", upperHalves);
+  }
+}
+
+// ____________________________________________________________________________
+void TerminalManager::coverPixels(int row, int firstChar, int numChars) {
+  if (!halfBlocks_ || row < 0 || row >= numRows_) {
+    return;
+  }
+  int line = row & ~1;
+  for (int col = std::max(firstChar / 2, 0);
+       col <= (firstChar + numChars - 1) / 2 && col < numCols_; ++col) {
+    pixels_[line * numCols_ + col] = 0;
+    pixels_[(line + 1) * numCols_ + col] = 0;
+  }
+}
+
 // ____________________________________________________________________________
 UserInput TerminalManager::getUserInput() {
+  if (waitForKeys_) {
+    // The whole screen has to be there before waiting for a key.
+    drain();
+    refresh();
+    drain();
+  } else {
+    refresh();
+  }
   UserInput userInput;
-  userInput.keycode_ = getch();
+  userInput.keycode_ = wgetch(input_);
   MEVENT event;
   if ((userInput.keycode_ == KEY_MOUSE) && (getmouse(&event) == OK)) {
     if (event.bstate & BUTTON1_PRESSED) {
-      userInput.mouseRow_ = event.y;
+      userInput.mouseRow_ = event.y * rowsPerLine();
       userInput.mouseCol_ = event.x / 2;
     }
   }
-  std::string logMessage =
-      "Received user input: " + std::to_string(userInput.keycode_);
+  if (userInput.keycode_ != ERR) {
+    TRACE_EVENT(TRACE_INPUT, userInput.keycode_);
+  }
   return userInput;
 }
 
@@ -109,8 +318,10 @@ void TerminalManager::drawString(int row, int col, int color, const char *str) {
   if (color >= numColors_) {
     throw std::runtime_error("Invalid color given to drawString");
   }
+  drawn_ = true;
   attron(COLOR_PAIR(color + systemColors));
-  mvprintw(row, 2 * col, "%s", str);
+  mvprintw(row / rowsPerLine(), 2 * col, "%s", str);
+  coverPixels(row, 2 * col, strlen(str));
 }
 
 // ____________________________________________________________________________
@@ -118,6 +329,8 @@ void TerminalManager::drawScore(int row, int col, int color, int score) {
   if (color >= numColors_) {
     throw std::runtime_error("Invalid color given to drawScore");
   }
+  drawn_ = true;
   attron(COLOR_PAIR(color + systemColors));
-  mvprintw(row, col, "%d", score);
+  mvprintw(row / rowsPerLine(), col, "%d", score);
+  coverPixels(row, col, std::to_string(score).size());
 }
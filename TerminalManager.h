@@ -6,8 +6,12 @@
 #pragma once
 
 #include "./VirtualTerminalManager.h"
+#include <cstdint>
+#include <cstdio>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <termios.h>
 #include <utility>
 #include <vector>
 
@@ -35,8 +39,16 @@ public:
   float blue() const { return blue_; }
 };
 
+// The window type of ncurses, which only the implementation includes
+struct _win_st;
+
 // A class to draw pixels on or read input from the terminal, using ncurses.
 // Is derived from the pure virtual base class VirtualTerminalManager.
+// ncurses writes into a memory file instead of the terminal, and its output
+// goes to the terminal without blocking. While the terminal has not taken
+// all of it (a slow link or a paused pane), new frames are not shown. ncurses
+// keeps their changes and shows them all at once when it is their turn, so
+// the game never waits for the terminal.
 class TerminalManager : public VirtualTerminalManager {
 public:
   // Constructor: Set up the terminal for use with ncurses commands.
@@ -44,7 +56,12 @@ public:
   // manager: Each pair consists of [foreground color, background color]. The
   // `i-th` color pair in the vector can then later be chosen if `i` is
   // specified as the color argument to `drawPixel` or `drawString`.
-  TerminalManager(const std::vector<std::pair<Color, Color>> &colors);
+  // With `halfBlocks`, two logical rows share a line of the terminal: a cell
+  // is an upper half block in the color of the upper pixel on the color of
+  // the lower one. That halves the characters per frame for slow links, but
+  // needs a UTF-8 locale.
+  TerminalManager(const std::vector<std::pair<Color, Color>> &colors,
+                  bool halfBlocks = false);
 
   // Destructor: Clean up the terminal after use.
   ~TerminalManager();
@@ -63,12 +80,20 @@ public:
   // Draw a score at the given logical position and color.
   void drawScore(int row, int col, int color, int score) override;
 
-  // Show the contents of the screen.
-  void refresh();
+  // Show the contents of the screen. Reading the input does this, too.
+  // Unless the terminal still has output pending, then the frame is dropped
+  // and its changes wait for the next one. Returns whether it was shown.
+  bool refresh();
+
+  uint64_t droppedFrames() const override { return droppedFrames_; }
+
+  // Bytes of output the terminal has not taken yet
+  size_t pendingBytes() const { return output_.size() - sent_; }
 
   // Return the logical dimensions of the screen.
   int numRows() const override { return numRows_; }
   int numCols() const override { return numCols_; }
+  int rowsPerLine() const override { return halfBlocks_ ? 2 : 1; }
 
   // Switch waiting for a key press.
   void flipDelay(bool to) override;
@@ -93,8 +118,48 @@ public:
   }
 
 private:
+  // Draw the cell with the pixel at the logical position in half-block mode.
+  void drawHalfBlocks(int row, int col);
+
+  // Forget the pixels under text in half-block mode, it covers them.
+  void coverPixels(int row, int firstChar, int numChars);
+
+  // Collect what ncurses wrote and write as much of the output as the
+  // terminal takes without blocking.
+  void flush();
+
+  // Write all of the output, waiting for the terminal at most timeoutMs
+  // milliseconds (forever if negative). Returns whether all was written.
+  bool drain(int timeoutMs = -1);
+
   // The logical dimensions of the screen.
   int numRows_;
   int numCols_;
   int numColors_;
+  bool halfBlocks_;
+  // The colors of all pixels in half-block mode, row by row, because a cell
+  // shows two of them
+  std::vector<uint8_t> pixels_;
+
+  // Where ncurses reads keys, a window that never changes, so reading does
+  // not show the screen
+  struct _win_st *input_;
+  // The file ncurses writes to. Its descriptor is the memory file after the
+  // setup.
+  FILE *ncursesOutput_;
+  // Modes of the terminal before ncurses changed them
+  struct termios shellModes_;
+  bool hasShellModes_{false};
+  int memoryFd_{-1};
+  // The terminal, and the terminal opened once more to write without
+  // blocking
+  int terminalFd_{-1};
+  int writeFd_{-1};
+  std::string output_;
+  size_t sent_{0};
+  // Whether anything was drawn since the last frame that was shown or
+  // dropped
+  bool drawn_{false};
+  bool waitForKeys_{false};
+  uint64_t droppedFrames_{0};
 };
@@ -0,0 +1,148 @@
+// Copyright (C)
+
+#include "./TerminalManager.h"
+#include "./TetrisGame.h"
+#include <chrono>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <pty.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+// What the child process on the terminal reports after each phase
+struct Phase {
+  int shown;
+  uint64_t dropped;
+  int64_t millis;
+};
+
+// Draw every pixel in a color that changes every frame, the most output a
+// frame can have.
+void drawAll(TerminalManager *tm, int frame, int numColors) {
+  for (int row = 0; row < tm->numRows(); ++row) {
+    for (int col = 0; col < tm->numCols(); ++col) {
+      tm->drawPixel(row, col, (row + col + frame) % numColors);
+    }
+  }
+}
+
+int64_t millisSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Runs in the child with the terminal as stdin and stdout, reports the
+// phases to `results`.
+void playOnTerminal(int results) {
+  setenv("TERM", "xterm-256color", 1);
+  int numColors = TetrisGame::colors().size();
+  auto report = [results](const Phase &phase) {
+    if (write(results, &phase, sizeof(phase)) != sizeof(phase)) {
+      _exit(1);
+    }
+  };
+  auto tm = std::make_unique<TerminalManager>(TetrisGame::colors());
+  // Nobody reads the terminal: frames are dropped instead of waited for.
+  Phase stalled{0, 0, 0};
+  auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < 200; ++frame) {
+    drawAll(tm.get(), frame, numColors);
+    stalled.shown += tm->refresh();
+  }
+  stalled.dropped = tm->droppedFrames();
+  stalled.millis = millisSince(start);
+  report(stalled);
+  // The terminal is read again: frames get through.
+  Phase reading{0, 0, 0};
+  start = std::chrono::steady_clock::now();
+  for (int frame = 0; !reading.shown && millisSince(start) < 5000; ++frame) {
+    drawAll(tm.get(), frame, numColors);
+    reading.shown += tm->refresh();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  reading.dropped = tm->droppedFrames();
+  reading.millis = millisSince(start);
+  report(reading);
+  // Stalled again when quitting: the rest of the output is dropped.
+  Phase quit{0, 0, 0};
+  for (int frame = 0; frame < 200 && tm->pendingBytes() == 0; ++frame) {
+    drawAll(tm.get(), frame, numColors);
+    quit.shown += tm->refresh();
+  }
+  start = std::chrono::steady_clock::now();
+  tm.reset();
+  quit.millis = millisSince(start);
+  report(quit);
+}
+
+// Read a phase from the child, waiting at most 10 seconds. While `master` is
+// not -1, the terminal is read meanwhile.
+bool readPhase(int results, int master, Phase *phase) {
+  auto start = std::chrono::steady_clock::now();
+  while (millisSince(start) < 10'000) {
+    pollfd fds[2] = {{results, POLLIN, 0}, {master, POLLIN, 0}};
+    poll(fds, master >= 0 ? 2 : 1, 100);
+    if (fds[0].revents & POLLIN) {
+      return read(results, phase, sizeof(*phase)) == sizeof(*phase);
+    }
+    if (master >= 0 && (fds[1].revents & POLLIN)) {
+      char buffer[1 << 16];
+      if (read(master, buffer, sizeof(buffer)) < 0) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+} // namespace
+
+TEST(TerminalManager, dropsFramesInsteadOfBlocking) {
+  // A pseudo terminal whose output is not read fills up like a paused pane
+  // or a slow link.
+  int master;
+  int slave;
+  struct winsize size = {40, 120, 0, 0};
+  ASSERT_EQ(openpty(&master, &slave, nullptr, nullptr, &size), 0);
+  int results[2];
+  ASSERT_EQ(pipe(results), 0);
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    close(master);
+    close(results[0]);
+    dup2(slave, STDIN_FILENO);
+    dup2(slave, STDOUT_FILENO);
+    close(slave);
+    playOnTerminal(results[1]);
+    _exit(0);
+  }
+  close(slave);
+  close(results[1]);
+  Phase stalled;
+  Phase reading;
+  Phase quit;
+  ASSERT_TRUE(readPhase(results[0], -1, &stalled));
+  ASSERT_TRUE(readPhase(results[0], master, &reading));
+  ASSERT_TRUE(readPhase(results[0], -1, &quit));
+  int status;
+  waitpid(child, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+  close(master);
+  close(results[0]);
+
+  // Only the first frames fit, the others were dropped without waiting.
+  ASSERT_LT(stalled.shown, 10);
+  ASSERT_EQ(stalled.dropped, static_cast<uint64_t>(200 - stalled.shown));
+  ASSERT_LT(stalled.millis, 5000);
+  // Once the terminal takes the output, frames are shown again.
+  ASSERT_EQ(reading.shown, 1);
+  ASSERT_GE(reading.dropped, stalled.dropped);
+  // Quitting waits about a second for the stalled terminal, not forever.
+  ASSERT_GE(quit.millis, 900);
+  ASSERT_LT(quit.millis, 3000);
+}
@@ -0,0 +1,113 @@
+// Copyright (C)
+
+#include "./TetrisApi.h"
+#include "./TetrisGame.h"
+#include <exception>
+#include <ncurses.h> // For keycodes
+#include <new>
+#include <string>
+
+static thread_local std::string lastError;
+
+// The environment is a headless game that fills its observation in place.
+struct TetrisEnv : public TetrisGame {
+  TetrisEnv() : TetrisGame(std::make_unique<HeadlessTerminalManager>()) {
+    observation.cells = screen_.colors(0);
+  }
+
+  void reset(uint64_t seed) {
+    setSeed(seed);
+    resetGame();
+    newGame();
+    observe();
+  }
+
+  int32_t step(int32_t action) {
+    if (gameOver_) {
+      return 0;
+    }
+    const int keys[TETRIS_NUM_ACTIONS] = {-1,       KEY_LEFT,   KEY_RIGHT,
+                                          KEY_DOWN, keycodeD_, keycodeA_};
+    UserInput uI;
+    uI.keycode_ = action > 0 && action < TETRIS_NUM_ACTIONS ? keys[action] : -1;
+    int before = score_;
+    // No exception may cross into C.
+    try {
+      simulateFrame(uI);
+    } catch (const std::exception &e) {
+      lastError = e.what();
+      gameOver_ = true;
+    }
+    observe();
+    return score_ - before;
+  }
+
+  // Copy the few values that are not read from the board directly.
+  void observe() {
+    observation.score = score_;
+    observation.lines = lines_;
+    observation.level = level_;
+    observation.current = static_cast<int>(currentTetromino_.form());
+    observation.next = static_cast<int>(nextTetromino_.form());
+    observation.rotation = currentTetromino_.form() == TetrominoForm::I
+                               ? !iIsUp
+                               : static_cast<int>(currentTetromino_.rotation());
+    observation.positionX = positionTetromino_.first;
+    observation.positionY = positionTetromino_.second;
+    observation.gameOver = gameOver_;
+    observation.frame = frame_;
+    observation.pieces = pieces_;
+  }
+
+  TetrisObservation observation{};
+};
+
+// ____________________________________________________________________________
+int tetris_api_version(void) { return TETRIS_API_VERSION; }
+
+// ____________________________________________________________________________
+TetrisEnv *tetris_create(void) {
+  try {
+    TetrisEnv *env = new TetrisEnv();
+    env->reset(0);
+    lastError.clear();
+    return env;
+  } catch (const std::exception &e) {
+    lastError = e.what();
+    return nullptr;
+  }
+}
+
+// ____________________________________________________________________________
+void tetris_destroy(TetrisEnv *env) { delete env; }
+
+// ____________________________________________________________________________
+void tetris_reset(TetrisEnv *env, uint64_t seed) { env->reset(seed); }
+
+// ____________________________________________________________________________
+int32_t tetris_step(TetrisEnv *env, int32_t action) {
+  return env->step(action);
+}
+
+// ____________________________________________________________________________
+void tetris_step_batch(TetrisEnv *const *envs, size_t count,
+                       const int32_t *actions, int32_t *rewards,
+                       uint8_t *gameOver) {
+  for (size_t i = 0; i < count; ++i) {
+    int32_t reward = envs[i]->step(actions[i]);
+    if (rewards != nullptr) {
+      rewards[i] = reward;
+    }
+    if (gameOver != nullptr) {
+      gameOver[i] = envs[i]->observation.gameOver;
+    }
+  }
+}
+
+// ____________________________________________________________________________
+const TetrisObservation *tetris_observation(const TetrisEnv *env) {
+  return &env->observation;
+}
+
+// ____________________________________________________________________________
+const char *tetris_last_error(void) { return lastError.c_str(); }
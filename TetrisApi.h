@@ -0,0 +1,89 @@
+// Copyright (C)
+
+#pragma once
+
+// C interface of the game engine, built as libtetris.so, for trainers and
+// tools that are not written in C++. An environment is one headless game
+// that advances a frame per step, with gravity counted in frames, so the
+// same seed and actions always give the same game.
+// Observations are not copied out: tetris_observation() returns a pointer to
+// a struct that belongs to the environment, and its cells point right into
+// the board of the engine. Both stay valid until tetris_destroy() and show
+// the state after the last step.
+// The version only changes when existing functions or structs change.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TETRIS_API_VERSION 1
+
+#define TETRIS_ROWS 20
+#define TETRIS_COLS 10
+
+typedef struct TetrisEnv TetrisEnv;
+
+enum TetrisAction {
+  TETRIS_NONE = 0,
+  TETRIS_LEFT = 1,
+  TETRIS_RIGHT = 2,
+  TETRIS_DOWN = 3,
+  TETRIS_ROTATE_CW = 4,
+  TETRIS_ROTATE_CCW = 5,
+  TETRIS_NUM_ACTIONS = 6
+};
+
+typedef struct TetrisObservation {
+  // TETRIS_ROWS rows of TETRIS_COLS colors, row 0 is the top, 0 is empty.
+  // Includes the falling Tetromino. Points into the engine.
+  const uint8_t *cells;
+  int32_t score;
+  int32_t lines;
+  int32_t level;
+  // Forms of the current and the next Tetromino, 0 to 6
+  int32_t current;
+  int32_t next;
+  int32_t rotation;
+  int32_t positionX;
+  int32_t positionY;
+  int32_t gameOver;
+  // Steps since the last reset and Tetrominos spawned in this game
+  uint64_t frame;
+  uint64_t pieces;
+} TetrisObservation;
+
+// TETRIS_API_VERSION of the library, to check against the header.
+int tetris_api_version(void);
+
+// A new environment with a game started with seed 0. Returns NULL on
+// failure, see tetris_last_error().
+TetrisEnv *tetris_create(void);
+
+void tetris_destroy(TetrisEnv *env);
+
+// Start a new game with the seed.
+void tetris_reset(TetrisEnv *env, uint64_t seed);
+
+// Advance the game by one frame with the action (a TetrisAction). Returns
+// the points the step was worth. Does nothing once the game is over.
+int32_t tetris_step(TetrisEnv *env, int32_t action);
+
+// Step `count` environments, each with its own action. Writes the rewards
+// and whether the games are over, if the arrays are not NULL. Saves a call
+// per environment.
+void tetris_step_batch(TetrisEnv *const *envs, size_t count,
+                       const int32_t *actions, int32_t *rewards,
+                       uint8_t *gameOver);
+
+// The observation of the environment, updated in place by every step.
+const TetrisObservation *tetris_observation(const TetrisEnv *env);
+
+// Message of the last error on this thread, or an empty string.
+const char *tetris_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
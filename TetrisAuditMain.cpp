@@ -0,0 +1,94 @@
+// Copyright (C)
+
+#include "./TetrisGame.h"
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+// Verifies the claimed results of all replays in a directory by
+// re-simulating them headless with the game itself, so the audit scores lines
+// exactly like the live game (TetrisGame::lineScore).
+// Usage: ./TetrisAuditMain <directory> [threads]
+
+// The verdict for one replay file.
+struct Verdict {
+  bool ok{false};
+  std::string message;
+  uint64_t frames{0};
+};
+
+// Re-simulate one replay straight from its memory mapping.
+Verdict audit(TetrisGame *game, const std::string &path) {
+  Verdict verdict;
+  try {
+    MappedFile file(path);
+    file.adviseSequential();
+    ReplayReader reader(file.data(), file.size());
+    ReplayResult result = game->replay(reader);
+    const ReplayResult &claimed = reader.result();
+    verdict.frames = result.frames;
+    verdict.ok = result.score == claimed.score &&
+                 result.lines == claimed.lines && result.level == claimed.level;
+    verdict.message = "score " + std::to_string(result.score) + " (claimed " +
+                      std::to_string(claimed.score) + "), lines " +
+                      std::to_string(result.lines) + " (claimed " +
+                      std::to_string(claimed.lines) + "), level " +
+                      std::to_string(result.level) + " (claimed " +
+                      std::to_string(claimed.level) + ")";
+  } catch (const std::exception &e) {
+    verdict.ok = false;
+    verdict.message = e.what();
+  }
+  return verdict;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./TetrisAuditMain <directory> [threads]\n");
+    return 2;
+  }
+  std::vector<std::string> paths;
+  for (const auto &entry : std::filesystem::directory_iterator(argv[1])) {
+    if (entry.is_regular_file()) {
+      paths.push_back(entry.path().string());
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+  int numThreads = argc > 2 ? std::stoi(argv[2])
+                            : std::max(1u, std::thread::hardware_concurrency());
+
+  // Every thread takes the next file until none are left. Verdicts go to the
+  // slot of their file, so nothing else is shared.
+  std::vector<Verdict> verdicts(paths.size());
+  std::atomic<size_t> nextFile{0};
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&]() {
+      TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+      size_t i;
+      while ((i = nextFile.fetch_add(1)) < paths.size()) {
+        verdicts[i] = audit(&game, paths[i]);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  size_t failed{0};
+  uint64_t frames{0};
+  for (size_t i = 0; i < paths.size(); ++i) {
+    printf("%s %s: %s\n", verdicts[i].ok ? "OK  " : "FAIL", paths[i].c_str(),
+           verdicts[i].message.c_str());
+    failed += !verdicts[i].ok;
+    frames += verdicts[i].frames;
+  }
+  printf("\n%zu replays, %zu ok, %zu failed, %d threads\n", paths.size(),
+         paths.size() - failed, failed, numThreads);
+  printf("%.3f s, %.1f replays/s, %.0f simulated frames/s\n", elapsed.count(),
+         paths.size() / elapsed.count(), frames / elapsed.count());
+  return failed == 0 ? 0 : 1;
+}
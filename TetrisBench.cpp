@@ -0,0 +1,454 @@
+// Copyright (C)
+
+#include "./PositionStore.h"
+#include "./Rollback.h"
+#include "./SharedEnv.h"
+#include "./SparseBoard.h"
+#include "./TetrisGame.h"
+#include "./TrainingData.h"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <memory>
+#include <ncurses.h> // For keycodes
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Micro benchmarks for the hot paths of the game.
+// Run `make bench` to get the results as JSON in TetrisBench.json.
+
+// Makes the protected methods of TetrisGame accessible for benchmarking.
+class BenchGame : public TetrisGame {
+public:
+  using TetrisGame::TetrisGame;
+
+  using TetrisGame::bufferTetromino;
+  using TetrisGame::checkCollisionDown;
+  using TetrisGame::checkCollisionLeft;
+  using TetrisGame::checkCollisionRight;
+  using TetrisGame::checkCollisionRotateCW;
+  using TetrisGame::checkCollisionRotateICW;
+  using TetrisGame::drawBoard;
+  using TetrisGame::drawScreen;
+  using TetrisGame::settleTetromino;
+
+  // Put the given Tetromino at the given position and buffer it.
+  void place(TetrominoForm form, int x, int y) {
+    currentTetromino_ = Tetromino{form};
+    positionTetromino_ = std::make_pair(x, y);
+    iIsUp = true;
+    bufferTetromino();
+  }
+
+  // Fill the bottom `lines` rows except for the leftmost column and put a
+  // vertical I into that column, so settling it clears exactly `lines` rows.
+  void prepareLineClear(int lines) {
+    screen_.clear();
+    for (int i = 20 - lines; i < 20; ++i) {
+      for (int j = 1; j < 10; ++j) {
+        screen_.settle(j, i, 3);
+      }
+    }
+    place(TetrominoForm::I, 0, 18);
+  }
+
+  // Some settled Tetrominos, so the collision checks have something to find.
+  void prepareBoard() {
+    for (int i = 14; i < 20; ++i) {
+      for (int j = 0; j < 10; ++j) {
+        if ((i + j) % 3 != 0) {
+          screen_.settle(j, i, 4);
+        }
+      }
+    }
+  }
+};
+
+// Games that do not draw anything, so only the game logic is measured.
+static std::unique_ptr<BenchGame> headlessGame() {
+  return std::make_unique<BenchGame>(
+      std::make_unique<HeadlessTerminalManager>());
+}
+
+// ____________________________________________________________________________
+static void BM_TetrominoConstruction(benchmark::State &state) {
+  for (auto _ : state) {
+    Tetromino tetromino{static_cast<TetrominoForm>(state.range(0))};
+    benchmark::DoNotOptimize(tetromino);
+  }
+}
+BENCHMARK(BM_TetrominoConstruction)->DenseRange(0, 6);
+
+// ____________________________________________________________________________
+static void BM_bufferTetromino(benchmark::State &state) {
+  auto game = headlessGame();
+  game->place(static_cast<TetrominoForm>(state.range(0)), 5, 5);
+  for (auto _ : state) {
+    game->bufferTetromino();
+  }
+}
+BENCHMARK(BM_bufferTetromino)->DenseRange(0, 6);
+
+// ____________________________________________________________________________
+static void BM_checkCollisionLeft(benchmark::State &state) {
+  auto game = headlessGame();
+  game->prepareBoard();
+  game->place(TetrominoForm::T, 5, 11);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game->checkCollisionLeft());
+  }
+}
+BENCHMARK(BM_checkCollisionLeft);
+
+// ____________________________________________________________________________
+static void BM_checkCollisionRight(benchmark::State &state) {
+  auto game = headlessGame();
+  game->prepareBoard();
+  game->place(TetrominoForm::T, 5, 11);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game->checkCollisionRight());
+  }
+}
+BENCHMARK(BM_checkCollisionRight);
+
+// ____________________________________________________________________________
+static void BM_checkCollisionDown(benchmark::State &state) {
+  auto game = headlessGame();
+  game->prepareBoard();
+  game->place(TetrominoForm::T, 5, 11);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game->checkCollisionDown());
+  }
+}
+BENCHMARK(BM_checkCollisionDown);
+
+// ____________________________________________________________________________
+static void BM_checkCollisionRotateCW(benchmark::State &state) {
+  auto game = headlessGame();
+  game->prepareBoard();
+  game->place(TetrominoForm::L, 5, 11);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game->checkCollisionRotateCW(true));
+  }
+}
+BENCHMARK(BM_checkCollisionRotateCW);
+
+// ____________________________________________________________________________
+static void BM_checkCollisionRotateICW(benchmark::State &state) {
+  auto game = headlessGame();
+  game->prepareBoard();
+  game->place(TetrominoForm::I, 5, 11);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game->checkCollisionRotateICW());
+  }
+}
+BENCHMARK(BM_checkCollisionRotateICW);
+
+// ____________________________________________________________________________
+static void BM_settleTetromino(benchmark::State &state) {
+  auto game = headlessGame();
+  for (auto _ : state) {
+    state.PauseTiming();
+    game->prepareLineClear(state.range(0));
+    state.ResumeTiming();
+    game->settleTetromino();
+  }
+}
+BENCHMARK(BM_settleTetromino)->DenseRange(0, 4);
+
+// ____________________________________________________________________________
+template <class B> static void BM_clearFullLines(benchmark::State &state) {
+  // Every other row is full, so half of the board is cleared.
+  B board;
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (int y = 0; y < B::height; ++y) {
+      for (int x = y % 2; x < B::width; ++x) {
+        board.settle(x, y, 3);
+      }
+    }
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(board.clearFullLines());
+  }
+}
+BENCHMARK_TEMPLATE(BM_clearFullLines, StandardBoard);
+BENCHMARK_TEMPLATE(BM_clearFullLines, TrainingBoard);
+BENCHMARK_TEMPLATE(BM_clearFullLines, TallBoard);
+BENCHMARK_TEMPLATE(BM_clearFullLines, Board<64, 40>);
+
+// Boards with 10'000 rows for the stress benchmarks
+static constexpr int tallHeight = 10'000;
+using DenseTallBoard = Board<10, tallHeight>;
+using SparseTallBoard = SparseBoard<10>;
+
+template <class B> static std::unique_ptr<B> makeTallBoard();
+template <> std::unique_ptr<DenseTallBoard> makeTallBoard() {
+  return std::make_unique<DenseTallBoard>();
+}
+template <> std::unique_ptr<SparseTallBoard> makeTallBoard() {
+  return std::make_unique<SparseTallBoard>(tallHeight);
+}
+
+// Fill the bottom `rows` rows of a tall board, every other one completely.
+template <class B> static void fillTallBoard(B *board, int rows) {
+  for (int y = tallHeight - rows; y < tallHeight; ++y) {
+    for (int x = y % 2; x < 10; ++x) {
+      board->settle(x, y, 3 + y % 7);
+    }
+  }
+}
+
+// ____________________________________________________________________________
+template <class B> static void BM_tallBoardClear(benchmark::State &state) {
+  auto filled = makeTallBoard<B>();
+  fillTallBoard(filled.get(), state.range(0));
+  auto board = makeTallBoard<B>();
+  for (auto _ : state) {
+    state.PauseTiming();
+    *board = *filled;
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(board->clearFullLines());
+  }
+}
+BENCHMARK_TEMPLATE(BM_tallBoardClear, DenseTallBoard)->Arg(20)->Arg(2'000);
+BENCHMARK_TEMPLATE(BM_tallBoardClear, SparseTallBoard)->Arg(20)->Arg(2'000);
+
+// ____________________________________________________________________________
+template <class B> static void BM_tallBoardCollision(benchmark::State &state) {
+  auto board = makeTallBoard<B>();
+  fillTallBoard(board.get(), state.range(0));
+  std::vector<std::pair<int, int>> points = {{4, 0}, {5, 0}, {6, 0}, {5, 1}};
+  int y = tallHeight - state.range(0) - 3;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(board->collides(points, 0, y));
+  }
+}
+BENCHMARK_TEMPLATE(BM_tallBoardCollision, DenseTallBoard)->Arg(20)->Arg(2'000);
+BENCHMARK_TEMPLATE(BM_tallBoardCollision, SparseTallBoard)->Arg(20)->Arg(2'000);
+
+// ____________________________________________________________________________
+template <class B> static void BM_drawTallBoard(benchmark::State &state) {
+  // Only the viewport at the top of the stack is drawn.
+  auto game = headlessGame();
+  auto board = makeTallBoard<B>();
+  fillTallBoard(board.get(), state.range(0));
+  int firstRow = std::max(0, tallHeight - static_cast<int>(state.range(0)) - 4);
+  for (auto _ : state) {
+    game->drawBoard(*board, firstRow);
+  }
+}
+BENCHMARK_TEMPLATE(BM_drawTallBoard, DenseTallBoard)->Arg(2'000);
+BENCHMARK_TEMPLATE(BM_drawTallBoard, SparseTallBoard)->Arg(2'000);
+
+// ____________________________________________________________________________
+static void BM_drawScreenHeadless(benchmark::State &state) {
+  auto game = headlessGame();
+  game->prepareBoard();
+  for (auto _ : state) {
+    game->drawScreen();
+  }
+}
+BENCHMARK(BM_drawScreenHeadless);
+
+// ____________________________________________________________________________
+static void BM_drawScreenMock(benchmark::State &state) {
+  BenchGame game(1, nullptr, true);
+  game.prepareBoard();
+  for (auto _ : state) {
+    game.drawScreen();
+  }
+}
+BENCHMARK(BM_drawScreenMock);
+
+// ____________________________________________________________________________
+static void BM_drawScreenTerminal(benchmark::State &state) {
+  // ncurses needs a real terminal.
+  if (!isatty(STDOUT_FILENO) || getenv("TERM") == nullptr) {
+    state.SkipWithError("stdout is not a terminal");
+    return;
+  }
+  BenchGame game(1, nullptr, false);
+  game.prepareBoard();
+  for (auto _ : state) {
+    game.drawScreen();
+  }
+}
+BENCHMARK(BM_drawScreenTerminal);
+
+// ____________________________________________________________________________
+static void BM_GameStateCopy(benchmark::State &state) {
+  auto game = headlessGame();
+  game->prepareBoard();
+  game->place(TetrominoForm::T, 5, 5);
+  GameState snapshot = game->snapshot();
+  for (auto _ : state) {
+    GameState fork = snapshot;
+    benchmark::DoNotOptimize(fork);
+  }
+}
+BENCHMARK(BM_GameStateCopy);
+
+// ____________________________________________________________________________
+static void BM_snapshot(benchmark::State &state) {
+  auto game = headlessGame();
+  game->prepareBoard();
+  game->place(TetrominoForm::T, 5, 5);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game->snapshot());
+  }
+}
+BENCHMARK(BM_snapshot);
+
+// ____________________________________________________________________________
+static void BM_restore(benchmark::State &state) {
+  auto game = headlessGame();
+  game->prepareBoard();
+  game->place(TetrominoForm::T, 5, 5);
+  GameState snapshot = game->snapshot();
+  for (auto _ : state) {
+    game->restore(snapshot);
+  }
+}
+BENCHMARK(BM_restore);
+
+// ____________________________________________________________________________
+// Publishing a frame where a Tetromino moved, with the given number of
+// spectators reading the broadcast at the same time. The cost should not
+// depend on the number of spectators.
+static void BM_broadcastPublish(benchmark::State &state) {
+  std::string name = "/tetris-bench-" + std::to_string(getpid());
+  BroadcastPublisher publisher(name);
+  std::atomic<bool> running{true};
+  std::vector<std::thread> spectators;
+  for (int i = 0; i < state.range(0); ++i) {
+    spectators.emplace_back([&name, &running]() {
+      BroadcastSubscriber subscriber(name);
+      BroadcastFrame frame;
+      while (running) {
+        subscriber.update(&frame);
+        std::this_thread::yield();
+      }
+    });
+  }
+  BroadcastFrame frame;
+  for (auto _ : state) {
+    int x = frame.frame % 7;
+    for (int y = 0; y < 4; ++y) {
+      frame.cells[y][x] = 0;
+      frame.cells[y][x + 1] = 4;
+    }
+    frame.frame++;
+    publisher.publish(frame);
+  }
+  running = false;
+  for (auto &spectator : spectators) {
+    spectator.join();
+  }
+}
+BENCHMARK(BM_broadcastPublish)->Arg(0)->Arg(1)->Arg(8);
+
+// A rollback of the full prediction window: every iteration confirms a
+// remote key for a frame that was predicted as "no key", so the next frame
+// re-simulates 8 frames of both boards. Must stay far below 16 ms.
+static void BM_rollback(benchmark::State &state) {
+  const int window = 8;
+  RollbackSession session(1, 0, window + 1);
+  for (int i = 0; i < window; ++i) {
+    session.advanceFrame(-1);
+  }
+  int key = 0;
+  for (auto _ : state) {
+    // Alternate left and right so the boards stay in play.
+    session.addRemoteInput(key++ % 2 == 0 ? KEY_LEFT : KEY_RIGHT);
+    session.advanceFrame(-1);
+  }
+  state.counters["resimulated"] = benchmark::Counter(
+      session.stats().resimulatedFrames, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_rollback);
+
+// Appending training records like a headless game does, a few rows of the
+// board change per record. Compressing and writing happens on the background
+// thread of the writer, so this measures what the game pays.
+static void BM_trainingExport(benchmark::State &state) {
+  std::string path = "/tmp/tetris-bench-training-" + std::to_string(getpid());
+  TrainingWriter writer(path);
+  TrainingRecord record{};
+  uint32_t piece = 0;
+  for (auto _ : state) {
+    record.board[19 - piece % 20] ^= 1 << (piece % 10);
+    record.current = piece % 7;
+    record.piece = ++piece;
+    writer.append(record);
+  }
+  writer.close();
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bytesPerRecord"] =
+      static_cast<double>(writer.bytesWritten()) / state.iterations();
+  state.counters["stalls"] = writer.stalls();
+  unlink(path.c_str());
+}
+BENCHMARK(BM_trainingExport);
+
+// A round trip through the shared memory environment server for a batch of
+// the given size: write the actions, step all games, read the observations.
+// The server runs on a thread here, the doorbells are the same between
+// processes.
+static void BM_sharedEnvRoundTrip(benchmark::State &state) {
+  std::string name = "/tetris-bench-envs-" + std::to_string(getpid());
+  SharedEnvServer server(name, state.range(0));
+  std::thread thread([&server]() { server.run(); });
+  SharedEnvClient client(name);
+  const SharedEnvSlots &slots = client.slots();
+  int32_t step = 0;
+  for (auto _ : state) {
+    for (uint32_t i = 0; i < client.numEnvs(); ++i) {
+      slots.actions[i] = slots.gameOver[i] ? SharedEnvSlots::resetAction
+                                           : (step + i) % TETRIS_NUM_ACTIONS;
+    }
+    client.step();
+    step++;
+  }
+  server.stop();
+  thread.join();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["sleeps"] = benchmark::Counter(
+      client.sleeps(), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_sharedEnvRoundTrip)->Arg(1)->Arg(64)->Arg(256)->UseRealTime();
+
+// Visits of the position store from 1 to 64 threads. Positions come from a
+// million distinct ones, so most visits count a known position, and the
+// store holds a quarter of them, so the others evict.
+static void BM_positionStoreVisit(benchmark::State &state) {
+  static std::unique_ptr<PositionStore> store;
+  static std::vector<PositionKey> keys;
+  if (state.thread_index() == 0) {
+    store = std::make_unique<PositionStore>(size_t{1} << 24);
+    if (keys.empty()) {
+      uint64_t random = 1;
+      for (int i = 0; i < 1 << 20; ++i) {
+        uint16_t rows[20]{};
+        for (int y = 10; y < 20; ++y) {
+          random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+          rows[y] = random >> 54;
+        }
+        keys.push_back(PositionKey::of(rows, TetrominoForm(i % 7)));
+      }
+    }
+  }
+  uint64_t next = state.thread_index() * 7919;
+  for (auto _ : state) {
+    next = next * 2862933555777941757ULL + 3037000493ULL;
+    benchmark::DoNotOptimize(store->visit(keys[next >> 44]));
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    state.counters["bytesPerEntry"] = PositionStore::bytesPerEntry;
+    state.counters["evictions"] = store->evictions();
+  }
+}
+BENCHMARK(BM_positionStoreVisit)->ThreadRange(1, 64)->UseRealTime();
+
+BENCHMARK_MAIN();
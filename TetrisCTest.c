@@ -0,0 +1,142 @@
+// Copyright (C)
+
+// Plays random games through the C API of libtetris.so, one environment at a
+// time and in batches, checks the observations and prints the steps per
+// second. Written in C to make sure the header and the library are usable
+// without C++. Exits with 1 on the first failed check.
+
+#define _POSIX_C_SOURCE 199309L // For clock_gettime
+
+#include "./TetrisApi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_STEPS 1000000
+#define NUM_ENVS 64
+
+#define CHECK(condition)                                                       \
+  if (!(condition)) {                                                          \
+    fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,           \
+            #condition);                                                       \
+    exit(1);                                                                   \
+  }
+
+static uint64_t randomState = 88172645463325252ull;
+
+// xorshift64, the same sequence on every platform
+static int32_t randomAction(void) {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 7;
+  randomState ^= randomState << 17;
+  return randomState % TETRIS_NUM_ACTIONS;
+}
+
+static double seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void checkObservation(const TetrisObservation *observation) {
+  CHECK(observation->current >= 0 && observation->current < 7);
+  CHECK(observation->next >= 0 && observation->next < 7);
+  CHECK(observation->score >= 0);
+  CHECK(observation->lines >= 0);
+  int filled = 0;
+  for (int i = 0; i < TETRIS_ROWS * TETRIS_COLS; ++i) {
+    filled += observation->cells[i] != 0;
+  }
+  // The falling Tetromino is always on the board.
+  CHECK(filled >= 4 || observation->gameOver);
+}
+
+static void singleEnvironment(void) {
+  TetrisEnv *env = tetris_create();
+  CHECK(env != NULL);
+  const TetrisObservation *observation = tetris_observation(env);
+  const uint8_t *cells = observation->cells;
+  checkObservation(observation);
+  CHECK(observation->frame == 0);
+  uint64_t games = 0;
+  int64_t score = 0;
+  int64_t lines = 0;
+  double start = seconds();
+  for (int step = 0; step < NUM_STEPS; ++step) {
+    int32_t before = observation->score;
+    int32_t reward = tetris_step(env, randomAction());
+    CHECK(observation->score - before == reward);
+    if (observation->gameOver) {
+      score += observation->score;
+      lines += observation->lines;
+      games++;
+      tetris_reset(env, games);
+      CHECK(observation->score == 0 && observation->frame == 0);
+    }
+  }
+  double elapsed = seconds() - start;
+  // Still the same memory, no copies
+  CHECK(tetris_observation(env) == observation);
+  CHECK(observation->cells == cells);
+  checkObservation(observation);
+  printf("single: %d steps in %.3f s, %.2f M steps/s, %lu games, %.1f points "
+         "and %.2f lines per game\n",
+         NUM_STEPS, elapsed, NUM_STEPS / elapsed / 1e6, (unsigned long)games,
+         games > 0 ? (double)score / games : 0.0,
+         games > 0 ? (double)lines / games : 0.0);
+  tetris_destroy(env);
+}
+
+static void batchedEnvironments(void) {
+  TetrisEnv *envs[NUM_ENVS];
+  int32_t actions[NUM_ENVS];
+  int32_t rewards[NUM_ENVS];
+  uint8_t gameOver[NUM_ENVS];
+  for (int i = 0; i < NUM_ENVS; ++i) {
+    envs[i] = tetris_create();
+    CHECK(envs[i] != NULL);
+    tetris_reset(envs[i], 1000 + i);
+  }
+  // The same seed gives the same game.
+  tetris_reset(envs[1], 1000);
+  uint64_t games = 0;
+  double start = seconds();
+  for (int step = 0; step < NUM_STEPS / NUM_ENVS; ++step) {
+    for (int i = 0; i < NUM_ENVS; ++i) {
+      actions[i] = randomAction();
+    }
+    actions[1] = actions[0];
+    tetris_step_batch(envs, NUM_ENVS, actions, rewards, gameOver);
+    CHECK(rewards[0] == rewards[1] && gameOver[0] == gameOver[1]);
+    for (int i = 0; i < NUM_ENVS; ++i) {
+      CHECK(gameOver[i] == tetris_observation(envs[i])->gameOver);
+      if (gameOver[i] && i > 1) {
+        games++;
+        tetris_reset(envs[i], 1000 + i + NUM_ENVS * games);
+      }
+    }
+    if (gameOver[0]) {
+      games += 2;
+      tetris_reset(envs[0], step);
+      tetris_reset(envs[1], step);
+    }
+  }
+  double elapsed = seconds() - start;
+  int steps = NUM_STEPS / NUM_ENVS * NUM_ENVS;
+  printf("batch of %d: %d steps in %.3f s, %.2f M steps/s, %lu games\n",
+         NUM_ENVS, steps, elapsed, steps / elapsed / 1e6,
+         (unsigned long)games);
+  for (int i = 0; i < NUM_ENVS; ++i) {
+    checkObservation(tetris_observation(envs[i]));
+    tetris_destroy(envs[i]);
+  }
+}
+
+int main(void) {
+  CHECK(tetris_api_version() == TETRIS_API_VERSION);
+  CHECK(tetris_last_error()[0] == '\0');
+  singleEnvironment();
+  batchedEnvironments();
+  printf("PASSED\n");
+  return 0;
+}
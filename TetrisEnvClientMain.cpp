@@ -0,0 +1,61 @@
+// Copyright (C)
+
+#include "./Histogram.h"
+#include "./SharedEnv.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+// Steps all environments of a ./TetrisEnvServerMain with random actions for
+// the given seconds and prints the round trip latency and the steps per
+// second. Games that are over are reset.
+// Usage: ./TetrisEnvClientMain <name> [seconds]
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./TetrisEnvClientMain <name> [seconds]\n");
+    return 2;
+  }
+  try {
+    SharedEnvClient client(argv[1]);
+    std::chrono::duration<double> duration(argc > 2 ? std::stod(argv[2]) : 5);
+    const SharedEnvSlots &slots = client.slots();
+    uint32_t numEnvs = client.numEnvs();
+    std::minstd_rand random(1);
+    Histogram latencies;
+    uint64_t games = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto now = start;
+    while (now - start < duration) {
+      for (uint32_t i = 0; i < numEnvs; ++i) {
+        if (slots.gameOver[i]) {
+          slots.actions[i] = SharedEnvSlots::resetAction;
+          slots.seeds[i] = random();
+          games++;
+        } else {
+          slots.actions[i] = random() % TETRIS_NUM_ACTIONS;
+        }
+      }
+      client.step();
+      auto before = now;
+      now = std::chrono::steady_clock::now();
+      latencies.record(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(now - before)
+              .count());
+    }
+    double seconds = std::chrono::duration<double>(now - start).count();
+    uint64_t batches = latencies.count();
+    printf("%u environments, %lu batches in %.1f s: %.0f batches/s, %.2f M "
+           "steps/s, %lu games\n",
+           numEnvs, batches, seconds, batches / seconds,
+           batches * numEnvs / seconds / 1e6, games);
+    printf("Round trip: p50 %.1f us, p99 %.1f us, max %.1f us, slept %lu "
+           "times\n",
+           latencies.percentile(50) / 1e3, latencies.percentile(99) / 1e3,
+           latencies.max() / 1e3, client.sleeps());
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+}
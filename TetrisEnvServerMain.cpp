@@ -0,0 +1,41 @@
+// Copyright (C)
+
+#include "./SharedEnv.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// Serves game environments to a trainer in another process through shared
+// memory, see SharedEnv.h, until interrupted or for the given seconds.
+// Usage: ./TetrisEnvServerMain <name> <environments> [seconds]
+// Try it with ./TetrisEnvClientMain <name>.
+
+static SharedEnvServer *server = nullptr;
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr,
+            "Usage: ./TetrisEnvServerMain <name> <environments> [seconds]\n");
+    return 2;
+  }
+  SharedEnvServer envServer(argv[1], std::stoul(argv[2]));
+  server = &envServer;
+  signal(SIGINT, [](int) { server->stop(); });
+  signal(SIGTERM, [](int) { server->stop(); });
+  if (argc > 3) {
+    std::thread([seconds = std::stoi(argv[3])]() {
+      std::this_thread::sleep_for(std::chrono::seconds(seconds));
+      server->stop();
+    }).detach();
+  }
+  printf("Serving %s environments at %s\n", argv[2], argv[1]);
+  auto start = std::chrono::steady_clock::now();
+  envServer.run();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  SharedEnvServer::Stats stats = envServer.stats();
+  printf("%lu batches, %lu steps in %.1f s, slept %lu times\n", stats.batches,
+         stats.steps, elapsed.count(), stats.sleeps);
+}
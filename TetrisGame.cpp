@@ -1,47 +1,26 @@
 // Copyright
 
 #include "./TetrisGame.h"
+#include "./SparseBoard.h"
+#include "./Trace.h"
+#include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <stdexcept>
 
 #include <iostream>
 
-// Implementation of Row class
-
-int ID = 0;
-
-Row::Row() {
-  num_ = ID % 20;
-  ID++;
-  clear();
-}
-
-void Row::clear() {
-  for (auto &pair : row_) {
-    pair = std::make_pair(0, 0);
-  }
-}
-
-void Row::getUpper(const Row &row) {
-  for (int i = 0; i < 10; ++i) {
-    row_[i] = row.row_[i];
-  }
-}
-
-bool Row::isFull() const {
-  for (int i = 0; i < 10; ++i) {
-    if (row_[i].second != 69) {
-      return false;
-    }
-  }
-  return true;
+// Duration in whole microseconds, for the histograms
+static uint64_t micros(Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
 }
 
 // Implementation of TetrisGame class
 
 // Public
 
-TetrisGame::TetrisGame(int argc, char **argv, bool mock) {
+TetrisGame::TetrisGame(int argc, char **argv, bool mock, bool halfBlocks) {
   const char *d = "default";
   if (argc > 1) {
     if (argv[1] != d) {
@@ -79,6 +58,14 @@ TetrisGame::TetrisGame(int argc, char **argv, bool mock) {
       }
     }
   }
+  if (!mock) {
+    tm_ = std::make_unique<TerminalManager>(colors(), halfBlocks);
+  } else {
+    tm_ = std::make_unique<MockTerminalManager>(100, 100);
+  }
+}
+
+std::vector<std::pair<Color, Color>> TetrisGame::colors() {
   // Background Color
   Color Background{0, 0, 0};
 
@@ -99,7 +86,6 @@ TetrisGame::TetrisGame(int argc, char **argv, bool mock) {
   Color ColorO{1, 1, 0.0};
 
   std::vector<std::pair<Color, Color>> colors_;
-
   colors_.push_back(std::make_pair(Background, Background));
   colors_.push_back(std::make_pair(Border, Border));
   colors_.push_back(std::make_pair(TextFront, TextBack));
@@ -110,69 +96,148 @@ TetrisGame::TetrisGame(int argc, char **argv, bool mock) {
   colors_.push_back(std::make_pair(ColorT, ColorT));
   colors_.push_back(std::make_pair(ColorI, ColorI));
   colors_.push_back(std::make_pair(ColorO, ColorO));
-  if (!mock) {
-    tm_ = std::make_unique<TerminalManager>(colors_);
-  } else {
-    tm_ = std::make_unique<MockTerminalManager>(100, 100);
-  }
+  return colors_;
 }
 
+TetrisGame::TetrisGame(std::unique_ptr<VirtualTerminalManager> tm)
+    : tm_(std::move(tm)) {}
+
 void TetrisGame::play(int cycles) {
   int cycle{0};
-  srand(time(0)); // Seed random number generator
-  initGame();
+  newGame();
   UserInput uI_;
   times_.clear();
-  start_ = std::chrono::system_clock::now();
   while (!((uI_ = tm_->getUserInput()).isEscape()) && !gameOver_ &&
          (cycles < 0 || cycle < cycles)) {
-    removeTetrominoOld();
-    std::chrono::milliseconds threshold((gameSpeed_ * 16));
-    end_ = std::chrono::system_clock::now();
-    if (end_ - start_ >= threshold) {
+    Clock::time_point lastGravity = start_;
+    if (tick(uI_)) {
       if (cycles > 0) {
         cycle++;
       }
       if (cycles != -1) {
-        times_.emplace_back((end_ - start_) * 1000);
+        times_.emplace_back((end_ - lastGravity) * 1000);
       }
-      start_ = end_;
-      gameFalling();
-    } else {
-      handleInput(uI_);
     }
-    bufferTetromino();
-    writeToScreen();
-    drawScreen();
-    usleep(16'667);
+    clock_->sleepFor(frameDuration);
+  }
+  endGame();
+}
+
+void TetrisGame::newGame() {
+  // Seed random number generator
+  if (!fixedSeed_) {
+    seed_ = std::chrono::system_clock::now().time_since_epoch().count();
+  }
+  seedRandom(seed_);
+  if (!recordDirectory_.empty() && !practice_ && puzzles_.empty()) {
+    try {
+      recorder_ = std::make_unique<ReplayWriter>(
+          recordDirectory_ + "/tetris-" + std::to_string(seed_) + ".replay",
+          ReplayHeader{seed_, level_, keycodeA_, keycodeD_});
+      recordError_.clear();
+    } catch (const std::runtime_error &e) {
+      // Not being recorded is no reason not to play.
+      recordError_ = e.what();
+    }
+  }
+  initGame();
+  frame_ = 0;
+  frameTimes_.clear();
+  simulationTimes_.clear();
+  renderTimes_.clear();
+  inputLatencies_.clear();
+  inputPending_ = false;
+  undo_.clear();
+  undo_.push(snapshot());
+  undoPieces_ = pieces_;
+  start_ = clock_->now();
+}
+
+bool TetrisGame::tick(UserInput uI) {
+  Clock::time_point now = clock_->now();
+  if (frame_ > 0) {
+    frameTimes_.record(micros(now - frameStart_));
+  }
+  frameStart_ = now;
+  // Reading the input refreshes the terminal, so the result of the last
+  // input is visible now.
+  if (inputPending_) {
+    inputLatencies_.record(micros(now - inputTime_));
+    inputPending_ = false;
+  }
+  if (uI.keycode_ == keycodeHud_) {
+    hudOn_ = !hudOn_;
+    drawHud();
+    uI.keycode_ = -1;
+  } else if (practice_ && uI.keycode_ == keycodeUndo_) {
+    undo();
+    uI.keycode_ = -1;
+  } else if (uI.keycode_ >= 0) {
+    inputTime_ = now;
+    inputPending_ = true;
+  }
+  std::chrono::milliseconds threshold((gameSpeed_ * 16));
+  end_ = clock_->now();
+  bool gravity = end_ - start_ >= threshold;
+  if (gravity) {
+    start_ = end_;
+  }
+  if (recorder_) {
+    if (frame_ > 0 && frame_ % keyframeInterval == 0) {
+      recorder_->keyframe(frame_, snapshot());
+    }
+    // Inputs with a negative keycode do nothing, so they are not recorded.
+    if (gravity) {
+      recorder_->gravity(frame_);
+    } else if (uI.keycode_ >= 0) {
+      recorder_->input(frame_, uI.keycode_);
+    }
+  }
+  stepFrame(uI, gravity);
+  if (practice_ && pieces_ != undoPieces_) {
+    undo_.push(snapshot());
+    undoPieces_ = pieces_;
+  }
+  Clock::time_point simulated = clock_->now();
+  simulationTimes_.record(micros(simulated - now));
+  drawScreen();
+  if (broadcaster_) {
+    broadcaster_->publish(broadcastFrame());
+  }
+  if (hudOn_ && frame_ % 30 == 0) {
+    drawHud();
+  }
+  renderTimes_.record(micros(clock_->now() - simulated));
+  frame_++;
+  return gravity;
+}
+
+void TetrisGame::simulateFrame(UserInput uI) {
+  bool gravity = ++gravityFrames_ >= gameSpeed_;
+  if (gravity) {
+    gravityFrames_ = 0;
+  }
+  stepFrame(uI, gravity);
+  frame_++;
+}
+
+void TetrisGame::endGame() {
+  if (recorder_) {
+    recorder_->finish(ReplayResult{frame_, score_, lines_, level_});
+    recorder_.reset();
   }
 }
 
+bool TetrisGame::gameOver() const { return gameOver_; }
+
 void TetrisGame::restartHandler() {
   while (1) {
     tm_->flipDelay(false);
-    if (gameOver_) {
-      tm_->drawString(tm_->numRows() - 31, tm_->numCols() / 2 - 3, 2,
-                      "Game Over!");
-      tm_->drawString(tm_->numRows() - 30, tm_->numCols() / 2 - 7, 2,
-                      ("Score: " + std::to_string(score_)).c_str());
-    }
-    tm_->drawString(tm_->numRows() - 28, tm_->numCols() / 2 - 5, 2,
-                    "Press Space to Play");
-    tm_->drawString(tm_->numRows() - 27, tm_->numCols() / 2 - 5, 2,
-                    "Press ESC to Exit");
+    drawMenu();
     UserInput uI = tm_->getUserInput();
     if (uI.isSpace()) {
-      for (int i = 0; i < tm_->numRows(); ++i) {
-        for (int j = 0; j < tm_->numCols(); ++j) {
-          tm_->drawPixel(i, j, 0);
-        }
-      }
       tm_->flipDelay(true);
-      gameOver_ = false;
-      score_ = 0;
-      lines_ = 0;
-      level_ = startLevel_;
+      resetGame();
       play();
     } else if (uI.isEscape()) {
       return;
@@ -180,9 +245,413 @@ void TetrisGame::restartHandler() {
   }
 }
 
+void TetrisGame::drawMenu() const {
+  Layout l = layout();
+  if (!puzzles_.empty()) {
+    // The outcome of the last puzzle and the goal of the next one
+    size_t next = (puzzle_ + puzzleSolved_) % puzzles_.size();
+    std::string goal = "Puzzle " + std::to_string(next + 1) + " of " +
+                       std::to_string(puzzles_.size()) + ": " +
+                       std::to_string(puzzles_[next].lines) + " lines";
+    if (gameOver_) {
+      tm_->drawString(l.menu, tm_->numCols() / 2 - 3, 2,
+                      puzzleSolved_ ? "Solved!   " : "Not solved");
+    }
+    tm_->drawString(l.menu + l.rowsPerLine, tm_->numCols() / 2 - 7, 2,
+                    goal.c_str());
+  } else if (gameOver_) {
+    tm_->drawString(l.menu, tm_->numCols() / 2 - 3, 2, "Game Over!");
+    tm_->drawString(l.menu + l.rowsPerLine, tm_->numCols() / 2 - 7, 2,
+                    ("Score: " + std::to_string(score_)).c_str());
+  }
+  tm_->drawString(l.menu + 3 * l.rowsPerLine, tm_->numCols() / 2 - 5, 2,
+                  "Press Space to Play");
+  tm_->drawString(l.menu + 4 * l.rowsPerLine, tm_->numCols() / 2 - 5, 2,
+                  "Press ESC to Exit");
+}
+
+void TetrisGame::resetGame() {
+  for (int i = 0; i < tm_->numRows(); ++i) {
+    for (int j = 0; j < tm_->numCols(); ++j) {
+      tm_->drawPixel(i, j, 0);
+    }
+  }
+  if (puzzleSolved_) {
+    puzzle_ = (puzzle_ + 1) % puzzles_.size();
+    puzzleSolved_ = false;
+  }
+  gameOver_ = false;
+  score_ = 0;
+  lines_ = 0;
+  level_ = startLevel_;
+}
+
+void TetrisGame::setClock(std::unique_ptr<Clock> clock) {
+  clock_ = std::move(clock);
+}
+
+void TetrisGame::recordTo(const std::string &directory) {
+  recordDirectory_ = directory;
+}
+
+void TetrisGame::broadcastTo(const std::string &name) {
+  broadcaster_ = std::make_unique<BroadcastPublisher>(name);
+}
+
+void TetrisGame::spectate(BroadcastSubscriber &subscriber) {
+  BroadcastFrame frame;
+  bool synced{false};
+  Layout l = layout();
+  tm_->drawString(l.menu + 3 * l.rowsPerLine, tm_->numCols() / 2 - 5, 2,
+                  "Waiting for the game");
+  while (!tm_->getUserInput().isEscape()) {
+    if (subscriber.update(&frame)) {
+      if (!synced) {
+        resetGame();
+        initScreen();
+        synced = true;
+      }
+      showFrame(frame);
+    }
+    clock_->sleepFor(frameDuration);
+  }
+}
+
+StressResult TetrisGame::stress(int height, int filled, uint64_t pieces) {
+  if (height < StandardBoard::height || filled < 0 || filled >= height) {
+    throw std::runtime_error("Stress mode needs at least 20 rows and fewer "
+                             "filled rows than rows");
+  }
+  if (!fixedSeed_) {
+    seed_ = std::chrono::system_clock::now().time_since_epoch().count();
+  }
+  seedRandom(seed_);
+  SparseBoard<StandardBoard::width> board(height);
+  for (int y = height - filled; y < height; ++y) {
+    int hole = (randomForm() + y) % StandardBoard::width;
+    for (int x = 0; x < StandardBoard::width; ++x) {
+      if (x != hole) {
+        board.settle(x, y, garbageColor);
+      }
+    }
+  }
+  resetGame();
+  initScreen();
+  StressResult result;
+  Layout l = layout();
+  auto start = std::chrono::steady_clock::now();
+  while (pieces == 0 || result.pieces < pieces) {
+    // Try every rotation in every column, keep the one that lands lowest.
+    Tetromino tetromino{static_cast<TetrominoForm>(randomForm())};
+    std::vector<std::pair<int, int>> best;
+    int bestX = 0;
+    int bestY = 0;
+    int bestBottom = -1;
+    int top = board.highestRow();
+    for (int rotation = 0; rotation < 4; ++rotation) {
+      std::vector<std::pair<int, int>> points =
+          tetromino.getRotatedForm(rotation);
+      int minX = 4, maxX = -4, maxY = -4;
+      for (const auto &point : points) {
+        minX = std::min(minX, point.first);
+        maxX = std::max(maxX, point.first);
+        maxY = std::max(maxY, point.second);
+      }
+      for (int x = -minX; x + maxX < StandardBoard::width; ++x) {
+        int y = top - 1 - maxY;
+        while (!board.collides(points, x, y + 1)) {
+          y++;
+        }
+        if (y + maxY > bestBottom) {
+          best = points;
+          bestX = x;
+          bestY = y;
+          bestBottom = y + maxY;
+        }
+      }
+    }
+    bool fits = true;
+    for (const auto &point : best) {
+      fits &= point.second + bestY >= 0;
+    }
+    if (!fits) {
+      break;
+    }
+    for (const auto &point : best) {
+      board.settle(point.first + bestX, point.second + bestY,
+                   static_cast<int>(tetromino.form()) + 3);
+    }
+    result.pieces++;
+    result.maxStoredRows = std::max(result.maxStoredRows, board.numRows());
+    result.lines += board.clearFullLines();
+    lines_ = result.lines;
+    drawBoard(board, std::clamp(board.highestRow() - 4, 0,
+                                height - StandardBoard::height));
+    tm_->drawScore(l.text(l.linesBox, 0), tm_->numCols() - 1, 2, lines_);
+    if (tm_->getUserInput().isEscape()) {
+      break;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+  result.stackRows = height - board.highestRow();
+  return result;
+}
+
+BroadcastFrame TetrisGame::broadcastFrame() const {
+  BroadcastFrame frame;
+  frame.frame = frame_;
+  frame.score = score_;
+  frame.lines = lines_;
+  frame.level = level_;
+  frame.high = high_;
+  frame.next = static_cast<int32_t>(nextTetromino_.form());
+  for (int y = 0; y < StandardBoard::height; ++y) {
+    memcpy(frame.cells[y], screen_.colors(y), StandardBoard::width);
+  }
+  return frame;
+}
+
+void TetrisGame::onSettle(std::function<void(int cleared)> callback) {
+  onSettle_ = std::move(callback);
+}
+
+void TetrisGame::onReplayEvent(std::function<void(uint64_t frame)> callback) {
+  onReplayEvent_ = std::move(callback);
+}
+
+void TetrisGame::exportTrainingTo(TrainingWriter *writer) {
+  trainingWriter_ = writer;
+}
+
+void TetrisGame::addGarbage(int lines, int hole) {
+  if (screen_.insertGarbage(lines, hole, garbageColor)) {
+    gameOver_ = true;
+  }
+}
+
+void TetrisGame::showFrame(const BroadcastFrame &frame) {
+  screen_.clear();
+  for (int y = 0; y < StandardBoard::height; ++y) {
+    for (int x = 0; x < StandardBoard::width; ++x) {
+      screen_.paint(x, y, frame.cells[y][x]);
+    }
+  }
+  score_ = frame.score;
+  lines_ = frame.lines;
+  level_ = frame.level;
+  high_ = frame.high;
+  nextTetromino_ = Tetromino{static_cast<TetrominoForm>(frame.next)};
+  drawNextTetromino();
+  drawScreen();
+}
+
+void TetrisGame::setSeed(uint64_t seed) {
+  seed_ = seed;
+  fixedSeed_ = true;
+}
+
+ReplayResult TetrisGame::replay(ReplayReader &reader, bool live) {
+  reader.rewind();
+  startReplay(reader.header());
+  return continueReplay(reader, live);
+}
+
+void TetrisGame::seek(ReplayReader &reader, uint64_t frame) {
+  startReplay(reader.header());
+  GameState keyframe;
+  uint64_t keyframeFrame;
+  if (reader.seekKeyframe(frame, &keyframe, &keyframeFrame)) {
+    restore(keyframe);
+    frame_ = keyframeFrame;
+    // The last gravity tick before the keyframe is not known.
+    replayGravity_ = keyframeFrame;
+  }
+  // Re-simulate the remaining events before the frame.
+  uint64_t eventFrame;
+  uint32_t code;
+  while (!gameOver_ && reader.peek(&eventFrame, &code) && eventFrame < frame) {
+    reader.next(&eventFrame, &code);
+    replayEvent(eventFrame, code);
+  }
+  frame_ = frame;
+}
+
+ReplayResult TetrisGame::continueReplay(ReplayReader &reader, bool live) {
+  uint64_t eventFrame;
+  uint32_t code;
+  bool ended{false};
+  while (!gameOver_ && !(ended = !reader.next(&eventFrame, &code))) {
+    if (live) {
+      // Idle frames change nothing, they only have to be waited for.
+      for (; frame_ < eventFrame; ++frame_) {
+        if (tm_->getUserInput().isEscape()) {
+          return ReplayResult{frame_, score_, lines_, level_};
+        }
+        drawScreen();
+        clock_->sleepFor(frameDuration);
+      }
+    }
+    frame_ = eventFrame;
+    replayEvent(frame_, code);
+    if (onReplayEvent_) {
+      onReplayEvent_(frame_);
+    }
+    if (live) {
+      drawScreen();
+      clock_->sleepFor(frameDuration);
+    }
+    frame_++;
+  }
+  // Events after a game over are ignored, but the claimed result is read.
+  while (!ended && reader.next(&eventFrame, &code)) {
+  }
+  // Gravity also has to tick in the idle frames before the end.
+  if (!gameOver_ && reader.result().frames > 0) {
+    checkReplayGravity(reader.result().frames - 1, false);
+  }
+  return ReplayResult{reader.result().frames, score_, lines_, level_};
+}
+
+GameState TetrisGame::snapshot() const {
+  GameState state;
+  state.rngState = rngState_;
+  for (int i = 0; i < StandardBoard::height; ++i) {
+    for (int j = 0; j < StandardBoard::width; ++j) {
+      if (!screen_.settled(j, i)) {
+        continue;
+      }
+      uint32_t cell = 7;
+      if (screen_.color(j, i) == garbageColor) {
+        state.garbageRows |= 1u << i;
+      } else {
+        cell = screen_.color(j, i) - 2;
+      }
+      assert(cell >= 1 && cell <= 7);
+      state.rows[i] |= cell << (3 * j);
+    }
+  }
+  state.score = score_;
+  state.lines = lines_;
+  state.level = level_;
+  state.current = static_cast<int>(currentTetromino_.form());
+  state.next = static_cast<int>(nextTetromino_.form());
+  state.rotation = currentTetromino_.rotation();
+  state.positionX = positionTetromino_.first;
+  state.positionY = positionTetromino_.second;
+  state.iIsUp = iIsUp;
+  state.gravityFrames = gravityFrames_;
+  state.gameOver = gameOver_;
+  return state;
+}
+
+void TetrisGame::restore(const GameState &state) {
+  rngState_ = state.rngState;
+  screen_.clear();
+  for (int i = 0; i < StandardBoard::height; ++i) {
+    for (int j = 0; j < StandardBoard::width; ++j) {
+      int cell = (state.rows[i] >> (3 * j)) & 7;
+      if (cell == 0) {
+        continue;
+      }
+      bool garbage = (state.garbageRows >> i & 1) != 0;
+      screen_.settle(j, i, garbage ? garbageColor : cell + 2);
+    }
+  }
+  score_ = state.score;
+  lines_ = state.lines;
+  level_ = state.level;
+  calculateGameSpeed();
+  currentTetromino_ = Tetromino{static_cast<TetrominoForm>(state.current)};
+  for (int i = 0; i < state.rotation; ++i) {
+    currentTetromino_.rotateCW(false);
+  }
+  nextTetromino_ = Tetromino{static_cast<TetrominoForm>(state.next)};
+  positionTetromino_ = std::make_pair(state.positionX, state.positionY);
+  iIsUp = state.iIsUp;
+  gravityFrames_ = state.gravityFrames;
+  gameOver_ = state.gameOver;
+  drawNextTetromino();
+  bufferTetromino();
+  writeToScreen();
+}
+
+void TetrisGame::setPractice(bool practice) { practice_ = practice; }
+
+void TetrisGame::setPuzzles(std::vector<Puzzle> puzzles) {
+  puzzles_ = std::move(puzzles);
+  puzzle_ = 0;
+  puzzleSolved_ = false;
+}
+
+TetrominoForm TetrisGame::puzzleForm(uint64_t piece) const {
+  const Puzzle &puzzle = puzzles_[puzzle_];
+  return piece < puzzle.numPieces
+             ? static_cast<TetrominoForm>(puzzle.pieces[piece])
+             : TetrominoForm::N;
+}
+
 // Private
 
+void TetrisGame::undo() {
+  // The newest state is the spawn of the current Tetromino.
+  if (undo_.size() < 2) {
+    return;
+  }
+  undo_.pop();
+  restore(undo_.top());
+}
+
+void TetrisGame::startReplay(const ReplayHeader &header) {
+  seed_ = header.seed;
+  seedRandom(seed_);
+  level_ = header.level;
+  keycodeA_ = header.keycodeA;
+  keycodeD_ = header.keycodeD;
+  score_ = 0;
+  lines_ = 0;
+  gameOver_ = false;
+  initGame();
+  frame_ = 0;
+  replayGravity_ = 0;
+}
+
+void TetrisGame::replayEvent(uint64_t frame, uint32_t code) {
+  checkReplayGravity(frame, code == REPLAY_GRAVITY);
+  UserInput uI;
+  uI.keycode_ = code == REPLAY_GRAVITY ? -1 : code - REPLAY_INPUT;
+  stepFrame(uI, code == REPLAY_GRAVITY);
+}
+
+void TetrisGame::checkReplayGravity(uint64_t frame, bool gravity) {
+  // play() ticks gravity once gameSpeed_ * 16 ms passed and every frame
+  // sleeps for frameDuration, so the next tick is gameSpeed_ frames after
+  // the last one at the latest. A replay without it gave the player more
+  // time than the rules allow.
+  uint64_t due = replayGravity_ + gameSpeed_;
+  if (gravity ? frame > due : frame >= due) {
+    throw std::runtime_error("Replay skips the gravity tick of frame " +
+                             std::to_string(due));
+  }
+  if (gravity) {
+    replayGravity_ = frame;
+  }
+}
+
+void TetrisGame::stepFrame(UserInput uI, bool gravity) {
+  removeTetrominoOld();
+  if (gravity) {
+    gameFalling();
+  } else {
+    handleInput(uI);
+  }
+  bufferTetromino();
+  writeToScreen();
+}
+
 void TetrisGame::gameFalling() {
+  TRACE_SCOPE(TRACE_TICK);
   if (!checkCollisionDown()) {
     positionTetromino_.second++;
   } else {
@@ -242,28 +711,21 @@ void TetrisGame::handleInput(UserInput uI) {
 }
 
 bool TetrisGame::checkCollisionRotateICW() const {
+  // The rotated I may neither touch the left wall nor the floor.
+  bool collision = false;
   if (iIsUp) {
     for (int i = 0; i < 4; ++i) {
-      if (screen_[positionTetromino_.second]
-                  .row_[i - 2 + positionTetromino_.first]
-                  .second == 69 ||
-          i - 2 + positionTetromino_.first > 9 ||
-          i - 2 + positionTetromino_.first < 1) {
-        return true;
-      }
+      int x = i - 2 + positionTetromino_.first;
+      collision |= screen_.blocked(x, positionTetromino_.second) | (x < 1);
     }
-    return false;
   } else {
     for (int i = 0; i < 4; ++i) {
-      if (screen_[i - 2 + positionTetromino_.second]
-                  .row_[positionTetromino_.first]
-                  .second == 69 ||
-          i - 2 + positionTetromino_.second > 18) {
-        return true;
-      }
+      int y = i - 2 + positionTetromino_.second;
+      collision |= screen_.blocked(positionTetromino_.first, y) |
+                   (y > StandardBoard::height - 2);
     }
-    return false;
   }
+  return collision;
 }
 
 bool TetrisGame::checkCollisionRotateCW(bool CW) { // Theoretically modifies
@@ -271,12 +733,10 @@ bool TetrisGame::checkCollisionRotateCW(bool CW) { // Theoretically modifies
                                                    // technically doesn't.
   currentTetromino_.rotateCW(CW);
   bufferTetromino();
-  bool ret_{false};
+  // The rotated Tetromino may not touch the floor.
+  bool ret_{screen_.collides(points_)};
   for (const auto &point : points_) {
-    if (screen_[point.second].row_[point.first].second == 69 ||
-        point.first < 0 || point.first > 9 || point.second > 18) {
-      ret_ = true;
-    }
+    ret_ |= point.second > StandardBoard::height - 2;
   }
   currentTetromino_.rotateCW(!CW);
   bufferTetromino();
@@ -284,41 +744,52 @@ bool TetrisGame::checkCollisionRotateCW(bool CW) { // Theoretically modifies
 }
 
 bool TetrisGame::checkCollisionLeft() const {
-  for (const auto &point : points_) {
-    // Returns true if any point goes out of bounds.
-    if (point.first < 1) {
-      return true;
-    }
-    if (screen_[point.second].row_[point.first - 1].second == 69) {
-      return true;
-    }
-  }
-  return false;
+  return screen_.collides(points_, -1, 0);
 }
 
 bool TetrisGame::checkCollisionRight() const {
-  for (const auto &point : points_) {
-    // Returns true if any point goes out of bounds.
-    if (point.first > 8) {
-      return true;
-    }
-    if (screen_[point.second].row_[point.first + 1].second == 69) {
-      return true;
-    }
-  }
-  return false;
+  return screen_.collides(points_, 1, 0);
 }
 
 bool TetrisGame::checkCollisionDown() const {
-  for (const auto &point : points_) {
-    // Returns true if any point goes out of bounds.
-    // Retrurns True if any point hits another that is already onscreen.
-    if (screen_[point.second + 1].row_[point.first].second == 69 ||
-        point.second > 18) {
-      return true;
+  return screen_.collides(points_, 0, 1);
+}
+
+void TetrisGame::seedRandom(uint64_t seed) {
+  rngState_ = seed ^ 0x9E3779B97F4A7C15ULL;
+  if (rngState_ == 0) {
+    rngState_ = 1;
+  }
+}
+
+// xorshift64* on the given state
+static int randomFormOf(uint64_t *rngState) {
+  *rngState ^= *rngState >> 12;
+  *rngState ^= *rngState << 25;
+  *rngState ^= *rngState >> 27;
+  return ((*rngState * 0x2545F4914F6CDD1DULL) >> 32) % 7;
+}
+
+int TetrisGame::randomForm() { return randomFormOf(&rngState_); }
+
+std::vector<TetrominoForm>
+TetrisGame::upcomingTetrominos(const GameState &state, size_t count) {
+  std::vector<TetrominoForm> forms;
+  uint64_t rngState = state.rngState;
+  int next = state.next;
+  if (count > 0) {
+    forms.push_back(static_cast<TetrominoForm>(state.current));
+  }
+  while (forms.size() < count) {
+    forms.push_back(static_cast<TetrominoForm>(next));
+    // Like generateNextTetromino()
+    int current = next;
+    next = randomFormOf(&rngState);
+    if (next == current) {
+      next = randomFormOf(&rngState);
     }
   }
-  return false;
+  return forms;
 }
 
 void TetrisGame::calculateGameSpeed() {
@@ -359,7 +830,7 @@ void TetrisGame::calculateGameSpeed() {
 
 void TetrisGame::removeTetrominoOld() {
   for (const auto &point : points_) {
-    screen_[point.second].row_[point.first] = std::make_pair(0, 0);
+    screen_.erase(point.first, point.second);
   }
 }
 
@@ -375,7 +846,8 @@ void TetrisGame::bufferTetromino() {
           point = currentTetromino_.getRotation(point);
         }
       }
-      if (points_.size() != 4) {
+      // N, after the last Tetromino of a puzzle, has no blocks.
+      if (points_.size() != 4 && currentTetromino_.form() != TetrominoForm::N) {
         throw std::runtime_error("Buffering Tetromino went wrong");
       }
     }
@@ -385,45 +857,73 @@ void TetrisGame::bufferTetromino() {
   for (auto &point : points_) {
     point.first += positionTetromino_.first;
     point.second += positionTetromino_.second;
-    if (screen_[point.second].row_[point.first].second == 69) {
+    if (screen_.settled(point.first, point.second)) {
       gameOver_ = true;
     }
   }
 }
 
 void TetrisGame::settleTetromino() {
+  TRACE_SCOPE(TRACE_SETTLE);
+  // The board before the Tetromino settles and where it settles
+  TrainingRecord record{};
+  int scoreBefore = score_;
+  if (trainingWriter_) {
+    for (int y = 0; y < StandardBoard::height; ++y) {
+      record.board[y] = screen_.row(y);
+    }
+    record.current = static_cast<int>(currentTetromino_.form());
+    record.next = static_cast<int>(nextTetromino_.form());
+    record.rotation = currentTetromino_.form() == TetrominoForm::I
+                          ? !iIsUp
+                          : static_cast<int>(currentTetromino_.rotation());
+    record.positionX = positionTetromino_.first;
+    record.positionY = positionTetromino_.second;
+    record.level = level_;
+    record.piece = pieces_;
+  }
   for (const auto &point : points_) {
-    screen_[point.second].row_[point.first] =
-        std::make_pair(static_cast<int>(currentTetromino_.form()) + 3, 69);
+    screen_.settle(point.first, point.second,
+                   static_cast<int>(currentTetromino_.form()) + 3);
   }
-  checkLineFull();
-  for (const auto &line : linesToErase_) {
+  int cleared = screen_.clearFullLines();
+  for (int i = 0; i < cleared; ++i) {
     lines_++;
     if (lines_ % 10 == 0) {
       level_++;
       calculateGameSpeed();
     }
-    if (line.second) {
-      screen_[line.first].clear();
-    }
-    for (int j = line.first; j > -1; --j) {
-      if (j != 0) {
-        screen_[j].getUpper(screen_[j - 1]);
-      } else {
-        screen_[0].clear();
-      }
-    }
   }
-  lineScore(linesToErase_.size());
+  lineScore(cleared);
+  if (!puzzles_.empty() && lines_ >= puzzles_[puzzle_].lines) {
+    puzzleSolved_ = true;
+    gameOver_ = true;
+  }
+  if (trainingWriter_) {
+    record.cleared = cleared;
+    record.reward = score_ - scoreBefore;
+    trainingWriter_->append(record);
+  }
+  if (onSettle_) {
+    onSettle_(cleared);
+  }
   drawScreen();
 }
 
 void TetrisGame::generateNextTetromino() {
+  pieces_++;
   // Calculating next Tetromino
   currentTetromino_ = nextTetromino_;
-  nextTetromino_ = Tetromino{static_cast<TetrominoForm>(rand() % 7)};
-  if (nextTetromino_.form() == currentTetromino_.form()) {
-    nextTetromino_ = Tetromino{static_cast<TetrominoForm>(rand() % 7)};
+  if (!puzzles_.empty()) {
+    nextTetromino_ = Tetromino{puzzleForm(pieces_)};
+    if (currentTetromino_.form() == TetrominoForm::N) {
+      gameOver_ = true;
+    }
+  } else {
+    nextTetromino_ = Tetromino{static_cast<TetrominoForm>(randomForm())};
+    if (nextTetromino_.form() == currentTetromino_.form()) {
+      nextTetromino_ = Tetromino{static_cast<TetrominoForm>(randomForm())};
+    }
   }
   if (currentTetromino_.form() == TetrominoForm::I) {
     positionTetromino_ = std::make_pair(5, 2);
@@ -431,12 +931,17 @@ void TetrisGame::generateNextTetromino() {
   } else {
     positionTetromino_ = std::make_pair(5, 1);
   }
+  drawNextTetromino();
+}
+
+void TetrisGame::drawNextTetromino() {
+  Layout l = layout();
   // Clearing NEXT screen
-  for (int i = tm_->numRows() - 18; i < tm_->numRows() - 11; ++i) {
+  for (int i = l.nextArea; i < l.nextArea + l.nextAreaRows; ++i) {
     for (int j = tm_->numCols() / 2 + 8; j < tm_->numCols() / 2 + 14; ++j) {
       tm_->drawPixel(i, j, 0);
     }
-    tm_->drawString(tm_->numRows() - 18, tm_->numCols() / 2 + 10, 2, "NEXT");
+    tm_->drawString(l.text(l.nextBox, 0), tm_->numCols() / 2 + 10, 2, "NEXT");
   }
   // Placing next Tetromino into NEXT screen
   std::vector<std::pair<int, int>> nextTetromino =
@@ -448,7 +953,7 @@ void TetrisGame::generateNextTetromino() {
     }
   }
   for (const auto &point : nextTetromino) {
-    tm_->drawPixel(point.second + tm_->numRows() - 15,
+    tm_->drawPixel(point.second + l.nextArea + (l.nextAreaRows - 2) / 2,
                    nextTetromino_.form() == TetrominoForm::J
                        ? point.first + tm_->numCols() / 2 + 11
                        : point.first + tm_->numCols() / 2 + 10,
@@ -456,15 +961,6 @@ void TetrisGame::generateNextTetromino() {
   }
 }
 
-void TetrisGame::checkLineFull() {
-  linesToErase_.clear();
-  for (const auto &row : screen_) {
-    if (row.isFull()) {
-      linesToErase_.emplace_back(std::make_pair(row.num_, true));
-    }
-  }
-}
-
 void TetrisGame::lineScore(int lines) {
   switch (lines) {
   case 0:
@@ -494,38 +990,72 @@ int TetrisGame::calculateLengthOfScore(int number) const {
 
 void TetrisGame::writeToScreen() {
   for (const auto &point : points_) {
-    screen_[point.second].row_[point.first] =
-        std::make_pair(static_cast<int>(currentTetromino_.form()) + 3, 1);
+    screen_.paint(point.first, point.second,
+                  static_cast<int>(currentTetromino_.form()) + 3);
   }
 }
 
 void TetrisGame::drawScreen() {
-  for (const auto &row : screen_) {
-    for (int i = 0; i < 10; ++i) {
-      tm_->drawPixel(row.num_ + tm_->numRows() - 23, i + tm_->numCols() / 2 - 5,
-                     row.row_[i].first);
-    }
-  }
+  TRACE_SCOPE(TRACE_DRAW_SCREEN);
+  drawBoard(screen_, 0);
   if (score_ > high_) {
     high_ = score_;
   }
-  tm_->drawScore(tm_->numRows() - 24,
+  Layout l = layout();
+  tm_->drawScore(l.text(l.scoreBox, 1),
                  tm_->numCols() + 27 - calculateLengthOfScore(high_), 2, high_);
-  tm_->drawScore(tm_->numRows() - 22,
+  tm_->drawScore(l.text(l.scoreBox, 3),
                  tm_->numCols() + 27 - calculateLengthOfScore(score_), 2,
                  score_);
-  tm_->drawScore(tm_->numRows() - 7,
+  tm_->drawScore(l.text(l.levelBox, 1),
                  tm_->numCols() + 27 - calculateLengthOfScore(level_), 2,
                  level_);
-  tm_->drawScore(tm_->numRows() - 25, tm_->numCols() - 1, 2, lines_);
+  tm_->drawScore(l.text(l.linesBox, 0), tm_->numCols() - 1, 2, lines_);
+}
+
+void TetrisGame::drawHud() const {
+  const std::pair<const char *, const Histogram *> stats[] = {
+      {"frame", &frameTimes_},
+      {"sim", &simulationTimes_},
+      {"draw", &renderTimes_},
+      {"input", &inputLatencies_}};
+  int row = layout().hud;
+  int col = tm_->numCols() / 2 - 19;
+  char line[32];
+  // Every line is 23 characters long, so blanks overwrite it completely.
+  const char *blank = "                       ";
+  tm_->drawString(row, col, 2, hudOn_ ? "ms      p50   p99   max" : blank);
+  for (const auto &[name, histogram] : stats) {
+    row += tm_->rowsPerLine();
+    snprintf(line, sizeof(line), "%-5s %5.1f %5.1f %5.1f", name,
+             histogram->percentile(50) / 1000.0,
+             histogram->percentile(99) / 1000.0, histogram->max() / 1000.0);
+    tm_->drawString(row, col, 2, hudOn_ ? line : blank);
+  }
+  // Frames the terminal could not take in time
+  row += tm_->rowsPerLine();
+  snprintf(line, sizeof(line), "%-5s %17lu", "drop", tm_->droppedFrames());
+  tm_->drawString(row, col, 2, hudOn_ ? line : blank);
 }
 
 void TetrisGame::initGame() {
-  nextTetromino_ = Tetromino{static_cast<TetrominoForm>(rand() % 7)};
-  for (int i = 0; i < 20; ++i) {
-    for (int j = 0; j < 10; ++j) {
-      screen_[i].row_[j] = std::make_pair(0, 0);
+  pieces_ = 0;
+  gravityFrames_ = 0;
+  screen_.clear();
+  if (puzzles_.empty()) {
+    nextTetromino_ = Tetromino{static_cast<TetrominoForm>(randomForm())};
+  } else {
+    // The blocks of the puzzle in the colors of Tetrominos, so snapshots
+    // can hold them
+    const Puzzle &puzzle = puzzles_[puzzle_];
+    for (int y = 0; y < StandardBoard::height; ++y) {
+      for (int x = 0; x < StandardBoard::width; ++x) {
+        if ((puzzle.rows[y] >> x & 1) != 0) {
+          screen_.settle(x, y, 3 + y % 7);
+        }
+      }
     }
+    nextTetromino_ = Tetromino{puzzleForm(0)};
   }
   calculateGameSpeed();
   initScreen();
@@ -535,59 +1065,76 @@ void TetrisGame::initGame() {
   drawScreen();
 }
 
+TetrisGame::Layout TetrisGame::layout() const {
+  int rows = tm_->numRows();
+  if (tm_->rowsPerLine() == 2) {
+    // Top borders in the lower half of a line and bottom borders in the
+    // upper half, so text gets lines of its own.
+    return Layout{rows - 38, rows - 28, rows - 27, rows - 24, rows - 27,
+                  rows - 17, rows - 9,  rows - 14, 4,         2};
+  }
+  return Layout{rows - 31, rows - 26, rows - 26, rows - 24, rows - 26,
+                rows - 19, rows - 9,  rows - 17, 6,         1};
+}
+
 void TetrisGame::initScreen() const {
+  Layout l = layout();
+  int center = tm_->numCols() / 2;
   // Draw playscreen
-  for (int i = tm_->numRows() - 24; i < tm_->numRows() - 2; ++i) {
-    tm_->drawPixel(i, tm_->numCols() / 2 - 6, 1);
-    tm_->drawPixel(i, tm_->numCols() / 2 + 5, 1);
+  for (int i = l.playScreen; i < l.playScreen + 22; ++i) {
+    tm_->drawPixel(i, center - 6, 1);
+    tm_->drawPixel(i, center + 5, 1);
   }
-  for (int j = tm_->numCols() / 2 - 5; j < tm_->numCols() / 2 + 5; ++j) {
-    tm_->drawPixel(tm_->numRows() - 24, j, 1);
-    tm_->drawPixel(tm_->numRows() - 3, j, 1);
+  for (int j = center - 5; j < center + 5; ++j) {
+    tm_->drawPixel(l.playScreen, j, 1);
+    tm_->drawPixel(l.playScreen + 21, j, 1);
   }
   // Draw linebar
-  for (int i = tm_->numRows() - 26; i < tm_->numRows() - 24; ++i) {
-    tm_->drawPixel(i, tm_->numCols() / 2 - 6, 1);
-    tm_->drawPixel(i, tm_->numCols() / 2 + 5, 1);
+  for (int i = l.linesBox; i < l.playScreen; ++i) {
+    tm_->drawPixel(i, center - 6, 1);
+    tm_->drawPixel(i, center + 5, 1);
   }
-  for (int j = tm_->numCols() / 2 - 5; j < tm_->numCols() / 2 + 5; ++j) {
-    tm_->drawPixel(tm_->numRows() - 26, j, 1);
+  for (int j = center - 5; j < center + 5; ++j) {
+    tm_->drawPixel(l.linesBox, j, 1);
   }
-  tm_->drawString(tm_->numRows() - 25, tm_->numCols() / 2 - 4, 2, "LINES-");
+  tm_->drawString(l.text(l.linesBox, 0), center - 4, 2, "LINES-");
   // Draw scorescreen
-  for (int i = tm_->numRows() - 26; i < tm_->numRows() - 20; ++i) {
-    tm_->drawPixel(i, tm_->numCols() / 2 + 7, 1);
-    tm_->drawPixel(i, tm_->numCols() / 2 + 14, 1);
+  int bottom = l.text(l.scoreBox, 4);
+  for (int i = l.scoreBox; i <= bottom; ++i) {
+    tm_->drawPixel(i, center + 7, 1);
+    tm_->drawPixel(i, center + 14, 1);
   }
-  for (int j = tm_->numCols() / 2 + 7; j < tm_->numCols() / 2 + 15; ++j) {
-    tm_->drawPixel(tm_->numRows() - 26, j, 1);
-    tm_->drawPixel(tm_->numRows() - 21, j, 1);
+  for (int j = center + 7; j < center + 15; ++j) {
+    tm_->drawPixel(l.scoreBox, j, 1);
+    tm_->drawPixel(bottom, j, 1);
   }
-  tm_->drawString(tm_->numRows() - 25, tm_->numCols() / 2 + 8, 2, "TOP");
-  tm_->drawString(tm_->numRows() - 23, tm_->numCols() / 2 + 8, 2, "SCORE");
+  tm_->drawString(l.text(l.scoreBox, 0), center + 8, 2, "TOP");
+  tm_->drawString(l.text(l.scoreBox, 2), center + 8, 2, "SCORE");
   // Draw nextscreen
-  for (int i = tm_->numRows() - 19; i < tm_->numRows() - 10; ++i) {
-    tm_->drawPixel(i, tm_->numCols() / 2 + 7, 1);
-    tm_->drawPixel(i, tm_->numCols() / 2 + 14, 1);
+  bottom = l.nextArea + l.nextAreaRows;
+  for (int i = l.nextBox; i <= bottom; ++i) {
+    tm_->drawPixel(i, center + 7, 1);
+    tm_->drawPixel(i, center + 14, 1);
   }
-  for (int j = tm_->numCols() / 2 + 7; j < tm_->numCols() / 2 + 15; ++j) {
-    tm_->drawPixel(tm_->numRows() - 19, j, 1);
-    tm_->drawPixel(tm_->numRows() - 11, j, 1);
+  for (int j = center + 7; j < center + 15; ++j) {
+    tm_->drawPixel(l.nextBox, j, 1);
+    tm_->drawPixel(bottom, j, 1);
   }
-  for (int i = tm_->numRows() - 18; i < tm_->numRows() - 11; ++i) {
-    for (int j = tm_->numCols() / 2 + 8; j < tm_->numCols() / 2 + 14; ++j) {
+  for (int i = l.nextArea; i < bottom; ++i) {
+    for (int j = center + 8; j < center + 14; ++j) {
       tm_->drawPixel(i, j, 0);
     }
   }
-  tm_->drawString(tm_->numRows() - 18, tm_->numCols() / 2 + 10, 2, "NEXT");
+  tm_->drawString(l.text(l.nextBox, 0), center + 10, 2, "NEXT");
   // Draw level
-  for (int i = tm_->numRows() - 9; i < tm_->numRows() - 5; ++i) {
-    tm_->drawPixel(i, tm_->numCols() / 2 + 7, 1);
-    tm_->drawPixel(i, tm_->numCols() / 2 + 14, 1);
+  bottom = l.text(l.levelBox, 2);
+  for (int i = l.levelBox; i <= bottom; ++i) {
+    tm_->drawPixel(i, center + 7, 1);
+    tm_->drawPixel(i, center + 14, 1);
   }
-  for (int j = tm_->numCols() / 2 + 7; j < tm_->numCols() / 2 + 15; ++j) {
-    tm_->drawPixel(tm_->numRows() - 9, j, 1);
-    tm_->drawPixel(tm_->numRows() - 6, j, 1);
+  for (int j = center + 7; j < center + 15; ++j) {
+    tm_->drawPixel(l.levelBox, j, 1);
+    tm_->drawPixel(bottom, j, 1);
   }
-  tm_->drawString(tm_->numRows() - 8, tm_->numCols() / 2 + 8, 2, "LEVEL");
+  tm_->drawString(l.text(l.levelBox, 0), center + 8, 2, "LEVEL");
 }
@@ -2,64 +2,204 @@
 
 #pragma once
 
+#include "./Board.h"
+#include "./Broadcast.h"
+#include "./Clock.h"
+#include "./HeadlessTerminalManager.h"
+#include "./Histogram.h"
+#include "./MappedFile.h"
 #include "./MockTerminalManager.h"
+#include "./Puzzle.h"
+#include "./Replay.h"
 #include "./TerminalManager.h"
 #include "./Tetromino.h"
+#include "./TrainingData.h"
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <ctime>
+#include <functional>
 #include <gtest/gtest.h>
+#include <memory>
 #include <string>
 #include <unistd.h>
 #include <vector>
 
-// Declaration of Row class
-
-// Rows do only save settled blocks, not falling Tetrominos
+// Declaration of TetrisGame class
 
-extern int ID;
+// Outcome of TetrisGame::stress()
+struct StressResult {
+  uint64_t pieces{0};
+  int lines{0};
+  // Rows of the stack at the end and the most rows stored at once
+  int stackRows{0};
+  size_t maxStoredRows{0};
+  double seconds{0};
+};
 
-class Row {
+class TetrisGame {
 public:
-  // Constructor of a Row
-  Row();
+  // With `halfBlocks` the terminal shows two rows of blocks per line, see
+  // TerminalManager.
+  TetrisGame(int argc, char **argv, bool mock = false,
+             bool halfBlocks = false);
 
-  // Rows will not be destructed manually so no need for destructor or something
+  // Constructor for a game on an already created terminal manager, e.g. a
+  // HeadlessTerminalManager for simulations.
+  explicit TetrisGame(std::unique_ptr<VirtualTerminalManager> tm);
 
-  // Empty the Row
-  void clear();
+  void play(int cycles = -1);
 
-  // Get the upper row (for when the row drops down)
-  void getUpper(const Row &row);
+  void restartHandler();
 
-  // Check if the row is full
-  bool isFull() const;
+  // The steps of play() for callers that run their own loop, e.g. a server
+  // hosting many games: start a game, simulate and draw one frame without
+  // waiting (returns if it had a gravity tick) and finish the recording.
+  void newGame();
+  bool tick(UserInput uI);
+  void endGame();
+
+  // Simulate one frame like tick(), but with gravity counted in frames
+  // instead of measured on the clock. The same snapshot and inputs always
+  // give the same game, e.g. for re-simulating frames in rollback netcode.
+  // Draws nothing.
+  void simulateFrame(UserInput uI);
+
+  // Is the current game over?
+  bool gameOver() const;
+
+  // Number of Tetrominos spawned in the current game
+  uint64_t pieces() const { return pieces_; }
+
+  // Draws the game over message and how to start a new game or exit
+  void drawMenu() const;
+
+  // Clears the terminal and resets score, lines and level for a new game
+  void resetGame();
+
+  // Record every following game to a new replay file in the given directory.
+  // If a replay file can not be created, the game is played without
+  // recording and recordError() tells why.
+  void recordTo(const std::string &directory);
+
+  // Why the last game could not be recorded, empty if it could.
+  const std::string &recordError() const { return recordError_; }
+
+  // Broadcast every frame of the following games to spectators through the
+  // shared memory with the given name.
+  void broadcastTo(const std::string &name);
+
+  // Watch a broadcast and draw it at real speed until ESC is pressed.
+  void spectate(BroadcastSubscriber &subscriber);
+
+  // Stress mode for tall boards: the bottom `filled` rows of a SparseBoard
+  // with `height` rows are filled with garbage, then Tetrominos are dropped
+  // where they land lowest as fast as possible. Only the 20 rows at the top
+  // of the stack are drawn. Ends when the stack reaches the top, after
+  // `pieces` Tetrominos (0 for no limit) or when ESC is pressed.
+  StressResult stress(int height, int filled, uint64_t pieces = 0);
+
+  // What spectators see of the current frame
+  BroadcastFrame broadcastFrame() const;
+
+  // Call the callback with the number of cleared lines whenever a Tetromino
+  // settles, before the next one spawns. Versus mode exchanges garbage here.
+  void onSettle(std::function<void(int cleared)> callback);
+
+  // Call the callback with the frame number after every event of a replay,
+  // when the frame may have changed. Exporters render replays here.
+  void onReplayEvent(std::function<void(uint64_t frame)> callback);
+
+  // Append a TrainingRecord to the writer whenever a Tetromino settles, from
+  // the thread of the game. nullptr stops. The writer is not owned.
+  void exportTrainingTo(TrainingWriter *writer);
+
+  // Push the settled blocks up by garbage lines with a hole in the given
+  // column. The game is over if blocks are pushed off the top.
+  void addGarbage(int lines, int hole);
+
+  // Use a fixed seed for the following games instead of the current time.
+  void setSeed(uint64_t seed);
+
+  // Re-simulate a replay with the same rules as play(). If live, every frame
+  // is drawn at real speed and ESC aborts. Otherwise nothing is waited for
+  // and the replay runs as fast as possible.
+  // Returns the simulated frames, score, lines and level.
+  ReplayResult replay(ReplayReader &reader, bool live = false);
+
+  // Bring the game to the state at the start of the given frame of a replay:
+  // restores the nearest keyframe before it from the index and re-simulates
+  // only the events in between. continueReplay() can play on from there.
+  void seek(ReplayReader &reader, uint64_t frame);
+
+  // Play the rest of a replay from the current position of the reader.
+  ReplayResult continueReplay(ReplayReader &reader, bool live = false);
+
+  // The full game state at the start of the current frame. Cheap enough to
+  // fork games millions of times per second for search.
+  GameState snapshot() const;
+
+  // Continue from a snapshot, also redraws the NEXT screen.
+  void restore(const GameState &state);
+
+  // The forms of the next `count` Tetrominos of a snapshot, starting with its
+  // current and next one. The rest follows from the random number generator
+  // in the snapshot, so solvers and puzzles know the pieces to come.
+  static std::vector<TetrominoForm> upcomingTetrominos(const GameState &state,
+                                                       size_t count);
+
+  // Practice mode: U takes back the last placed Tetromino. Practice games
+  // are not recorded.
+  void setPractice(bool practice);
+
+  // Puzzle mode: every game starts with the blocks and Tetrominos of the
+  // current puzzle and ends when its lines are cleared or its Tetrominos are
+  // used up. A solved puzzle moves on to the next one. Puzzles are not
+  // recorded.
+  void setPuzzles(std::vector<Puzzle> puzzles);
 
-  // Number (ID) of the row.
-  int num_;
+  // Frames between two keyframes in recorded replays (one minute).
+  static constexpr uint64_t keyframeInterval = 3600;
 
-  // Array holding 10 cells of a pair of Color and a bool if the cell is to be
-  // collided with.
-  std::pair<int, int> row_[10];
-};
+  Clock::time_point start_;
+  Clock::time_point end_;
+  std::vector<std::chrono::duration<float>> times_;
 
-// Declaration of TetrisGame class
+  // Use the given clock for timing and waiting. Default is a RealClock.
+  void setClock(std::unique_ptr<Clock> clock);
 
-class TetrisGame {
-public:
-  TetrisGame(int argc, char **argv, bool mock = false);
+  // Time of one frame (60 frames per second).
+  static constexpr std::chrono::microseconds frameDuration{16'667};
 
-  void play(int cycles = -1);
+  // Color of garbage lines in versus mode, the color of the border
+  static constexpr int garbageColor = 1;
 
-  void restartHandler();
-
-  std::chrono::system_clock::time_point start_;
-  std::chrono::system_clock::time_point end_;
-  std::vector<std::chrono::duration<float>> times_;
+  // Foreground and background of the colors the game draws with
+  static std::vector<std::pair<Color, Color>> colors();
 
 protected:
+  // Start a game with the seed, level and keycodes of a replay header.
+  void startReplay(const ReplayHeader &header);
+
+  // Simulate the frame of a replay event.
+  void replayEvent(uint64_t frame, uint32_t code);
+
+  // Throws if gravity of a replay did not tick in time up to the frame, in
+  // which it ticks or not.
+  void checkReplayGravity(uint64_t frame, bool gravity);
+
+  // Draw a broadcast frame instead of the own game.
+  void showFrame(const BroadcastFrame &frame);
+
+  // Restores the state at the spawn of the previous Tetromino
+  void undo();
+
+  // Simulates one frame: a gravity tick or the given input, then buffers the
+  // Tetromino and writes it to the screen. Does not draw.
+  void stepFrame(UserInput uI, bool gravity);
+
   // A function for the timed falling of the Tetromino
   void gameFalling();
   // Trivial. Only calls other functions (has an if statement.....)
@@ -90,6 +230,14 @@ protected:
   bool checkCollisionDown() const;
   FRIEND_TEST(TetrisGameTest, checkCollisions);
 
+  // Restart the random number generator with the given seed
+  void seedRandom(uint64_t seed);
+
+  // Random number in [0, 7) from the game's own generator (xorshift64*).
+  // Unlike rand(), its state belongs to the game and is the same on every
+  // platform, so replays are deterministic.
+  int randomForm();
+
   // Calculate game speed
   void calculateGameSpeed();
   // Trivial. It's literally a bunch of if else statements.
@@ -111,10 +259,11 @@ protected:
   void generateNextTetromino();
   FRIEND_TEST(TetrisGameTest, generateNextTetromino);
 
-  // Checks if a Line is full
-  void checkLineFull();
-  // Is tested in TEST(Row, isFull) and used in settleTetrominoTest.
-  // It is also tested in settleTetrominoTest in the tests for point adjustment.
+  // The Tetromino with the index in the current puzzle, N after the last
+  TetrominoForm puzzleForm(uint64_t piece) const;
+
+  // Draws the upcoming Tetromino into the NEXT screen
+  void drawNextTetromino();
 
   // Grants points based on the number of lines cleared
   void lineScore(int lines);
@@ -134,10 +283,44 @@ protected:
   void drawScreen();
   // Tested in many Test suites
 
+  // Draws the rows firstRow to firstRow + 19 of a board into the play screen.
+  // Boards taller than the play screen only cost their visible part.
+  template <class B> void drawBoard(const B &board, int firstRow);
+
   // Initializes a standard game
   void initGame();
   FRIEND_TEST(TetrisGame, initGame);
 
+  // Draws the performance HUD left of the play screen, or clears it if it is
+  // switched off
+  void drawHud() const;
+
+  // The first rows of the parts of the screen. A box with text has its top
+  // border at the row of the box, then lines of text rowsPerLine() rows
+  // apart. With two rows per line the boxes keep text off the lines of
+  // their borders and the menu moves up, while the play screen keeps one row
+  // per block and takes half the lines.
+  struct Layout {
+    // Lines of the menu and the HUD
+    int menu;
+    int hud;
+    // Boxes: the lines above the play screen, the play screen, the scores,
+    // the next Tetromino and the level
+    int linesBox;
+    int playScreen;
+    int scoreBox;
+    int nextBox;
+    int levelBox;
+    // Where the next Tetromino is drawn in its box, and its rows
+    int nextArea;
+    int nextAreaRows;
+    int rowsPerLine;
+
+    // Line i of text in the box with the top border at the row
+    int text(int box, int i) const { return box + 1 + i * rowsPerLine; }
+  };
+  Layout layout() const;
+
   // Initialize the Screen
   void initScreen() const;
   // Only draws on the TM...
@@ -145,7 +328,7 @@ protected:
 
   // A screen where the game happens
   // Highest Row is 0.
-  Row screen_[20];
+  StandardBoard screen_;
 
   // The current onscreen Tetromino
   Tetromino currentTetromino_;
@@ -162,12 +345,12 @@ protected:
   // A terminalmanager to display the game
   std::unique_ptr<VirtualTerminalManager> tm_;
 
+  // The clock for gravity, frame timing and statistics
+  std::unique_ptr<Clock> clock_{std::make_unique<RealClock>()};
+
   // Bool if the I is up
   bool iIsUp{true};
 
-  // Array of lines that are to be erased
-  std::vector<std::pair<int, bool>> linesToErase_;
-
   // Starting level
   int startLevel_{0};
 
@@ -177,6 +360,10 @@ protected:
   int lines_{0};
   int high_{0};
   int gameSpeed_{48};
+  // Frames since the last gravity tick of simulateFrame()
+  int gravityFrames_{0};
+  // Frame of the last gravity tick of a replay
+  uint64_t replayGravity_{0};
 
   bool gameOver_{false};
 
@@ -184,7 +371,76 @@ protected:
   int keycodeA_{97};
   int keycodeD_{100};
 
+  // Practice mode, keycode for U and the game states at the spawn of the
+  // last Tetrominos for undo
+  bool practice_{false};
+  int keycodeUndo_{117};
+  GameStateRing<64> undo_;
+
+  // Puzzles of puzzle mode, the current one and whether it was solved
+  std::vector<Puzzle> puzzles_;
+  size_t puzzle_{0};
+  bool puzzleSolved_{false};
+
+  // Number of Tetrominos spawned in the current game
+  uint64_t pieces_{0};
+  // ... when the last undo snapshot was taken
+  uint64_t undoPieces_{0};
+
+  // Keycode for P, toggles the performance HUD
+  int keycodeHud_{112};
+  bool hudOn_{false};
+
+  // Performance statistics of the current game in microseconds: time from
+  // one frame to the next, time to simulate and to draw a frame, and time
+  // from reading an input until the terminal shows the result.
+  Histogram frameTimes_;
+  Histogram simulationTimes_;
+  Histogram renderTimes_;
+  Histogram inputLatencies_;
+  // Start of the last frame and time of the last input that is not visible
+  // yet, for the statistics
+  Clock::time_point frameStart_;
+  Clock::time_point inputTime_;
+  bool inputPending_{false};
+
   // bools for game settings
   bool hardDropOn{false};
   bool wallKickOn{false};
+
+  // Seed of the current game and state of the random number generator
+  uint64_t seed_{0};
+  bool fixedSeed_{false};
+  uint64_t rngState_{1};
+
+  // Number of frames since the start of the current game
+  uint64_t frame_{0};
+
+  // Replay recording. Empty directory means no recording.
+  std::string recordDirectory_;
+  std::unique_ptr<ReplayWriter> recorder_;
+  std::string recordError_;
+
+  // Spectator broadcast, none if null
+  std::unique_ptr<BroadcastPublisher> broadcaster_;
+
+  // Called after every settled Tetromino, if set
+  std::function<void(int cleared)> onSettle_;
+
+  // Called after every event of a replay, if set
+  std::function<void(uint64_t frame)> onReplayEvent_;
+
+  // Gets a record of every settled Tetromino, if set
+  TrainingWriter *trainingWriter_{nullptr};
 };
+
+template <class B> void TetrisGame::drawBoard(const B &board, int firstRow) {
+  int top = layout().playScreen + 1;
+  for (int y = 0; y < StandardBoard::height; ++y) {
+    const uint8_t *colors = board.colors(firstRow + y);
+    for (int x = 0; x < B::width; ++x) {
+      tm_->drawPixel(y + top,
+                     x + tm_->numCols() / 2 - B::width / 2, colors[x]);
+    }
+  }
+}
@@ -1,83 +1,20 @@
 // Copyright (C)
 
+#include "./SparseBoard.h"
 #include "./TetrisGame.h"
 
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <gtest/gtest.h>
+#include <map>
 #include <memory>
 #include <ncurses.h> // For keycodes
 #include <string>
 #include <utility>
 #include <vector>
 
-// Tests for the Row class
-
-// Set row to random values for testing.
-// Should work, if not, the whole row testing is broken.
-void setRowRandom(Row &row) {
-  srand(time(nullptr));
-  for (int i = 0; i < 10; ++i) {
-    row.row_[i] = std::make_pair(rand() % 100, 69);
-  }
-}
-
-TEST(Row, Row) {
-  Row row[20];
-  for (int i = 0; i < 20; ++i) {
-    ASSERT_EQ(row[i].num_, i);
-  }
-}
-
-TEST(Row, clear) {
-  Row row[20];
-  for (int i = 0; i < 20; ++i) {
-    setRowRandom(row[i]);
-    row[i].clear();
-    ASSERT_EQ(row[i].row_[i % 10].first, 0);
-    ASSERT_EQ(row[i].row_[i % 10].second, 0);
-  }
-}
-
-TEST(Row, getUpper) {
-  Row row[20];
-  for (int i = 0; i < 20; ++i) {
-    setRowRandom(row[i]);
-  }
-  Row row2[20];
-  for (int i = 0; i < 20; ++i) {
-    for (int j = 0; j < 10; ++j) {
-      row2[i].row_[j] = row[i].row_[j];
-    }
-  }
-  for (int i = 19; i > 0; --i) {
-    row[i].getUpper(row[i - 1]);
-  }
-  // Row 0 (Top row) will be cleared after every row moves one down.
-  row[0].clear();
-  for (int i = 19; i > 0; --i) {
-    for (int j = 0; j < 10; ++j) {
-      ASSERT_EQ(row[i].row_[j], row2[i - 1].row_[j]);
-    }
-  }
-  // Row 0 (Top row) should be cleared after every row moves one down.
-  for (int j = 0; j < 10; ++j) {
-    ASSERT_EQ(row[0].row_[j], std::make_pair(0, 0));
-  }
-}
-
-TEST(Row, isFull) {
-  Row row[20];
-  for (int i = 0; i < 20; ++i) {
-    setRowRandom(row[i]);
-  }
-  for (int i = 0; i < 20; ++i) {
-
-    ASSERT_TRUE(row[i].isFull());
-  }
-}
-
 // Tests for the TetrisGame class
 
 TEST(TetrisGame, TetrisGame) {
@@ -104,6 +41,10 @@ public:
 
   void drawScreenTest() { drawScreen(); }
 
+  template <class B> void drawBoardTest(const B &board, int firstRow) {
+    drawBoard(board, firstRow);
+  }
+
   bool checkCollisionLeftTest() { return checkCollisionLeft(); }
 
   bool checkCollisionRightTest() { return checkCollisionRight(); }
@@ -114,6 +55,30 @@ public:
 
   void removeTetrominoOldTest() { removeTetrominoOld(); }
 
+  void stepFrameTest(UserInput uI, bool gravity) { stepFrame(uI, gravity); }
+
+  void drawHudTest() const { drawHud(); }
+
+  void drawMenuTest() const { drawMenu(); }
+
+  // Start a game like play() does, but without the loop.
+  void startGame(uint64_t seed) {
+    seedRandom(seed);
+    initGame();
+  }
+
+  bool gameOver_Test() const { return gameOver_; }
+
+  void undoTest() { undo(); }
+
+  GameStateRing<64> &undo_Test() { return undo_; }
+
+  uint64_t pieces_Test() const { return pieces_; }
+
+  const Histogram &frameTimes_Test() const { return frameTimes_; }
+
+  const Histogram &renderTimes_Test() const { return renderTimes_; }
+
   // Simulates a "step" of the game.
   // A step is the rotation of removing the current tetromino, buffering again
   // and then writing to the screen.
@@ -124,7 +89,7 @@ public:
   }
 
   // Getter for the protected members for testing.
-  Row *screen_Test() { return screen_; }
+  StandardBoard &screen_Test() { return screen_; }
 
   std::vector<std::pair<int, int>> &points_Test() { return points_; }
 
@@ -192,7 +157,7 @@ public:
 
   void fillLine(int line) {
     for (int i = 0; i < 10; ++i) {
-      screen_Test()[line % 20].row_[i] = std::make_pair(3, 69);
+      screen_Test().settle(i, line % 20, 3);
     }
   }
 };
@@ -273,9 +238,7 @@ TEST(TetrisGameTest, checkCollisions) {
   game.bufferTetrominoTest();
   // Does not collide!
   ASSERT_FALSE(game.checkCollisionLeftTest());
-  for (int i = 0; i < 20; ++i) {
-    game.screen_Test()[i].clear();
-  }
+  game.screen_Test().clear();
   game.setTetrominoAtPosition(Tetromino{TetrominoForm::L}, 4, 9);
   game.setCurrentTetromino(Tetromino{TetrominoForm::J});
   game.setPositionTetromino(3, 9);
@@ -286,9 +249,7 @@ TEST(TetrisGameTest, checkCollisions) {
   game.bufferTetrominoTest();
   // Does not collide!
   ASSERT_FALSE(game.checkCollisionRightTest());
-  for (int i = 0; i < 20; ++i) {
-    game.screen_Test()[i].clear();
-  }
+  game.screen_Test().clear();
   game.setTetrominoAtPosition(Tetromino{TetrominoForm::J}, 4, 9);
   game.setCurrentTetromino(Tetromino{TetrominoForm::L});
   game.setPositionTetromino(4, 6);
@@ -301,6 +262,19 @@ TEST(TetrisGameTest, checkCollisions) {
   ASSERT_FALSE(game.checkCollisionDownTest());
 }
 
+TEST(TetrisGameTest, drawBoard) {
+  // Only the 20 rows of the viewport of a tall board are drawn.
+  TetrisGameTest game(1, nullptr, true);
+  SparseBoard<10> board(10'000);
+  board.settle(2, 9'999, 4);
+  board.settle(7, 9'980, 5);
+  board.settle(3, 9'979, 6);
+  game.drawBoardTest(board, 9'980);
+  ASSERT_TRUE(game.getTerminalManager()->isCellPixel(19 + 77, 2 + 45));
+  ASSERT_TRUE(game.getTerminalManager()->isCellPixel(0 + 77, 7 + 45));
+  ASSERT_FALSE(game.getTerminalManager()->isCellPixel(0 + 77, 3 + 45));
+}
+
 TEST(TetrisGameTest, removeTetrominoOld) {
   TetrisGameTest game(1, nullptr, true);
   game.setCurrentTetromino(Tetromino{TetrominoForm::L});
@@ -343,7 +317,7 @@ TEST(TetrisGameTest, settleTetrominoTest) {
     game.bufferTetrominoTest();
     game.settleTetrominoTest();
     for (const auto &point : game.points_Test()) {
-      ASSERT_EQ(game.screen_Test()[point.second].row_[point.first].second, 69);
+      ASSERT_TRUE(game.screen_Test().settled(point.first, point.second));
     }
   }
   {
@@ -364,7 +338,7 @@ TEST(TetrisGameTest, settleTetrominoTest) {
     // No line should be full anymore
     ASSERT_EQ(game.lines_Test(), 5);
     for (int i = 0; i < 20; ++i) {
-      ASSERT_FALSE(game.screen_Test()[i].isFull());
+      ASSERT_FALSE(game.screen_Test().isFull(i));
     }
     ASSERT_EQ(game.level_Test(), 7);
     ASSERT_EQ(game.score_Test(), 1320);
@@ -403,13 +377,14 @@ TEST(TetrisGameTest, writeToScreen) {
   game.writeToScreenTest();
   // Test the current tetromino
   for (const auto &point : game.points_Test()) {
-    ASSERT_EQ(game.screen_Test()[point.second].row_[point.first].second, 1);
+    ASSERT_FALSE(game.screen_Test().settled(point.first, point.second));
+    ASSERT_EQ(game.screen_Test().color(point.first, point.second), 3);
   }
   // Test the settled tetromino
-  ASSERT_EQ(game.screen_Test()[8].row_[3].second, 69);
-  ASSERT_EQ(game.screen_Test()[9].row_[3].second, 69);
-  ASSERT_EQ(game.screen_Test()[10].row_[3].second, 69);
-  ASSERT_EQ(game.screen_Test()[10].row_[2].second, 69);
+  ASSERT_TRUE(game.screen_Test().settled(3, 8));
+  ASSERT_TRUE(game.screen_Test().settled(3, 9));
+  ASSERT_TRUE(game.screen_Test().settled(3, 10));
+  ASSERT_TRUE(game.screen_Test().settled(2, 10));
 }
 
 TEST(TetrisGameTest, initGame) {
@@ -420,8 +395,51 @@ TEST(TetrisGameTest, initGame) {
   // Then it buffers, writes and draws. This is all already tested.
 }
 
+// A terminal with two rows per line that remembers the borders and where
+// text went
+class HalfBlockTerminalManager : public MockTerminalManager {
+public:
+  using MockTerminalManager::MockTerminalManager;
+  int rowsPerLine() const override { return 2; }
+  void drawPixel(int row, int col, int color) override {
+    MockTerminalManager::drawPixel(row, col, color);
+    borders_[std::make_pair(row, col)] = color == 1;
+  }
+  void drawString(int row, int col, int color, const char *str) override {
+    MockTerminalManager::drawString(row, col, color, str);
+    strings_.emplace_back(std::make_pair(row, col), str);
+  }
+  std::map<std::pair<int, int>, bool> borders_;
+  std::vector<std::pair<std::pair<int, int>, std::string>> strings_;
+};
+
+TEST(TetrisGameTest, halfBlockLayout) {
+  // With two rows per line every text starts a line and shares it with no
+  // border, and the play screen keeps its rows.
+  auto tm = std::make_unique<HalfBlockTerminalManager>(38, 40);
+  HalfBlockTerminalManager *terminal = tm.get();
+  TetrisGameTest game(std::move(tm));
+  game.startGame(1);
+  game.drawHudTest();
+  game.drawMenuTest();
+  ASSERT_GE(terminal->strings_.size(), 10u);
+  for (const auto &[position, text] : terminal->strings_) {
+    auto [row, col] = position;
+    ASSERT_EQ(row % 2, 0) << text;
+    ASSERT_GE(row, 0) << text;
+    for (int x = col; x < col + static_cast<int>(text.size() + 1) / 2; ++x) {
+      ASSERT_FALSE(terminal->borders_[std::make_pair(row, x)]) << text;
+      ASSERT_FALSE(terminal->borders_[std::make_pair(row + 1, x)]) << text;
+    }
+  }
+  ASSERT_EQ(terminal->getCellColor(38 - 24, 20), 1);
+  ASSERT_EQ(terminal->getCellColor(38 - 3, 20), 1);
+  ASSERT_EQ(terminal->getCellColor(38 - 23, 14), 1);
+  ASSERT_EQ(terminal->getCellColor(38 - 4, 25), 1);
+}
+
 TEST(TetrisGameTest, inputhandling) {
-  /* auto drawScreen = [](const Row *screen) {
+  /* auto drawScreen = [](const StandardBoard &screen) {
     std::string line;
     printf("X   0 1 2 3 4 5 6 7 8 9\n\n");
     for (int i = 0; i < 20; ++i) {
@@ -431,8 +449,8 @@ TEST(TetrisGameTest, inputhandling) {
         printf("%d ", i);
       }
       for (int j = 0; j < 10; ++j) {
-        if (screen[i].row_[j].second != 69) {
-          line += screen[i].row_[j].second == 0 ? " -" : " #";
+        if (!screen.settled(j, i)) {
+          line += screen.color(j, i) == 0 ? " -" : " #";
         } else {
           line += " O";
         }
@@ -499,6 +517,7 @@ TEST(TetrisGameTest, inputhandling) {
 
 TEST(TetrisGameTest, play) {
   TetrisGameTest game(1, nullptr, true);
+  game.setClock(std::make_unique<VirtualClock>());
   UserInput ui;
   game.setLevel(15);
   for (int i = 10; i < 20; ++i) {
@@ -517,6 +536,379 @@ TEST(TetrisGameTest, play) {
   // The rest has been already tested. It is just called in play() method.
 }
 
+TEST(TetrisGameTest, gravityAtEveryLevel) {
+  // Gravity ticks on the first frame after gameSpeed * 16 ms. With the
+  // virtual clock every frame takes exactly a 60th of a second, so the time
+  // between two ticks is exact.
+  const int framesPerDrop[] = {48, 43, 38, 33, 28, 23, 18, 13, 8, 6, 5, 5, 5,
+                               4,  4,  4,  3,  3,  3,  2,  2,  2, 2, 2, 2, 2,
+                               2,  2,  2,  1,  1};
+  for (int level = 0; level <= 30; ++level) {
+    TetrisGameTest game(1, nullptr, true);
+    game.setClock(std::make_unique<VirtualClock>());
+    game.setLevel(level);
+    game.play(8);
+    ASSERT_EQ(game.gameSpeed(), framesPerDrop[level]);
+    ASSERT_EQ(game.times_.size(), 8u);
+    // Number of frames until gameSpeed * 16 ms have passed.
+    int64_t threshold = framesPerDrop[level] * 16'000;
+    int64_t frames = (threshold + TetrisGame::frameDuration.count() - 1) /
+                     TetrisGame::frameDuration.count();
+    float expected = frames * TetrisGame::frameDuration.count() / 1000.0;
+    // The first tick comes after the first frame.
+    for (size_t i = 1; i < game.times_.size(); ++i) {
+      ASSERT_NEAR(game.times_[i].count(), expected, 0.001) << level;
+    }
+  }
+}
+
+TEST(Replay, varint) {
+  std::vector<uint64_t> values = {0, 1, 127, 128, 300, 1ULL << 35, ~0ULL};
+  std::vector<uint8_t> buffer;
+  for (uint64_t value : values) {
+    putVarint(&buffer, value);
+  }
+  // Small values take a single byte.
+  ASSERT_EQ(buffer[0], 0);
+  ASSERT_EQ(buffer[2], 127);
+  size_t pos = 0;
+  for (uint64_t value : values) {
+    ASSERT_EQ(getVarint(buffer.data(), buffer.size(), &pos), value);
+  }
+  ASSERT_EQ(pos, buffer.size());
+  ASSERT_THROW(getVarint(buffer.data(), buffer.size(), &pos),
+               std::runtime_error);
+}
+
+TEST(TetrisGameTest, replay) {
+  // Simulate a game with pseudo random inputs, record it and re-simulate the
+  // replay. Both games have to end up in exactly the same state.
+  const char *path = "TetrisGameTest.replay";
+  const uint64_t seed = 4711;
+  TetrisGameTest game(std::make_unique<HeadlessTerminalManager>());
+  game.startGame(seed);
+  const int keys[] = {KEY_LEFT, KEY_RIGHT, KEY_DOWN, 97, 100, 120};
+  uint64_t frame = 0;
+  {
+    ReplayWriter writer(path, ReplayHeader{seed, 0, 97, 100});
+    srand(seed);
+    for (; frame < 20'000 && !game.gameOver_Test(); ++frame) {
+      UserInput ui;
+      ui.keycode_ = -1;
+      bool gravity = frame % 48 == 0;
+      if (gravity) {
+        writer.gravity(frame);
+      } else if (frame % 3 == 0) {
+        ui.keycode_ = keys[rand() % 6];
+        writer.input(frame, ui.keycode_);
+      }
+      game.stepFrameTest(ui, gravity);
+    }
+    writer.finish(ReplayResult{frame, game.score_Test(), game.lines_Test(),
+                               game.level_Test()});
+  }
+  MappedFile file(path);
+  std::remove(path);
+  ReplayReader reader(file.data(), file.size());
+  ASSERT_EQ(reader.header().seed, seed);
+  TetrisGameTest replayed(std::make_unique<HeadlessTerminalManager>());
+  ReplayResult result = replayed.replay(reader);
+  ASSERT_EQ(result.frames, frame);
+  ASSERT_EQ(result.score, reader.result().score);
+  ASSERT_EQ(result.lines, reader.result().lines);
+  ASSERT_EQ(result.level, reader.result().level);
+  ASSERT_EQ(result.score, game.score_Test());
+  ASSERT_TRUE(replayed.screen_Test() == game.screen_Test());
+  ASSERT_EQ(replayed.getCurrentTetromino().form(),
+            game.getCurrentTetromino().form());
+  ASSERT_EQ(replayed.getNextTetromino().form(), game.getNextTetromino().form());
+}
+
+TEST(TetrisGameTest, playsWithoutRecording) {
+  // A replay that can not be created does not stop the game.
+  TetrisGameTest game(1, nullptr, true);
+  game.setClock(std::make_unique<VirtualClock>());
+  game.recordTo("/nonexistent/replays");
+  ASSERT_NO_THROW(game.play(3));
+  ASSERT_NE(game.recordError().find("/nonexistent/replays"), std::string::npos);
+  game.recordTo(".");
+  game.setSeed(78);
+  game.play(3);
+  ASSERT_EQ(game.recordError(), "");
+  ASSERT_EQ(std::remove("./tetris-78.replay"), 0);
+}
+
+TEST(TetrisGameTest, stress) {
+  // Tetrominos land on the garbage of a tall board, only the rows of the
+  // stack are stored.
+  TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+  game.setSeed(42);
+  StressResult result = game.stress(10'000, 2'000, 3'000);
+  ASSERT_EQ(result.pieces, 3'000u);
+  ASSERT_GT(result.lines, 0);
+  ASSERT_GE(result.stackRows, 2'000);
+  ASSERT_GE(result.maxStoredRows, static_cast<size_t>(result.stackRows));
+  ASSERT_LT(result.maxStoredRows, 2'000u + 3'000u);
+  // A short board fills up and ends the run.
+  StressResult full = game.stress(40, 30);
+  ASSERT_LT(full.pieces, 100u);
+  ASSERT_GT(full.stackRows, 36);
+  ASSERT_THROW(game.stress(19, 0), std::runtime_error);
+  ASSERT_THROW(game.stress(100, 100), std::runtime_error);
+}
+
+// Bytes of a replay with gravity every `speed` frames and the given inputs
+// (frame and keycode).
+static std::vector<uint8_t>
+writeReplay(int speed, const std::vector<std::pair<uint64_t, int>> &inputs) {
+  const char *path = "TetrisGameTest.rules.replay";
+  {
+    ReplayWriter writer(path, ReplayHeader{5, 0, 97, 100});
+    size_t next = 0;
+    for (uint64_t frame = 0; frame < 600; ++frame) {
+      if (frame % speed == 0) {
+        writer.gravity(frame);
+      }
+      for (; next < inputs.size() && inputs[next].first == frame; ++next) {
+        writer.input(frame, inputs[next].second);
+      }
+    }
+    writer.finish(ReplayResult{600, 0, 0, 0});
+  }
+  MappedFile file(path);
+  std::remove(path);
+  return std::vector<uint8_t>(file.data(), file.data() + file.size());
+}
+
+TEST(TetrisGameTest, replayRules) {
+  // A game recorded by play() follows the rules.
+  {
+    TetrisGameTest game(1, nullptr, true);
+    game.setClock(std::make_unique<VirtualClock>());
+    game.setSeed(77);
+    game.setLevel(5);
+    game.recordTo(".");
+    game.play(60);
+  }
+  {
+    MappedFile file("./tetris-77.replay");
+    std::remove("./tetris-77.replay");
+    ReplayReader reader(file.data(), file.size());
+    TetrisGameTest replayed(std::make_unique<HeadlessTerminalManager>());
+    ReplayResult result = replayed.replay(reader);
+    ASSERT_GT(result.frames, 60u * 23);
+    ASSERT_EQ(result.score, reader.result().score);
+  }
+  TetrisGameTest game(std::make_unique<HeadlessTerminalManager>());
+  std::vector<uint8_t> fair = writeReplay(48, {{7, KEY_LEFT}, {20, 100}});
+  ReplayReader fairReader(fair.data(), fair.size());
+  ASSERT_EQ(game.replay(fairReader).frames, 600u);
+
+  // Gravity every 60 frames at level 0 leaves 12 frames too many for every
+  // Tetromino.
+  std::vector<uint8_t> slow = writeReplay(60, {});
+  ReplayReader slowReader(slow.data(), slow.size());
+  ASSERT_THROW(game.replay(slowReader), std::runtime_error);
+
+  // Two moves in one frame
+  std::vector<uint8_t> twice = writeReplay(48, {{7, KEY_LEFT}, {7, KEY_LEFT}});
+  ReplayReader twiceReader(twice.data(), twice.size());
+  ASSERT_THROW(game.replay(twiceReader), std::runtime_error);
+
+  // An index whose size only fits when the multiplication overflows
+  std::vector<uint8_t> crafted = fair;
+  uint64_t count;
+  size_t countPos = crafted.size() - 4 - 2 * sizeof(uint64_t);
+  memcpy(&count, &crafted[countPos], sizeof(count));
+  count += uint64_t{1} << 60;
+  memcpy(&crafted[countPos], &count, sizeof(count));
+  ASSERT_THROW(ReplayReader(crafted.data(), crafted.size()),
+               std::runtime_error);
+}
+
+TEST(TetrisGameTest, seek) {
+  // Record a game with a keyframe every 100 frames and remember the state at
+  // some frames of the straight-through simulation. Seeking to these frames
+  // has to give exactly the same states.
+  const char *path = "TetrisGameTest.seek.replay";
+  const uint64_t seed = 1234;
+  TetrisGameTest game(std::make_unique<HeadlessTerminalManager>());
+  game.startGame(seed);
+  const int keys[] = {KEY_LEFT, KEY_RIGHT, 97, 100};
+  std::vector<std::pair<uint64_t, GameState>> states;
+  uint64_t frame = 0;
+  {
+    ReplayWriter writer(path, ReplayHeader{seed, 0, 97, 100});
+    srand(seed);
+    for (; frame < 5'000 && !game.gameOver_Test(); ++frame) {
+      if (frame > 0 && frame % 100 == 0) {
+        writer.keyframe(frame, game.snapshot());
+      }
+      if (frame % 37 == 0 || frame % 100 == 0) {
+        states.emplace_back(frame, game.snapshot());
+      }
+      UserInput ui;
+      ui.keycode_ = -1;
+      bool gravity = frame % 10 == 0;
+      if (gravity) {
+        writer.gravity(frame);
+      } else if (frame % 4 == 0) {
+        ui.keycode_ = keys[rand() % 4];
+        writer.input(frame, ui.keycode_);
+      }
+      game.stepFrameTest(ui, gravity);
+    }
+    writer.finish(ReplayResult{frame, game.score_Test(), game.lines_Test(),
+                               game.level_Test()});
+  }
+  MappedFile file(path);
+  std::remove(path);
+  ReplayReader reader(file.data(), file.size());
+  ASSERT_EQ(reader.numKeyframes(), (frame - 1) / 100);
+  ASSERT_GT(states.size(), 10u);
+  // Seek in both directions.
+  TetrisGameTest seeked(std::make_unique<HeadlessTerminalManager>());
+  for (auto it = states.rbegin(); it != states.rend(); ++it) {
+    seeked.seek(reader, it->first);
+    ASSERT_TRUE(seeked.snapshot() == it->second) << it->first;
+  }
+  for (const auto &[stateFrame, state] : states) {
+    seeked.seek(reader, stateFrame);
+    ASSERT_TRUE(seeked.snapshot() == state) << stateFrame;
+  }
+  // Playing on after a seek ends like the straight-through playback.
+  seeked.seek(reader, frame / 2);
+  ReplayResult result = seeked.continueReplay(reader);
+  ASSERT_EQ(result.score, game.score_Test());
+  ASSERT_EQ(result.lines, game.lines_Test());
+  ASSERT_TRUE(seeked.snapshot() == game.snapshot());
+}
+
+TEST(TetrisGameTest, frameStatistics) {
+  // At level 29 gravity ticks every frame. Every frame sleeps for a 60th of a
+  // second, so no frame can take less.
+  TetrisGameTest game(1, nullptr, true);
+  game.setClock(std::make_unique<VirtualClock>());
+  game.setLevel(29);
+  game.play(5);
+  ASSERT_GE(game.frameTimes_Test().count(), 4u);
+  ASSERT_GE(game.frameTimes_Test().percentile(50), 16'000u);
+  ASSERT_EQ(game.frameTimes_Test().max(), 16'667u);
+  ASSERT_GE(game.frameTimes_Test().max(),
+            game.frameTimes_Test().percentile(50));
+  ASSERT_EQ(game.renderTimes_Test().count(),
+            game.frameTimes_Test().count() + 1);
+}
+
+TEST(GameState, snapshotAndRestore) {
+  // Play a bit, fork the game from a snapshot and play both on with the same
+  // inputs. They have to stay the same.
+  TetrisGameTest game(std::make_unique<HeadlessTerminalManager>());
+  game.startGame(99);
+  const int keys[] = {KEY_LEFT, KEY_RIGHT, KEY_DOWN, 97, 100};
+  UserInput ui;
+  for (int frame = 0; frame < 500; ++frame) {
+    ui.keycode_ = keys[frame % 5];
+    game.stepFrameTest(ui, frame % 7 == 0);
+  }
+  GameState state = game.snapshot();
+  ASSERT_LT(sizeof(state), 128u);
+  TetrisGameTest fork(std::make_unique<HeadlessTerminalManager>());
+  fork.restore(state);
+  ASSERT_TRUE(fork.snapshot() == state);
+  for (int frame = 0; frame < 500; ++frame) {
+    ui.keycode_ = keys[(frame * 3) % 5];
+    game.stepFrameTest(ui, frame % 5 == 0);
+    fork.stepFrameTest(ui, frame % 5 == 0);
+  }
+  ASSERT_TRUE(fork.snapshot() == game.snapshot());
+  ASSERT_EQ(fork.score_Test(), game.score_Test());
+  // The falling Tetromino is on the screen after restoring.
+  ASSERT_TRUE(fork.screen_Test() == game.screen_Test());
+}
+
+TEST(GameState, garbage) {
+  // Garbage keeps its color and its holes through a snapshot, also after
+  // pieces settled on top of it. Like in versus mode it arrives when a
+  // Tetromino settles.
+  TetrisGameTest game(std::make_unique<HeadlessTerminalManager>());
+  game.startGame(7);
+  int settled = 0;
+  game.onSettle([&](int) {
+    settled++;
+    if (settled == 1) {
+      game.addGarbage(2, 3);
+    } else if (settled == 4) {
+      game.addGarbage(1, 8);
+    }
+  });
+  const int keys[] = {KEY_LEFT, KEY_RIGHT, KEY_DOWN, 97, 100};
+  UserInput ui;
+  for (int frame = 0; settled < 4; ++frame) {
+    ASSERT_LT(frame, 1000);
+    ui.keycode_ = keys[frame % 5];
+    game.stepFrameTest(ui, frame % 7 == 0);
+  }
+  ASSERT_FALSE(game.gameOver());
+  GameState state = game.snapshot();
+  ASSERT_EQ(state.garbageRows, 7u << 17);
+  ASSERT_EQ(state.rows[18] >> (3 * 3) & 7, 0u);
+  ASSERT_EQ(state.rows[18] >> (3 * 2) & 7, 7u);
+  ASSERT_EQ(state.rows[19] >> 30, 0u);
+  TetrisGameTest fork(std::make_unique<HeadlessTerminalManager>());
+  fork.restore(state);
+  ASSERT_TRUE(fork.snapshot() == state);
+  ASSERT_TRUE(fork.screen_Test() == game.screen_Test());
+  for (int x = 0; x < StandardBoard::width; ++x) {
+    ASSERT_EQ(fork.screen_Test().settled(x, 17), x != 3);
+    ASSERT_EQ(fork.screen_Test().settled(x, 19), x != 8);
+    ASSERT_EQ(fork.screen_Test().color(x, 19), x != 8 ? 1 : 0);
+  }
+}
+
+TEST(GameState, ring) {
+  GameStateRing<3> ring;
+  ASSERT_TRUE(ring.empty());
+  for (int i = 0; i < 5; ++i) {
+    GameState state;
+    state.score = i;
+    ring.push(state);
+  }
+  // Only the last three are left.
+  ASSERT_EQ(ring.size(), 3u);
+  ASSERT_EQ(ring.top().score, 4);
+  ring.pop();
+  ASSERT_EQ(ring.top().score, 3);
+  ring.pop();
+  ASSERT_EQ(ring.top().score, 2);
+  ring.pop();
+  ASSERT_TRUE(ring.empty());
+}
+
+TEST(TetrisGameTest, undo) {
+  // Drop two Tetrominos and take both back.
+  TetrisGameTest game(std::make_unique<HeadlessTerminalManager>());
+  game.startGame(7);
+  game.undo_Test().push(game.snapshot());
+  GameState start = game.snapshot();
+  UserInput ui;
+  ui.keycode_ = KEY_DOWN;
+  for (int piece = 0; piece < 2; ++piece) {
+    uint64_t pieces = game.pieces_Test();
+    while (game.pieces_Test() == pieces) {
+      game.stepFrameTest(ui, false);
+    }
+    game.undo_Test().push(game.snapshot());
+  }
+  ASSERT_FALSE(game.snapshot() == start);
+  game.undoTest();
+  game.undoTest();
+  ASSERT_TRUE(game.snapshot() == start);
+  // Nothing left to take back.
+  game.undoTest();
+  ASSERT_TRUE(game.snapshot() == start);
+}
+
 // This is for asthetic purpose only.
 #include <stdio.h>
 
@@ -0,0 +1,28 @@
+// Copyright (C)
+
+#include "./LoadClients.h"
+#include <cstdio>
+#include <string>
+
+// Connects local stand-in clients to a TetrisServer that play random keys,
+// to put it under load. The server reports its tick jitter.
+// Usage: ./TetrisLoadMain <socket> <clients> <seconds>
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    fprintf(stderr, "Usage: ./TetrisLoadMain <socket> <clients> <seconds>\n");
+    return 2;
+  }
+  int numClients = std::stoi(argv[2]);
+  int seconds = std::stoi(argv[3]);
+  LoadClients clients(argv[1], numClients);
+  clients.run(std::chrono::seconds(seconds));
+  uint64_t bytes = 0;
+  for (int i = 0; i < numClients; ++i) {
+    bytes += clients.bytesReceived(i);
+  }
+  printf("%zu of %d clients still connected, %.1f KiB/s per client\n",
+         clients.numConnected(), numClients,
+         bytes / 1024.0 / numClients / seconds);
+  return clients.numConnected() == static_cast<size_t>(numClients) ? 0 : 1;
+}
@@ -1,8 +1,298 @@
 // Copyright (C)
 
+#include "./Asciicast.h"
+#include "./Rollback.h"
 #include "./TetrisGame.h"
+#include "./Versus.h"
+#include "./VersusView.h"
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+// Renders a replay file into a terminal recording as fast as possible and
+// prints how long that took.
+int exportMain(ReplayReader &reader, const char *path, const char *output,
+               AsciicastWriter::Format format) {
+  std::string title = path;
+  title = title.substr(title.find_last_of('/') + 1);
+  AsciicastStats stats = exportReplay(reader, output, format, title);
+  double realTime = stats.result.frames / 60.0;
+  printf("Exported %lu frames (%.1f s of play) as %lu outputs, %.1f KiB in "
+         "%.3f s (%.0fx real speed)\n",
+         stats.result.frames, realTime, stats.outputs, stats.bytes / 1024.0,
+         stats.seconds, realTime / stats.seconds);
+  return 0;
+}
+
+// Re-simulates a replay file. Headless it runs as fast as possible and prints
+// the result, live it is drawn at real speed. Both can start at any frame.
+int replayMain(const char *path, bool live, uint64_t seekFrame) {
+  MappedFile file(path);
+  ReplayReader reader(file.data(), file.size());
+  if (live) {
+    TetrisGame game(1, nullptr);
+    game.seek(reader, seekFrame);
+    game.continueReplay(reader, true);
+    return 0;
+  }
+  TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+  auto start = std::chrono::steady_clock::now();
+  if (seekFrame > 0) {
+    game.seek(reader, seekFrame);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf("Seeked to frame %lu in %.3f ms (%zu keyframes)\n", seekFrame,
+           elapsed.count() * 1000, reader.numKeyframes());
+    return 0;
+  }
+  ReplayResult result = game.replay(reader);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  const ReplayResult &claimed = reader.result();
+  double realTime = result.frames / 60.0;
+  printf("Frames:  %lu (%.1f s of play)\n", result.frames, realTime);
+  printf("Score:   %d (claimed %d)\n", result.score, claimed.score);
+  printf("Lines:   %d (claimed %d)\n", result.lines, claimed.lines);
+  printf("Level:   %d (claimed %d)\n", result.level, claimed.level);
+  printf("Time:    %.3f ms (%.0fx real speed)\n", elapsed.count() * 1000,
+         realTime / elapsed.count());
+  bool match = result.score == claimed.score &&
+               result.lines == claimed.lines && result.level == claimed.level;
+  printf("%s\n", match ? "Replay matches" : "Replay does NOT match");
+  return match ? 0 : 1;
+}
+
+// Drops Tetrominos onto a tall board as fast as possible and prints how fast
+// that was and how many rows had to be stored.
+int stressMain(int height, int filled, uint64_t pieces) {
+  StressResult result;
+  {
+    TetrisGame game(1, nullptr);
+    result = game.stress(height, filled, pieces);
+  }
+  printf("%lu Tetrominos in %.3f s (%.0f per s), %d lines, a stack of %d of "
+         "%d rows, at most %zu rows stored\n",
+         result.pieces, result.seconds, result.pieces / result.seconds,
+         result.lines, result.stackRows, height, result.maxStoredRows);
+  return 0;
+}
+
+// Plays a versus match and prints how well the frame rate was held.
+int versusMain(int numBoards, int numHumans) {
+  int winner;
+  Versus::Stats stats;
+  {
+    Versus versus(std::make_unique<TerminalManager>(TetrisGame::colors()),
+                  numBoards, numHumans);
+    winner = versus.run();
+    stats = versus.stats();
+  }
+  if (winner >= 0) {
+    printf("Board %d wins\n", winner + 1);
+  }
+  printf("%.1f s, boards at %.1f fps or more, drawn at %.1f fps, %lu late "
+         "frames, %lu garbage lines\n",
+         stats.seconds, stats.minBoardFps, stats.renderFps, stats.lateFrames,
+         stats.garbageLines);
+  return 0;
+}
+
+// Plays a versus game against another process with rollback netcode. The
+// peers bind <path>.0 and <path>.1, outgoing messages are held back by the
+// given delay to try it with the latency of a network.
+int rollbackMain(const std::string &path, int player, int delayMillis) {
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  sockaddr_un own{};
+  sockaddr_un other{};
+  own.sun_family = other.sun_family = AF_UNIX;
+  std::string ownPath = path + "." + std::to_string(player);
+  std::string otherPath = path + "." + std::to_string(1 - player);
+  if (otherPath.size() >= sizeof(own.sun_path)) {
+    throw std::runtime_error("Socket path is too long: " + path);
+  }
+  strncpy(own.sun_path, ownPath.c_str(), sizeof(own.sun_path) - 1);
+  strncpy(other.sun_path, otherPath.c_str(), sizeof(other.sun_path) - 1);
+  unlink(ownPath.c_str());
+  if (fd < 0 ||
+      bind(fd, reinterpret_cast<sockaddr *>(&own), sizeof(own)) < 0) {
+    throw std::runtime_error("Could not bind " + ownPath);
+  }
+  // Both peers use the same seed without agreeing on one first.
+  RollbackSession session(std::hash<std::string>{}(path), player);
+  RollbackPeer peer(fd, &session, std::chrono::milliseconds(delayMillis));
+  auto tm = std::make_unique<TerminalManager>(TetrisGame::colors());
+  VersusView view(tm.get(), {player == 0 ? "You" : "Opponent",
+                             player == 1 ? "You" : "Opponent"});
+  view.drawLayout();
+  while (connect(fd, reinterpret_cast<sockaddr *>(&other), sizeof(other)) <
+         0) {
+    view.drawMessage(player, "Waiting");
+    if (tm->getUserInput().isEscape()) {
+      unlink(ownPath.c_str());
+      return 0;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  auto deadline = std::chrono::steady_clock::now();
+  int key{-1};
+  bool over{false};
+  while (true) {
+    UserInput uI = tm->getUserInput();
+    if (uI.isEscape()) {
+      break;
+    }
+    if (uI.keycode_ >= 0) {
+      key = uI.keycode_;
+    }
+    peer.poll(std::chrono::steady_clock::now());
+    if (!over && session.advanceFrame(key)) {
+      key = -1;
+    }
+    // The game is only over when the other peer confirmed all its inputs.
+    session.synchronize();
+    for (int i = 0; i < 2; ++i) {
+      view.drawFrame(i, session.board(i).broadcastFrame());
+      if (!over && session.board(i).gameOver() &&
+          session.remoteConfirmed() >= session.frame()) {
+        over = true;
+        view.drawMessage(1 - i, "Winner!");
+      }
+    }
+    deadline += TetrisGame::frameDuration;
+    std::this_thread::sleep_until(deadline);
+  }
+  tm.reset();
+  RollbackSession::Stats stats = session.stats();
+  printf("%lu rollbacks, %lu frames simulated again, at most %lu frames and "
+         "%.0f us at once, %lu stalled frames\n",
+         stats.rollbacks, stats.resimulatedFrames, stats.maxRollbackFrames,
+         stats.maxRollbackMicros, stats.stalls);
+  close(fd);
+  unlink(ownPath.c_str());
+  return 0;
+}
 
 int main(int argc, char **argv) {
-  TetrisGame game(argc, argv);
-  game.restartHandler();
+  // ./TetrisMain --replay <file> [--live] [--seek <frame>]
+  //     [--cast <file> | --ansi <file>]
+  if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+    bool live{false};
+    uint64_t seekFrame{0};
+    const char *output = nullptr;
+    AsciicastWriter::Format format = AsciicastWriter::Format::Asciicast;
+    for (int i = 3; i < argc; ++i) {
+      if (strcmp(argv[i], "--live") == 0) {
+        live = true;
+      } else if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc) {
+        seekFrame = std::stoull(argv[++i]);
+      } else if ((strcmp(argv[i], "--cast") == 0 ||
+                  strcmp(argv[i], "--ansi") == 0) &&
+                 i + 1 < argc) {
+        format = argv[i][2] == 'c' ? AsciicastWriter::Format::Asciicast
+                                   : AsciicastWriter::Format::Ansi;
+        output = argv[++i];
+      }
+    }
+    if (output != nullptr) {
+      MappedFile file(argv[2]);
+      ReplayReader reader(file.data(), file.size());
+      return exportMain(reader, argv[2], output, format);
+    }
+    return replayMain(argv[2], live, seekFrame);
+  }
+  // ./TetrisMain --versus <boards> [<humans>]
+  if (argc > 2 && strcmp(argv[1], "--versus") == 0) {
+    return versusMain(std::stoi(argv[2]), argc > 3 ? std::stoi(argv[3]) : 1);
+  }
+  // ./TetrisMain --rollback <path> <player 0 or 1> [<delay in ms>]
+  if (argc > 3 && strcmp(argv[1], "--rollback") == 0) {
+    return rollbackMain(argv[2], std::stoi(argv[3]),
+                        argc > 4 ? std::stoi(argv[4]) : 0);
+  }
+  // ./TetrisMain --stress <rows> [<filled rows> [<Tetrominos>]]
+  if (argc > 2 && strcmp(argv[1], "--stress") == 0) {
+    int height = std::stoi(argv[2]);
+    return stressMain(height, argc > 3 ? std::stoi(argv[3]) : height / 2,
+                      argc > 4 ? std::stoull(argv[4]) : 0);
+  }
+  // ./TetrisMain --spectate <name>
+  if (argc > 2 && strcmp(argv[1], "--spectate") == 0) {
+    BroadcastSubscriber subscriber(argv[2]);
+    TetrisGame game(1, nullptr);
+    game.spectate(subscriber);
+    return 0;
+  }
+  // ./TetrisMain --puzzles <file>
+  if (argc > 2 && strcmp(argv[1], "--puzzles") == 0) {
+    TetrisGame game(1, nullptr);
+    game.setPuzzles(readPuzzles(argv[2]));
+    game.restartHandler();
+    return 0;
+  }
+  // ./TetrisMain [--export <file>] [--broadcast <name>] [--practice]
+  //     [--half-blocks] [<level> <keycode a> ...]
+  std::unique_ptr<TrainingWriter> training;
+  if (argc > 2 && strcmp(argv[1], "--export") == 0) {
+    training = std::make_unique<TrainingWriter>(argv[2]);
+    argv[2] = argv[0];
+    argc -= 2;
+    argv += 2;
+  }
+  const char *broadcast = nullptr;
+  if (argc > 2 && strcmp(argv[1], "--broadcast") == 0) {
+    broadcast = argv[2];
+    argv[2] = argv[0];
+    argc -= 2;
+    argv += 2;
+  }
+  bool practice = argc > 1 && strcmp(argv[1], "--practice") == 0;
+  if (practice) {
+    argv[1] = argv[0];
+    argc--;
+    argv++;
+  }
+  bool halfBlocks = argc > 1 && strcmp(argv[1], "--half-blocks") == 0;
+  if (halfBlocks) {
+    argv[1] = argv[0];
+    argc--;
+    argv++;
+  }
+  // Every game of the session is recorded to replays/ if possible. Warnings
+  // are printed after the session, the game screen would hide them.
+  std::string recordError;
+  if (mkdir("replays", 0755) != 0 && errno != EEXIST) {
+    recordError = std::string("Could not create replays/: ") + strerror(errno);
+  }
+  {
+    TetrisGame game(argc, argv, false, halfBlocks);
+    game.setPractice(practice);
+    if (broadcast != nullptr) {
+      game.broadcastTo(broadcast);
+    }
+    game.exportTrainingTo(training.get());
+    if (recordError.empty()) {
+      game.recordTo("replays");
+    }
+    game.restartHandler();
+    if (recordError.empty()) {
+      recordError = game.recordError();
+    }
+  }
+  if (!recordError.empty()) {
+    fprintf(stderr, "Warning: games were not recorded. %s\n",
+            recordError.c_str());
+  }
+  if (training) {
+    try {
+      training->close();
+    } catch (const std::runtime_error &e) {
+      fprintf(stderr, "%s\n", e.what());
+      return 1;
+    }
+  }
 }
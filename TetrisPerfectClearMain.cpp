@@ -0,0 +1,80 @@
+// Copyright (C)
+
+#include "./PerfectClear.h"
+#include "./TetrisGame.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Searches a perfect clear for the first Tetrominos of games with the seeds
+// 1 to n, once on one thread and once on all of them, and prints the nodes
+// per second and the speedup.
+// Usage: ./TetrisPerfectClearMain [--seeds <n>] [--pieces <n>] [--lines <n>]
+//            [--threads <n>] [--deadline <ms>]
+
+static const char *usage =
+    "Usage: ./TetrisPerfectClearMain [--seeds <n>] [--pieces <n>] "
+    "[--lines <n>] [--threads <n>] [--deadline <ms>]\n";
+
+int main(int argc, char **argv) {
+  int seeds = 10;
+  size_t pieces = 10;
+  PerfectClear::Options options;
+  options.maxLines = 4;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      bool hasValue = i + 1 < argc;
+      if (strcmp(argv[i], "--seeds") == 0 && hasValue) {
+        seeds = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--pieces") == 0 && hasValue) {
+        pieces = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--lines") == 0 && hasValue) {
+        options.maxLines = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+        options.threads = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--deadline") == 0 && hasValue) {
+        options.deadline = std::chrono::milliseconds(std::stoi(argv[++i]));
+      } else {
+        fprintf(stderr, "%s", usage);
+        return 2;
+      }
+    }
+    PerfectClear::Options single = options;
+    single.threads = 1;
+    PerfectClear::Result totals[2];
+    int found = 0;
+    for (int seed = 1; seed <= seeds; ++seed) {
+      TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+      game.setSeed(seed);
+      game.newGame();
+      PerfectClear perfectClear(game.snapshot(), pieces);
+      PerfectClear::Result results[] = {perfectClear.solve(single),
+                                        perfectClear.solve(options)};
+      for (int i = 0; i < 2; ++i) {
+        totals[i].nodes += results[i].nodes;
+        totals[i].seconds += results[i].seconds;
+        totals[i].threads = results[i].threads;
+        totals[i].steals += results[i].steals;
+      }
+      const PerfectClear::Result &result = results[1];
+      found += result.found;
+      printf("Seed %d: %s in %.1f ms, %lu nodes, %lu pruned\n", seed,
+             result.found      ? "perfect clear"
+             : result.timedOut ? "deadline"
+                               : "none",
+             result.seconds * 1000, result.nodes, result.pruned);
+    }
+    printf("%d of %d sequences have a perfect clear\n", found, seeds);
+    for (const PerfectClear::Result &total : totals) {
+      printf("%d threads: %.2f M nodes/s, %.2f s, %lu steals\n", total.threads,
+             total.nodes / total.seconds / 1e6, total.seconds, total.steals);
+    }
+    printf("Speedup: %.2fx in time, %.2fx in nodes/s\n",
+           totals[0].seconds / totals[1].seconds,
+           (totals[1].nodes / totals[1].seconds) /
+               (totals[0].nodes / totals[0].seconds));
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n%s", e.what(), usage);
+    return 2;
+  }
+}
@@ -0,0 +1,59 @@
+// Copyright (C)
+
+#include "./Puzzle.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Generates puzzles with exactly one solution on all cores, writes them to
+// the file for `./TetrisMain --puzzles <file>` and prints the puzzles per
+// minute.
+// Usage: ./TetrisPuzzleMain <file> [--count <n>] [--pieces <n>]
+//            [--lines <n>] [--rows <n>] [--threads <n>] [--seed <n>]
+
+static const char *usage =
+    "Usage: ./TetrisPuzzleMain <file> [--count <n>] [--pieces <n>] "
+    "[--lines <n>] [--rows <n>] [--threads <n>] [--seed <n>]\n";
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argv[1][0] == '-') {
+    fprintf(stderr, "%s", usage);
+    return 2;
+  }
+  size_t count = 100;
+  PuzzleGenerator::Options options;
+  options.progress = stdout;
+  try {
+    for (int i = 2; i < argc; ++i) {
+      bool hasValue = i + 1 < argc;
+      if (strcmp(argv[i], "--count") == 0 && hasValue) {
+        count = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--pieces") == 0 && hasValue) {
+        options.pieces = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--lines") == 0 && hasValue) {
+        options.lines = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--rows") == 0 && hasValue) {
+        options.maxRows = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+        options.threads = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+        options.seed = std::stoull(argv[++i]);
+      } else {
+        fprintf(stderr, "%s", usage);
+        return 2;
+      }
+    }
+    PuzzleGenerator generator(options);
+    std::vector<Puzzle> puzzles = generator.generate(count);
+    writePuzzles(argv[1], puzzles);
+    PuzzleGenerator::Stats stats = generator.stats();
+    printf("%lu puzzles from %lu candidates (%lu unsolvable, %lu ambiguous) "
+           "in %.2f s: %.0f puzzles per minute\n",
+           stats.accepted, stats.candidates, stats.unsolvable,
+           stats.ambiguous, stats.seconds,
+           stats.accepted / stats.seconds * 60);
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n%s", e.what(), usage);
+    return 2;
+  }
+}
@@ -0,0 +1,314 @@
+// Copyright (C)
+
+#include "./TetrisServer.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Epoll ids of the server's own file descriptors. Sessions count up from 1.
+static constexpr uint64_t listenId = ~uint64_t{0};
+static constexpr uint64_t timerId = ~uint64_t{0} - 1;
+static constexpr uint64_t stopId = ~uint64_t{0} - 2;
+
+// The timer wheel turns once per 64 ms in slots of 1 ms.
+static constexpr std::chrono::milliseconds wheelResolution{1};
+static constexpr size_t wheelSlots = 64;
+
+// Throw with the message of errno.
+static void throwErrno(const std::string &what) {
+  throw std::runtime_error(what + ": " + strerror(errno));
+}
+
+// CPU time of the calling thread in seconds
+static double threadCpuSeconds() {
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// ____________________________________________________________________________
+TetrisServer::TetrisServer(const std::string &path) : path_(path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path is too long: " + path);
+  }
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd_ < 0) {
+    throwErrno("socket");
+  }
+  unlink(path.c_str());
+  if (bind(listenFd_, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) < 0 ||
+      listen(listenFd_, SOMAXCONN) < 0) {
+    throwErrno("Could not listen on " + path);
+  }
+  epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+  timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epollFd_ < 0 || timerFd_ < 0 || stopFd_ < 0) {
+    throwErrno("Could not create the event loop");
+  }
+  for (auto [fd, id] : {std::make_pair(listenFd_, listenId),
+                        std::make_pair(timerFd_, timerId),
+                        std::make_pair(stopFd_, stopId)}) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+  }
+}
+
+// ____________________________________________________________________________
+TetrisServer::~TetrisServer() {
+  for (auto &[id, session] : sessions_) {
+    close(session.fd);
+  }
+  for (int fd : {listenFd_, epollFd_, timerFd_, stopFd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  unlink(path_.c_str());
+}
+
+// ____________________________________________________________________________
+void TetrisServer::run(int reportInterval) {
+  startTime_ = std::chrono::steady_clock::now();
+  startCpu_ = threadCpuSeconds();
+  wallSeconds_ = 0;
+  cpuSeconds_ = 0;
+  jitter_.clear();
+  ticks_ = 0;
+  wheel_ = std::make_unique<TimerWheel>(wheelResolution, wheelSlots,
+                                        startTime_);
+  for (auto &[id, session] : sessions_) {
+    wheel_->schedule(id, startTime_ + TetrisGame::frameDuration);
+  }
+  itimerspec interval{};
+  interval.it_interval.tv_nsec =
+      std::chrono::nanoseconds(wheelResolution).count();
+  interval.it_value = interval.it_interval;
+  timerfd_settime(timerFd_, 0, &interval, nullptr);
+  auto nextReport = startTime_ + std::chrono::seconds(reportInterval);
+
+  epoll_event events[256];
+  bool running{true};
+  while (running) {
+    int n = epoll_wait(epollFd_, events, 256, -1);
+    if (n < 0 && errno != EINTR) {
+      throwErrno("epoll_wait");
+    }
+    for (int i = 0; i < n; ++i) {
+      uint64_t id = events[i].data.u64;
+      if (id == stopId) {
+        uint64_t value;
+        if (read(stopFd_, &value, sizeof(value)) > 0) {
+          running = false;
+        }
+      } else if (id == listenId) {
+        acceptClients();
+      } else if (id == timerId) {
+        uint64_t expirations;
+        if (read(timerFd_, &expirations, sizeof(expirations)) < 0) {
+          continue;
+        }
+        tickDueSessions();
+        Clock::time_point now = std::chrono::steady_clock::now();
+        wallSeconds_ = std::chrono::duration<double>(now - startTime_).count();
+        cpuSeconds_ = threadCpuSeconds() - startCpu_;
+        if (reportInterval > 0 && now >= nextReport) {
+          printf("%s\n", report().c_str());
+          fflush(stdout);
+          nextReport += std::chrono::seconds(reportInterval);
+        }
+      } else {
+        auto it = sessions_.find(id);
+        if (it == sessions_.end()) {
+          continue;
+        }
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+          readClient(&it->second);
+        }
+        it = sessions_.find(id);
+        if (it != sessions_.end() && (events[i].events & EPOLLOUT)) {
+          flushSession(&it->second);
+        }
+      }
+    }
+  }
+  itimerspec off{};
+  timerfd_settime(timerFd_, 0, &off, nullptr);
+}
+
+// ____________________________________________________________________________
+void TetrisServer::tickDueSessions() {
+  auto tick = [this](uint64_t id, Clock::time_point deadline) {
+    auto it = sessions_.find(id);
+    if (it == sessions_.end()) {
+      return;
+    }
+    Clock::time_point now = std::chrono::steady_clock::now();
+    jitter_.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - deadline)
+            .count());
+    ticks_++;
+    tickSession(&it->second);
+    if (sessions_.count(id) == 0) {
+      return;
+    }
+    // Frames that were missed completely are skipped.
+    Clock::time_point next = deadline + TetrisGame::frameDuration;
+    while (next < now) {
+      next += TetrisGame::frameDuration;
+    }
+    wheel_->schedule(id, next);
+  };
+  wheel_->advance(std::chrono::steady_clock::now(), tick);
+}
+
+// ____________________________________________________________________________
+void TetrisServer::stop() {
+  uint64_t one = 1;
+  if (write(stopFd_, &one, sizeof(one)) < 0) {
+    // The event loop is woken up already.
+  }
+}
+
+// ____________________________________________________________________________
+TetrisServer::Stats TetrisServer::stats() const {
+  Stats stats;
+  stats.sessions = sessions_.size();
+  stats.ticks = ticks_;
+  stats.wallSeconds = wallSeconds_;
+  stats.cpuSeconds = cpuSeconds_;
+  stats.sessionsPerCore =
+      cpuSeconds_ > 0 ? stats.sessions * wallSeconds_ / cpuSeconds_ : 0;
+  stats.jitterP50 = jitter_.percentile(50);
+  stats.jitterP99 = jitter_.percentile(99);
+  stats.jitterMax = jitter_.max();
+  return stats;
+}
+
+// ____________________________________________________________________________
+std::string TetrisServer::report() const {
+  Stats s = stats();
+  char line[256];
+  snprintf(line, sizeof(line),
+           "%zu sessions, %.0f ticks/s, cpu %.1f%%, %.0f sessions per core, "
+           "tick jitter p50 %lu us, p99 %lu us, max %lu us",
+           s.sessions, s.wallSeconds > 0 ? s.ticks / s.wallSeconds : 0,
+           s.wallSeconds > 0 ? 100 * s.cpuSeconds / s.wallSeconds : 0,
+           s.sessionsPerCore, s.jitterP50, s.jitterP99, s.jitterMax);
+  return line;
+}
+
+// ____________________________________________________________________________
+void TetrisServer::acceptClients() {
+  while (true) {
+    int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    uint64_t id = nextId_++;
+    auto tm = std::make_unique<SocketTerminalManager>(TetrisGame::colors());
+    Session &session = sessions_[id];
+    session.id = id;
+    session.fd = fd;
+    session.tm = tm.get();
+    session.game = std::make_unique<TetrisGame>(std::move(tm));
+    numSessions_++;
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+    if (wheel_) {
+      wheel_->schedule(id, std::chrono::steady_clock::now() +
+                               TetrisGame::frameDuration);
+    }
+    session.game->drawMenu();
+    flushSession(&session);
+  }
+}
+
+// ____________________________________________________________________________
+void TetrisServer::readClient(Session *session) {
+  char buffer[4096];
+  while (true) {
+    ssize_t n = recv(session->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (n > 0) {
+      session->tm->receive(buffer, n);
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    } else {
+      closeSession(session->id);
+      return;
+    }
+  }
+}
+
+// ____________________________________________________________________________
+void TetrisServer::tickSession(Session *session) {
+  TetrisGame *game = session->game.get();
+  // One key per frame, like TetrisGame::play() reads it.
+  UserInput uI = session->tm->getUserInput();
+  if (session->playing) {
+    if (uI.isEscape() || game->gameOver()) {
+      game->endGame();
+      session->playing = false;
+      game->drawMenu();
+    } else {
+      game->tick(uI);
+    }
+  } else if (uI.isSpace()) {
+    game->resetGame();
+    game->newGame();
+    session->playing = true;
+  } else if (uI.isEscape()) {
+    closeSession(session->id);
+    return;
+  }
+  flushSession(session);
+}
+
+// ____________________________________________________________________________
+void TetrisServer::flushSession(Session *session) {
+  if (!session->tm->flush(session->fd) ||
+      session->tm->pendingBytes() > maxPendingBytes) {
+    closeSession(session->id);
+    return;
+  }
+  bool blocked = session->tm->pendingBytes() > 0;
+  if (blocked != session->writeBlocked) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    if (blocked) {
+      event.events |= EPOLLOUT;
+    }
+    event.data.u64 = session->id;
+    epoll_ctl(epollFd_, EPOLL_CTL_MOD, session->fd, &event);
+    session->writeBlocked = blocked;
+  }
+}
+
+// ____________________________________________________________________________
+void TetrisServer::closeSession(uint64_t id) {
+  auto it = sessions_.find(id);
+  if (it == sessions_.end()) {
+    return;
+  }
+  epoll_ctl(epollFd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+  close(it->second.fd);
+  sessions_.erase(it);
+  numSessions_--;
+}
@@ -0,0 +1,105 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Histogram.h"
+#include "./SocketTerminalManager.h"
+#include "./TetrisGame.h"
+#include "./TimerWheel.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Hosts many games in one process for terminal clients on a Unix domain
+// socket, e.g. `socat -,raw,echo=0 UNIX-CONNECT:<path>`.
+// One thread runs an epoll event loop: a timerfd advances a timer wheel that
+// ticks every session once per frame, each with its own TetrisGame drawing
+// into a SocketTerminalManager. Output is sent without blocking, whatever a
+// client does not take yet stays in its buffer.
+class TetrisServer {
+public:
+  // Listen on the socket at the path. An old socket file is replaced.
+  explicit TetrisServer(const std::string &path);
+  ~TetrisServer();
+
+  // Run the event loop until stop() is called. Prints report() every
+  // reportInterval seconds, never if it is 0.
+  void run(int reportInterval = 0);
+
+  // Make run() return. Can be called from any thread and signal handlers.
+  void stop();
+
+  // Number of connected clients
+  size_t numSessions() const { return numSessions_; }
+
+  // Tick statistics since the start of run(). Only call from the thread of
+  // run() or after it returned.
+  struct Stats {
+    size_t sessions;
+    uint64_t ticks;
+    double wallSeconds;
+    double cpuSeconds;
+    // Sessions one core could tick at the current cost per session
+    double sessionsPerCore;
+    // Microseconds that ticks started after their deadline
+    uint64_t jitterP50;
+    uint64_t jitterP99;
+    uint64_t jitterMax;
+  };
+  Stats stats() const;
+  std::string report() const;
+
+  // Clients with more unsent output than this are disconnected.
+  static constexpr size_t maxPendingBytes = 1 << 20;
+
+private:
+  struct Session {
+    uint64_t id;
+    int fd;
+    SocketTerminalManager *tm;
+    std::unique_ptr<TetrisGame> game;
+    bool playing{false};
+    // Waiting for the socket to become writable
+    bool writeBlocked{false};
+  };
+
+  // Accept all pending connections.
+  void acceptClients();
+
+  // Tick every session whose frame is due on the timer wheel and schedule
+  // its next frame.
+  void tickDueSessions();
+
+  // Read what the client sent into its key queue.
+  void readClient(Session *session);
+
+  // Simulate and draw one frame of a session.
+  void tickSession(Session *session);
+
+  // Send pending output and watch for writability if not all was sent.
+  void flushSession(Session *session);
+
+  // Disconnect and remove a session.
+  void closeSession(uint64_t id);
+
+  std::string path_;
+  int listenFd_{-1};
+  int epollFd_{-1};
+  int timerFd_{-1};
+  int stopFd_{-1};
+
+  std::unordered_map<uint64_t, Session> sessions_;
+  std::atomic<size_t> numSessions_{0};
+  uint64_t nextId_{1};
+  // Ids of closed sessions are never reused, so stale timers are harmless.
+  std::unique_ptr<TimerWheel> wheel_;
+
+  Histogram jitter_;
+  uint64_t ticks_{0};
+  Clock::time_point startTime_;
+  double startCpu_{0};
+  double wallSeconds_{0};
+  double cpuSeconds_{0};
+};
@@ -0,0 +1,32 @@
+// Copyright (C)
+
+#include "./TetrisServer.h"
+#include <csignal>
+#include <thread>
+
+// Hosts games for terminal clients on a Unix domain socket and prints the
+// number of sessions, sessions per core and tick jitter every 5 seconds.
+// Usage: ./TetrisServerMain <socket> [seconds]
+// Play with `socat -,raw,echo=0 UNIX-CONNECT:<socket>` in an 80x32 terminal.
+
+static TetrisServer *server = nullptr;
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: ./TetrisServerMain <socket> [seconds]\n");
+    return 2;
+  }
+  TetrisServer tetrisServer(argv[1]);
+  server = &tetrisServer;
+  signal(SIGINT, [](int) { server->stop(); });
+  signal(SIGTERM, [](int) { server->stop(); });
+  if (argc > 2) {
+    std::thread([seconds = std::stoi(argv[2])]() {
+      std::this_thread::sleep_for(std::chrono::seconds(seconds));
+      server->stop();
+    }).detach();
+  }
+  printf("Listening on %s\n", argv[1]);
+  tetrisServer.run(5);
+  printf("%s\n", tetrisServer.report().c_str());
+}
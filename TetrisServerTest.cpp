@@ -0,0 +1,151 @@
+// Copyright (C)
+
+#include "./LoadClients.h"
+#include "./TetrisServer.h"
+#include <gtest/gtest.h>
+#include <ncurses.h> // For keycodes
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+TEST(TimerWheel, advance) {
+  using std::chrono::milliseconds;
+  Clock::time_point start{};
+  TimerWheel wheel(milliseconds(1), 8, start);
+  wheel.schedule(1, start + milliseconds(5));
+  wheel.schedule(2, start + milliseconds(2));
+  // More than one turn of the wheel ahead, in the same slot as 1.
+  wheel.schedule(3, start + milliseconds(13));
+  ASSERT_EQ(wheel.size(), 3u);
+  std::vector<std::pair<uint64_t, int>> fired;
+  auto record = [&](uint64_t id, Clock::time_point deadline) {
+    fired.emplace_back(id, (deadline - start) / milliseconds(1));
+  };
+  wheel.advance(start + milliseconds(1), record);
+  ASSERT_TRUE(fired.empty());
+  wheel.advance(start + milliseconds(6), record);
+  ASSERT_EQ(fired, (std::vector<std::pair<uint64_t, int>>{{2, 2}, {1, 5}}));
+  wheel.advance(start + milliseconds(12), record);
+  ASSERT_EQ(fired.size(), 2u);
+  wheel.advance(start + milliseconds(13), record);
+  ASSERT_EQ(fired.back(), std::make_pair(uint64_t{3}, 13));
+  ASSERT_EQ(wheel.size(), 0u);
+  // Rescheduling from the callback, also into the past.
+  int count = 0;
+  std::function<void(uint64_t, Clock::time_point)> again =
+      [&](uint64_t id, Clock::time_point deadline) {
+        if (++count < 5) {
+          wheel.schedule(id, deadline);
+        }
+      };
+  wheel.schedule(4, start + milliseconds(14));
+  wheel.advance(start + milliseconds(20), again);
+  ASSERT_EQ(count, 5);
+  ASSERT_EQ(wheel.size(), 0u);
+}
+
+TEST(SocketTerminalManager, input) {
+  SocketTerminalManager tm(TetrisGame::colors());
+  const char keys[] = "a\x1b[D \x1b[";
+  tm.receive(keys, sizeof(keys) - 1);
+  // The arrow key continues in the next read.
+  tm.receive("C\x1b", 2);
+  for (int keycode : {97, KEY_LEFT, 32, KEY_RIGHT}) {
+    ASSERT_EQ(tm.getUserInput().keycode_, keycode);
+  }
+  // So may the ESC at the end: it is only pressed alone when nothing
+  // followed it for a while.
+  for (int i = 1; i < SocketTerminalManager::escapeReads; ++i) {
+    ASSERT_EQ(tm.getUserInput().keycode_, -1);
+  }
+  ASSERT_EQ(tm.getUserInput().keycode_, 27);
+  ASSERT_EQ(tm.getUserInput().keycode_, -1);
+  // An arrow key split after the ESC
+  tm.receive("\x1b", 1);
+  ASSERT_EQ(tm.getUserInput().keycode_, -1);
+  tm.receive("[A", 2);
+  ASSERT_EQ(tm.getUserInput().keycode_, KEY_UP);
+  ASSERT_EQ(tm.getUserInput().keycode_, -1);
+  // A lone ESC followed by another key in a later read
+  tm.receive("\x1b", 1);
+  tm.receive("a", 1);
+  ASSERT_EQ(tm.getUserInput().keycode_, 27);
+  ASSERT_EQ(tm.getUserInput().keycode_, 97);
+}
+
+TEST(SocketTerminalManager, floodedInput) {
+  // A client that sends far more keys than one per frame only fills the
+  // queue up to its limit, the keys after that are dropped.
+  SocketTerminalManager tm(TetrisGame::colors());
+  std::string flood(1 << 20, 'a');
+  flood.replace(0, 3, "\x1b[D");
+  for (int i = 0; i < 16; ++i) {
+    tm.receive(flood.data(), flood.size());
+  }
+  ASSERT_EQ(tm.numPendingKeys(), SocketTerminalManager::maxPendingKeys);
+  ASSERT_EQ(tm.getUserInput().keycode_, KEY_LEFT);
+  for (size_t i = 1; i < SocketTerminalManager::maxPendingKeys; ++i) {
+    ASSERT_EQ(tm.getUserInput().keycode_, 97);
+  }
+  ASSERT_EQ(tm.getUserInput().keycode_, -1);
+  // Once read, keys are taken again.
+  tm.receive("d", 1);
+  ASSERT_EQ(tm.getUserInput().keycode_, 100);
+}
+
+TEST(SocketTerminalManager, output) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  SocketTerminalManager tm(TetrisGame::colors());
+  tm.drawPixel(3, 4, 1);
+  tm.drawPixel(3, 5, 1);
+  tm.drawString(0, 0, 2, "NEXT");
+  ASSERT_GT(tm.pendingBytes(), 0u);
+  ASSERT_TRUE(tm.flush(fds[0]));
+  ASSERT_EQ(tm.pendingBytes(), 0u);
+  char buffer[1024];
+  ssize_t n = read(fds[1], buffer, sizeof(buffer));
+  std::string output(buffer, n);
+  // Border color once for both pixels, pixels are two characters wide.
+  ASSERT_NE(output.find("\x1b[4;9H\x1b[48;2;0;255;255m  \x1b[4;11H  "),
+            std::string::npos);
+  ASSERT_NE(output.find("\x1b[1;1H\x1b[38;2;255;0;255m\x1b[48;2;0;0;0mNEXT"),
+            std::string::npos);
+  ASSERT_THROW(tm.drawPixel(0, 0, 10), std::runtime_error);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(TetrisServer, sessions) {
+  const std::string path = "TetrisServerTest.socket";
+  TetrisServer server(path);
+  std::thread thread([&server]() { server.run(); });
+  {
+    LoadClients clients(path, 50);
+    // Every client starts a game and plays for a while.
+    clients.run(std::chrono::milliseconds(600),
+                std::chrono::milliseconds(20));
+    ASSERT_EQ(server.numSessions(), 50u);
+    ASSERT_EQ(clients.numConnected(), 50u);
+    for (int i = 0; i < 50; ++i) {
+      // Much more than the menu, so the game was drawn.
+      ASSERT_GT(clients.bytesReceived(i), 10'000u) << i;
+    }
+  }
+  // Disconnected clients are removed.
+  for (int i = 0; i < 500 && server.numSessions() > 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(server.numSessions(), 0u);
+  server.stop();
+  thread.join();
+  TetrisServer::Stats stats = server.stats();
+  // 60 ticks per second for 50 sessions
+  ASSERT_GT(stats.ticks, 50u * 20);
+  ASSERT_GT(stats.cpuSeconds, 0);
+  ASSERT_GE(stats.jitterMax, stats.jitterP99);
+  ASSERT_EQ(access(path.c_str(), F_OK), 0);
+}
@@ -0,0 +1,59 @@
+// Copyright (C)
+
+#include "./Tablebase.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Builds the tablebase of the small board into the file, continuing from the
+// checkpoint if there is one, and prints the expected lines of every
+// Tetromino on the empty board.
+// Usage: ./TetrisTablebaseMain <file> [--threads <n>] [--checkpoint <file>]
+//            [--sweeps <n>] [--bits <n>]
+
+static const char *usage =
+    "Usage: ./TetrisTablebaseMain <file> [--threads <n>] "
+    "[--checkpoint <file>] [--sweeps <n>] [--bits <n>]\n";
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argv[1][0] == '-') {
+    fprintf(stderr, "%s", usage);
+    return 2;
+  }
+  std::string path = argv[1];
+  TablebaseBuilder::Options options;
+  options.progress = stdout;
+  try {
+    for (int i = 2; i < argc; ++i) {
+      bool hasValue = i + 1 < argc;
+      if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+        options.threads = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--checkpoint") == 0 && hasValue) {
+        options.checkpoint = argv[++i];
+      } else if (strcmp(argv[i], "--sweeps") == 0 && hasValue) {
+        options.maxSweeps = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--bits") == 0 && hasValue) {
+        options.valueBits = std::stoi(argv[++i]);
+      } else {
+        fprintf(stderr, "%s", usage);
+        return 2;
+      }
+    }
+    TablebaseBuilder builder(options);
+    builder.build(path);
+    TablebaseBuilder::Stats stats = builder.stats();
+    printf("%lu boards, %d sweeps (%d from the checkpoint), largest change "
+           "%.6f, %.1f s\n",
+           stats.boards, stats.sweeps, stats.resumedSweeps, stats.delta,
+           stats.seconds);
+    Tablebase tablebase(path);
+    const char *names = "LJZSTIO";
+    for (int form = 0; form < 7; ++form) {
+      printf("Empty board, %c: %.3f expected lines\n", names[form],
+             tablebase.expectedLines(0, static_cast<TetrominoForm>(form)));
+    }
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n%s", e.what(), usage);
+    return 2;
+  }
+}
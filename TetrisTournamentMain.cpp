@@ -0,0 +1,57 @@
+// Copyright (C)
+
+#include "./Tournament.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// Plays a round robin of bots, solo score races and versus games, on all
+// cores and prints the standings and the throughput.
+// Usage: ./TetrisTournamentMain [--seeds <n>] [--frames <n>] [--threads <n>]
+//            [--export <prefix>] [<bot> ...]
+// A bot is "name" or "name:lines,holes,height,bumpiness[,framesPerKey]", see
+// BotConfig. Without bots, a few built-in ones play. With --export, every
+// settled Tetromino is written as training data to <prefix>.<worker>.
+
+static const char *usage =
+    "Usage: ./TetrisTournamentMain [--seeds <n>] [--frames <n>] "
+    "[--threads <n>] [--export <prefix>] [<bot> ...]\n"
+    "A bot is name or name:lines,holes,height,bumpiness[,framesPerKey]\n";
+
+int main(int argc, char **argv) {
+  Tournament::Options options;
+  std::vector<BotConfig> bots;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      bool hasValue = i + 1 < argc;
+      if (strcmp(argv[i], "--seeds") == 0 && hasValue) {
+        options.seeds = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+        options.maxFrames = std::stoull(argv[++i]);
+      } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+        options.threads = std::stoi(argv[++i]);
+      } else if (strcmp(argv[i], "--export") == 0 && hasValue) {
+        options.exportPrefix = argv[++i];
+      } else if (argv[i][0] == '-') {
+        fprintf(stderr, "%s", usage);
+        return 2;
+      } else {
+        bots.push_back(BotConfig::parse(argv[i]));
+      }
+    }
+    if (bots.empty()) {
+      for (const char *spec :
+           {"balanced", "holes-only:0,-10,0,0", "flat:1,-4,-0.2,-4",
+            "tall:3,-8,0.5,-1", "slow:3,-8,-0.5,-2,8"}) {
+        bots.push_back(BotConfig::parse(spec));
+      }
+    }
+    Tournament tournament(bots, options);
+    tournament.run();
+    tournament.print(stdout);
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n%s", e.what(), usage);
+    return 2;
+  }
+}
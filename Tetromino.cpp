@@ -1,37 +1,60 @@
 // Copyright (C)
 
 #include "./Tetromino.h"
-#include <regex>
 #include <utility>
 
-// Implementation of Tetromino class
+// Tables shared by all Tetrominos
+
+namespace {
+struct Tables {
+  // Map for the rotations in clockwise direction
+  std::map<std::pair<int, int>, std::pair<int, int>> rotationMapCW_;
+  std::pair<std::vector<std::pair<int, int>>, std::vector<std::pair<int, int>>>
+      rotationI_;
+
+  // Map for the forms
+  std::map<TetrominoForm, std::vector<std::pair<int, int>>> defaultForms_;
+
+  Tables() {
+    // Initialize rotation map for clockwise rotation
+    rotationMapCW_[std::make_pair(-1, -1)] = std::make_pair(1, -1);
+    rotationMapCW_[std::make_pair(0, -1)] = std::make_pair(1, 0);
+    rotationMapCW_[std::make_pair(1, -1)] = std::make_pair(1, 1);
+    rotationMapCW_[std::make_pair(-1, 0)] = std::make_pair(0, -1);
+    rotationMapCW_[std::make_pair(1, 0)] = std::make_pair(0, 1);
+    rotationMapCW_[std::make_pair(-1, 1)] = std::make_pair(-1, -1);
+    rotationMapCW_[std::make_pair(0, 1)] = std::make_pair(-1, 0);
+    rotationMapCW_[std::make_pair(1, 1)] = std::make_pair(-1, 1);
+    rotationMapCW_[std::make_pair(0, 0)] = std::make_pair(0, 0);
+
+    rotationI_.first = {std::make_pair(0, -2), std::make_pair(0, 1),
+                        std::make_pair(0, 0), std::make_pair(0, -1)};
+    rotationI_.second = {std::make_pair(-2, 0), std::make_pair(-1, 0),
+                         std::make_pair(0, 0), std::make_pair(1, 0)};
+
+    // Initialize default forms
+    defaultForms_[TetrominoForm::I] = rotationI_.first;
+    defaultForms_[TetrominoForm::J] = {{-1, 1}, {0, 0}, {0, 1}, {0, -1}};
+    defaultForms_[TetrominoForm::L] = {{1, 1}, {0, 0}, {0, 1}, {0, -1}};
+    defaultForms_[TetrominoForm::O] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+    defaultForms_[TetrominoForm::S] = {{-1, 1}, {0, 0}, {0, 1}, {1, 0}};
+    defaultForms_[TetrominoForm::T] = {{0, 1}, {0, 0}, {-1, 0}, {1, 0}};
+    defaultForms_[TetrominoForm::Z] = {{1, 1}, {0, 0}, {0, 1}, {-1, 0}};
+    // N has no blocks
+    defaultForms_[TetrominoForm::N] = {};
+  }
+};
 
-Tetromino::Tetromino(TetrominoForm form) : form_(form) {
-  // Initialize rotation map for clockwise rotation
-  rotationMapCW_[std::make_pair(-1, -1)] = std::make_pair(1, -1);
-  rotationMapCW_[std::make_pair(0, -1)] = std::make_pair(1, 0);
-  rotationMapCW_[std::make_pair(1, -1)] = std::make_pair(1, 1);
-  rotationMapCW_[std::make_pair(-1, 0)] = std::make_pair(0, -1);
-  rotationMapCW_[std::make_pair(1, 0)] = std::make_pair(0, 1);
-  rotationMapCW_[std::make_pair(-1, 1)] = std::make_pair(-1, -1);
-  rotationMapCW_[std::make_pair(0, 1)] = std::make_pair(-1, 0);
-  rotationMapCW_[std::make_pair(1, 1)] = std::make_pair(-1, 1);
-  rotationMapCW_[std::make_pair(0, 0)] = std::make_pair(0, 0);
-
-  rotationI_.first = {std::make_pair(0, -2), std::make_pair(0, 1),
-                      std::make_pair(0, 0), std::make_pair(0, -1)};
-  rotationI_.second = {std::make_pair(-2, 0), std::make_pair(-1, 0),
-                       std::make_pair(0, 0), std::make_pair(1, 0)};
-
-  // Initialize default forms
-  defaultForms_[TetrominoForm::I] = rotationI_.first;
-  defaultForms_[TetrominoForm::J] = {{-1, 1}, {0, 0}, {0, 1}, {0, -1}};
-  defaultForms_[TetrominoForm::L] = {{1, 1}, {0, 0}, {0, 1}, {0, -1}};
-  defaultForms_[TetrominoForm::O] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
-  defaultForms_[TetrominoForm::S] = {{-1, 1}, {0, 0}, {0, 1}, {1, 0}};
-  defaultForms_[TetrominoForm::T] = {{0, 1}, {0, 0}, {-1, 0}, {1, 0}};
-  defaultForms_[TetrominoForm::Z] = {{1, 1}, {0, 0}, {0, 1}, {-1, 0}};
+// Created on first use, thread safe.
+const Tables &tables() {
+  static const Tables tables;
+  return tables;
 }
+} // namespace
+
+// Implementation of Tetromino class
+
+Tetromino::Tetromino(TetrominoForm form) : form_(form) {}
 
 void Tetromino::rotateCW(bool direction) {
   if (!direction) {
@@ -41,4 +64,39 @@ void Tetromino::rotateCW(bool direction) {
     rotation_ =
         static_cast<TetrominoRotation>((static_cast<int>(rotation_) + 3) % 4);
   }
-}
\ No newline at end of file
+}
+
+std::pair<int, int>
+Tetromino::getRotation(std::pair<int, int> coordinate) const {
+  auto it = tables().rotationMapCW_.find(coordinate);
+  return it != tables().rotationMapCW_.end() ? it->second
+                                             : std::make_pair(0, 0);
+}
+
+std::vector<std::pair<int, int>> Tetromino::getDefaultForm() const {
+  return tables().defaultForms_.at(form_);
+}
+
+std::vector<std::pair<int, int>> Tetromino::getIRotation(bool up) const {
+  if (up) {
+    return tables().rotationI_.first;
+  } else {
+    return tables().rotationI_.second;
+  }
+}
+
+std::vector<std::pair<int, int>> Tetromino::getRotatedForm(int rotation) const {
+  if (form_ == TetrominoForm::I) {
+    return getIRotation(rotation % 2 == 0);
+  }
+  std::vector<std::pair<int, int>> points = getDefaultForm();
+  if (form_ != TetrominoForm::O) {
+    // Like TetrisGame::bufferTetromino()
+    for (auto &point : points) {
+      for (int i = 0; i < 4 - rotation % 4; ++i) {
+        point = getRotation(point);
+      }
+    }
+  }
+  return points;
+}
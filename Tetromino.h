@@ -37,21 +37,16 @@ public:
   TetrominoForm form() const { return form_; }
   TetrominoRotation rotation() const { return rotation_; }
 
-  std::pair<int, int> getRotation(std::pair<int, int> coordinate) {
-    return rotationMapCW_[coordinate];
-  }
-
-  std::vector<std::pair<int, int>> getDefaultForm() {
-    return defaultForms_[form_];
-  }
-
-  std::vector<std::pair<int, int>> getIRotation(bool up) {
-    if (up) {
-      return rotationI_.first;
-    } else {
-      return rotationI_.second;
-    }
-  }
+  std::pair<int, int> getRotation(std::pair<int, int> coordinate) const;
+
+  std::vector<std::pair<int, int>> getDefaultForm() const;
+
+  std::vector<std::pair<int, int>> getIRotation(bool up) const;
+
+  // The blocks of the form in the given rotation, the way the game buffers
+  // them: 0 to 3 like TetrominoRotation, for I 0 is upright and 1 flat, O
+  // does not rotate. For searches that try all rotations.
+  std::vector<std::pair<int, int>> getRotatedForm(int rotation) const;
 
 private:
   // Form of the Tetromino
@@ -60,11 +55,7 @@ private:
   // Rotation of the Tetromino
   TetrominoRotation rotation_ = NORTH;
 
-  // Map for the rotations in clockwise direction
-  std::map<std::pair<int, int>, std::pair<int, int>> rotationMapCW_;
-  std::pair<std::vector<std::pair<int, int>>, std::vector<std::pair<int, int>>>
-      rotationI_;
-
-  // Map for the forms
-  std::map<TetrominoForm, std::vector<std::pair<int, int>>> defaultForms_;
+  // The rotation map and the forms are the same for every Tetromino, so they
+  // are shared (see Tetromino.cpp) and a Tetromino is cheap to create and
+  // copy.
 };
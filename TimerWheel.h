@@ -0,0 +1,86 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A hashed timer wheel: timers are put into the slot of their deadline, so
+// scheduling is constant time and advancing only looks at the slots that
+// passed, however many timers there are. Timers more than one turn of the
+// wheel ahead stay in their slot until their turn comes.
+class TimerWheel {
+public:
+  // A wheel with the given number of slots, each `resolution` long, starting
+  // at `start`.
+  TimerWheel(Clock::duration resolution, size_t numSlots,
+             Clock::time_point start)
+      : resolution_(resolution), start_(start), slots_(numSlots) {}
+
+  // Schedule the id for the deadline. Deadlines that passed already are due
+  // in the next slot that is advanced.
+  void schedule(uint64_t id, Clock::time_point deadline) {
+    // Rounded up, so that no timer is due before its deadline.
+    uint64_t tick = tickOf(deadline + resolution_ - Clock::duration(1));
+    tick = std::max(tick, currentTick_ + advancing_);
+    slots_[tick % slots_.size()].push_back(Timer{id, deadline, tick});
+    size_++;
+  }
+
+  // Call callback(id, deadline) for every timer that is due at `now`, in the
+  // order of their slots. Callbacks may schedule again.
+  template <class Callback> void advance(Clock::time_point now, Callback cb) {
+    uint64_t nowTick = tickOf(now);
+    for (; currentTick_ <= nowTick; ++currentTick_) {
+      auto &slot = slots_[currentTick_ % slots_.size()];
+      if (slot.empty()) {
+        continue;
+      }
+      due_.clear();
+      due_.swap(slot);
+      advancing_ = true;
+      for (const Timer &timer : due_) {
+        if (timer.tick <= currentTick_) {
+          size_--;
+          cb(timer.id, timer.deadline);
+        } else {
+          slot.push_back(timer);
+        }
+      }
+      advancing_ = false;
+    }
+  }
+
+  // Number of scheduled timers
+  size_t size() const { return size_; }
+
+  // Start of the next slot that advance() looks at
+  Clock::time_point nextTick() const {
+    return start_ + currentTick_ * resolution_;
+  }
+
+private:
+  struct Timer {
+    uint64_t id;
+    Clock::time_point deadline;
+    uint64_t tick;
+  };
+
+  // Number of the slot the time falls into, counted from the start
+  uint64_t tickOf(Clock::time_point time) const {
+    return time <= start_ ? 0 : (time - start_) / resolution_;
+  }
+
+  Clock::duration resolution_;
+  Clock::time_point start_;
+  std::vector<std::vector<Timer>> slots_;
+  // Reused for the timers of the slot that is advanced
+  std::vector<Timer> due_;
+  uint64_t currentTick_{0};
+  // Callbacks of the current slot are running
+  bool advancing_{false};
+  size_t size_{0};
+};
@@ -0,0 +1,209 @@
+// Copyright (C)
+
+#include "./Tournament.h"
+#include "./Versus.h"
+#include "./WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+
+// A headless game that starts with the seed
+static std::unique_ptr<TetrisGame> startGame(uint64_t seed,
+                                             TrainingWriter *training) {
+  auto game =
+      std::make_unique<TetrisGame>(std::make_unique<HeadlessTerminalManager>());
+  game->setSeed(seed);
+  game->exportTrainingTo(training);
+  game->newGame();
+  return game;
+}
+
+// ____________________________________________________________________________
+Tournament::Match Tournament::playSolo(const BotConfig &first,
+                                       const BotConfig &second, uint64_t seed,
+                                       uint64_t maxFrames,
+                                       TrainingWriter *training) {
+  Match match{-1, {0, 0}, {0, 0}, 0};
+  const BotConfig *configs[] = {&first, &second};
+  for (int i = 0; i < 2; ++i) {
+    auto game = startGame(seed, training);
+    Bot bot(*configs[i]);
+    UserInput uI;
+    for (uint64_t frame = 0; frame < maxFrames && !game->gameOver();
+         ++frame) {
+      uI.keycode_ = bot.nextKey(*game);
+      game->simulateFrame(uI);
+      match.frames++;
+    }
+    BroadcastFrame result = game->broadcastFrame();
+    match.score[i] = result.score;
+    match.lines[i] = result.lines;
+  }
+  if (match.score[0] != match.score[1]) {
+    match.winner = match.score[0] > match.score[1] ? 0 : 1;
+  }
+  return match;
+}
+
+// ____________________________________________________________________________
+Tournament::Match Tournament::playVersus(const BotConfig &first,
+                                         const BotConfig &second,
+                                         uint64_t seed, uint64_t maxFrames,
+                                         TrainingWriter *training) {
+  Match match{-1, {0, 0}, {0, 0}, 0};
+  std::unique_ptr<TetrisGame> games[] = {startGame(seed, training),
+                                        startGame(seed, training)};
+  Bot bots[] = {Bot(first), Bot(second)};
+  int pendingGarbage[2] = {0, 0};
+  std::minstd_rand random(seed);
+  for (int i = 0; i < 2; ++i) {
+    // Like in Versus, garbage is taken when the next Tetromino settles.
+    games[i]->onSettle([&, i](int cleared) {
+      pendingGarbage[1 - i] += Versus::garbageFor(cleared);
+      if (pendingGarbage[i] > 0) {
+        games[i]->addGarbage(pendingGarbage[i],
+                             random() % StandardBoard::width);
+        pendingGarbage[i] = 0;
+      }
+    });
+  }
+  UserInput uI;
+  for (uint64_t frame = 0;
+       frame < maxFrames && !games[0]->gameOver() && !games[1]->gameOver();
+       ++frame) {
+    for (int i = 0; i < 2; ++i) {
+      uI.keycode_ = bots[i].nextKey(*games[i]);
+      games[i]->simulateFrame(uI);
+      match.frames++;
+    }
+  }
+  for (int i = 0; i < 2; ++i) {
+    BroadcastFrame result = games[i]->broadcastFrame();
+    match.score[i] = result.score;
+    match.lines[i] = result.lines;
+  }
+  if (games[0]->gameOver() != games[1]->gameOver()) {
+    match.winner = games[0]->gameOver() ? 1 : 0;
+  }
+  return match;
+}
+
+// ____________________________________________________________________________
+Tournament::Tournament(std::vector<BotConfig> bots, const Options &options)
+    : bots_(std::move(bots)), options_(options) {
+  if (bots_.size() < 2) {
+    throw std::invalid_argument("A tournament needs at least two bots");
+  }
+}
+
+// ____________________________________________________________________________
+void Tournament::run() {
+  WorkStealingPool pool(options_.threads);
+  // Every worker adds up its own matches, on its own cache lines.
+  struct alignas(64) WorkerResults {
+    std::vector<Standing> standings;
+    uint64_t matches{0};
+    uint64_t frames{0};
+  };
+  std::vector<WorkerResults> results(pool.numThreads());
+  for (WorkerResults &worker : results) {
+    worker.standings.resize(bots_.size());
+  }
+  std::vector<std::unique_ptr<TrainingWriter>> training(pool.numThreads());
+  if (!options_.exportPrefix.empty()) {
+    for (size_t i = 0; i < training.size(); ++i) {
+      training[i] = std::make_unique<TrainingWriter>(options_.exportPrefix +
+                                                     "." + std::to_string(i));
+    }
+  }
+  auto start = std::chrono::steady_clock::now();
+  int numBots = bots_.size();
+  for (int a = 0; a < numBots; ++a) {
+    for (int b = a + 1; b < numBots; ++b) {
+      for (Mode mode : {Mode::Solo, Mode::Versus}) {
+        for (int s = 0; s < options_.seeds; ++s) {
+          pool.submit([this, &results, &training, a, b, mode, s](int worker) {
+            uint64_t seed = options_.seed + s;
+            TrainingWriter *writer = training[worker].get();
+            Match match = mode == Mode::Solo
+                              ? playSolo(bots_[a], bots_[b], seed,
+                                         options_.maxFrames, writer)
+                              : playVersus(bots_[a], bots_[b], seed,
+                                           options_.maxFrames, writer);
+            WorkerResults &own = results[worker];
+            own.matches++;
+            own.frames += match.frames;
+            int players[] = {a, b};
+            for (int i = 0; i < 2; ++i) {
+              Standing &standing = own.standings[players[i]];
+              standing.played++;
+              standing.wins += match.winner == i;
+              standing.draws += match.winner == -1;
+              standing.losses += match.winner == 1 - i;
+              standing.score += match.score[i];
+              standing.lines += match.lines[i];
+            }
+          });
+        }
+      }
+    }
+  }
+  pool.wait();
+  stats_ = Stats{};
+  for (auto &writer : training) {
+    if (writer) {
+      writer->close();
+      stats_.records += writer->numRecords();
+    }
+  }
+  stats_.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  stats_.threads = pool.numThreads();
+  stats_.steals = pool.steals();
+  standings_.assign(bots_.size(), Standing{});
+  for (int i = 0; i < numBots; ++i) {
+    standings_[i].name = bots_[i].name;
+  }
+  for (const WorkerResults &worker : results) {
+    stats_.matches += worker.matches;
+    stats_.frames += worker.frames;
+    for (int i = 0; i < numBots; ++i) {
+      const Standing &own = worker.standings[i];
+      standings_[i].played += own.played;
+      standings_[i].wins += own.wins;
+      standings_[i].draws += own.draws;
+      standings_[i].losses += own.losses;
+      standings_[i].score += own.score;
+      standings_[i].lines += own.lines;
+    }
+  }
+}
+
+// ____________________________________________________________________________
+void Tournament::print(FILE *file) const {
+  std::vector<Standing> sorted = standings_;
+  auto points = [](const Standing &s) { return 2 * s.wins + s.draws; };
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [&points](const Standing &a, const Standing &b) {
+                     return points(a) > points(b);
+                   });
+  fprintf(file, "%-16s %6s %5s %5s %5s %6s %10s %8s\n", "Bot", "Played",
+          "Won", "Drawn", "Lost", "Points", "Avg score", "Avg lines");
+  for (const Standing &s : sorted) {
+    double played = std::max<uint64_t>(s.played, 1);
+    fprintf(file, "%-16s %6lu %5lu %5lu %5lu %6lu %10.0f %8.1f\n",
+            s.name.c_str(), s.played, s.wins, s.draws, s.losses, points(s),
+            s.score / played, s.lines / played);
+  }
+  fprintf(file,
+          "%lu matches in %.2f s on %d threads: %.1f matches/s, %.2f M "
+          "frames/s (%.2f M per thread), %lu steals\n",
+          stats_.matches, stats_.seconds, stats_.threads,
+          stats_.matches / stats_.seconds, stats_.frames / stats_.seconds / 1e6,
+          stats_.frames / stats_.seconds / 1e6 / stats_.threads, stats_.steals);
+  if (stats_.records > 0) {
+    fprintf(file, "%lu training records exported\n", stats_.records);
+  }
+}
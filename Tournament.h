@@ -0,0 +1,94 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Bot.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Plays every pair of bots against each other on a number of seeds, as a
+// solo score race and as a versus game, on a WorkStealingPool. Every match
+// is a task and runs headless on the simulation of TetrisGame. Workers keep
+// their own standings, which are summed up after all matches, so nothing is
+// shared while the matches run.
+class Tournament {
+public:
+  struct Options {
+    // Matches per pair and mode, with the seeds seed, seed + 1, ...
+    int seeds{4};
+    uint64_t seed{1};
+    // A match is a draw when nobody won after this many frames.
+    uint64_t maxFrames{3 * 60 * 60};
+    // Zero means one per core.
+    int threads{0};
+    // If set, every settled Tetromino is exported as training data to
+    // <exportPrefix>.<worker>, one file per worker.
+    std::string exportPrefix;
+  };
+
+  enum class Mode { Solo, Versus };
+
+  // Result of one match of two bots
+  struct Match {
+    // 0 or 1, -1 for a draw
+    int winner;
+    int score[2];
+    int lines[2];
+    // Frames simulated, of both boards
+    uint64_t frames;
+  };
+
+  // Solo score race: both bots play the same sequence of Tetrominos on their
+  // own board until their game is over or the time is up, the higher score
+  // wins.
+  static Match playSolo(const BotConfig &first, const BotConfig &second,
+                        uint64_t seed, uint64_t maxFrames,
+                        TrainingWriter *training = nullptr);
+
+  // Versus: the same sequence of Tetrominos, and cleared lines send garbage
+  // to the other board like in Versus. The last board standing wins.
+  static Match playVersus(const BotConfig &first, const BotConfig &second,
+                          uint64_t seed, uint64_t maxFrames,
+                          TrainingWriter *training = nullptr);
+
+  Tournament(std::vector<BotConfig> bots, const Options &options);
+
+  // Play all matches.
+  void run();
+
+  struct Standing {
+    std::string name;
+    uint64_t played;
+    uint64_t wins;
+    uint64_t draws;
+    uint64_t losses;
+    // Over all matches
+    uint64_t score;
+    uint64_t lines;
+  };
+  // Standings of the bots, in the order they were given
+  const std::vector<Standing> &standings() const { return standings_; }
+
+  struct Stats {
+    uint64_t matches;
+    uint64_t frames;
+    double seconds;
+    int threads;
+    uint64_t steals;
+    // Exported training records
+    uint64_t records;
+  };
+  Stats stats() const { return stats_; }
+
+  // Write the standings sorted by points (2 for a win, 1 for a draw) and the
+  // throughput.
+  void print(FILE *file) const;
+
+private:
+  std::vector<BotConfig> bots_;
+  Options options_;
+  std::vector<Standing> standings_;
+  Stats stats_{};
+};
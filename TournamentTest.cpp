@@ -0,0 +1,145 @@
+// Copyright (C)
+
+#include "./Tournament.h"
+#include "./WorkStealingPool.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+
+// Tasks that split themselves up like a recursive search.
+static void split(WorkStealingPool *pool, std::atomic<int> *leaves,
+                  int depth) {
+  if (depth == 0) {
+    (*leaves)++;
+    return;
+  }
+  for (int i = 0; i < 2; ++i) {
+    pool->submit(
+        [pool, leaves, depth](int) { split(pool, leaves, depth - 1); });
+  }
+}
+
+TEST(WorkStealingPool, recursiveTasks) {
+  WorkStealingPool pool(4);
+  ASSERT_EQ(pool.numThreads(), 4);
+  std::atomic<int> leaves{0};
+  std::atomic<bool> validWorkers{true};
+  pool.submit([&](int worker) {
+    validWorkers = validWorkers && worker >= 0 && worker < 4;
+    split(&pool, &leaves, 10);
+  });
+  pool.wait();
+  ASSERT_EQ(leaves, 1024);
+  ASSERT_TRUE(validWorkers);
+  // The pool can be used again after waiting.
+  pool.submit([&](int) { leaves = 0; });
+  pool.wait();
+  ASSERT_EQ(leaves, 0);
+}
+
+TEST(Bot, parse) {
+  BotConfig config = BotConfig::parse("flat:1,-4,-0.5,-3,6");
+  ASSERT_EQ(config.name, "flat");
+  ASSERT_EQ(config.lines, 1);
+  ASSERT_EQ(config.holes, -4);
+  ASSERT_EQ(config.height, -0.5);
+  ASSERT_EQ(config.bumpiness, -3);
+  ASSERT_EQ(config.framesPerKey, 6);
+  ASSERT_EQ(BotConfig::parse("plain").holes, BotConfig{}.holes);
+  ASSERT_THROW(BotConfig::parse("broken:1,2"), std::invalid_argument);
+  ASSERT_THROW(BotConfig::parse(":1,2,3,4"), std::invalid_argument);
+}
+
+TEST(Bot, clearsLines) {
+  BotConfig config = BotConfig::parse("bot");
+  Tournament::Match match = Tournament::playSolo(config, config, 3, 3000);
+  // The same bot on the same Tetrominos plays the same game.
+  ASSERT_EQ(match.winner, -1);
+  ASSERT_EQ(match.lines[0], match.lines[1]);
+  ASSERT_GE(match.lines[0], 10);
+  ASSERT_EQ(match.frames, 6000u);
+
+  // Without any sense for holes, it does not survive for long.
+  Tournament::Match versus = Tournament::playVersus(
+      config, BotConfig::parse("bad:0,0,1,0"), 3, 6000);
+  ASSERT_EQ(versus.winner, 0);
+}
+
+namespace {
+// A game whose blocks can be settled directly, without garbage or snapshots
+class BlockGame : public TetrisGame {
+public:
+  BlockGame() : TetrisGame(std::make_unique<HeadlessTerminalManager>()) {}
+  void settle(int x, int y, int color) { screen_.settle(x, y, color); }
+};
+} // namespace
+
+TEST(Bot, plansOnGarbage) {
+  // A bot has to play the same on garbage as on the same cells settled
+  // by Tetrominos: holes and clears do not depend on the color.
+  BlockGame garbage;
+  BlockGame blocks;
+  for (BlockGame *game : {&garbage, &blocks}) {
+    game->setSeed(5);
+    game->newGame();
+  }
+  garbage.addGarbage(3, 2);
+  for (int y = StandardBoard::height - 3; y < StandardBoard::height; ++y) {
+    for (int x = 0; x < StandardBoard::width; ++x) {
+      if (x != 2) {
+        blocks.settle(x, y, 3);
+      }
+    }
+  }
+  Bot bots[] = {Bot(BotConfig{}), Bot(BotConfig{})};
+  UserInput uI;
+  for (int frame = 0; frame < 2000; ++frame) {
+    uI.keycode_ = bots[0].nextKey(garbage);
+    ASSERT_EQ(bots[1].nextKey(blocks), uI.keycode_) << frame;
+    garbage.simulateFrame(uI);
+    blocks.simulateFrame(uI);
+  }
+  GameState played = garbage.snapshot();
+  ASSERT_GT(played.lines, 3);
+  ASSERT_FALSE(played.gameOver);
+  ASSERT_EQ(played.lines, blocks.snapshot().lines);
+  ASSERT_EQ(played.score, blocks.snapshot().score);
+}
+
+TEST(Tournament, roundRobin) {
+  std::vector<BotConfig> bots = {BotConfig::parse("a"),
+                                 BotConfig::parse("b:1,-4,-0.2,-4"),
+                                 BotConfig::parse("c:3,-8,-0.5,-2,8")};
+  Tournament::Options options;
+  options.seeds = 2;
+  options.maxFrames = 300;
+  options.threads = 3;
+  Tournament tournament(bots, options);
+  tournament.run();
+  Tournament::Stats stats = tournament.stats();
+  // 3 pairs, 2 modes, 2 seeds
+  ASSERT_EQ(stats.matches, 12u);
+  ASSERT_GT(stats.frames, 0u);
+  ASSERT_EQ(stats.threads, 3);
+  uint64_t wins = 0;
+  uint64_t losses = 0;
+  for (const Tournament::Standing &standing : tournament.standings()) {
+    ASSERT_EQ(standing.played, 8u);
+    ASSERT_EQ(standing.wins + standing.draws + standing.losses, 8u);
+    wins += standing.wins;
+    losses += standing.losses;
+  }
+  ASSERT_EQ(wins, losses);
+  ASSERT_EQ(tournament.standings()[1].name, "b");
+
+  // The results do not depend on the number of threads.
+  options.threads = 1;
+  Tournament single(bots, options);
+  single.run();
+  for (size_t i = 0; i < bots.size(); ++i) {
+    ASSERT_EQ(single.standings()[i].wins, tournament.standings()[i].wins);
+    ASSERT_EQ(single.standings()[i].score, tournament.standings()[i].score);
+  }
+  ASSERT_THROW(Tournament({bots[0]}, options), std::invalid_argument);
+}
@@ -0,0 +1,99 @@
+// Copyright (C)
+
+#include "./Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+// Names of the events and of their arguments in the trace file.
+static const struct {
+  const char *name;
+  const char *args[3];
+} eventNames[TRACE_NUM_EVENTS] = {
+    {"drawPixel", {"row", "col", "color"}},
+    {"input", {"keycode", nullptr, nullptr}},
+    {"drawScreen", {nullptr, nullptr, nullptr}},
+    {"tick", {nullptr, nullptr, nullptr}},
+    {"settle", {nullptr, nullptr, nullptr}},
+    {"dropFrame", {"pendingBytes", nullptr, nullptr}}};
+
+// ____________________________________________________________________________
+TraceBuffer::TraceBuffer(int threadId)
+    : records_(new TraceRecord[capacity]), threadId_(threadId) {}
+
+// ____________________________________________________________________________
+std::vector<TraceRecord> TraceBuffer::records() const {
+  uint64_t head = head_.load(std::memory_order_acquire);
+  uint64_t first = head > capacity ? head - capacity : 0;
+  std::vector<TraceRecord> records;
+  records.reserve(head - first);
+  for (uint64_t i = first; i < head; ++i) {
+    records.push_back(records_[i & (capacity - 1)]);
+  }
+  return records;
+}
+
+// ____________________________________________________________________________
+uint64_t TraceBuffer::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// ____________________________________________________________________________
+Tracer &Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+// ____________________________________________________________________________
+TraceBuffer *Tracer::registerThread() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffers_.push_back(std::make_unique<TraceBuffer>(buffers_.size() + 1));
+  return buffers_.back().get();
+}
+
+// ____________________________________________________________________________
+void Tracer::writeChromeTrace(const std::string &path) const {
+  FILE *file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    throw std::runtime_error("Could not open trace file " + path);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  fprintf(file, "{\"traceEvents\":[");
+  bool first = true;
+  for (const auto &buffer : buffers_) {
+    for (const TraceRecord &record : buffer->records()) {
+      const auto &names = eventNames[record.event];
+      fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,",
+              first ? "" : ",", names.name, record.phase,
+              record.timestamp / 1000.0);
+      fprintf(file, "\"pid\":1,\"tid\":%d", buffer->threadId());
+      if (record.phase == 'i') {
+        fprintf(file, ",\"s\":\"t\",\"args\":{");
+        for (int i = 0; i < 3 && names.args[i] != nullptr; ++i) {
+          fprintf(file, "%s\"%s\":%d", i == 0 ? "" : ",", names.args[i],
+                  record.args[i]);
+        }
+        fprintf(file, "}");
+      }
+      fprintf(file, "}");
+      first = false;
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+}
+
+// ____________________________________________________________________________
+Tracer::~Tracer() {
+#ifdef TETRIS_TRACE
+  const char *path = getenv("TETRIS_TRACE_FILE");
+  try {
+    writeChromeTrace(path != nullptr ? path : "tetris-trace.json");
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n", e.what());
+  }
+#endif
+}
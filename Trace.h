@@ -0,0 +1,129 @@
+// Copyright (C)
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Low overhead event tracing. Every thread writes fixed size binary records
+// into its own ring buffer, without locks and without allocations. When the
+// program exits, all buffers are written as a Chrome trace (load it in
+// chrome://tracing or https://ui.perfetto.dev).
+//
+// Tracing is compiled out completely unless TETRIS_TRACE is defined
+// (`make TRACE=1`). The trace file is tetris-trace.json or the path in the
+// environment variable TETRIS_TRACE_FILE.
+
+// The traced events.
+enum TraceEvent : uint8_t {
+  TRACE_DRAW_PIXEL,
+  TRACE_INPUT,
+  TRACE_DRAW_SCREEN,
+  TRACE_TICK,
+  TRACE_SETTLE,
+  TRACE_DROP_FRAME,
+  TRACE_NUM_EVENTS
+};
+
+// One traced event. Phase is 'i' for an instant, 'B' and 'E' for the begin
+// and end of a duration.
+struct TraceRecord {
+  uint64_t timestamp;
+  uint8_t event;
+  char phase;
+  int16_t args[3];
+};
+static_assert(sizeof(TraceRecord) == 16, "Trace records should be small");
+
+// The ring buffer of one thread. Only its own thread writes, the newest
+// records overwrite the oldest.
+class TraceBuffer {
+public:
+  static constexpr uint64_t capacity = 1 << 16;
+
+  explicit TraceBuffer(int threadId);
+
+  // Append an instant record.
+  void instant(TraceEvent event, int a = 0, int b = 0, int c = 0) {
+    record(event, 'i', a, b, c);
+  }
+
+  // Append a record.
+  void record(TraceEvent event, char phase, int a = 0, int b = 0, int c = 0) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    records_[head & (capacity - 1)] =
+        TraceRecord{now(), event, phase,
+                    {static_cast<int16_t>(a), static_cast<int16_t>(b),
+                     static_cast<int16_t>(c)}};
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  // The records still in the buffer, oldest first.
+  std::vector<TraceRecord> records() const;
+
+  int threadId() const { return threadId_; }
+
+  // Monotonic time in nanoseconds.
+  static uint64_t now();
+
+private:
+  std::unique_ptr<TraceRecord[]> records_;
+  std::atomic<uint64_t> head_{0};
+  int threadId_;
+};
+
+// Owns the buffers of all threads.
+class Tracer {
+public:
+  static Tracer &instance();
+
+  // The buffer of the calling thread. Registering a new thread takes a lock,
+  // after that it is a thread local lookup.
+  static TraceBuffer &threadBuffer() {
+    thread_local TraceBuffer *buffer = instance().registerThread();
+    return *buffer;
+  }
+
+  // Write all buffers as a Chrome trace JSON file.
+  void writeChromeTrace(const std::string &path) const;
+
+  // Writes the trace file if tracing is compiled in.
+  ~Tracer();
+
+private:
+  Tracer() = default;
+  TraceBuffer *registerThread();
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+};
+
+// Traces the lifetime of a scope as a duration.
+class TraceScope {
+public:
+  explicit TraceScope(TraceEvent event) : event_(event) {
+    Tracer::threadBuffer().record(event_, 'B');
+  }
+  ~TraceScope() { Tracer::threadBuffer().record(event_, 'E'); }
+
+private:
+  TraceEvent event_;
+};
+
+#ifdef TETRIS_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_EVENT(...) Tracer::threadBuffer().instant(__VA_ARGS__)
+#define TRACE_SCOPE(event) TraceScope TRACE_CONCAT(traceScope, __LINE__)(event)
+#else
+#define TRACE_EVENT(...)                                                       \
+  do {                                                                         \
+  } while (0)
+#define TRACE_SCOPE(event)                                                     \
+  do {                                                                         \
+  } while (0)
+#endif
@@ -0,0 +1,59 @@
+// Copyright (C)
+
+#include "./Trace.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+
+TEST(TraceBuffer, record) {
+  TraceBuffer buffer(1);
+  buffer.instant(TRACE_DRAW_PIXEL, 3, 4, 5);
+  buffer.record(TRACE_SETTLE, 'B');
+  buffer.record(TRACE_SETTLE, 'E');
+  std::vector<TraceRecord> records = buffer.records();
+  ASSERT_EQ(records.size(), 3u);
+  ASSERT_EQ(records[0].event, TRACE_DRAW_PIXEL);
+  ASSERT_EQ(records[0].phase, 'i');
+  ASSERT_EQ(records[0].args[1], 4);
+  ASSERT_EQ(records[1].phase, 'B');
+  ASSERT_EQ(records[2].phase, 'E');
+  ASSERT_LE(records[0].timestamp, records[2].timestamp);
+}
+
+TEST(TraceBuffer, overwritesOldest) {
+  TraceBuffer buffer(1);
+  for (uint64_t i = 0; i < TraceBuffer::capacity + 10; ++i) {
+    buffer.instant(TRACE_INPUT, i % 1000);
+  }
+  std::vector<TraceRecord> records = buffer.records();
+  ASSERT_EQ(records.size(), TraceBuffer::capacity);
+  // The first 10 records are gone.
+  ASSERT_EQ(records.front().args[0], 10);
+  ASSERT_EQ(records.back().args[0], (TraceBuffer::capacity + 9) % 1000);
+}
+
+TEST(Tracer, chromeTrace) {
+  // Every thread gets its own buffer and id.
+  Tracer::threadBuffer().instant(TRACE_INPUT, 97);
+  std::thread([]() {
+    TraceScope scope(TRACE_TICK);
+  }).join();
+  ASSERT_NE(&Tracer::threadBuffer(), nullptr);
+  const char *path = "TraceTest.json";
+  Tracer::instance().writeChromeTrace(path);
+  std::ifstream file(path);
+  std::stringstream json;
+  json << file.rdbuf();
+  std::remove(path);
+  ASSERT_EQ(json.str().rfind("{\"traceEvents\":[", 0), 0u);
+  ASSERT_NE(json.str().find("\"name\":\"input\",\"ph\":\"i\""),
+            std::string::npos);
+  ASSERT_NE(json.str().find("\"keycode\":97"), std::string::npos);
+  ASSERT_NE(json.str().find("\"name\":\"tick\",\"ph\":\"B\""),
+            std::string::npos);
+  ASSERT_NE(json.str().find("\"name\":\"tick\",\"ph\":\"E\""),
+            std::string::npos);
+  ASSERT_NE(json.str().find("\"tid\":2"), std::string::npos);
+}
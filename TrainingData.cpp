@@ -0,0 +1,297 @@
+// Copyright (C)
+
+#include "./TrainingData.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+static constexpr char trainingMagic[4] = {'T', 'T', 'R', 'N'};
+static constexpr char trainingIndexMagic[4] = {'T', 'T', 'R', 'X'};
+static constexpr uint8_t trainingVersion = 1;
+static constexpr size_t headerSize = 12;
+// Number of blocks, offset of the index and the magic
+static constexpr size_t footerSize = 20;
+
+// Where the columns are in a TrainingRecord
+static constexpr struct {
+  const char *name;
+  size_t offset;
+  size_t width;
+} columns[TRAINING_NUM_COLUMNS] = {
+    {"board", offsetof(TrainingRecord, board), sizeof(TrainingRecord::board)},
+    {"current", offsetof(TrainingRecord, current), 1},
+    {"next", offsetof(TrainingRecord, next), 1},
+    {"rotation", offsetof(TrainingRecord, rotation), 1},
+    {"positionX", offsetof(TrainingRecord, positionX), 1},
+    {"positionY", offsetof(TrainingRecord, positionY), 1},
+    {"cleared", offsetof(TrainingRecord, cleared), 1},
+    {"level", offsetof(TrainingRecord, level), 2},
+    {"reward", offsetof(TrainingRecord, reward), 4},
+    {"piece", offsetof(TrainingRecord, piece), 4}};
+
+// ____________________________________________________________________________
+const char *trainingColumnName(int column) { return columns[column].name; }
+
+// ____________________________________________________________________________
+size_t trainingColumnWidth(int column) { return columns[column].width; }
+
+// ____________________________________________________________________________
+void encodeTrainingColumn(const uint8_t *values, size_t count, size_t width,
+                          std::vector<uint8_t> *out) {
+  size_t zeros = 0;
+  auto flushZeros = [&zeros, out]() {
+    while (zeros > 0) {
+      size_t run = std::min<size_t>(zeros, 256);
+      out->push_back(0);
+      out->push_back(run - 1);
+      zeros -= run;
+    }
+  };
+  for (size_t b = 0; b < width; ++b) {
+    uint8_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+      uint8_t value = values[i * width + b];
+      uint8_t delta = value ^ previous;
+      previous = value;
+      if (delta == 0) {
+        zeros++;
+        continue;
+      }
+      flushZeros();
+      out->push_back(delta);
+    }
+  }
+  flushZeros();
+}
+
+// ____________________________________________________________________________
+void decodeTrainingColumn(const uint8_t *data, size_t size, size_t count,
+                          size_t width, uint8_t *values) {
+  size_t total = count * width;
+  // Position in the order of encodeTrainingColumn(), byte by byte
+  size_t pos = 0;
+  auto put = [&](uint8_t delta) {
+    if (pos == total) {
+      throw std::runtime_error("Training data column has the wrong size");
+    }
+    size_t b = pos / count;
+    size_t i = pos % count;
+    uint8_t previous = i > 0 ? values[(i - 1) * width + b] : 0;
+    values[i * width + b] = previous ^ delta;
+    pos++;
+  };
+  for (size_t k = 0; k < size; ++k) {
+    if (data[k] != 0) {
+      put(data[k]);
+      continue;
+    }
+    if (k + 1 == size) {
+      throw std::runtime_error("Training data column is truncated");
+    }
+    size_t run = data[++k] + 1;
+    for (size_t j = 0; j < run; ++j) {
+      put(0);
+    }
+  }
+  if (pos != total) {
+    throw std::runtime_error("Training data column has the wrong size");
+  }
+}
+
+// ____________________________________________________________________________
+TrainingWriter::TrainingWriter(const std::string &path,
+                               uint32_t recordsPerBlock)
+    : path_(path), recordsPerBlock_(recordsPerBlock) {
+  if (recordsPerBlock == 0) {
+    throw std::invalid_argument("Blocks need at least one record");
+  }
+  file_ = fopen(path.c_str(), "wb");
+  if (file_ == nullptr) {
+    throw std::runtime_error("Could not open training data file " + path);
+  }
+  uint8_t header[headerSize] = {};
+  memcpy(header, trainingMagic, 4);
+  header[4] = trainingVersion;
+  memcpy(header + 8, &recordsPerBlock, 4);
+  failed_ = fwrite(header, 1, headerSize, file_) != headerSize;
+  written_ = headerSize;
+  for (auto &block : blocks_) {
+    block.reserve(recordsPerBlock);
+  }
+  thread_ = std::thread([this]() { writeBlocks(); });
+}
+
+// ____________________________________________________________________________
+TrainingWriter::~TrainingWriter() {
+  try {
+    close();
+  } catch (const std::runtime_error &) {
+  }
+}
+
+// ____________________________________________________________________________
+void TrainingWriter::handOff() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (writing_ != -1) {
+      stalls_++;
+      changed_.wait(lock, [this]() { return writing_ == -1; });
+    }
+    writing_ = active_;
+    handedOff_ += blocks_[active_].size();
+    active_ = 1 - active_;
+  }
+  changed_.notify_all();
+  // The background thread is done with the block that was written last.
+  blocks_[active_].clear();
+}
+
+// ____________________________________________________________________________
+void TrainingWriter::close() {
+  if (file_ == nullptr) {
+    return;
+  }
+  if (!blocks_[active_].empty()) {
+    handOff();
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this]() { return writing_ == -1; });
+    closing_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+  // The index goes last, without it readers reject the file.
+  if (!failed_) {
+    uint64_t footer[2] = {index_.size(), written_};
+    failed_ = fwrite(index_.data(), sizeof(TrainingBlockEntry), index_.size(),
+                     file_) != index_.size() ||
+              fwrite(footer, sizeof(footer), 1, file_) != 1 ||
+              fwrite(trainingIndexMagic, 1, 4, file_) != 4;
+    written_ += index_.size() * sizeof(TrainingBlockEntry) + footerSize;
+  }
+  failed_ |= fclose(file_) != 0;
+  file_ = nullptr;
+  if (failed_) {
+    throw std::runtime_error("Could not write training data file " + path_);
+  }
+}
+
+// ____________________________________________________________________________
+void TrainingWriter::writeBlocks() {
+  while (true) {
+    int block;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this]() { return writing_ != -1 || closing_; });
+      if (writing_ == -1) {
+        return;
+      }
+      block = writing_;
+    }
+    writeBlock(blocks_[block]);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      writing_ = -1;
+    }
+    changed_.notify_all();
+  }
+}
+
+// ____________________________________________________________________________
+void TrainingWriter::writeBlock(const std::vector<TrainingRecord> &block) {
+  TrainingBlockEntry entry{};
+  entry.offset = written_;
+  entry.numRecords = block.size();
+  encoded_.clear();
+  for (int c = 0; c < TRAINING_NUM_COLUMNS; ++c) {
+    size_t width = columns[c].width;
+    column_.resize(block.size() * width);
+    for (size_t i = 0; i < block.size(); ++i) {
+      memcpy(&column_[i * width],
+             reinterpret_cast<const uint8_t *>(&block[i]) + columns[c].offset,
+             width);
+    }
+    size_t before = encoded_.size();
+    encodeTrainingColumn(column_.data(), block.size(), width, &encoded_);
+    entry.columnSizes[c] = encoded_.size() - before;
+  }
+  failed_ |=
+      fwrite(encoded_.data(), 1, encoded_.size(), file_) != encoded_.size();
+  written_ += encoded_.size();
+  index_.push_back(entry);
+}
+
+// ____________________________________________________________________________
+TrainingReader::TrainingReader(const uint8_t *data, size_t size)
+    : data_(data), size_(size) {
+  if (size_ < headerSize + footerSize ||
+      memcmp(data_, trainingMagic, 4) != 0 ||
+      memcmp(data_ + size_ - 4, trainingIndexMagic, 4) != 0) {
+    throw std::runtime_error("Not a complete training data file");
+  }
+  if (data_[4] != trainingVersion) {
+    throw std::runtime_error("Unsupported training data version");
+  }
+  uint64_t footer[2];
+  memcpy(footer, data_ + size_ - footerSize, sizeof(footer));
+  // Subtractions only, a crafted footer must not overflow the checks.
+  uint64_t indexEnd = size_ - footerSize;
+  if (footer[1] < headerSize || footer[1] > indexEnd ||
+      footer[0] > (indexEnd - footer[1]) / sizeof(TrainingBlockEntry) ||
+      footer[0] * sizeof(TrainingBlockEntry) != indexEnd - footer[1]) {
+    throw std::runtime_error("Training data has a corrupt index");
+  }
+  numBlocks_ = footer[0];
+  index_ = data_ + footer[1];
+  for (size_t i = 0; i < numBlocks_; ++i) {
+    TrainingBlockEntry entry = blockEntry(i);
+    uint64_t size = 0;
+    for (uint32_t columnSize : entry.columnSizes) {
+      size += columnSize;
+    }
+    if (entry.offset < headerSize || entry.offset > footer[1] ||
+        size > footer[1] - entry.offset) {
+      throw std::runtime_error("Training data has a corrupt index");
+    }
+    numRecords_ += entry.numRecords;
+  }
+}
+
+// ____________________________________________________________________________
+TrainingBlockEntry TrainingReader::blockEntry(size_t block) const {
+  TrainingBlockEntry entry;
+  memcpy(&entry, index_ + block * sizeof(TrainingBlockEntry), sizeof(entry));
+  return entry;
+}
+
+// ____________________________________________________________________________
+void TrainingReader::readColumn(size_t block, int column,
+                                std::vector<uint8_t> *values) const {
+  TrainingBlockEntry entry = blockEntry(block);
+  uint64_t offset = entry.offset;
+  for (int c = 0; c < column; ++c) {
+    offset += entry.columnSizes[c];
+  }
+  values->resize(entry.numRecords * columns[column].width);
+  decodeTrainingColumn(data_ + offset, entry.columnSizes[column],
+                       entry.numRecords, columns[column].width,
+                       values->data());
+}
+
+// ____________________________________________________________________________
+void TrainingReader::readBlock(size_t block,
+                               std::vector<TrainingRecord> *records) const {
+  TrainingBlockEntry entry = blockEntry(block);
+  records->resize(entry.numRecords);
+  std::vector<uint8_t> values;
+  for (int c = 0; c < TRAINING_NUM_COLUMNS; ++c) {
+    readColumn(block, c, &values);
+    size_t width = columns[c].width;
+    for (size_t i = 0; i < entry.numRecords; ++i) {
+      memcpy(reinterpret_cast<uint8_t *>(&(*records)[i]) + columns[c].offset,
+             &values[i * width], width);
+    }
+  }
+}
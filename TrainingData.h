@@ -0,0 +1,191 @@
+// Copyright (C)
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Training data for learning to play: one fixed-width record per settled
+// Tetromino with the board before it settled, the Tetromino, where it
+// settled and what that was worth.
+struct TrainingRecord {
+  // Settled blocks before the placement, bit x is column x, row 0 is the top
+  uint16_t board[20];
+  // Forms of the current and the next Tetromino
+  int8_t current;
+  int8_t next;
+  // The placement: rotation (for the I 0 or 1) and position where the
+  // Tetromino settled
+  int8_t rotation;
+  int8_t positionX;
+  int8_t positionY;
+  int8_t cleared;
+  int16_t level;
+  // Points of the cleared lines
+  int32_t reward;
+  // Number of the Tetromino in its game, 1 for the first one
+  uint32_t piece;
+};
+static_assert(sizeof(TrainingRecord) == 56,
+              "TrainingRecord is written raw and must not have padding");
+
+// The columns of the file, one per field of TrainingRecord.
+enum TrainingColumn {
+  TRAINING_BOARD,
+  TRAINING_CURRENT,
+  TRAINING_NEXT,
+  TRAINING_ROTATION,
+  TRAINING_POSITION_X,
+  TRAINING_POSITION_Y,
+  TRAINING_CLEARED,
+  TRAINING_LEVEL,
+  TRAINING_REWARD,
+  TRAINING_PIECE,
+  TRAINING_NUM_COLUMNS
+};
+
+// Name and width in bytes of a column.
+const char *trainingColumnName(int column);
+size_t trainingColumnWidth(int column);
+
+// Layout of a training data file:
+//   "TTRN" magic, one version byte, three zero bytes, uint32 records per
+//   block,
+//   blocks: for every column of the block, its values compressed on their
+//           own (see encodeTrainingColumn()),
+//   index: one raw TrainingBlockEntry per block, then the uint64 number of
+//          blocks, the uint64 offset of the index and "TTRX".
+// Like in a replay, the index has a fixed width and sits at the end, so a
+// reader finds any block, or one column of it, without decoding the rest.
+
+// Entry of the block index
+struct TrainingBlockEntry {
+  uint64_t offset;
+  uint32_t numRecords;
+  // Compressed size of every column, the columns follow each other
+  uint32_t columnSizes[TRAINING_NUM_COLUMNS];
+};
+
+// Compress `count` values of `width` bytes: every value is XORed with the
+// previous one, which leaves mostly zeros for boards that change a few rows
+// per record, then the bytes are regrouped by their position in the value,
+// so the zeros line up, and runs of zeros are stored as a zero and the
+// length of the run minus one.
+void encodeTrainingColumn(const uint8_t *values, size_t count, size_t width,
+                          std::vector<uint8_t> *out);
+
+// Undo encodeTrainingColumn(). Throws if the data does not decode to
+// exactly `count` values.
+void decodeTrainingColumn(const uint8_t *data, size_t size, size_t count,
+                          size_t width, uint8_t *values);
+
+// Writes training data. The game thread only copies records into a block;
+// full blocks are compressed and written by a background thread while the
+// game fills the other of two blocks, so exporting costs the game a copy
+// per record and no syscalls. It only waits if the background thread is
+// still busy with the previous block. Records are appended from one thread.
+class TrainingWriter {
+public:
+  // Create the file and write the header. Throws if it cannot be created.
+  explicit TrainingWriter(const std::string &path,
+                          uint32_t recordsPerBlock = 8192);
+
+  // Calls close() if that did not happen yet. Errors are lost then, so call
+  // close() to learn about them.
+  ~TrainingWriter();
+
+  TrainingWriter(const TrainingWriter &) = delete;
+  TrainingWriter &operator=(const TrainingWriter &) = delete;
+
+  // Add a record.
+  void append(const TrainingRecord &record) {
+    std::vector<TrainingRecord> &block = blocks_[active_];
+    block.push_back(record);
+    if (block.size() == recordsPerBlock_) {
+      handOff();
+    }
+  }
+
+  // Write the last block and the index and close the file. Nothing can be
+  // appended afterwards. Throws if any write failed, e.g. on a full disk.
+  // The index is not written then, so readers reject the file instead of
+  // reading a truncated one.
+  void close();
+
+  // Records appended so far
+  uint64_t numRecords() const {
+    return handedOff_ + blocks_[active_].size();
+  }
+
+  // Bytes of the file, complete after close()
+  uint64_t bytesWritten() const { return written_; }
+
+  // Blocks for which append() had to wait for the background thread
+  uint64_t stalls() const { return stalls_; }
+
+private:
+  // Give the active block to the background thread and switch to the other.
+  void handOff();
+
+  // Main loop of the background thread.
+  void writeBlocks();
+
+  // Compress a block, write it and add it to the index.
+  void writeBlock(const std::vector<TrainingRecord> &block);
+
+  FILE *file_;
+  std::string path_;
+  uint32_t recordsPerBlock_;
+  std::vector<TrainingRecord> blocks_[2];
+  // Block the game fills
+  int active_{0};
+  // Block the background thread writes, -1 for none
+  int writing_{-1};
+  bool closing_{false};
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::thread thread_;
+  // Only touched by the background thread until it is joined
+  std::vector<TrainingBlockEntry> index_;
+  std::vector<uint8_t> column_;
+  std::vector<uint8_t> encoded_;
+  std::atomic<uint64_t> written_{0};
+  // A write was short, only set by the background thread until it is joined
+  bool failed_{false};
+  // Records of the blocks that were handed off
+  uint64_t handedOff_{0};
+  uint64_t stalls_{0};
+};
+
+// Reads training data from memory, usually a MappedFile. Does not copy or
+// own the data.
+class TrainingReader {
+public:
+  // Checks the magic and reads the index. Throws on a corrupt file.
+  TrainingReader(const uint8_t *data, size_t size);
+
+  size_t numBlocks() const { return numBlocks_; }
+  uint64_t numRecords() const { return numRecords_; }
+
+  // Decode all records of a block.
+  void readBlock(size_t block, std::vector<TrainingRecord> *records) const;
+
+  // Decode one column of a block, trainingColumnWidth() bytes per record.
+  void readColumn(size_t block, int column, std::vector<uint8_t> *values) const;
+
+  TrainingBlockEntry blockEntry(size_t block) const;
+
+private:
+  const uint8_t *data_;
+  size_t size_;
+  const uint8_t *index_{nullptr};
+  size_t numBlocks_{0};
+  uint64_t numRecords_{0};
+};
@@ -0,0 +1,156 @@
+// Copyright (C)
+
+#include "./Bot.h"
+#include "./MappedFile.h"
+#include "./TrainingData.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+TEST(TrainingData, columnCodec) {
+  std::minstd_rand random(3);
+  for (size_t width : {1, 2, 4, 40}) {
+    for (size_t count : {1, 7, 1000}) {
+      // Mostly repeated values with a few changes and long runs of zeros
+      std::vector<uint8_t> values(count * width);
+      for (size_t i = 1; i < count; ++i) {
+        memcpy(&values[i * width], &values[(i - 1) * width], width);
+        if (random() % 5 == 0) {
+          values[i * width + random() % width] = random();
+        }
+      }
+      std::vector<uint8_t> encoded;
+      encodeTrainingColumn(values.data(), count, width, &encoded);
+      std::vector<uint8_t> decoded(count * width, 0xAB);
+      decodeTrainingColumn(encoded.data(), encoded.size(), count, width,
+                           decoded.data());
+      ASSERT_EQ(decoded, values) << width << " " << count;
+      // Like boards, where most bytes stay the same
+      if (width == 40 && count == 1000) {
+        ASSERT_LT(encoded.size(), values.size() / 2);
+      }
+    }
+  }
+  std::vector<uint8_t> values(4, 0);
+  std::vector<uint8_t> encoded;
+  encodeTrainingColumn(values.data(), 4, 1, &encoded);
+  ASSERT_EQ(encoded, (std::vector<uint8_t>{0, 3}));
+  ASSERT_THROW(decodeTrainingColumn(encoded.data(), 1, 4, 1, values.data()),
+               std::runtime_error);
+  ASSERT_THROW(decodeTrainingColumn(encoded.data(), 2, 3, 1, values.data()),
+               std::runtime_error);
+}
+
+TEST(TrainingData, writeAndRead) {
+  std::string path = "/tmp/tetris-training-" + std::to_string(getpid());
+  std::vector<TrainingRecord> records(1050);
+  for (size_t i = 0; i < records.size(); ++i) {
+    TrainingRecord &record = records[i];
+    record = i > 0 ? records[i - 1] : TrainingRecord{};
+    record.board[19 - i % 20] |= 1 << (i % 10);
+    record.current = i % 7;
+    record.next = (i + 3) % 7;
+    record.positionX = i % 10;
+    record.reward = i % 13 == 0 ? 40 : 0;
+    record.piece = i + 1;
+  }
+  {
+    TrainingWriter writer(path, 100);
+    for (const TrainingRecord &record : records) {
+      writer.append(record);
+    }
+    ASSERT_EQ(writer.numRecords(), 1050u);
+    writer.close();
+    ASSERT_GT(writer.bytesWritten(), 0u);
+    ASSERT_LT(writer.bytesWritten(), records.size() * sizeof(TrainingRecord));
+  }
+  MappedFile file(path);
+  TrainingReader reader(file.data(), file.size());
+  ASSERT_EQ(reader.numBlocks(), 11u);
+  ASSERT_EQ(reader.numRecords(), 1050u);
+  std::vector<TrainingRecord> block;
+  for (size_t b = 0; b < reader.numBlocks(); ++b) {
+    reader.readBlock(b, &block);
+    ASSERT_EQ(block.size(), b < 10 ? 100u : 50u);
+    for (size_t i = 0; i < block.size(); ++i) {
+      ASSERT_EQ(memcmp(&block[i], &records[b * 100 + i], sizeof(block[i])), 0);
+    }
+  }
+  // A single column without decoding the others
+  std::vector<uint8_t> pieces;
+  reader.readColumn(3, TRAINING_PIECE, &pieces);
+  ASSERT_EQ(pieces.size(), 400u);
+  uint32_t piece;
+  memcpy(&piece, &pieces[4 * 7], 4);
+  ASSERT_EQ(piece, 308u);
+  ASSERT_STREQ(trainingColumnName(TRAINING_PIECE), "piece");
+  ASSERT_THROW(TrainingReader(file.data(), file.size() - 1),
+               std::runtime_error);
+  // An index whose size only fits when the multiplication overflows
+  std::vector<uint8_t> crafted(file.data(), file.data() + file.size());
+  uint64_t numBlocks;
+  size_t footer = crafted.size() - 4 - 2 * sizeof(uint64_t);
+  memcpy(&numBlocks, &crafted[footer], sizeof(numBlocks));
+  numBlocks += uint64_t{1} << 60;
+  memcpy(&crafted[footer], &numBlocks, sizeof(numBlocks));
+  ASSERT_THROW(TrainingReader(crafted.data(), crafted.size()),
+               std::runtime_error);
+  unlink(path.c_str());
+}
+
+TEST(TrainingData, writeErrors) {
+  // Every write to /dev/full fails with ENOSPC, like on a full disk.
+  TrainingWriter writer("/dev/full", 100);
+  for (int i = 0; i < 1000; ++i) {
+    writer.append(TrainingRecord{});
+  }
+  ASSERT_THROW(writer.close(), std::runtime_error);
+  // Closed anyway, nothing is written twice.
+  writer.close();
+}
+
+TEST(TrainingData, exportFromGame) {
+  std::string path = "/tmp/tetris-training-game-" + std::to_string(getpid());
+  TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+  Bot bot(BotConfig::parse("bot"));
+  uint64_t numRecords;
+  {
+    TrainingWriter writer(path, 16);
+    game.setSeed(5);
+    game.exportTrainingTo(&writer);
+    game.newGame();
+    UserInput uI;
+    for (int frame = 0; frame < 2000 && !game.gameOver(); ++frame) {
+      uI.keycode_ = bot.nextKey(game);
+      game.simulateFrame(uI);
+    }
+    game.exportTrainingTo(nullptr);
+    numRecords = writer.numRecords();
+  }
+  // Every Tetromino but the falling one settled.
+  ASSERT_EQ(numRecords, game.pieces() - 1);
+  MappedFile file(path);
+  TrainingReader reader(file.data(), file.size());
+  ASSERT_EQ(reader.numRecords(), numRecords);
+  int lines = 0;
+  std::vector<TrainingRecord> records;
+  std::vector<TrainingRecord> block;
+  for (size_t b = 0; b < reader.numBlocks(); ++b) {
+    reader.readBlock(b, &block);
+    records.insert(records.end(), block.begin(), block.end());
+  }
+  for (size_t i = 0; i < records.size(); ++i) {
+    ASSERT_EQ(records[i].piece, i + 1);
+    lines += records[i].cleared;
+    ASSERT_EQ(records[i].reward > 0, records[i].cleared > 0);
+    if (i > 0) {
+      ASSERT_EQ(records[i].current, records[i - 1].next);
+    }
+  }
+  ASSERT_EQ(records[0].board[19], 0);
+  ASSERT_EQ(lines, game.broadcastFrame().lines);
+  ASSERT_GT(lines, 0);
+  unlink(path.c_str());
+}
@@ -0,0 +1,43 @@
+// Copyright (C)
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from one writer thread to one reader thread without
+// locks and without either ever waiting. Writer and reader each own one of
+// three buffers and swap theirs with the spare one. Values the reader misses
+// are simply overwritten.
+template <class T> class TripleBuffer {
+public:
+  // The buffer the writer fills next
+  T &back() { return buffers_[back_]; }
+
+  // Make the back buffer the latest value, from the writer thread.
+  void publish() {
+    back_ = spare_.exchange(back_ | fresh, std::memory_order_acq_rel) & index;
+  }
+
+  // Take the latest value if there is a new one, from the reader thread.
+  // Returns false if nothing was published since the last call.
+  bool update() {
+    if ((spare_.load(std::memory_order_relaxed) & fresh) == 0) {
+      return false;
+    }
+    front_ = spare_.exchange(front_, std::memory_order_acq_rel) & index;
+    return true;
+  }
+
+  // The value the reader took last
+  const T &front() const { return buffers_[front_]; }
+
+private:
+  static constexpr uint8_t index = 3;
+  static constexpr uint8_t fresh = 4;
+
+  T buffers_[3]{};
+  alignas(64) uint8_t back_{0};
+  alignas(64) std::atomic<uint8_t> spare_{1};
+  alignas(64) uint8_t front_{2};
+};
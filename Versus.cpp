@@ -0,0 +1,199 @@
+// Copyright (C)
+
+#include "./Versus.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <ncurses.h> // For keycodes
+#include <stdexcept>
+#include <string>
+
+// Keys of the second human and the keys of the game they stand for
+static constexpr std::pair<int, int> secondHumanKeys[] = {
+    {'j', KEY_LEFT}, {'l', KEY_RIGHT}, {'k', KEY_DOWN}, {'u', 'a'}, {'o', 'd'}};
+
+// Keys the bots press
+static constexpr int botKeys[] = {KEY_LEFT, KEY_RIGHT, KEY_DOWN, KEY_DOWN,
+                                  'a', 'd'};
+
+// ____________________________________________________________________________
+Versus::Versus(std::unique_ptr<VirtualTerminalManager> tm, int numBoards,
+               int numHumans)
+    : tm_(std::move(tm)) {
+  if (numBoards < 1 || numBoards > maxBoards || numHumans < 0 ||
+      numHumans > std::min(2, numBoards)) {
+    throw std::invalid_argument("Versus needs 1 to 8 boards and at most two "
+                                "humans");
+  }
+  std::vector<std::string> names;
+  for (int i = 0; i < numBoards; ++i) {
+    names.push_back((i < numHumans ? "P" : "Bot ") + std::to_string(i + 1));
+  }
+  view_ = std::make_unique<VersusView>(tm_.get(), names);
+  uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+  for (int i = 0; i < numBoards; ++i) {
+    auto player = std::make_unique<Player>();
+    // The boards draw nothing themselves, the render thread does.
+    player->game = std::make_unique<TetrisGame>(
+        std::make_unique<HeadlessTerminalManager>());
+    player->game->setSeed(seed + i);
+    player->game->onSettle([this, i](int cleared) { settled(i, cleared); });
+    player->human = i < numHumans;
+    player->random.seed(seed + i);
+    player->nextTarget = i + 1;
+    players_.push_back(std::move(player));
+  }
+}
+
+// ____________________________________________________________________________
+Versus::~Versus() {
+  running_ = false;
+  for (auto &player : players_) {
+    if (player->thread.joinable()) {
+      player->thread.join();
+    }
+  }
+}
+
+// ____________________________________________________________________________
+int Versus::garbageFor(int cleared) {
+  static constexpr int garbage[] = {0, 0, 1, 2, 4};
+  return garbage[std::clamp(cleared, 0, 4)];
+}
+
+// ____________________________________________________________________________
+int Versus::run(Clock::duration timeLimit) {
+  view_->drawLayout();
+  running_ = true;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < players_.size(); ++i) {
+    players_[i]->thread = std::thread([this, i]() { simulate(i); });
+  }
+  uint64_t renderedFrames{0};
+  auto deadline = start;
+  int alive = players_.size();
+  while (dispatchKeys() && alive > (players_.size() > 1 ? 1 : 0) &&
+         (timeLimit == Clock::duration::zero() ||
+          deadline - start < timeLimit)) {
+    alive = 0;
+    for (size_t i = 0; i < players_.size(); ++i) {
+      Player &player = *players_[i];
+      if (player.frame.update()) {
+        view_->drawFrame(i, player.frame.front());
+      }
+      alive += !player.over;
+    }
+    renderedFrames++;
+    deadline += TetrisGame::frameDuration;
+    std::this_thread::sleep_until(deadline);
+  }
+  running_ = false;
+  int winner{-1};
+  stats_ = Stats{};
+  stats_.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  stats_.minBoardFps = 1e9;
+  for (size_t i = 0; i < players_.size(); ++i) {
+    Player &player = *players_[i];
+    player.thread.join();
+    if (!player.over) {
+      winner = winner == -1 ? i : -2;
+    }
+    stats_.minBoardFps =
+        std::min(stats_.minBoardFps, player.frames / stats_.seconds);
+    stats_.lateFrames += player.lateFrames;
+  }
+  stats_.renderFps = renderedFrames / stats_.seconds;
+  stats_.garbageLines = garbageLines_;
+  if (winner >= 0 && players_.size() > 1 && alive == 1) {
+    view_->drawMessage(winner, "Winner!");
+    tm_->flipDelay(false);
+    tm_->getUserInput();
+    tm_->flipDelay(true);
+  }
+  return std::max(winner, -1);
+}
+
+// ____________________________________________________________________________
+void Versus::simulate(int index) {
+  Player &player = *players_[index];
+  TetrisGame &game = *player.game;
+  game.newGame();
+  player.frame.back() = game.broadcastFrame();
+  player.frame.publish();
+  auto deadline = std::chrono::steady_clock::now();
+  while (running_ && !game.gameOver()) {
+    UserInput uI;
+    uI.keycode_ = -1;
+    if (player.human) {
+      int key;
+      if (player.keys.pop(&key)) {
+        uI.keycode_ = key;
+      }
+    } else if (player.random() % 8 == 0) {
+      uI.keycode_ = botKeys[player.random() % std::size(botKeys)];
+    }
+    game.tick(uI);
+    player.frame.back() = game.broadcastFrame();
+    player.frame.publish();
+    player.frames++;
+    deadline += TetrisGame::frameDuration;
+    auto now = std::chrono::steady_clock::now();
+    if (now > deadline + TetrisGame::frameDuration) {
+      // Missed frames are skipped, not caught up.
+      player.lateFrames++;
+      deadline = now;
+    }
+    std::this_thread::sleep_until(deadline);
+  }
+  game.endGame();
+  player.over = game.gameOver();
+}
+
+// ____________________________________________________________________________
+void Versus::settled(int index, int cleared) {
+  Player &player = *players_[index];
+  int lines = garbageFor(cleared);
+  int numPlayers = players_.size();
+  for (int i = 0; lines > 0 && i < numPlayers; ++i) {
+    int target = (player.nextTarget + i) % numPlayers;
+    if (target == index || players_[target]->over) {
+      continue;
+    }
+    player.nextTarget = target + 1;
+    // A full queue means the opponent is flooded already.
+    if (players_[target]->garbage.push(Garbage{
+            lines, static_cast<int>(player.random() % StandardBoard::width)})) {
+      garbageLines_ += lines;
+    }
+    break;
+  }
+  Garbage garbage;
+  while (player.garbage.pop(&garbage)) {
+    player.game->addGarbage(garbage.lines, garbage.hole);
+  }
+}
+
+// ____________________________________________________________________________
+bool Versus::dispatchKeys() {
+  UserInput uI;
+  // Reading the input also shows what was drawn.
+  while ((uI = tm_->getUserInput()).keycode_ >= 0) {
+    if (uI.isEscape()) {
+      return false;
+    }
+    int key = uI.keycode_;
+    size_t player = 0;
+    for (auto [from, to] : secondHumanKeys) {
+      if (key == from && players_.size() > 1 && players_[1]->human) {
+        key = to;
+        player = 1;
+      }
+    }
+    if (players_[player]->human) {
+      players_[player]->keys.push(key);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,98 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Broadcast.h"
+#include "./Clock.h"
+#include "./Histogram.h"
+#include "./MpscQueue.h"
+#include "./TerminalManager.h"
+#include "./TetrisGame.h"
+#include "./TripleBuffer.h"
+#include "./VersusView.h"
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Local versus mode for up to 8 boards side by side. Clearing 2, 3 or 4 lines
+// sends 1, 2 or 4 garbage lines to the next opponent that is still alive.
+// Every board is simulated on its own thread at 60 frames per second. Garbage
+// goes through a lock-free queue of the receiving board, which takes it when
+// its next Tetromino settles. The thread that calls run() is the only one
+// that touches the terminal: it reads the keys, hands them to the boards and
+// draws the latest frame of every board.
+class Versus {
+public:
+  // Boards beyond the human players are played by bots pressing random keys.
+  // The first human plays with the keys of the game (arrows, A and D), the
+  // second one with J, L, K and U, O. The terminal needs 13 pixels per board.
+  Versus(std::unique_ptr<VirtualTerminalManager> tm, int numBoards,
+         int numHumans);
+  ~Versus();
+
+  Versus(const Versus &) = delete;
+  Versus &operator=(const Versus &) = delete;
+
+  // Play until only one board is left (or the only board is over), ESC is
+  // pressed or the time limit is reached, if it is not zero.
+  // Returns the index of the winning board, -1 if there is none.
+  int run(Clock::duration timeLimit = Clock::duration::zero());
+
+  // Garbage lines sent for the number of cleared lines
+  static int garbageFor(int cleared);
+
+  static constexpr int maxBoards = 8;
+
+  // Statistics of the last run()
+  struct Stats {
+    double seconds;
+    // Frames per second of the slowest board and of the render thread
+    double minBoardFps;
+    double renderFps;
+    // Frames that a board started more than one frame late, over all boards
+    uint64_t lateFrames;
+    uint64_t garbageLines;
+  };
+  Stats stats() const { return stats_; }
+
+private:
+  struct Garbage {
+    int lines;
+    int hole;
+  };
+
+  struct Player {
+    std::unique_ptr<TetrisGame> game;
+    bool human{false};
+    // Garbage from the opponents and keys from the render thread
+    MpscQueue<Garbage, 64> garbage;
+    MpscQueue<int, 64> keys;
+    // Latest frame for the render thread
+    TripleBuffer<BroadcastFrame> frame;
+    std::atomic<bool> over{false};
+    std::atomic<uint64_t> frames{0};
+    uint64_t lateFrames{0};
+    std::minstd_rand random;
+    // Round robin over the opponents
+    int nextTarget{0};
+    std::thread thread;
+  };
+
+  // Thread of a board: simulate a frame, publish it and wait for the next.
+  void simulate(int index);
+
+  // Send garbage for the cleared lines and take the incoming garbage.
+  void settled(int index, int cleared);
+
+  // Hand the keys of the terminal to the human boards. Returns false on ESC.
+  bool dispatchKeys();
+
+  std::unique_ptr<VirtualTerminalManager> tm_;
+  std::vector<std::unique_ptr<Player>> players_;
+  std::unique_ptr<VersusView> view_;
+  std::atomic<bool> running_{false};
+  std::atomic<uint64_t> garbageLines_{0};
+  Stats stats_{};
+};
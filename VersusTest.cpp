@@ -0,0 +1,175 @@
+// Copyright (C)
+
+#include "./Versus.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <memory>
+#include <ncurses.h> // For keycodes
+#include <thread>
+#include <vector>
+
+TEST(MpscQueue, producers) {
+  MpscQueue<std::pair<int, int>, 64> queue;
+  std::pair<int, int> value;
+  ASSERT_FALSE(queue.pop(&value));
+  // Full after its capacity.
+  for (int i = 0; i < 64; ++i) {
+    ASSERT_TRUE(queue.push({0, i}));
+  }
+  ASSERT_FALSE(queue.push({0, 64}));
+  for (int i = 0; i < 64; ++i) {
+    ASSERT_TRUE(queue.pop(&value));
+    ASSERT_EQ(value.second, i);
+  }
+  ASSERT_FALSE(queue.pop(&value));
+
+  // Every value of every producer arrives once and in the order of its
+  // producer.
+  const int numProducers = 4;
+  const int numValues = 20'000;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < numProducers; ++p) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < numValues; ++i) {
+        while (!queue.push({p, i})) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::vector<int> next(numProducers, 0);
+  for (int received = 0; received < numProducers * numValues;) {
+    if (queue.pop(&value)) {
+      ASSERT_EQ(value.second, next[value.first]++);
+      received++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  ASSERT_FALSE(queue.pop(&value));
+}
+
+TEST(TripleBuffer, latest) {
+  TripleBuffer<int> buffer;
+  ASSERT_FALSE(buffer.update());
+  buffer.back() = 1;
+  buffer.publish();
+  buffer.back() = 2;
+  buffer.publish();
+  // Only the latest value is seen.
+  ASSERT_TRUE(buffer.update());
+  ASSERT_EQ(buffer.front(), 2);
+  ASSERT_FALSE(buffer.update());
+
+  std::thread writer([&buffer]() {
+    for (int i = 3; i <= 100'000; ++i) {
+      buffer.back() = i;
+      buffer.publish();
+    }
+  });
+  int last = 2;
+  while (last < 100'000) {
+    if (buffer.update()) {
+      ASSERT_GT(buffer.front(), last);
+      last = buffer.front();
+    }
+  }
+  writer.join();
+}
+
+TEST(Versus, garbage) {
+  ASSERT_EQ(Versus::garbageFor(1), 0);
+  ASSERT_EQ(Versus::garbageFor(2), 1);
+  ASSERT_EQ(Versus::garbageFor(4), 4);
+  TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+  game.setSeed(3);
+  std::vector<int> cleared;
+  game.onSettle([&cleared](int lines) { cleared.push_back(lines); });
+  game.newGame();
+  game.addGarbage(3, 4);
+  BroadcastFrame frame = game.broadcastFrame();
+  for (int y = 17; y < 20; ++y) {
+    for (int x = 0; x < 10; ++x) {
+      ASSERT_EQ(frame.cells[y][x], x == 4 ? 0 : 1);
+    }
+  }
+  ASSERT_EQ(frame.cells[16][0], 0);
+  // Drop the first Tetromino onto the garbage.
+  UserInput down;
+  down.keycode_ = KEY_DOWN;
+  for (int i = 0; i < 30 && cleared.empty(); ++i) {
+    game.tick(down);
+  }
+  ASSERT_EQ(cleared, std::vector<int>{0});
+  ASSERT_FALSE(game.gameOver());
+  game.addGarbage(20, 0);
+  ASSERT_TRUE(game.gameOver());
+}
+
+TEST(Versus, eightBoards) {
+  Versus versus(std::make_unique<HeadlessTerminalManager>(30, 110), 8, 0);
+  ASSERT_EQ(versus.run(std::chrono::seconds(1)), -1);
+  Versus::Stats stats = versus.stats();
+  ASSERT_GE(stats.seconds, 1.0);
+  // Every board and the render thread keep up with 60 frames per second.
+  ASSERT_GT(stats.minBoardFps, 55);
+  ASSERT_GT(stats.renderFps, 55);
+  ASSERT_THROW(Versus(std::make_unique<HeadlessTerminalManager>(30, 50), 8, 0),
+               std::runtime_error);
+}
+
+namespace {
+// A terminal on which one key is pressed once, then nothing
+class OneKeyTerminal : public MockTerminalManager {
+public:
+  explicit OneKeyTerminal(int key) : MockTerminalManager(30, 110), key_(key) {}
+  UserInput getUserInput() override {
+    UserInput uI;
+    uI.keycode_ = key_;
+    key_ = -1;
+    return uI;
+  }
+
+private:
+  int key_;
+};
+} // namespace
+
+TEST(Versus, idleHuman) {
+  // After one press of left the Tetromino of the human moves one column and
+  // then stays, like in a new game that starts with the same Tetromino. A
+  // key is not repeated in the frames without one.
+  auto terminal = std::make_unique<OneKeyTerminal>(KEY_LEFT);
+  OneKeyTerminal *tm = terminal.get();
+  Versus versus(std::move(terminal), 1, 1);
+  versus.run(std::chrono::milliseconds(300));
+  BroadcastFrame shown{};
+  int color = 0;
+  for (int y = 0; y < 20; ++y) {
+    for (int x = 0; x < 10; ++x) {
+      shown.cells[y][x] = tm->getCellColor(y + 2, x + 2);
+      color = std::max(color, static_cast<int>(shown.cells[y][x]));
+    }
+  }
+  TetrisGame game(std::make_unique<HeadlessTerminalManager>());
+  UserInput left;
+  left.keycode_ = KEY_LEFT;
+  BroadcastFrame moved;
+  for (uint64_t seed = 0; seed < 100; ++seed) {
+    game.setSeed(seed);
+    game.newGame();
+    game.tick(left);
+    moved = game.broadcastFrame();
+    if (std::count(&moved.cells[0][0], &moved.cells[20][0], color) > 0) {
+      break;
+    }
+  }
+  for (int y = 0; y < 20; ++y) {
+    for (int x = 0; x < 10; ++x) {
+      ASSERT_EQ(shown.cells[y][x], moved.cells[y][x]) << x << ", " << y;
+    }
+  }
+}
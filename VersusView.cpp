@@ -0,0 +1,61 @@
+// Copyright (C)
+
+#include "./VersusView.h"
+#include <cstring>
+#include <stdexcept>
+
+// ____________________________________________________________________________
+VersusView::VersusView(VirtualTerminalManager *tm,
+                       const std::vector<std::string> &names)
+    : tm_(tm), names_(names), drawn_(names.size()) {
+  int numBoards = names.size();
+  if (tm_->numCols() < numBoards * boardPixels + 1 ||
+      tm_->numRows() < layoutRows) {
+    throw std::runtime_error("The terminal is too small for " +
+                             std::to_string(numBoards) + " boards");
+  }
+  // Anything differs from the first frame, so it is drawn completely.
+  for (BroadcastFrame &drawn : drawn_) {
+    memset(drawn.cells, 0xFF, sizeof(drawn.cells));
+    drawn.score = -1;
+  }
+}
+
+// ____________________________________________________________________________
+void VersusView::drawLayout() const {
+  for (size_t i = 0; i < names_.size(); ++i) {
+    int left = i * boardPixels + 1;
+    tm_->drawString(0, left + 1, 2, names_[i].c_str());
+    for (int y = 1; y < StandardBoard::height + 3; ++y) {
+      tm_->drawPixel(y, left, 1);
+      tm_->drawPixel(y, left + StandardBoard::width + 1, 1);
+    }
+    for (int x = left + 1; x <= left + StandardBoard::width; ++x) {
+      tm_->drawPixel(1, x, 1);
+      tm_->drawPixel(StandardBoard::height + 2, x, 1);
+    }
+  }
+}
+
+// ____________________________________________________________________________
+void VersusView::drawFrame(int index, const BroadcastFrame &frame) {
+  BroadcastFrame &drawn = drawn_[index];
+  int left = index * boardPixels + 2;
+  for (int y = 0; y < StandardBoard::height; ++y) {
+    for (int x = 0; x < StandardBoard::width; ++x) {
+      if (frame.cells[y][x] != drawn.cells[y][x]) {
+        tm_->drawPixel(y + 2, left + x, frame.cells[y][x]);
+      }
+    }
+  }
+  if (frame.score != drawn.score || frame.lines != drawn.lines) {
+    tm_->drawScore(layoutRows - 2, 2 * left, 2, frame.score);
+    tm_->drawScore(layoutRows - 1, 2 * left, 2, frame.lines);
+  }
+  drawn = frame;
+}
+
+// ____________________________________________________________________________
+void VersusView::drawMessage(int index, const char *message) const {
+  tm_->drawString(0, index * boardPixels + 2, 2, message);
+}
@@ -0,0 +1,36 @@
+// Copyright (C)
+
+#pragma once
+
+#include "./Broadcast.h"
+#include "./VirtualTerminalManager.h"
+#include <string>
+#include <vector>
+
+// Draws the frames of several boards side by side, each with its name, score
+// and lines. Only the cells that changed since the last frame of a board are
+// drawn. Every board takes 13 pixels (26 columns) and the layout 25 rows.
+class VersusView {
+public:
+  // A view on the terminal for boards with the given names. Throws if the
+  // terminal is too small.
+  VersusView(VirtualTerminalManager *tm, const std::vector<std::string> &names);
+
+  // Draw the names and borders of all boards.
+  void drawLayout() const;
+
+  // Draw the frame of a board.
+  void drawFrame(int index, const BroadcastFrame &frame);
+
+  // Replace the name of a board with a message, e.g. "Winner!".
+  void drawMessage(int index, const char *message) const;
+
+  static constexpr int boardPixels = 13;
+  static constexpr int layoutRows = 25;
+
+private:
+  VirtualTerminalManager *tm_;
+  std::vector<std::string> names_;
+  // What was drawn last for every board
+  std::vector<BroadcastFrame> drawn_;
+};
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 // Declaration and Implementation of a virtual base class TerminalManager
 
 class UserInput {
@@ -41,6 +43,15 @@ public: // Everybody needs to use this......
   virtual int numRows() const = 0;
   virtual int numCols() const = 0;
 
+  // Logical rows that share one line of the terminal. Text fills whole lines
+  // and starts at the first row of one, so layouts with text between pixels
+  // take this into account.
+  virtual int rowsPerLine() const { return 1; }
+
+  // Frames that were not shown because the terminal had not taken the output
+  // of earlier ones yet
+  virtual uint64_t droppedFrames() const { return 0; }
+
   // Switch waiting for a user input. Virtual
   virtual void flipDelay(bool to) = 0;
 
@@ -0,0 +1,110 @@
+// Copyright (C)
+
+#include "./WorkStealingPool.h"
+#include <algorithm>
+
+// The pool and index of the worker running on this thread, if any
+static thread_local const WorkStealingPool *currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+// ____________________________________________________________________________
+WorkStealingPool::WorkStealingPool(int numThreads) {
+  if (numThreads <= 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (int i = 0; i < numThreads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (int i = 0; i < numThreads; ++i) {
+    workers_[i]->thread = std::thread([this, i]() { work(i); });
+  }
+}
+
+// ____________________________________________________________________________
+WorkStealingPool::~WorkStealingPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  workAvailable_.notify_all();
+  for (auto &worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+// ____________________________________________________________________________
+void WorkStealingPool::submit(Task task) {
+  int index = currentPool == this
+                  ? currentWorker
+                  : nextWorker_.fetch_add(1, std::memory_order_relaxed) %
+                        workers_.size();
+  pending_.fetch_add(1);
+  {
+    Worker &worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  // A worker that goes to sleep counts itself before it checks queued_, so
+  // either it sees the task or this sees it sleeping.
+  queued_.fetch_add(1);
+  if (sleeping_.load() > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    workAvailable_.notify_one();
+  }
+}
+
+// ____________________________________________________________________________
+void WorkStealingPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  allDone_.wait(lock, [this]() { return pending_.load() == 0; });
+}
+
+// ____________________________________________________________________________
+void WorkStealingPool::work(int index) {
+  currentPool = this;
+  currentWorker = index;
+  Task task;
+  while (true) {
+    if (take(index, &task)) {
+      task(index);
+      task = nullptr;
+      if (pending_.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        allDone_.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    sleeping_.fetch_add(1);
+    workAvailable_.wait(
+        lock, [this]() { return stopping_ || queued_.load() > 0; });
+    sleeping_.fetch_sub(1);
+    if (stopping_) {
+      return;
+    }
+  }
+}
+
+// ____________________________________________________________________________
+bool WorkStealingPool::take(int index, Task *task) {
+  int numWorkers = workers_.size();
+  for (int i = 0; i < numWorkers; ++i) {
+    Worker &worker = *workers_[(index + i) % numWorkers];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      *task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+    } else {
+      *task = std::move(worker.tasks.front());
+      worker.tasks.pop_front();
+      steals_.fetch_add(1, std::memory_order_relaxed);
+    }
+    queued_.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,71 @@
+// Copyright (C)
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A thread pool where every worker has its own deque of tasks. A worker takes
+// the newest task of its own deque and, when that is empty, steals the oldest
+// task of another worker. Tasks submitted from a task go to the deque of its
+// worker, so recursive work stays local and only idle workers touch the
+// deques of others. Workers without anything to do sleep.
+class WorkStealingPool {
+public:
+  // A task gets the index of the worker that runs it, e.g. to write to
+  // per-worker results without locks.
+  using Task = std::function<void(int worker)>;
+
+  // Zero threads means one per core.
+  explicit WorkStealingPool(int numThreads = 0);
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  // Queue a task, from any thread. From a task of this pool it goes to the
+  // deque of the worker, otherwise the workers take turns.
+  void submit(Task task);
+
+  // Wait until all submitted tasks, also those submitted by tasks, are done.
+  void wait();
+
+  int numThreads() const { return workers_.size(); }
+
+  // Tasks that were taken from the deque of another worker
+  uint64_t steals() const { return steals_; }
+
+private:
+  // On its own cache line, so workers do not slow each other down.
+  struct alignas(64) Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  // Main loop of a worker thread.
+  void work(int index);
+
+  // Take the newest task of the own deque or steal the oldest one of another.
+  bool take(int index, Task *task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // Tasks in the deques and tasks that are not done yet
+  std::atomic<int64_t> queued_{0};
+  std::atomic<int64_t> pending_{0};
+  std::atomic<int> sleeping_{0};
+  std::atomic<uint64_t> nextWorker_{0};
+  std::atomic<uint64_t> steals_{0};
+  bool stopping_{false};
+  // For sleeping workers and wait()
+  std::mutex mutex_;
+  std::condition_variable workAvailable_;
+  std::condition_variable allDone_;
+};